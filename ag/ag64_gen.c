@@ -0,0 +1,618 @@
+#include <stdint.h>
+#include "ag/ag64_gen.h"
+#include "ag/ag_internal.h"
+
+#define emit4 ag_emit4
+
+void
+ag64_emitter_init(struct ag_Emitter *e)
+{
+    ag_emitter_init(e);
+    e->isa = AG_ISA_A64;
+}
+
+/* add/sub/logical (shifted register) */
+static void
+emit_shifted_reg(struct ag_Emitter *e, uint32_t opc, int sf, int rd, int rn, int rm, int shift, int amount)
+{
+    emit4(e, opc | (sf<<31) | (shift<<22) | (rm<<16) | ((amount&0x3f)<<10) | (rn<<5) | rd);
+}
+
+#define SHIFTED_REG(name, opc)                                          \
+    void                                                                \
+    ag64_emit_##name##_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount) \
+    {                                                                   \
+        emit_shifted_reg(e, opc, sf, rd, rn, rm, shift, amount);        \
+    }
+
+SHIFTED_REG(add, 0x0b000000)
+SHIFTED_REG(adds, 0x2b000000)
+SHIFTED_REG(sub, 0x4b000000)
+SHIFTED_REG(subs, 0x6b000000)
+SHIFTED_REG(and, 0x0a000000)
+SHIFTED_REG(orr, 0x2a000000)
+SHIFTED_REG(eor, 0x4a000000)
+SHIFTED_REG(ands, 0x6a000000)
+
+static int
+emit_addsub_imm(struct ag_Emitter *e, uint32_t opc, int sf, int rd, int rn, uint32_t imm)
+{
+    int sh = 0;
+
+    if (imm > 0xfff) {
+        if ((imm & 0xfff) || imm > (0xfff<<12)) {
+            return -1;
+        }
+        imm >>= 12;
+        sh = 1;
+    }
+
+    emit4(e, opc | (sf<<31) | (sh<<22) | (imm<<10) | (rn<<5) | rd);
+
+    return 0;
+}
+
+#define ADDSUB_IMM(name, opc)                                           \
+    int                                                                 \
+    ag64_emit_##name##_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint32_t imm) \
+    {                                                                   \
+        return emit_addsub_imm(e, opc, sf, rd, rn, imm);                \
+    }
+
+ADDSUB_IMM(add, 0x11000000)
+ADDSUB_IMM(adds, 0x31000000)
+ADDSUB_IMM(sub, 0x51000000)
+ADDSUB_IMM(subs, 0x71000000)
+
+static uint64_t
+ror_elem(uint64_t v, int r, int size)
+{
+    uint64_t mask = (size == 64) ? ~0ULL : ((1ULL<<size) - 1);
+    if (r == 0) {
+        return v;
+    }
+    return ((v >> r) | (v << (size - r))) & mask;
+}
+
+int
+ag64_encode_bitmask_imm(uint64_t imm, int sf)
+{
+    if (! sf) {
+        if (imm >> 32) {
+            return -1;
+        }
+        imm |= imm << 32;
+    }
+
+    if (imm == 0 || imm == ~0ULL) {
+        return -1;
+    }
+
+    /* smallest repeating element */
+    int size = 64;
+    while (size > 2) {
+        int half = size / 2;
+        uint64_t mask = (1ULL<<half) - 1;
+        if ((imm & mask) != ((imm >> half) & mask)) {
+            break;
+        }
+        size = half;
+    }
+
+    uint64_t elem = imm & ((size == 64) ? ~0ULL : ((1ULL<<size) - 1));
+    int ones = __builtin_popcountll(elem);
+    uint64_t run = (ones == 64) ? ~0ULL : ((1ULL<<ones) - 1);
+
+    /* elem must be rotated run of ones */
+    for (int r=0; r<size; r++) {
+        if (ror_elem(run, r, size) == elem) {
+            int n = (size == 64);
+            int imms = ((~(size-1) << 1) | (ones-1)) & 0x3f;
+            return (n<<12) | (r<<6) | imms;
+        }
+    }
+
+    return -1;
+}
+
+static int
+emit_logical_imm(struct ag_Emitter *e, uint32_t opc, int sf, int rd, int rn, uint64_t imm)
+{
+    int field = ag64_encode_bitmask_imm(imm, sf);
+    if (field < 0) {
+        return -1;
+    }
+
+    emit4(e, opc | (sf<<31) | (field<<10) | (rn<<5) | rd);
+
+    return 0;
+}
+
+#define LOGICAL_IMM(name, opc)                                          \
+    int                                                                 \
+    ag64_emit_##name##_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint64_t imm) \
+    {                                                                   \
+        return emit_logical_imm(e, opc, sf, rd, rn, imm);               \
+    }
+
+LOGICAL_IMM(and, 0x12000000)
+LOGICAL_IMM(orr, 0x32000000)
+LOGICAL_IMM(eor, 0x52000000)
+LOGICAL_IMM(ands, 0x72000000)
+
+void
+ag64_emit_cmp_reg(struct ag_Emitter *e, int sf, int rn, int rm)
+{
+    ag64_emit_subs_reg(e, sf, AG64_ZR, rn, rm, AG_SHIFT_LOG_LEFT, 0);
+}
+
+int
+ag64_emit_cmp_imm(struct ag_Emitter *e, int sf, int rn, uint32_t imm)
+{
+    return ag64_emit_subs_imm(e, sf, AG64_ZR, rn, imm);
+}
+
+void
+ag64_emit_mov_reg(struct ag_Emitter *e, int sf, int rd, int rm)
+{
+    ag64_emit_orr_reg(e, sf, rd, AG64_ZR, rm, AG_SHIFT_LOG_LEFT, 0);
+}
+
+void
+ag64_emit_madd(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int ra)
+{
+    emit4(e, 0x1b000000 | (sf<<31) | (rm<<16) | (ra<<10) | (rn<<5) | rd);
+}
+
+void
+ag64_emit_msub(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int ra)
+{
+    emit4(e, 0x1b008000 | (sf<<31) | (rm<<16) | (ra<<10) | (rn<<5) | rd);
+}
+
+void
+ag64_emit_mul(struct ag_Emitter *e, int sf, int rd, int rn, int rm)
+{
+    ag64_emit_madd(e, sf, rd, rn, rm, AG64_ZR);
+}
+
+/* data-processing (2 source) */
+#define DP2(name, opc)                                                  \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int sf, int rd, int rn, int rm) \
+    {                                                                   \
+        emit4(e, opc | (sf<<31) | (rm<<16) | (rn<<5) | rd);             \
+    }
+
+DP2(udiv, 0x1ac00800)
+DP2(sdiv, 0x1ac00c00)
+DP2(lslv, 0x1ac02000)
+DP2(lsrv, 0x1ac02400)
+DP2(asrv, 0x1ac02800)
+DP2(rorv, 0x1ac02c00)
+
+#define MOVE_WIDE(name, opc)                                            \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int sf, int rd, int imm16, int hw) \
+    {                                                                   \
+        emit4(e, opc | (sf<<31) | (hw<<21) | ((imm16&0xffff)<<5) | rd); \
+    }
+
+MOVE_WIDE(movn, 0x12800000)
+MOVE_WIDE(movz, 0x52800000)
+MOVE_WIDE(movk, 0x72800000)
+
+void
+ag64_emit_mov_imm(struct ag_Emitter *e, int sf, int rd, uint64_t imm)
+{
+    int nhw = sf ? 4 : 2;
+    int num_zero = 0, num_ones = 0;
+
+    if (! sf) {
+        imm &= 0xffffffff;
+    }
+
+    for (int i=0; i<nhw; i++) {
+        int hw = (imm >> (i*16)) & 0xffff;
+        num_zero += (hw == 0);
+        num_ones += (hw == 0xffff);
+    }
+
+    /* one instruction */
+    if (num_zero >= nhw-1 || num_ones >= nhw-1) {
+        /* movz / movn below */
+    } else if (ag64_encode_bitmask_imm(imm, sf) >= 0) {
+        ag64_emit_orr_imm(e, sf, rd, AG64_ZR, imm);
+        return;
+    }
+
+    /* movz + movk for non-zero halfwords, or movn + movk for non-ffff */
+    int inv = num_ones > num_zero;
+    int skip = inv ? 0xffff : 0;
+    int first = 1;
+
+    for (int i=0; i<nhw; i++) {
+        int hw = (imm >> (i*16)) & 0xffff;
+        if (hw == skip) {
+            continue;
+        }
+
+        if (first) {
+            if (inv) {
+                ag64_emit_movn(e, sf, rd, ~hw & 0xffff, i);
+            } else {
+                ag64_emit_movz(e, sf, rd, hw, i);
+            }
+            first = 0;
+        } else {
+            ag64_emit_movk(e, sf, rd, hw, i);
+        }
+    }
+
+    if (first) {
+        /* all halfwords are skip value : 0 or ~0 */
+        if (inv) {
+            ag64_emit_movn(e, sf, rd, 0, 0);
+        } else {
+            ag64_emit_movz(e, sf, rd, 0, 0);
+        }
+    }
+}
+
+void
+ag64_emit_nop(struct ag_Emitter *e)
+{
+    emit4(e, 0xd503201f);
+}
+
+/* load/store register (unsigned immediate) */
+static int
+emit_ldst_uimm(struct ag_Emitter *e, uint32_t opc, int scale, int rt, int rn, uint32_t imm)
+{
+    if (imm & ((1<<scale)-1)) {
+        return -1;
+    }
+    imm >>= scale;
+    if (imm > 0xfff) {
+        return -1;
+    }
+
+    emit4(e, opc | (imm<<10) | (rn<<5) | rt);
+
+    return 0;
+}
+
+int
+ag64_emit_ldr_imm(struct ag_Emitter *e, int size, int rt, int rn, uint32_t imm)
+{
+    return emit_ldst_uimm(e, 0x39400000 | (size<<30), size, rt, rn, imm);
+}
+
+int
+ag64_emit_str_imm(struct ag_Emitter *e, int size, int rt, int rn, uint32_t imm)
+{
+    return emit_ldst_uimm(e, 0x39000000 | (size<<30), size, rt, rn, imm);
+}
+
+/* SIMD&FP : size 4 (q) is size=0, opc=1x */
+static uint32_t
+v_size_bits(int size)
+{
+    if (size == 4) {
+        return 0x00800000;
+    }
+    return size<<30;
+}
+
+int
+ag64_emit_ldr_v_imm(struct ag_Emitter *e, int size, int vt, int rn, uint32_t imm)
+{
+    return emit_ldst_uimm(e, 0x3d400000 | v_size_bits(size), size, vt, rn, imm);
+}
+
+int
+ag64_emit_str_v_imm(struct ag_Emitter *e, int size, int vt, int rn, uint32_t imm)
+{
+    return emit_ldst_uimm(e, 0x3d000000 | v_size_bits(size), size, vt, rn, imm);
+}
+
+/* [rn, rm{, lsl #size}] */
+void
+ag64_emit_ldr_reg(struct ag_Emitter *e, int size, int rt, int rn, int rm, int scaled)
+{
+    emit4(e, 0x38606800 | (size<<30) | (rm<<16) | ((scaled?1:0)<<12) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_str_reg(struct ag_Emitter *e, int size, int rt, int rn, int rm, int scaled)
+{
+    emit4(e, 0x38206800 | (size<<30) | (rm<<16) | ((scaled?1:0)<<12) | (rn<<5) | rt);
+}
+
+/* load/store pair. opc : 2bit size field, v : SIMD&FP, scale : log2 of element bytes */
+static int
+emit_ldst_pair(struct ag_Emitter *e, int opc, int v, int l, int scale,
+               int rt, int rt2, int rn, int imm, enum ag64_index idx)
+{
+    static const int idx_bits[] = {2, 1, 3};
+
+    if (imm & ((1<<scale)-1)) {
+        return -1;
+    }
+    imm >>= scale;
+    if (imm < -64 || imm > 63) {
+        return -1;
+    }
+
+    emit4(e, (opc<<30) | 0x28000000 | (v<<26) | (idx_bits[idx]<<23) | (l<<22) |
+          ((imm&0x7f)<<15) | (rt2<<10) | (rn<<5) | rt);
+
+    return 0;
+}
+
+int
+ag64_emit_ldp(struct ag_Emitter *e, int sf, int rt, int rt2, int rn, int imm, enum ag64_index idx)
+{
+    return emit_ldst_pair(e, sf ? 2 : 0, 0, 1, sf ? 3 : 2, rt, rt2, rn, imm, idx);
+}
+
+int
+ag64_emit_stp(struct ag_Emitter *e, int sf, int rt, int rt2, int rn, int imm, enum ag64_index idx)
+{
+    return emit_ldst_pair(e, sf ? 2 : 0, 0, 0, sf ? 3 : 2, rt, rt2, rn, imm, idx);
+}
+
+int
+ag64_emit_ldp_v(struct ag_Emitter *e, int size, int vt, int vt2, int rn, int imm, enum ag64_index idx)
+{
+    return emit_ldst_pair(e, size-2, 1, 1, size, vt, vt2, rn, imm, idx);
+}
+
+int
+ag64_emit_stp_v(struct ag_Emitter *e, int size, int vt, int vt2, int rn, int imm, enum ag64_index idx)
+{
+    return emit_ldst_pair(e, size-2, 1, 0, size, vt, vt2, rn, imm, idx);
+}
+
+void
+ag64_emit_ldr_literal(struct ag_Emitter *e, int rt, uint32_t val)
+{
+    ag_emit_pool_load(e, 0x18000000 | rt, LABELREF_TYPE_A64_B19, val, AG_NO_LABEL);
+}
+
+void
+ag64_emit_ldxr(struct ag_Emitter *e, int size, int rt, int rn)
+{
+    emit4(e, 0x085f7c00 | (size<<30) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_ldaxr(struct ag_Emitter *e, int size, int rt, int rn)
+{
+    emit4(e, 0x085ffc00 | (size<<30) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_stxr(struct ag_Emitter *e, int size, int rs, int rt, int rn)
+{
+    emit4(e, 0x08007c00 | (size<<30) | (rs<<16) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_stlxr(struct ag_Emitter *e, int size, int rs, int rt, int rn)
+{
+    emit4(e, 0x0800fc00 | (size<<30) | (rs<<16) | (rn<<5) | rt);
+}
+
+/* atomic memory operations : A = bit 23, R = bit 22 */
+static void
+emit_lse(struct ag_Emitter *e, uint32_t opc, int size, int order, int rs, int rt, int rn)
+{
+    emit4(e, opc | (size<<30) | ((order&AG64_ACQ)?1<<23:0) | ((order&AG64_REL)?1<<22:0) |
+          (rs<<16) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_ldadd(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn)
+{
+    emit_lse(e, 0x38200000, size, order, rs, rt, rn);
+}
+
+void
+ag64_emit_swp(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn)
+{
+    emit_lse(e, 0x38208000, size, order, rs, rt, rn);
+}
+
+void
+ag64_emit_cas(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn)
+{
+    /* L (acquire) = bit 22, o0 (release) = bit 15 */
+    emit4(e, 0x08a07c00 | (size<<30) | ((order&AG64_ACQ)?1<<22:0) | ((order&AG64_REL)?1<<15:0) |
+          (rs<<16) | (rn<<5) | rt);
+}
+
+void
+ag64_emit_b(struct ag_Emitter *e, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x14000000, LABELREF_TYPE_A64_B26, dst);
+}
+
+void
+ag64_emit_bl(struct ag_Emitter *e, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x94000000, LABELREF_TYPE_A64_B26, dst);
+}
+
+void
+ag64_emit_b_cond(struct ag_Emitter *e, enum ag_cond cc, ag_label_id_t dst)
+{
+    uint32_t off;
+
+    /* half of 19bit range, pool flush may come in between */
+    if (ag_label_offset(e, dst, &off) && e->cur - off >= (1<<17)) {
+        /* skip is a label : pool may be flushed between two branches */
+        ag_label_id_t skip = ag_alloc_label(e, NULL);
+        ag_emit4_ref(e, 0x54000000 | (cc^1), LABELREF_TYPE_A64_B19, skip);
+        ag64_emit_b(e, dst);
+        ag_emit_label(e, skip);
+        return;
+    }
+
+    ag_emit4_ref(e, 0x54000000 | cc, LABELREF_TYPE_A64_B19, dst);
+}
+
+void
+ag64_emit_cbz(struct ag_Emitter *e, int sf, int rt, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x34000000 | (sf<<31) | rt, LABELREF_TYPE_A64_B19, dst);
+}
+
+void
+ag64_emit_cbnz(struct ag_Emitter *e, int sf, int rt, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x35000000 | (sf<<31) | rt, LABELREF_TYPE_A64_B19, dst);
+}
+
+void
+ag64_emit_tbz(struct ag_Emitter *e, int rt, int bit, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x36000000 | ((bit>>5)<<31) | ((bit&0x1f)<<19) | rt, LABELREF_TYPE_A64_B14, dst);
+}
+
+void
+ag64_emit_tbnz(struct ag_Emitter *e, int rt, int bit, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, 0x37000000 | ((bit>>5)<<31) | ((bit&0x1f)<<19) | rt, LABELREF_TYPE_A64_B14, dst);
+}
+
+void
+ag64_emit_br(struct ag_Emitter *e, int rn)
+{
+    emit4(e, 0xd61f0000 | (rn<<5));
+}
+
+void
+ag64_emit_blr(struct ag_Emitter *e, int rn)
+{
+    emit4(e, 0xd63f0000 | (rn<<5));
+}
+
+void
+ag64_emit_ret(struct ag_Emitter *e)
+{
+    emit4(e, 0xd65f0000 | (AG64_LR<<5));
+}
+
+/* AdvSIMD three same : 0 Q U 01110 size 1 Rm opcode 1 Rn Rd */
+static void
+emit_simd3(struct ag_Emitter *e, int q, int u, int size, int opcode, int vd, int vn, int vm)
+{
+    emit4(e, 0x0e200400 | (q<<30) | (u<<29) | (size<<22) | (vm<<16) | (opcode<<11) | (vn<<5) | vd);
+}
+
+#define SIMD3_INT(name, u, opcode)                                      \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int q, int size, int vd, int vn, int vm) \
+    {                                                                   \
+        emit_simd3(e, q, u, size, opcode, vd, vn, vm);                  \
+    }
+
+SIMD3_INT(vadd, 0, 0x10)
+SIMD3_INT(vsub, 1, 0x10)
+SIMD3_INT(vmul, 0, 0x13)
+SIMD3_INT(vmla, 0, 0x12)
+
+/* size field selects operation */
+#define SIMD3_LOGICAL(name, u, size)                                    \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int q, int vd, int vn, int vm) \
+    {                                                                   \
+        emit_simd3(e, q, u, size, 0x03, vd, vn, vm);                    \
+    }
+
+SIMD3_LOGICAL(vand, 0, 0)
+SIMD3_LOGICAL(vorr, 0, 2)
+SIMD3_LOGICAL(veor, 1, 0)
+
+/* size<1> is part of opcode, size<0> is sz */
+#define SIMD3_FP(name, u, size1, opcode)                                \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm) \
+    {                                                                   \
+        emit_simd3(e, q, u, (size1<<1) | dbl, opcode, vd, vn, vm);      \
+    }
+
+SIMD3_FP(vfadd, 0, 0, 0x1a)
+SIMD3_FP(vfsub, 0, 1, 0x1a)
+SIMD3_FP(vfmul, 1, 0, 0x1b)
+SIMD3_FP(vfdiv, 1, 0, 0x1f)
+SIMD3_FP(vfmla, 0, 0, 0x19)
+
+void
+ag64_emit_vscvtf(struct ag_Emitter *e, int q, int dbl, int vd, int vn)
+{
+    emit4(e, 0x0e21d800 | (q<<30) | (dbl<<22) | (vn<<5) | vd);
+}
+
+void
+ag64_emit_vfcvtzs(struct ag_Emitter *e, int q, int dbl, int vd, int vn)
+{
+    emit4(e, 0x0ea1b800 | (q<<30) | (dbl<<22) | (vn<<5) | vd);
+}
+
+/* floating-point data-processing (2 source) */
+#define FP2(name, opcode)                                               \
+    void                                                                \
+    ag64_emit_##name(struct ag_Emitter *e, int dbl, int vd, int vn, int vm) \
+    {                                                                   \
+        emit4(e, 0x1e200800 | (dbl<<22) | (vm<<16) | (opcode<<12) | (vn<<5) | vd); \
+    }
+
+FP2(fmul, 0x0)
+FP2(fdiv, 0x1)
+FP2(fadd, 0x2)
+FP2(fsub, 0x3)
+
+void
+ag64_emit_fmadd(struct ag_Emitter *e, int dbl, int vd, int vn, int vm, int va)
+{
+    emit4(e, 0x1f000000 | (dbl<<22) | (vm<<16) | (va<<10) | (vn<<5) | vd);
+}
+
+void
+ag64_emit_dup_gen(struct ag_Emitter *e, int q, int size, int vd, int rn)
+{
+    emit4(e, 0x0e000c00 | (q<<30) | ((1<<size)<<16) | (rn<<5) | vd);
+}
+
+void
+ag64_emit_movi_zero(struct ag_Emitter *e, int q, int vd)
+{
+    emit4(e, 0x2f00e400 | (q<<30) | vd);
+}
+
+/* opcode field of ld1/st1 (multiple structures) by number of registers */
+static const uint32_t ldst1_multi_opcode[5] = {0, 0x7, 0xa, 0x6, 0x2};
+
+static void
+emit_ldst1_multi(struct ag_Emitter *e, uint32_t opc, int q, int size, int vt, int nreg, int rn, int post)
+{
+    /* post index by immediate : Rm = 31 */
+    if (post) {
+        opc |= 0x00800000 | (31<<16);
+    }
+    emit4(e, opc | (q<<30) | (ldst1_multi_opcode[nreg]<<12) | (size<<10) | (rn<<5) | vt);
+}
+
+void
+ag64_emit_ld1_multi(struct ag_Emitter *e, int q, int size, int vt, int nreg, int rn, int post)
+{
+    emit_ldst1_multi(e, 0x0c400000, q, size, vt, nreg, rn, post);
+}
+
+void
+ag64_emit_st1_multi(struct ag_Emitter *e, int q, int size, int vt, int nreg, int rn, int post)
+{
+    emit_ldst1_multi(e, 0x0c000000, q, size, vt, nreg, rn, post);
+}
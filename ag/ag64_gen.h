@@ -0,0 +1,173 @@
+#ifndef AG64_GEN_H
+#define AG64_GEN_H
+
+/* AArch64 (A64) backend.
+ *
+ * uses struct ag_Emitter and its label / literal pool / publication
+ * functions (ag_gen.h). initialize with ag64_emitter_init instead of
+ * ag_emitter_init. conditions are enum ag_cond, shift types are
+ * AG_SHIFT_*.
+ *
+ * sf : 1 = 64bit (x register), 0 = 32bit (w register)
+ * size : 0 = 8bit, 1 = 16bit, 2 = 32bit, 3 = 64bit
+ * q : 1 = 128bit vector, 0 = 64bit vector
+ * dbl : 1 = double, 0 = single
+ */
+
+#include "ag/ag_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AG64_FP 29
+#define AG64_LR 30
+#define AG64_SP 31              /* as base register */
+#define AG64_ZR 31              /* as operand */
+
+void ag64_emitter_init(struct ag_Emitter *e);
+
+/* integer */
+void ag64_emit_add_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_adds_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_sub_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_subs_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_and_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_orr_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_eor_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+void ag64_emit_ands_reg(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int shift, int amount);
+
+/* imm : 0..4095, or multiple of 4096 up to 4095<<12. return negative if out of range */
+int ag64_emit_add_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint32_t imm);
+int ag64_emit_adds_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint32_t imm);
+int ag64_emit_sub_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint32_t imm);
+int ag64_emit_subs_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint32_t imm);
+
+/* return 13bit N:immr:imms field of logical immediate, negative if imm can't be encoded */
+int ag64_encode_bitmask_imm(uint64_t imm, int sf);
+
+int ag64_emit_and_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint64_t imm);
+int ag64_emit_orr_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint64_t imm);
+int ag64_emit_eor_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint64_t imm);
+int ag64_emit_ands_imm(struct ag_Emitter *e, int sf, int rd, int rn, uint64_t imm);
+
+void ag64_emit_cmp_reg(struct ag_Emitter *e, int sf, int rn, int rm);
+int ag64_emit_cmp_imm(struct ag_Emitter *e, int sf, int rn, uint32_t imm);
+void ag64_emit_mov_reg(struct ag_Emitter *e, int sf, int rd, int rm);
+
+void ag64_emit_madd(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int ra);
+void ag64_emit_msub(struct ag_Emitter *e, int sf, int rd, int rn, int rm, int ra);
+void ag64_emit_mul(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_udiv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_sdiv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_lslv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_lsrv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_asrv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+void ag64_emit_rorv(struct ag_Emitter *e, int sf, int rd, int rn, int rm);
+
+/* hw : imm16 is shifted left by hw*16 */
+void ag64_emit_movz(struct ag_Emitter *e, int sf, int rd, int imm16, int hw);
+void ag64_emit_movn(struct ag_Emitter *e, int sf, int rd, int imm16, int hw);
+void ag64_emit_movk(struct ag_Emitter *e, int sf, int rd, int imm16, int hw);
+
+/* rd = imm with fewest instructions : movz/movn + movk, or orr rd, zr, #bitmask */
+void ag64_emit_mov_imm(struct ag_Emitter *e, int sf, int rd, uint64_t imm);
+
+void ag64_emit_nop(struct ag_Emitter *e);
+
+/* load / store */
+enum ag64_index {
+    AG64_OFFSET,                /* [rn, #imm] */
+    AG64_POST_INDEX,            /* [rn], #imm */
+    AG64_PRE_INDEX,             /* [rn, #imm]! */
+};
+
+/* [rn, #imm], imm : unsigned, multiple of access size. return negative if out of range */
+int ag64_emit_ldr_imm(struct ag_Emitter *e, int size, int rt, int rn, uint32_t imm);
+int ag64_emit_str_imm(struct ag_Emitter *e, int size, int rt, int rn, uint32_t imm);
+/* [rn, rm] or [rn, rm, lsl #size] */
+void ag64_emit_ldr_reg(struct ag_Emitter *e, int size, int rt, int rn, int rm, int scaled);
+void ag64_emit_str_reg(struct ag_Emitter *e, int size, int rt, int rn, int rm, int scaled);
+
+/* sf : 32/64bit pair. imm : multiple of 4 or 8, -64..63 elements */
+int ag64_emit_ldp(struct ag_Emitter *e, int sf, int rt, int rt2, int rn, int imm, enum ag64_index idx);
+int ag64_emit_stp(struct ag_Emitter *e, int sf, int rt, int rt2, int rn, int imm, enum ag64_index idx);
+
+/* SIMD&FP register, size : 2 = s, 3 = d, 4 = q */
+int ag64_emit_ldr_v_imm(struct ag_Emitter *e, int size, int vt, int rn, uint32_t imm);
+int ag64_emit_str_v_imm(struct ag_Emitter *e, int size, int vt, int rn, uint32_t imm);
+int ag64_emit_ldp_v(struct ag_Emitter *e, int size, int vt, int vt2, int rn, int imm, enum ag64_index idx);
+int ag64_emit_stp_v(struct ag_Emitter *e, int size, int vt, int vt2, int rn, int imm, enum ag64_index idx);
+
+/* ldr wt, =val (literal pool) */
+void ag64_emit_ldr_literal(struct ag_Emitter *e, int rt, uint32_t val);
+
+/* exclusive / atomics. size : 2 or 3 */
+void ag64_emit_ldxr(struct ag_Emitter *e, int size, int rt, int rn);
+void ag64_emit_ldaxr(struct ag_Emitter *e, int size, int rt, int rn);
+/* rs : status (0 = success) */
+void ag64_emit_stxr(struct ag_Emitter *e, int size, int rs, int rt, int rn);
+void ag64_emit_stlxr(struct ag_Emitter *e, int size, int rs, int rt, int rn);
+
+/* LSE (ARMv8.1) */
+#define AG64_ACQ 2
+#define AG64_REL 1
+/* rt = [rn]; [rn] += rs. order : AG64_ACQ|AG64_REL */
+void ag64_emit_ldadd(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn);
+void ag64_emit_swp(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn);
+/* if ([rn] == rs) [rn] = rt; rs = old [rn] */
+void ag64_emit_cas(struct ag_Emitter *e, int size, int order, int rs, int rt, int rn);
+
+/* branch */
+void ag64_emit_b(struct ag_Emitter *e, ag_label_id_t dst);
+void ag64_emit_bl(struct ag_Emitter *e, ag_label_id_t dst);
+/* out of range backward target is reached with "b.!cc 1f; b dst; 1:" */
+void ag64_emit_b_cond(struct ag_Emitter *e, enum ag_cond cc, ag_label_id_t dst);
+void ag64_emit_cbz(struct ag_Emitter *e, int sf, int rt, ag_label_id_t dst);
+void ag64_emit_cbnz(struct ag_Emitter *e, int sf, int rt, ag_label_id_t dst);
+void ag64_emit_tbz(struct ag_Emitter *e, int rt, int bit, ag_label_id_t dst);
+void ag64_emit_tbnz(struct ag_Emitter *e, int rt, int bit, ag_label_id_t dst);
+void ag64_emit_br(struct ag_Emitter *e, int rn);
+void ag64_emit_blr(struct ag_Emitter *e, int rn);
+void ag64_emit_ret(struct ag_Emitter *e);
+
+/* AdvSIMD integer, size : 0..3 (mul, mla : 0..2) */
+void ag64_emit_vadd(struct ag_Emitter *e, int q, int size, int vd, int vn, int vm);
+void ag64_emit_vsub(struct ag_Emitter *e, int q, int size, int vd, int vn, int vm);
+void ag64_emit_vmul(struct ag_Emitter *e, int q, int size, int vd, int vn, int vm);
+void ag64_emit_vmla(struct ag_Emitter *e, int q, int size, int vd, int vn, int vm);
+void ag64_emit_vand(struct ag_Emitter *e, int q, int vd, int vn, int vm);
+void ag64_emit_vorr(struct ag_Emitter *e, int q, int vd, int vn, int vm);
+void ag64_emit_veor(struct ag_Emitter *e, int q, int vd, int vn, int vm);
+
+/* AdvSIMD floating point (vector) */
+void ag64_emit_vfadd(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm);
+void ag64_emit_vfsub(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm);
+void ag64_emit_vfmul(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm);
+void ag64_emit_vfdiv(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm);
+void ag64_emit_vfmla(struct ag_Emitter *e, int q, int dbl, int vd, int vn, int vm);
+void ag64_emit_vscvtf(struct ag_Emitter *e, int q, int dbl, int vd, int vn);
+void ag64_emit_vfcvtzs(struct ag_Emitter *e, int q, int dbl, int vd, int vn);
+
+/* scalar floating point */
+void ag64_emit_fadd(struct ag_Emitter *e, int dbl, int vd, int vn, int vm);
+void ag64_emit_fsub(struct ag_Emitter *e, int dbl, int vd, int vn, int vm);
+void ag64_emit_fmul(struct ag_Emitter *e, int dbl, int vd, int vn, int vm);
+void ag64_emit_fdiv(struct ag_Emitter *e, int dbl, int vd, int vn, int vm);
+/* vd = va + vn*vm */
+void ag64_emit_fmadd(struct ag_Emitter *e, int dbl, int vd, int vn, int vm, int va);
+
+/* dup vd.<size>, rn */
+void ag64_emit_dup_gen(struct ag_Emitter *e, int q, int size, int vd, int rn);
+/* movi vd, #0 */
+void ag64_emit_movi_zero(struct ag_Emitter *e, int q, int vd);
+
+/* ld1/st1 {vt, .. vt+nreg-1}, [rn] (post : [rn], #bytes) */
+void ag64_emit_ld1_multi(struct ag_Emitter *e, int q, int size, int vt, int nreg, int rn, int post);
+void ag64_emit_st1_multi(struct ag_Emitter *e, int q, int size, int vt, int nreg, int rn, int post);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
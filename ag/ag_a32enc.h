@@ -0,0 +1,217 @@
+#ifndef AG_A32ENC_H
+#define AG_A32ENC_H
+
+/* C++ encoders of ag_a32.def rows (C++ only)
+ *
+ * ag_enc_<name>_<dt>::enc(operands) is the A32 word, constexpr. operands
+ * are same as ag_emit_<name>_<dt> (ag_gen.h). with constant operands
+ *
+ *   AG_EMIT_CONST(e, ag_enc_vadd_i32::enc(1, 0, 1, 2));
+ *
+ * the word and its T32 form are computed at compile time, and emission
+ * is one ag_emit4 of a constant. out of range register is compile error
+ * there, abort at run time (ag_emit_simd(e, ag_enc_*::enc(..))).
+ *
+ * reserved encodings (_f64, _p16, _p32) have no encoder. VFP rows are
+ * ag_enc_vfp_<name>_<dt>. vmov between core and SIMD registers is not a
+ * row, it has C emitters only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ag/ag_gen.h"
+#include "ag/ag_internal.h"
+
+/* not constexpr, constant evaluation reaching here fails to compile */
+static inline uint32_t
+ag_enc_operand_error(const char *insn)
+{
+    fprintf(stderr, "%s : operand out of range\n", insn);
+    abort();
+}
+
+template <uint32_t a32, uint32_t t32>
+static inline void
+ag_emit_const_word(struct ag_Emitter *e)
+{
+    ag_emit4(e, e->isa == AG_ISA_T32 ? t32 : a32);
+}
+
+#define AG_EMIT_CONST(e, word) ag_emit_const_word<(word), AG_SIMD_T32(word)>(e)
+
+/* q register number to d register number */
+#define AG_ENC_DREG(q, r) ((q) ? (r)*2 : (r))
+
+#define AG_ENC_3SAME(dt, size, rsv, name, U, A, B, C, regs, isa)         \
+    AG_ENC_3SAME_##rsv(dt, size, name, U, A, B, C, regs, isa)
+#define AG_ENC_3SAME_1(...)
+#define AG_ENC_3SAME_0(dt, size, name, U, A, B, C, regs, isa)           \
+struct ag_enc_##name##_##dt {                                           \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int q, int vd, int vn, int vm)                                  \
+    {                                                                   \
+        return ((!q || AG_NEON_Q_OK_##regs) &&                          \
+                AG_NEON_DREG_OK(q, AG_ENC_DREG(q, vd)) &&                 \
+                AG_NEON_DREG_OK(q, AG_ENC_DREG(q, vn)) &&                 \
+                AG_NEON_DREG_OK(q, AG_ENC_DREG(q, vm)))                   \
+            ? AG_NEON_VR3_WORD(AG_NEON_3SAME_OPC(U, A, B, C), q, size,  \
+                               AG_ENC_DREG(q, vd), AG_ENC_DREG(q, vn), AG_ENC_DREG(q, vm)) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_ENC_3DIFF(dt, size, rsv, name, U, A, regs, isa)              \
+    AG_ENC_3DIFF_##rsv(dt, size, name, U, A, regs, isa)
+#define AG_ENC_3DIFF_1(...)
+#define AG_ENC_3DIFF_0(dt, size, name, U, A, regs, isa)                 \
+struct ag_enc_##name##_##dt {                                           \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int q, int vd, int vn, int vm)                                  \
+    {                                                                   \
+        return (q == 0 && AG_NEON_DREG_OK(AG_NEON_QD_##regs, vd) &&     \
+                AG_NEON_DREG_OK(AG_NEON_QN_##regs, vn) &&               \
+                AG_NEON_DREG_OK(AG_NEON_QM_##regs, vm))                 \
+            ? AG_NEON_VR3_WORD(AG_NEON_3DIFF_OPC(U, A), 0, size, vd, vn, vm) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+/* q argument is allowed by regs column */
+#define AG_ENC_Q_OK(regs, q) ((q) ? AG_NEON_Q_OK_##regs : AG_NEON_D_OK_##regs)
+
+#define AG_ENC_SHIFT(dt, size, rsv, name, U, A, right, regs, isa)       \
+struct ag_enc_##name##_##dt {                                           \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int q, int vd, int vm, int n)                                   \
+    {                                                                   \
+        return (AG_ENC_Q_OK(regs, q) &&                                 \
+                AG_NEON_DREG_OK(q | AG_NEON_QD_##regs, vd) &&           \
+                AG_NEON_DREG_OK(q | AG_NEON_QM_##regs, vm) &&           \
+                (right ? (n >= 1 && n <= (8<<size)) : (n >= 0 && n < (8<<size)))) \
+            ? AG_NEON_SHIFT_WORD(AG_NEON_SHIFT_OPC(U, A), right, q, size, vd, vm, n) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_ENC_2MISC(dt, size, rsv, name, A, B, regs, isa)              \
+struct ag_enc_##name##_##dt {                                           \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int q, int vd, int vm)                                          \
+    {                                                                   \
+        return (AG_ENC_Q_OK(regs, q) &&                                 \
+                AG_NEON_DREG_OK(q | AG_NEON_QD_##regs, vd) &&           \
+                AG_NEON_DREG_OK(q | AG_NEON_QM_##regs, vm))             \
+            ? AG_NEON_2MISC_WORD(AG_NEON_2MISC_OPC(A, B), q, size, vd, vm) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_ENC_VTBL(name, op, isa)                                      \
+struct ag_enc_##name##_8 {                                              \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int vd, int vn, int nreg, int vm)                               \
+    {                                                                   \
+        return (AG_NEON_DREG_OK(0, vd) && AG_NEON_DREG_OK(0, vm) &&     \
+                nreg >= 1 && nreg <= 4 && vn >= 0 && vn + nreg <= 32)   \
+            ? AG_NEON_VTBL_WORD(AG_NEON_VTBL_OPC(op), vd, vn, nreg, vm) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+/* s0..s31, d0..d31 */
+#define AG_ENC_VFP_REG_OK(r) ((r) >= 0 && (r) <= 31)
+
+#define AG_ENC_VFP_3(dt, sz, rsv, name, A, op, isa)                     \
+struct ag_enc_vfp_##name##_##dt {                                       \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(enum ag_cond cc, int vd, int vn, int vm)                        \
+    {                                                                   \
+        return (AG_ENC_VFP_REG_OK(vd) && AG_ENC_VFP_REG_OK(vn) && AG_ENC_VFP_REG_OK(vm)) \
+            ? AG_VFP_WORD((uint32_t)cc, AG_VFP_3_OPC(A, op), sz, vd, vn, vm) \
+            : ag_enc_operand_error("v" #name);                          \
+    }                                                                   \
+};
+
+#define AG_ENC_VFP_2(dt, sz, rsv, name, A, B, isa)                      \
+struct ag_enc_vfp_##name##_##dt {                                       \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(enum ag_cond cc, int vd, int vm)                                \
+    {                                                                   \
+        return (AG_ENC_VFP_REG_OK(vd) && AG_ENC_VFP_REG_OK(vm))         \
+            ? AG_VFP_WORD((uint32_t)cc, AG_VFP_2_OPC(A, B), sz, vd, 0, vm) \
+            : ag_enc_operand_error("v" #name);                          \
+    }                                                                   \
+};
+
+#define AG_ENC_DUP(name, size, B, E, isa)                               \
+struct ag_enc_##name##size {                                            \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(enum ag_cond cc, int q, int vd, int rt)                         \
+    {                                                                   \
+        return (AG_NEON_DREG_OK(q, vd) && rt >= 0 && rt <= 14)          \
+            ? AG_NEON_DUP_WORD((uint32_t)cc, AG_NEON_DUP_OPC(B, E), q, vd, rt) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_ENC_CVT(name, dt, op, isa)                                   \
+struct ag_enc_##name##_##dt {                                           \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int q, int vd, int vm)                                          \
+    {                                                                   \
+        return (AG_NEON_DREG_OK(q, vd) && AG_NEON_DREG_OK(q, vm))       \
+            ? AG_NEON_CVT_WORD(AG_NEON_CVT_OPC(op), q, vd, vm)          \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_ENC_LDST_LANE(type, size, name, nelem, L, isa)               \
+struct ag_enc_##name##nelem##_##type {                                  \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int vd, int rn, int rm, int align)                              \
+    {                                                                   \
+        return (AG_NEON_DREG_OK(0, vd) && rn >= 0 && rn <= 15 &&        \
+                rm >= 0 && rm <= 15 && align >= 0 && align <= 15)       \
+            ? AG_NEON_LDST_LANE_WORD(AG_NEON_LDST_LANE_OPC(nelem, L), size, vd, rn, rm, align) \
+            : ag_enc_operand_error(#name #nelem);                       \
+    }                                                                   \
+};
+
+#define AG_ENC_LDST_MULTI(type, size, name, L, isa)                     \
+struct ag_enc_##name##_multi_##type {                                   \
+    static constexpr int feature = AG_A32_FEAT_##isa;                   \
+    static constexpr uint32_t                                           \
+    enc(int vd, int nreg, int rn, int rm, int align)                    \
+    {                                                                   \
+        return (nreg >= 1 && nreg <= 4 && vd >= 0 && vd + nreg <= 32 && \
+                rn >= 0 && rn <= 15 && rm >= 0 && rm <= 15 &&           \
+                align >= 0 && align <= 3)                               \
+            ? AG_NEON_LDST_MULTI_WORD(AG_NEON_LDST_MULTI_OPC(L), size, vd, nreg, rn, rm, align) \
+            : ag_enc_operand_error(#name);                              \
+    }                                                                   \
+};
+
+#define AG_NEON_3SAME(name, dt, ...) AG_NEON_DT_##dt(AG_ENC_3SAME, name, __VA_ARGS__)
+#define AG_NEON_3DIFF(name, dt, ...) AG_NEON_DT_##dt(AG_ENC_3DIFF, name, __VA_ARGS__)
+#define AG_NEON_DUP AG_ENC_DUP
+#define AG_NEON_CVT AG_ENC_CVT
+#define AG_NEON_LDST_LANE(...) AG_NEON_LANE_SIZES(AG_ENC_LDST_LANE, __VA_ARGS__)
+#define AG_NEON_LDST_MULTI(...) AG_NEON_MULTI_SIZES(AG_ENC_LDST_MULTI, __VA_ARGS__)
+#define AG_NEON_SHIFT(name, dt, ...) AG_NEON_DT_##dt(AG_ENC_SHIFT, name, __VA_ARGS__)
+#define AG_NEON_2MISC(name, dt, ...) AG_NEON_DT_##dt(AG_ENC_2MISC, name, __VA_ARGS__)
+#define AG_NEON_VTBL AG_ENC_VTBL
+#define AG_VFP_3(name, ...) AG_VFP_DT(AG_ENC_VFP_3, name, __VA_ARGS__)
+#define AG_VFP_2(name, ...) AG_VFP_DT(AG_ENC_VFP_2, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+
+#endif
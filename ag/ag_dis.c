@@ -0,0 +1,1220 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "ag/ag_dis.h"
+
+/* field extraction, lo is lowest bit */
+#define BITS(v, lo, n) (((v) >> (lo)) & ((1U<<(n))-1))
+#define BIT(v, n) BITS(v, n, 1)
+
+/* D:Vd (22, 15:12), N:Vn (7, 19:16), M:Vm (5, 3:0) */
+#define NEON_VD(v) ((BIT(v, 22)<<4) | BITS(v, 12, 4))
+#define NEON_VN(v) ((BIT(v, 7)<<4) | BITS(v, 16, 4))
+#define NEON_VM(v) ((BIT(v, 5)<<4) | BITS(v, 0, 4))
+
+/* VFP register number from D:Vd .. value, s<n> is Vd:D */
+#define VFP_REG(sz, x) ((sz) ? (x) : ((((x)&0xf)<<1) | ((x)>>4)))
+
+static const char *const cond_name[16] = {
+    "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+    "hi", "ls", "ge", "lt", "gt", "le", "", "",
+};
+
+static const char *const reg_name[16] = {
+    "r0", "r1", "r2", "r3", "r4", "r5", "r6", "r7",
+    "r8", "r9", "r10", "r11", "r12", "sp", "lr", "pc",
+};
+
+/* opcode field (24:21), same order as enum ag_data_process_opcode */
+static const char *const dp_name[16] = {
+    "and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+    "tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn",
+};
+
+static const char *const shift_name[4] = {"lsl", "lsr", "asr", "ror"};
+
+/* [T][B][L] */
+static const char *const ldst_name[2][2][2] = {
+    {{"str", "ldr"}, {"strb", "ldrb"}},
+    {{"strt", "ldrt"}, {"strbt", "ldrbt"}},
+};
+
+/* [L][n-1] */
+static const char *const vldst_name[2][4] = {
+    {"vst1", "vst2", "vst3", "vst4"},
+    {"vld1", "vld2", "vld3", "vld4"},
+};
+
+/* NEON data type by size field */
+static const char *const dt_i[4] = {"i8", "i16", "i32", "i64"};
+static const char *const dt_s[4] = {"s8", "s16", "s32", "s64"};
+static const char *const dt_u[4] = {"u8", "u16", "u32", "u64"};
+static const char *const dt_bits[4] = {"8", "16", "32", "64"};
+
+static int
+decode_dp(uint32_t inst, struct ag_dis_insn *d)
+{
+    int opc = BITS(inst, 21, 4);
+
+    /* should-be-zero Rn of mov, mvn and Rd of tst..cmn */
+    if (((opc == AG_MOV || opc == AG_MVN) && BITS(inst, 16, 4) != 0) ||
+        (opc >= AG_TST && opc <= AG_CMN && BITS(inst, 12, 4) != 0))
+    {
+        return -1;
+    }
+
+    d->form = AG_DIS_DATA_PROCESS;
+    d->name = dp_name[opc];
+    d->s = BIT(inst, 20);
+    d->rn = BITS(inst, 16, 4);
+    d->rd = BITS(inst, 12, 4);
+
+    if (BIT(inst, 25)) {
+        /* imm8 ror (rot*2) */
+        uint32_t imm8 = BITS(inst, 0, 8);
+        int rot = BITS(inst, 8, 4) * 2;
+        d->imm = (imm8 >> rot) | (imm8 << ((32 - rot) & 31));
+    } else {
+        d->rm = BITS(inst, 0, 4);
+        d->shift = BITS(inst, 4, 8);
+    }
+
+    return 0;
+}
+
+static int
+decode_ldst(uint32_t inst, struct ag_dis_insn *d)
+{
+    int p = BIT(inst, 24);
+    int w = BIT(inst, 21);
+
+    if (BIT(inst, 25) && BIT(inst, 4)) {
+        /* media instructions */
+        return -1;
+    }
+
+    d->form = AG_DIS_LDST;
+    d->name = ldst_name[!p && w][BIT(inst, 22)][BIT(inst, 20)];
+    d->rn = BITS(inst, 16, 4);
+    d->rd = BITS(inst, 12, 4);
+    d->incr = inst & (AG_PRE_INCR | AG_OFFSET_ADDR);
+
+    if (BIT(inst, 25)) {
+        d->rm = BITS(inst, 0, 4);
+        d->shift = BITS(inst, 4, 8);
+        d->add = BIT(inst, 23);
+    } else {
+        d->imm = BIT(inst, 23) ? (int32_t)BITS(inst, 0, 12) : -(int32_t)BITS(inst, 0, 12);
+    }
+
+    return 0;
+}
+
+static int
+decode_vdup(uint32_t inst, struct ag_dis_insn *d)
+{
+    int be = (BIT(inst, 22)<<1) | BIT(inst, 5);
+
+    if (be == 3) {
+        return -1;
+    }
+
+    d->form = AG_DIS_VDUP;
+    d->name = "vdup";
+    d->size = 2 - be;
+    d->dt = dt_bits[d->size];
+    d->q = BIT(inst, 21);
+    d->vd = (BIT(inst, 7)<<4) | BITS(inst, 16, 4);
+    d->rd = BITS(inst, 12, 4);
+
+    if (d->q && (d->vd & 1)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_vr3(uint32_t inst, struct ag_dis_insn *d)
+{
+    int a = BITS(inst, 8, 4);
+    int b = BIT(inst, 4);
+    int u = BIT(inst, 24);
+    int op = BIT(inst, 21);     /* float : sz is bit 20 */
+    int size = BITS(inst, 20, 2);
+
+    d->form = AG_DIS_VR3;
+    d->q = BIT(inst, 6);
+    d->size = size;
+    d->vd = NEON_VD(inst);
+    d->vn = NEON_VN(inst);
+    d->vm = NEON_VM(inst);
+
+    switch (a) {
+    case 0x0:
+    case 0x2:
+        if (!b) {
+            /* vhadd, vhsub */
+            return -1;
+        }
+        d->name = a ? "vqsub" : "vqadd";
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+
+    case 0x4:
+        if (b) {
+            /* vqshl */
+            return -1;
+        }
+        d->name = "vshl";
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+
+    case 0x8:
+        if (b) {
+            return -1;
+        }
+        d->name = u ? "vsub" : "vadd";
+        d->dt = dt_i[size];
+        break;
+
+    case 0x9:
+        if (size == 3) {
+            return -1;
+        }
+        if (b == 0) {
+            d->name = u ? "vmls" : "vmla";
+            d->dt = dt_i[size];
+        } else {
+            d->name = "vmul";
+            if (u) {
+                if (size != 0) {
+                    return -1;
+                }
+                d->dt = "p8";
+            } else {
+                d->dt = dt_i[size];
+            }
+        }
+        break;
+
+    case 0xa:
+        if (d->q || size == 3) {
+            return -1;
+        }
+        d->name = b ? "vpmin" : "vpmax";
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+
+    case 0xc:
+        if (u || !b || BIT(inst, 20)) {
+            return -1;
+        }
+        d->name = op ? "vfms" : "vfma";
+        d->dt = "f32";
+        d->size = 0;
+        break;
+
+    case 0xd:
+        if (BIT(inst, 20)) {
+            return -1;
+        }
+        if (!u && !b) {
+            d->name = op ? "vsub" : "vadd";
+        } else if (!u && b) {
+            d->name = op ? "vmls" : "vmla";
+        } else if (u && b && !op) {
+            d->name = "vmul";
+        } else {
+            return -1;
+        }
+        d->dt = "f32";
+        d->size = 0;
+        break;
+
+    case 0xf:
+        if (!u || b || d->q || BIT(inst, 20)) {
+            return -1;
+        }
+        d->name = op ? "vpmin" : "vpmax";
+        d->dt = "f32";
+        d->size = 0;
+        break;
+
+    default:
+        return -1;
+    }
+
+    if (d->q && ((d->vd | d->vn | d->vm) & 1)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* 3 registers of different length by A field, NULL : not decoded */
+static const char *const vr3_diff_name[16] = {
+    "vaddl", "vaddw", "vsubl", "vsubw", "vaddhn", NULL, "vsubhn", NULL,
+    "vmlal", NULL, "vmlsl", NULL, "vmull", "vqdmull", "vmull", NULL,
+};
+
+static int
+decode_vr3_diff(uint32_t inst, struct ag_dis_insn *d)
+{
+    int a = BITS(inst, 8, 4);
+    int u = BIT(inst, 24);
+    int size = BITS(inst, 20, 2);
+
+    d->name = vr3_diff_name[a];
+    d->size = size;
+    d->vd = NEON_VD(inst);
+    d->vn = NEON_VN(inst);
+    d->vm = NEON_VM(inst);
+
+    if (d->name == NULL) {
+        return -1;
+    }
+
+    switch (a) {
+    case 0x1:
+    case 0x3:
+        d->form = AG_DIS_VR3_WIDE;
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+
+    case 0x4:
+    case 0x6:
+        if (u) {
+            /* vraddhn, vrsubhn */
+            return -1;
+        }
+        d->form = AG_DIS_VR3_NARROW;
+        d->dt = dt_i[size+1];
+        break;
+
+    case 0xd:
+        if (u || size == 0) {
+            return -1;
+        }
+        d->form = AG_DIS_VR3_LONG;
+        d->dt = dt_s[size];
+        break;
+
+    case 0xe:
+        if (u || size != 0) {
+            return -1;
+        }
+        d->form = AG_DIS_VR3_LONG;
+        d->dt = "p8";
+        break;
+
+    default:
+        d->form = AG_DIS_VR3_LONG;
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+    }
+
+    /* q register operands */
+    if ((d->form != AG_DIS_VR3_NARROW && (d->vd & 1)) ||
+        (d->form != AG_DIS_VR3_LONG && (d->vn & 1)) ||
+        (d->form == AG_DIS_VR3_NARROW && (d->vm & 1)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_vshift(uint32_t inst, struct ag_dis_insn *d)
+{
+    int a = BITS(inst, 8, 4);
+    int u = BIT(inst, 24);
+    int l = BIT(inst, 7);
+    int imm6 = BITS(inst, 16, 6);
+    int imm7 = (l<<6) | imm6;
+    int size, esize;
+
+    /* element size is the highest set bit of L:imm6 */
+    if (l) {
+        size = 3;
+    } else if (imm6 & 0x20) {
+        size = 2;
+    } else if (imm6 & 0x10) {
+        size = 1;
+    } else if (imm6 & 0x08) {
+        size = 0;
+    } else {
+        /* one register and modified immediate */
+        return -1;
+    }
+
+    esize = 8 << size;
+
+    d->q = BIT(inst, 6);
+    d->size = size;
+    d->vd = NEON_VD(inst);
+    d->vm = NEON_VM(inst);
+
+    switch (a) {
+    case 0x0:
+        d->form = AG_DIS_VSHIFT;
+        d->name = "vshr";
+        d->dt = u ? dt_u[size] : dt_s[size];
+        d->imm = 2*esize - imm7;
+        break;
+
+    case 0x5:
+        if (u) {
+            /* vsli */
+            return -1;
+        }
+        d->form = AG_DIS_VSHIFT;
+        d->name = "vshl";
+        d->dt = dt_i[size];
+        d->imm = imm7 - esize;
+        break;
+
+    case 0x8:
+        if (u || l || d->q) {
+            /* vqshrun, vrshrn */
+            return -1;
+        }
+        d->form = AG_DIS_VSHIFT_NARROW;
+        d->name = "vshrn";
+        d->dt = dt_i[size+1];
+        d->imm = 2*esize - imm7;
+        break;
+
+    case 0xa:
+        if (l || d->q) {
+            return -1;
+        }
+        d->form = AG_DIS_VSHIFT_LONG;
+        d->imm = imm7 - esize;
+        d->name = d->imm ? "vshll" : "vmovl";
+        d->dt = u ? dt_u[size] : dt_s[size];
+        break;
+
+    default:
+        return -1;
+    }
+
+    if ((d->q && ((d->vd | d->vm) & 1)) ||
+        (d->form == AG_DIS_VSHIFT_LONG && (d->vd & 1)) ||
+        (d->form == AG_DIS_VSHIFT_NARROW && (d->vm & 1)))
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_v2misc(uint32_t inst, struct ag_dis_insn *d)
+{
+    static const char *const perm_name[4] = {NULL, "vtrn", "vuzp", "vzip"};
+    int size = BITS(inst, 18, 2);
+    int a = BITS(inst, 16, 2);
+    int b = BITS(inst, 6, 5);
+
+    d->form = AG_DIS_V2MISC;
+    d->q = BIT(inst, 6);
+    d->size = size;
+    d->vd = NEON_VD(inst);
+    d->vm = NEON_VM(inst);
+
+    if (a == 2 && b >= 0x02 && b <= 0x07) {
+        d->name = perm_name[b >> 1];
+        /* d form of vuzp.32, vzip.32 is undefined */
+        if (size == 3 || (size == 2 && !d->q && b >= 0x04)) {
+            return -1;
+        }
+        d->dt = dt_bits[size];
+    } else if (a == 2 && b >= 0x08 && b <= 0x0b) {
+        if (size == 3) {
+            return -1;
+        }
+        d->form = AG_DIS_V2MISC_NARROW;
+        d->q = 0;
+        switch (b) {
+        case 0x08: d->name = "vmovn"; d->dt = dt_i[size+1]; break;
+        case 0x09: d->name = "vqmovun"; d->dt = dt_s[size+1]; break;
+        case 0x0a: d->name = "vqmovn"; d->dt = dt_s[size+1]; break;
+        default: d->name = "vqmovn"; d->dt = dt_u[size+1]; break;
+        }
+        if (d->vm & 1) {
+            return -1;
+        }
+        return 0;
+    } else if (a == 3 && size == 2 && (b & 0x18) == 0x10) {
+        d->name = (b & 2) ? "vrsqrte" : "vrecpe";
+        d->dt = (b & 4) ? "f32" : "u32";
+    } else {
+        return -1;
+    }
+
+    if (d->q && ((d->vd | d->vm) & 1)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_vtbl(uint32_t inst, struct ag_dis_insn *d)
+{
+    d->form = AG_DIS_VTBL;
+    d->name = BIT(inst, 6) ? "vtbx" : "vtbl";
+    d->dt = "8";
+    d->nreg = BITS(inst, 8, 2) + 1;
+    d->vd = NEON_VD(inst);
+    d->vn = NEON_VN(inst);
+    d->vm = NEON_VM(inst);
+
+    if (d->vn + d->nreg > 32) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_vcvt(uint32_t inst, struct ag_dis_insn *d)
+{
+    static const char *const dt[4] = {"f32.s32", "f32.u32", "s32.f32", "u32.f32"};
+
+    if (BITS(inst, 18, 2) != 2) {
+        return -1;
+    }
+
+    d->form = AG_DIS_VCVT;
+    d->name = "vcvt";
+    d->dt = dt[BITS(inst, 7, 2)];
+    d->size = 2;
+    d->q = BIT(inst, 6);
+    d->vd = NEON_VD(inst);
+    d->vm = NEON_VM(inst);
+
+    if (d->q && ((d->vd | d->vm) & 1)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/* register spacing of vld2..4 single lane */
+static int
+vldst_lane_inc(int size, int ia)
+{
+    if (size == 1) {
+        return BIT(ia, 1) ? 2 : 1;
+    }
+    if (size == 2) {
+        return BIT(ia, 2) ? 2 : 1;
+    }
+    return 1;
+}
+
+static int
+decode_vldst(uint32_t inst, struct ag_dis_insn *d)
+{
+    int l = BIT(inst, 21);
+
+    d->rn = BITS(inst, 16, 4);
+    d->rm = BITS(inst, 0, 4);
+    d->vd = NEON_VD(inst);
+
+    if (BIT(inst, 23) == 0) {
+        int align = BITS(inst, 4, 2);
+
+        switch (BITS(inst, 8, 4)) {
+        case 0x7: d->nreg = 1; break;
+        case 0xa: d->nreg = 2; break;
+        case 0x6: d->nreg = 3; break;
+        case 0x2: d->nreg = 4; break;
+        default:
+            /* vld2..4 multiple structures */
+            return -1;
+        }
+
+        if (((d->nreg == 1 || d->nreg == 3) && (align & 2)) ||
+            (d->nreg == 2 && align == 3) ||
+            d->vd + d->nreg > 32)
+        {
+            return -1;
+        }
+
+        d->form = AG_DIS_VLDST_MULTI;
+        d->name = vldst_name[l][0];
+        d->size = BITS(inst, 6, 2);
+        d->dt = dt_bits[d->size];
+        d->align = align;
+        return 0;
+    }
+
+    int size = BITS(inst, 10, 2);
+    int n = BITS(inst, 8, 2) + 1;
+    int ia = BITS(inst, 4, 4);
+
+    if (size == 3) {
+        /* single element to all lanes */
+        return -1;
+    }
+
+    switch (n) {
+    case 1:
+        if ((size == 0 && (ia & 1)) ||
+            (size == 1 && (ia & 2)) ||
+            (size == 2 && ((ia & 4) || ((ia & 3) != 0 && (ia & 3) != 3))))
+        {
+            return -1;
+        }
+        break;
+    case 2:
+        if (size == 2 && (ia & 2)) {
+            return -1;
+        }
+        break;
+    case 3:
+        if ((size < 2 && (ia & 1)) || (size == 2 && (ia & 3))) {
+            return -1;
+        }
+        break;
+    case 4:
+        if (size == 2 && (ia & 3) == 3) {
+            return -1;
+        }
+        break;
+    }
+
+    if (d->vd + (n-1) * vldst_lane_inc(size, ia) > 31) {
+        return -1;
+    }
+
+    d->form = AG_DIS_VLDST_LANE;
+    d->name = vldst_name[l][n-1];
+    d->size = size;
+    d->dt = dt_bits[size];
+    d->nreg = n;
+    d->align = ia;
+    return 0;
+}
+
+static int
+decode_vfp(uint32_t inst, struct ag_dis_insn *d)
+{
+    int sz = BIT(inst, 8);
+    int a = BITS(inst, 20, 4) & 0xb; /* without D */
+    int op = BIT(inst, 6);
+
+    d->size = sz;
+    d->dt = sz ? "f64" : "f32";
+    d->vd = VFP_REG(sz, NEON_VD(inst));
+    d->vm = VFP_REG(sz, NEON_VM(inst));
+
+    if (a == 0xb) {
+        static const char *const name[2][4] = {
+            {NULL, "vmov", NULL, "vabs"},
+            {NULL, "vneg", NULL, "vsqrt"},
+        };
+        int opc2 = BITS(inst, 16, 4);
+        int opc3 = BITS(inst, 6, 2);
+
+        if (opc2 > 1 || name[opc2][opc3] == NULL) {
+            return -1;
+        }
+        d->form = AG_DIS_VFP2;
+        d->name = name[opc2][opc3];
+        return 0;
+    }
+
+    d->form = AG_DIS_VFP3;
+    d->vn = VFP_REG(sz, NEON_VN(inst));
+
+    switch (a) {
+    case 0x0: d->name = op ? "vmls" : "vmla"; break;
+    case 0x2: d->name = op ? "vnmul" : "vmul"; break;
+    case 0x3: d->name = op ? "vsub" : "vadd"; break;
+    case 0x8: d->name = op ? NULL : "vdiv"; break;
+    case 0xa: d->name = op ? "vfms" : "vfma"; break;
+    default: d->name = NULL; break;
+    }
+
+    return d->name ? 0 : -1;
+}
+
+/* vmov between core and VFP/NEON registers */
+static int
+decode_vmov_core(uint32_t inst, struct ag_dis_insn *d)
+{
+    d->name = "vmov";
+    d->to_core = BIT(inst, 20);
+    d->rd = BITS(inst, 12, 4);
+
+    if (BITS(inst, 24, 4) == 0xc) {
+        d->form = AG_DIS_VMOV_RR;
+        d->rn = BITS(inst, 16, 4);
+        d->vm = NEON_VM(inst);
+        if (d->rn == AG_PC || (d->to_core && d->rd == d->rn)) {
+            return -1;
+        }
+    } else if (BIT(inst, 8)) {
+        d->form = AG_DIS_VMOV_SCALAR;
+        d->dt = "32";
+        d->vn = NEON_VN(inst);
+        d->imm = BIT(inst, 21);
+    } else {
+        d->form = AG_DIS_VMOV_S;
+        d->vn = VFP_REG(0, NEON_VN(inst));
+    }
+
+    if (d->rd == AG_PC) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+decode_neon(uint32_t inst, struct ag_dis_insn *d)
+{
+    if ((inst & 0xffb30e10) == 0xf3b30600) {
+        return decode_vcvt(inst, d);
+    }
+    if ((inst & 0xfe800000) == 0xf2000000) {
+        return decode_vr3(inst, d);
+    }
+    if ((inst & 0xfe800050) == 0xf2800000 && BITS(inst, 20, 2) != 3) {
+        return decode_vr3_diff(inst, d);
+    }
+    if ((inst & 0xfe800010) == 0xf2800010) {
+        return decode_vshift(inst, d);
+    }
+    if ((inst & 0xffb00810) == 0xf3b00000) {
+        return decode_v2misc(inst, d);
+    }
+    if ((inst & 0xffb00c10) == 0xf3b00800) {
+        return decode_vtbl(inst, d);
+    }
+    if ((inst & 0xff100000) == 0xf4000000) {
+        return decode_vldst(inst, d);
+    }
+
+    return -1;
+}
+
+int
+ag_dis_decode(uint32_t inst, struct ag_dis_insn *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->dt = "";
+    d->cc = BITS(inst, 28, 4);
+    d->rd = d->rn = d->rm = d->rs = -1;
+    d->vd = d->vn = d->vm = -1;
+
+    if (d->cc == 15) {
+        return decode_neon(inst, d);
+    }
+
+    switch (BITS(inst, 25, 3)) {
+    case 0:
+        if ((inst & 0x0ffffff0) == 0x012fff10) {
+            d->form = AG_DIS_BX;
+            d->name = "bx";
+            d->rm = BITS(inst, 0, 4);
+            return 0;
+        }
+        if ((inst & 0x0fc000f0) == 0x00000090) {
+            int a = BIT(inst, 21);
+
+            if (!a && BITS(inst, 12, 4) != 0) {
+                return -1;
+            }
+
+            d->form = AG_DIS_MUL;
+            d->name = a ? "mla" : "mul";
+            d->s = BIT(inst, 20);
+            d->rd = BITS(inst, 16, 4);
+            d->rs = BITS(inst, 8, 4);
+            d->rm = BITS(inst, 0, 4);
+            if (a) {
+                d->rn = BITS(inst, 12, 4);
+            }
+            return 0;
+        }
+        if ((inst & 0x0ff00fff) == 0x01900f9f) {
+            d->form = AG_DIS_LDSTEX;
+            d->name = "ldrex";
+            d->rn = BITS(inst, 16, 4);
+            d->rd = BITS(inst, 12, 4);
+            return 0;
+        }
+        if ((inst & 0x0ff00ff0) == 0x01800f90) {
+            d->form = AG_DIS_LDSTEX;
+            d->name = "strex";
+            d->rn = BITS(inst, 16, 4);
+            d->rd = BITS(inst, 12, 4);
+            d->rm = BITS(inst, 0, 4);
+            return 0;
+        }
+        if ((inst & 0x90) == 0x90) {
+            /* other multiply, extra load/store */
+            return -1;
+        }
+        if ((inst & 0x01900000) == 0x01000000) {
+            /* tst..cmn without S : miscellaneous */
+            return -1;
+        }
+        return decode_dp(inst, d);
+
+    case 1:
+        if ((inst & 0x0fb00000) == 0x03000000) {
+            d->form = AG_DIS_MOVW;
+            d->name = BIT(inst, 22) ? "movt" : "movw";
+            d->rd = BITS(inst, 12, 4);
+            d->imm = (BITS(inst, 16, 4)<<12) | BITS(inst, 0, 12);
+            return 0;
+        }
+        if ((inst & 0x01900000) == 0x01000000) {
+            /* msr, hints */
+            return -1;
+        }
+        return decode_dp(inst, d);
+
+    case 2:
+    case 3:
+        return decode_ldst(inst, d);
+
+    case 4:
+        d->form = AG_DIS_LDSTM;
+        d->name = BIT(inst, 20) ? "ldm" : "stm";
+        d->p = BIT(inst, 24);
+        d->u = BIT(inst, 23);
+        d->s = BIT(inst, 22);
+        d->w = BIT(inst, 21);
+        d->rn = BITS(inst, 16, 4);
+        d->reg_bits = BITS(inst, 0, 16);
+        return 0;
+
+    case 5:
+        d->form = AG_DIS_BRANCH;
+        d->name = BIT(inst, 24) ? "bl" : "b";
+        d->imm = ((int32_t)(inst << 8)) >> 8;
+        return 0;
+
+    case 6:
+        if ((inst & 0x0fe00fd0) == 0x0c400b10) {
+            return decode_vmov_core(inst, d);
+        }
+        return -1;
+
+    case 7:
+        if ((inst & 0x0f900f5f) == 0x0e800b10) {
+            return decode_vdup(inst, d);
+        }
+        if ((inst & 0x0fe00f7f) == 0x0e000a10 ||
+            (inst & 0x0fc00f7f) == 0x0e000b10)
+        {
+            return decode_vmov_core(inst, d);
+        }
+        if ((inst & 0x0f000e10) == 0x0e000a00) {
+            return decode_vfp(inst, d);
+        }
+        return -1;
+
+    default:
+        return -1;
+    }
+}
+
+
+/* snprintf at buf+pos, return new pos (may exceed len, as snprintf) */
+static int
+append(char *buf, size_t len, int pos, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    if ((size_t)pos < len) {
+        n = vsnprintf(buf + pos, len - pos, fmt, ap);
+    } else {
+        n = vsnprintf(NULL, 0, fmt, ap);
+    }
+    va_end(ap);
+
+    return pos + n;
+}
+
+static int
+append_imm(char *buf, size_t len, int pos, int32_t imm)
+{
+    if (imm > -0x10000 && imm < 0x10000) {
+        return append(buf, len, pos, "#%d", (int)imm);
+    }
+    return append(buf, len, pos, "#0x%x", (unsigned int)imm);
+}
+
+/* ", lsl #4", ", ror r3", "" */
+static int
+append_shift(char *buf, size_t len, int pos, int shift)
+{
+    int type = (shift>>1) & 3;
+
+    if (shift & 1) {
+        return append(buf, len, pos, ", %s %s", shift_name[type], reg_name[(shift>>4) & 15]);
+    }
+
+    int amount = shift >> 3;
+
+    if (amount == 0) {
+        if (type == AG_SHIFT_LOG_LEFT) {
+            return pos;
+        }
+        if (type == AG_SHIFT_ROTATE_RIGHT) {
+            return append(buf, len, pos, ", rrx");
+        }
+        amount = 32;
+    }
+
+    return append(buf, len, pos, ", %s #%d", shift_name[type], amount);
+}
+
+static int
+append_reg_list(char *buf, size_t len, int pos, int reg_bits)
+{
+    const char *sep = "";
+
+    pos = append(buf, len, pos, "{");
+    for (int i=0; i<16; i++) {
+        if (reg_bits & (1<<i)) {
+            pos = append(buf, len, pos, "%s%s", sep, reg_name[i]);
+            sep = ", ";
+        }
+    }
+    return append(buf, len, pos, "}");
+}
+
+/* "d3", "q1" */
+static int
+append_vreg(char *buf, size_t len, int pos, int q, int d)
+{
+    if (q) {
+        return append(buf, len, pos, "q%d", d/2);
+    }
+    return append(buf, len, pos, "d%d", d);
+}
+
+/* ":64" .. of vld/vst, in bits */
+static int
+vldst_align_bits(const struct ag_dis_insn *d)
+{
+    int a = d->align;
+
+    if (d->form == AG_DIS_VLDST_MULTI) {
+        return a ? 32 << a : 0;
+    }
+
+    switch (d->nreg) {
+    case 1:
+        if (d->size == 1 && (a & 1)) return 16;
+        if (d->size == 2 && (a & 3) == 3) return 32;
+        return 0;
+    case 2:
+        return (a & 1) ? 16 << d->size : 0;
+    case 4:
+        if (d->size == 2) {
+            return (a & 3) == 1 ? 64 : (a & 3) == 2 ? 128 : 0;
+        }
+        return (a & 1) ? 32 << d->size : 0;
+    default:
+        return 0;
+    }
+}
+
+static int
+append_vldst(char *buf, size_t len, int pos, const struct ag_dis_insn *d)
+{
+    int align = vldst_align_bits(d);
+
+    if (d->form == AG_DIS_VLDST_MULTI) {
+        if (d->nreg == 1) {
+            pos = append(buf, len, pos, "{d%d}", d->vd);
+        } else {
+            pos = append(buf, len, pos, "{d%d-d%d}", d->vd, d->vd + d->nreg - 1);
+        }
+    } else {
+        int inc = vldst_lane_inc(d->size, d->align);
+        int index = d->align >> (d->size + 1);
+        const char *sep = "";
+
+        pos = append(buf, len, pos, "{");
+        for (int i=0; i<d->nreg; i++) {
+            pos = append(buf, len, pos, "%sd%d[%d]", sep, d->vd + i*inc, index);
+            sep = ", ";
+        }
+        pos = append(buf, len, pos, "}");
+    }
+
+    pos = append(buf, len, pos, ", [%s", reg_name[d->rn]);
+    if (align) {
+        pos = append(buf, len, pos, ":%d", align);
+    }
+    pos = append(buf, len, pos, "]");
+
+    if (d->rm == AG_VLDST_POST_INCR) {
+        pos = append(buf, len, pos, "!");
+    } else if (d->rm != AG_VLDST_NO_WRITEBACK) {
+        pos = append(buf, len, pos, ", %s", reg_name[d->rm]);
+    }
+
+    return pos;
+}
+
+int
+ag_dis_format(char *buf, size_t len, const struct ag_dis_insn *d, uintptr_t pc)
+{
+    int pos = 0;
+    const char *cc = cond_name[d->cc];
+
+    if (len > 0) {
+        buf[0] = '\0';
+    }
+
+    switch (d->form) {
+    case AG_DIS_DATA_PROCESS: {
+        int opc = 0;
+        while (opc < 15 && strcmp(dp_name[opc], d->name) != 0) {
+            opc++;
+        }
+
+        int compare = (opc >= AG_TST && opc <= AG_CMN);
+        int move = (opc == AG_MOV || opc == AG_MVN);
+
+        pos = append(buf, len, pos, "%s%s%s ", d->name, (d->s && !compare) ? "s" : "", cc);
+        if (compare) {
+            pos = append(buf, len, pos, "%s, ", reg_name[d->rn]);
+        } else if (move) {
+            pos = append(buf, len, pos, "%s, ", reg_name[d->rd]);
+        } else {
+            pos = append(buf, len, pos, "%s, %s, ", reg_name[d->rd], reg_name[d->rn]);
+        }
+
+        if (d->rm < 0) {
+            pos = append_imm(buf, len, pos, d->imm);
+        } else {
+            pos = append(buf, len, pos, "%s", reg_name[d->rm]);
+            pos = append_shift(buf, len, pos, d->shift);
+        }
+        break;
+    }
+
+    case AG_DIS_MUL:
+        pos = append(buf, len, pos, "%s%s%s %s, %s, %s", d->name, d->s ? "s" : "", cc,
+                     reg_name[d->rd], reg_name[d->rm], reg_name[d->rs]);
+        if (d->rn >= 0) {
+            pos = append(buf, len, pos, ", %s", reg_name[d->rn]);
+        }
+        break;
+
+    case AG_DIS_LDST: {
+        int post = (d->incr & AG_OFFSET_ADDR) == 0;
+
+        pos = append(buf, len, pos, "%s%s %s, [%s", d->name, cc, reg_name[d->rd], reg_name[d->rn]);
+        if (post) {
+            pos = append(buf, len, pos, "]");
+        }
+
+        if (d->rm < 0) {
+            if (d->imm != 0 || post) {
+                pos = append(buf, len, pos, ", ");
+                pos = append_imm(buf, len, pos, d->imm);
+            }
+        } else {
+            pos = append(buf, len, pos, ", %s%s", d->add ? "" : "-", reg_name[d->rm]);
+            pos = append_shift(buf, len, pos, d->shift);
+        }
+
+        if (!post) {
+            pos = append(buf, len, pos, "]%s", d->incr == AG_PRE_INCR ? "!" : "");
+        }
+
+        if (d->rn == AG_PC && d->rm < 0 && d->incr == AG_OFFSET_ADDR) {
+            pos = append(buf, len, pos, " ; 0x%lx", (unsigned long)(pc + 8 + d->imm));
+        }
+        break;
+    }
+
+    case AG_DIS_LDSTM: {
+        static const char *const mode[2][2] = {{"da", ""}, {"db", "ib"}};
+
+        pos = append(buf, len, pos, "%s%s%s %s%s, ", d->name, mode[d->p][d->u], cc,
+                     reg_name[d->rn], d->w ? "!" : "");
+        pos = append_reg_list(buf, len, pos, d->reg_bits);
+        if (d->s) {
+            pos = append(buf, len, pos, "^");
+        }
+        break;
+    }
+
+    case AG_DIS_LDSTEX:
+        if (d->rm >= 0) {
+            pos = append(buf, len, pos, "%s%s %s, %s, [%s]", d->name, cc,
+                         reg_name[d->rd], reg_name[d->rm], reg_name[d->rn]);
+        } else {
+            pos = append(buf, len, pos, "%s%s %s, [%s]", d->name, cc,
+                         reg_name[d->rd], reg_name[d->rn]);
+        }
+        break;
+
+    case AG_DIS_MOVW:
+        pos = append(buf, len, pos, "%s%s %s, #%d", d->name, cc, reg_name[d->rd], (int)d->imm);
+        break;
+
+    case AG_DIS_BRANCH:
+        pos = append(buf, len, pos, "%s%s 0x%lx", d->name, cc,
+                     (unsigned long)(pc + 8 + d->imm * 4));
+        break;
+
+    case AG_DIS_BX:
+        pos = append(buf, len, pos, "%s%s %s", d->name, cc, reg_name[d->rm]);
+        break;
+
+    case AG_DIS_VR3: {
+        /* vshl vd, vm, vn */
+        int shl = strcmp(d->name, "vshl") == 0;
+
+        pos = append(buf, len, pos, "%s.%s ", d->name, d->dt);
+        pos = append_vreg(buf, len, pos, d->q, d->vd);
+        pos = append(buf, len, pos, ", ");
+        pos = append_vreg(buf, len, pos, d->q, shl ? d->vm : d->vn);
+        pos = append(buf, len, pos, ", ");
+        pos = append_vreg(buf, len, pos, d->q, shl ? d->vn : d->vm);
+        break;
+    }
+
+    case AG_DIS_VR3_LONG:
+        pos = append(buf, len, pos, "%s.%s q%d, d%d, d%d", d->name, d->dt, d->vd/2, d->vn, d->vm);
+        break;
+
+    case AG_DIS_VR3_WIDE:
+        pos = append(buf, len, pos, "%s.%s q%d, q%d, d%d", d->name, d->dt, d->vd/2, d->vn/2, d->vm);
+        break;
+
+    case AG_DIS_VR3_NARROW:
+        pos = append(buf, len, pos, "%s.%s d%d, q%d, q%d", d->name, d->dt, d->vd, d->vn/2, d->vm/2);
+        break;
+
+    case AG_DIS_VDUP:
+        pos = append(buf, len, pos, "%s%s.%s ", d->name, cc, d->dt);
+        pos = append_vreg(buf, len, pos, d->q, d->vd);
+        pos = append(buf, len, pos, ", %s", reg_name[d->rd]);
+        break;
+
+    case AG_DIS_VCVT:
+        pos = append(buf, len, pos, "%s.%s ", d->name, d->dt);
+        pos = append_vreg(buf, len, pos, d->q, d->vd);
+        pos = append(buf, len, pos, ", ");
+        pos = append_vreg(buf, len, pos, d->q, d->vm);
+        break;
+
+    case AG_DIS_VLDST_LANE:
+    case AG_DIS_VLDST_MULTI:
+        pos = append(buf, len, pos, "%s.%s ", d->name, d->dt);
+        pos = append_vldst(buf, len, pos, d);
+        break;
+
+    case AG_DIS_VSHIFT:
+    case AG_DIS_V2MISC:
+        pos = append(buf, len, pos, "%s.%s ", d->name, d->dt);
+        pos = append_vreg(buf, len, pos, d->q, d->vd);
+        pos = append(buf, len, pos, ", ");
+        pos = append_vreg(buf, len, pos, d->q, d->vm);
+        if (d->form == AG_DIS_VSHIFT) {
+            pos = append(buf, len, pos, ", #%d", (int)d->imm);
+        }
+        break;
+
+    case AG_DIS_VSHIFT_LONG:
+        pos = append(buf, len, pos, "%s.%s q%d, d%d", d->name, d->dt, d->vd/2, d->vm);
+        if (d->imm) {
+            pos = append(buf, len, pos, ", #%d", (int)d->imm);
+        }
+        break;
+
+    case AG_DIS_VSHIFT_NARROW:
+    case AG_DIS_V2MISC_NARROW:
+        pos = append(buf, len, pos, "%s.%s d%d, q%d", d->name, d->dt, d->vd, d->vm/2);
+        if (d->form == AG_DIS_VSHIFT_NARROW) {
+            pos = append(buf, len, pos, ", #%d", (int)d->imm);
+        }
+        break;
+
+    case AG_DIS_VTBL: {
+        const char *sep = "";
+
+        pos = append(buf, len, pos, "%s.%s d%d, {", d->name, d->dt, d->vd);
+        for (int i=0; i<d->nreg; i++) {
+            pos = append(buf, len, pos, "%sd%d", sep, d->vn + i);
+            sep = ", ";
+        }
+        pos = append(buf, len, pos, "}, d%d", d->vm);
+        break;
+    }
+
+    case AG_DIS_VFP3:
+    case AG_DIS_VFP2: {
+        char r = d->size ? 'd' : 's';
+
+        pos = append(buf, len, pos, "%s%s.%s %c%d, ", d->name, cc, d->dt, r, d->vd);
+        if (d->form == AG_DIS_VFP3) {
+            pos = append(buf, len, pos, "%c%d, ", r, d->vn);
+        }
+        pos = append(buf, len, pos, "%c%d", r, d->vm);
+        break;
+    }
+
+    case AG_DIS_VMOV_RR:
+        if (d->to_core) {
+            pos = append(buf, len, pos, "%s%s %s, %s, d%d", d->name, cc,
+                         reg_name[d->rd], reg_name[d->rn], d->vm);
+        } else {
+            pos = append(buf, len, pos, "%s%s d%d, %s, %s", d->name, cc,
+                         d->vm, reg_name[d->rd], reg_name[d->rn]);
+        }
+        break;
+
+    case AG_DIS_VMOV_S:
+        if (d->to_core) {
+            pos = append(buf, len, pos, "%s%s %s, s%d", d->name, cc, reg_name[d->rd], d->vn);
+        } else {
+            pos = append(buf, len, pos, "%s%s s%d, %s", d->name, cc, d->vn, reg_name[d->rd]);
+        }
+        break;
+
+    case AG_DIS_VMOV_SCALAR:
+        if (d->to_core) {
+            pos = append(buf, len, pos, "%s%s.%s %s, d%d[%d]", d->name, cc, d->dt,
+                         reg_name[d->rd], d->vn, (int)d->imm);
+        } else {
+            pos = append(buf, len, pos, "%s%s.%s d%d[%d], %s", d->name, cc, d->dt,
+                         d->vn, (int)d->imm, reg_name[d->rd]);
+        }
+        break;
+    }
+
+    return pos;
+}
+
+int
+ag_disasm_a32(char *buf, size_t len, uint32_t inst, uintptr_t pc)
+{
+    struct ag_dis_insn d;
+
+    if (ag_dis_decode(inst, &d) < 0) {
+        return snprintf(buf, len, ".word 0x%08x", inst);
+    }
+
+    return ag_dis_format(buf, len, &d, pc);
+}
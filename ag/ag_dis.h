@@ -0,0 +1,90 @@
+#ifndef AG_DIS_H
+#define AG_DIS_H
+
+/* A32 / NEON decoder for the instructions ag_gen.h emits.
+ *
+ * fields are in the units of emitter arguments, so encoded instruction
+ * can be compared with what was passed to ag_emit_*. instructions ag
+ * never emits (and reserved encodings of the ones it does) are not
+ * decoded.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ag/ag_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum ag_dis_form {
+    AG_DIS_DATA_PROCESS,        /* and .. mvn, rm < 0 : immediate */
+    AG_DIS_MUL,                 /* mul, mla */
+    AG_DIS_LDST,                /* ldr/str(b), rm < 0 : immediate offset */
+    AG_DIS_LDSTM,
+    AG_DIS_LDSTEX,              /* ldrex, strex */
+    AG_DIS_MOVW,                /* movw, movt */
+    AG_DIS_BRANCH,              /* b, bl */
+    AG_DIS_BX,
+    AG_DIS_VR3,                 /* 3 registers same length (vadd ..) */
+    AG_DIS_VR3_LONG,            /* vmull qd, dn, dm */
+    AG_DIS_VR3_WIDE,            /* vaddw qd, qn, dm */
+    AG_DIS_VR3_NARROW,          /* vaddhn dd, qn, qm */
+    AG_DIS_VDUP,
+    AG_DIS_VCVT,
+    AG_DIS_VLDST_LANE,          /* vldN/vstN single element to one lane */
+    AG_DIS_VLDST_MULTI,         /* vld1/vst1 multiple single elements */
+    AG_DIS_VSHIFT,              /* vshr vd, vm, #imm */
+    AG_DIS_VSHIFT_LONG,         /* vshll qd, dm, #imm (vmovl) */
+    AG_DIS_VSHIFT_NARROW,       /* vshrn dd, qm, #imm */
+    AG_DIS_V2MISC,              /* vzip, vrecpe .. vd, vm */
+    AG_DIS_V2MISC_NARROW,       /* vmovn dd, qm .. */
+    AG_DIS_VTBL,                /* vtbl/vtbx dd, {dn ..}, dm */
+    AG_DIS_VFP3,                /* VFP vadd .. */
+    AG_DIS_VFP2,                /* VFP vsqrt .. */
+    AG_DIS_VMOV_RR,             /* vmov dm, rt, rt2 (rd : rt, rn : rt2) */
+    AG_DIS_VMOV_S,              /* vmov sn, rt */
+    AG_DIS_VMOV_SCALAR,         /* vmov.32 dn[imm], rt */
+};
+
+struct ag_dis_insn {
+    enum ag_dis_form form;
+    const char *name;           /* "add", "ldrb", "vmla" .. without "s", condition and data type */
+    const char *dt;             /* NEON data type "i32", "f32.s32" .., "" if none */
+    int cc;                     /* AG_COND_*, 15 : unconditional (NEON) */
+    int s;                      /* flags are set. ldm/stm : "^" */
+
+    int rd, rn, rm, rs;         /* core registers, -1 if none. ldr/str rt : rd, mla accumulator : rn */
+    int shift;                  /* emitter shift argument (AG_LSL_AM(n), AG_LSL_REG(r) ..) */
+    int32_t imm;                /* data processing : value, ldr/str : signed offset,
+                                 * movw/movt : imm16, b/bl : offset in words from pc+8,
+                                 * NEON shift : amount, vmov.32 : lane */
+    int incr;                   /* ldr/str : AG_OFFSET_ADDR, AG_PRE_INCR, AG_POST_INCR */
+    int add;                    /* ldr/str register : offset is added */
+    int p, u, w;                /* ldm/stm */
+    int reg_bits;               /* ldm/stm */
+
+    int q;
+    int size;                   /* NEON size field (result of narrowing), VFP sz */
+    int vd, vn, vm;             /* d register number, -1 if none. q<n> is d<2n>.
+                                 * VFP f32 and vmov sn : s register number */
+    int to_core;                /* vmov : core registers are written */
+    int nreg;                   /* vld/vst : number of d registers (multi) or elements (single lane) */
+    int align;                  /* vld/vst : align (multi) or index_align (single lane) field */
+};
+
+/* return 0 and fill *d, negative if inst is not decoded */
+int ag_dis_decode(uint32_t inst, struct ag_dis_insn *d);
+
+/* write text of decoded instruction ("addsgt r0, r1, r2, lsl r3"), pc is
+ * its address (b/bl target, literal address). return length as snprintf */
+int ag_dis_format(char *buf, size_t len, const struct ag_dis_insn *d, uintptr_t pc);
+
+/* decode + format, ".word 0x........" if not decoded */
+int ag_disasm_a32(char *buf, size_t len, uint32_t inst, uintptr_t pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -4,18 +4,42 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <pthread.h>
 #include "ag/ag_gen.h"
+#include "ag/ag_internal.h"
 #include "npr/varray.h"
+#include "npr/exec-mem.h"
 
 #define INST_SIZE 4
 
-struct CodeBufferBlock {
-#define CODEBUFFER_SIZE 512
+/* T32 16bit nop, pads literal pool to word boundary */
+#define T32_NOP16 0xbf00
 
-    struct CodeBufferBlock *chain;
-    size_t cur;
-    uint32_t buffer[CODEBUFFER_SIZE];
-};
+/* initial size of code buffer, doubled when full */
+#define CODE_BUFFER_INIT_SIZE (64*1024)
+#define DATA_BUFFER_INIT_SIZE 256
+
+/* words emitted between pool range check and the last possible flush point */
+#define POOL_MARGIN 8
+#define POOL_NO_USE (~0U)
+
+/* signed bits-bit word offset */
+#define OFFSET_IN_RANGE(d, bits) ((d) >= -(1<<((bits)-1)) && (d) < (1<<((bits)-1)))
+#define BRANCH_IN_RANGE(d) OFFSET_IN_RANGE(d, 24)
+/* place branch veneer island when first pending forward branch is this close to its limit */
+#define ISLAND_MARGIN (64*1024)
+
+/* code buffers released by ag_emitter_fini are kept mapped here,
+ * one free list per size (CODE_BUFFER_INIT_SIZE << class).
+ */
+#define ARENA_NUM_CLASS 16
+#define ARENA_MAX_CACHED 32
+
+static struct {
+    pthread_mutex_t lock;
+    struct npr_exec_mem free_list[ARENA_NUM_CLASS][ARENA_MAX_CACHED];
+    int num_free[ARENA_NUM_CLASS];
+} code_arena = {PTHREAD_MUTEX_INITIALIZER};
 
 typedef ag_label_id_t label_id_t;
 
@@ -31,88 +55,521 @@ struct Label {
     char *label_str;           /* strduped */
 };
 
-enum labelref_type {
-    LABELREF_TYPE_BRANCH, /* low 23bit, offset -8, shift 2 */
-    LABELREF_TYPE_LDR,    /* low 13bit, offset -8, shift 0 */
-};
-
 struct LabelRef {
     enum labelref_type type;
     unsigned int inst_offset;
     label_id_t label_id;
 };
 
+/* what pool and veneer islands need to know about ISA */
+static const struct isa_desc {
+    unsigned int unit;          /* bytes per e->cur step (label offsets are in units) */
+    uint32_t b;                 /* unconditional branch, offset fixed by branch_ref (memory order) */
+    int branch_bits;            /* width of b offset, in units */
+    enum labelref_type branch_ref;
+    uint32_t literal_range;     /* bytes, pc relative load */
+} isa_table[] = {
+    /* AG_ISA_A32 : b, ldr rt, [pc, #imm12] */
+    {4, 0xea000000, 24, LABELREF_TYPE_BRANCH, 4095},
+    /* AG_ISA_A64 : b, ldr wt, label */
+    {4, 0x14000000, 26, LABELREF_TYPE_A64_B26, (1<<20) - 4},
+    /* AG_ISA_X86_64 : byte stream, rel32 reaches everything. no pool, no island */
+    {1, 0, 32, LABELREF_TYPE_X86_REL32, 0},
+    /* AG_ISA_T32 : b.w (halfwords f000 b800), ldr.w rt, [pc, #imm12] */
+    {2, 0xb800f000, 24, LABELREF_TYPE_T32_B24, 4095},
+};
+
+/* pool words -> e->cur units */
+#define POOL_UNITS(isa, nword) ((nword) * INST_SIZE / (isa)->unit)
+
+
+
+static size_t
+page_round_up(size_t size)
+{
+    size_t page_size = sysconf(_SC_PAGE_SIZE);
+    return ((size + (page_size-1)) / page_size) * page_size;
+}
+
+static int
+arena_class(size_t size)
+{
+    for (int c=0; c<ARENA_NUM_CLASS; c++) {
+        if (((size_t)CODE_BUFFER_INIT_SIZE << c) == size) {
+            return c;
+        }
+    }
+
+    return -1;
+}
 
 static void
-alloc_1block(struct CodeBufferBlock **ret, struct CodeBufferBlock *prev)
+arena_get(struct npr_exec_mem *m, size_t size)
 {
-    struct CodeBufferBlock *b = malloc(sizeof(struct CodeBufferBlock));
+    int c = arena_class(size);
+    int found = 0;
 
-    b->cur = 0;
-    b->chain = prev;
+    pthread_mutex_lock(&code_arena.lock);
+    if (c >= 0 && code_arena.num_free[c] > 0) {
+        *m = code_arena.free_list[c][--code_arena.num_free[c]];
+        found = 1;
+    }
+    pthread_mutex_unlock(&code_arena.lock);
 
-    *ret = b;
+    if (found) {
+        return;
+    }
+
+    if (npr_exec_mem_alloc(m, size) < 0) {
+        perror("npr_exec_mem_alloc");
+        exit(1);
+    }
 }
 
+static void
+arena_put(struct npr_exec_mem *m)
+{
+    int c = arena_class(m->size);
 
+    pthread_mutex_lock(&code_arena.lock);
+    if (c >= 0 && code_arena.num_free[c] < ARENA_MAX_CACHED) {
+        code_arena.free_list[c][code_arena.num_free[c]++] = *m;
+        m->size = 0;
+    }
+    pthread_mutex_unlock(&code_arena.lock);
+
+    if (m->size) {
+        npr_exec_mem_free(m);
+    }
+}
+
+void
+ag_code_arena_trim(void)
+{
+    pthread_mutex_lock(&code_arena.lock);
+    for (int c=0; c<ARENA_NUM_CLASS; c++) {
+        for (int i=0; i<code_arena.num_free[c]; i++) {
+            npr_exec_mem_free(&code_arena.free_list[c][i]);
+        }
+        code_arena.num_free[c] = 0;
+    }
+    pthread_mutex_unlock(&code_arena.lock);
+}
+
+/* grow code buffer to hold at least size bytes */
 static void
-ag_emit4(struct ag_Emitter *e, uint32_t val)
+reserve_code(struct ag_Emitter *e, size_t size)
+{
+    if (size <= e->code_mem.size) {
+        return;
+    }
+
+    size_t new_size = e->code_mem.size;
+    while (new_size < size) {
+        new_size *= 2;
+    }
+
+    if (npr_exec_mem_resize(&e->code_mem, new_size) < 0) {
+        perror("npr_exec_mem_resize");
+        exit(1);
+    }
+
+    e->code_buffer = (uint32_t*)e->code_mem.rw;
+}
+
+/* one word in memory order (T32 : first halfword in low 16bit) */
+static void
+put4(struct ag_Emitter *e, uint32_t val)
 {
-    struct CodeBufferBlock *b = e->code_last;
+    unsigned int unit = isa_table[e->isa].unit;
+    size_t off = (size_t)e->cur * unit;
 
-    if (b->cur == CODEBUFFER_SIZE) {
-        alloc_1block(&e->code_last, e->code_last);
+    if (off + INST_SIZE > e->code_mem.size) {
+        reserve_code(e, off + INST_SIZE);
     }
 
-    b = e->code_last;
+    memcpy((unsigned char*)e->code_mem.rw + off, &val, INST_SIZE);
+    e->cur += INST_SIZE / unit;
+
+    if (e->it_remaining) {
+        e->it_remaining--;
+    }
+}
 
-    b->buffer[b->cur] = val;
-    b->cur++;
+/* T32 halfword */
+static void
+put2(struct ag_Emitter *e, uint16_t val)
+{
+    size_t off = (size_t)e->cur * 2;
+
+    if (off + 2 > e->code_mem.size) {
+        reserve_code(e, off + 2);
+    }
+
+    memcpy((unsigned char*)e->code_mem.rw + off, &val, 2);
     e->cur++;
+
+    if (e->it_remaining) {
+        e->it_remaining--;
+    }
 }
 
+void
+ag_emit_bytes(struct ag_Emitter *e, const void *p, unsigned int n)
+{
+    if (e->cur + n > e->code_mem.size) {
+        reserve_code(e, e->cur + n);
+    }
+
+    memcpy((unsigned char*)e->code_mem.rw + e->cur, p, n);
+    e->cur += n;
+}
+
+/* label ids of forward branch targets not emitted yet */
 static void
-ag_emit4_data(struct ag_Emitter *e, uint32_t val)
+collect_pending_targets(struct ag_Emitter *e, struct npr_varray *ret)
+{
+    int nref = e->label_refs.nelem;
+
+    for (int ri=0; ri<nref; ri++) {
+        struct LabelRef *lr = VA_ELEM_PTR(struct LabelRef, &e->label_refs, ri);
+        struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, lr->label_id);
+
+        if (lr->type != isa_table[e->isa].branch_ref || l->state != LABEL_STATE_NOT_EMITTED) {
+            continue;
+        }
+
+        int j, n = ret->nelem;
+        for (j=0; j<n; j++) {
+            if (VA_ELEM(label_id_t, ret, j) == lr->label_id) {
+                break;
+            }
+        }
+        if (j == n) {
+            VA_PUSH(label_id_t, ret, lr->label_id);
+        }
+    }
+}
+
+/* b over; literal pool; veneers; over:
+ *
+ * with_veneer : each pending forward branch is redirected to a
+ * "b target" veneer here, which has full branch range again.
+ */
+static void
+flush_pool(struct ag_Emitter *e, int with_veneer)
+{
+    const struct isa_desc *isa = &isa_table[e->isa];
+    unsigned int n = e->data_cur;
+    unsigned int pool_top;
+    struct npr_varray targets;
+
+    npr_varray_init(&targets, 4, sizeof(label_id_t));
+    if (with_veneer) {
+        collect_pending_targets(e, &targets);
+    }
+
+    if (n + targets.nelem == 0) {
+        npr_varray_discard(&targets);
+        if (with_veneer) {
+            e->branch_first_pending = POOL_NO_USE;
+        }
+        return;
+    }
+
+    /* branch over pool. "over" is not in targets, veneers don't take it */
+    label_id_t over = ag_alloc_label(e, NULL);
+    ag_add_label_ref(e, isa->branch_ref, over);
+    put4(e, isa->b);
+
+    if ((e->cur * isa->unit) % INST_SIZE) {
+        put2(e, T32_NOP16);
+    }
+
+    pool_top = e->cur;
+    for (unsigned int i=0; i<n; i++) {
+        label_id_t target = VA_ELEM(label_id_t, &e->pool_targets, i);
+
+        if (target != AG_NO_LABEL) {
+            struct LabelRef ref;
+            ref.type = LABELREF_TYPE_ABS32;
+            ref.label_id = target;
+            ref.inst_offset = e->cur;
+            VA_PUSH(struct LabelRef, &e->label_refs, ref);
+        }
+
+        put4(e, e->data_buffer[i]);
+    }
+
+    /* pending data labels become code labels */
+    int nl = e->labels.nelem;
+    struct Label *labels = (struct Label*)e->labels.elements;
+    for (int i=0; i<nl; i++) {
+        if (labels[i].state == LABEL_STATE_EMITTED_DATA) {
+            labels[i].offset = POOL_UNITS(isa, labels[i].offset) + pool_top;
+            labels[i].state = LABEL_STATE_EMITTED;
+        }
+    }
+
+    e->data_cur = 0;
+    e->pool_labels.nelem = 0;
+    e->pool_targets.nelem = 0;
+    e->pool_first_use = POOL_NO_USE;
+
+    if (with_veneer) {
+        int nt = targets.nelem;
+        unsigned int veneer_top = e->cur;
+        int nref = e->label_refs.nelem;
+
+        /* redirect existing refs, veneer j is at veneer_top + j */
+        label_id_t first_veneer = e->labels.nelem;
+        for (int j=0; j<nt; j++) {
+            ag_label_id_t v = ag_alloc_label(e, NULL);
+            struct Label *vl = VA_ELEM_PTR(struct Label, &e->labels, v);
+            vl->offset = veneer_top + POOL_UNITS(isa, j);
+            vl->state = LABEL_STATE_EMITTED;
+        }
+
+        for (int ri=0; ri<nref; ri++) {
+            struct LabelRef *lr = VA_ELEM_PTR(struct LabelRef, &e->label_refs, ri);
+            if (lr->type != isa->branch_ref) {
+                continue;
+            }
+            for (int j=0; j<nt; j++) {
+                if (VA_ELEM(label_id_t, &targets, j) == lr->label_id) {
+                    lr->label_id = first_veneer + j;
+                    break;
+                }
+            }
+        }
+
+        for (int j=0; j<nt; j++) {
+            struct LabelRef ref;
+            ref.type = isa->branch_ref;
+            ref.label_id = VA_ELEM(label_id_t, &targets, j);
+            ref.inst_offset = e->cur;
+            VA_PUSH(struct LabelRef, &e->label_refs, ref);
+
+            put4(e, isa->b);
+        }
+
+        e->branch_first_pending = nt ? veneer_top : POOL_NO_USE;
+    }
+
+    ag_emit_label(e, over);
+
+    npr_varray_discard(&targets);
+}
+
+/* flush pending pool if placing it after next few words would put
+ * first literal load out of range. same for pending forward branches.
+ * nothing is flushed inside T32 IT block (POOL_MARGIN covers one block) */
+void
+ag_check_pool(struct ag_Emitter *e)
 {
-    struct CodeBufferBlock *b = e->const_last;
+    const struct isa_desc *isa = &isa_table[e->isa];
 
-    if (b->cur == CODEBUFFER_SIZE) {
-        alloc_1block(&e->code_last, e->code_last);
+    if (e->it_remaining) {
+        return;
     }
 
-    b = e->const_last;
+    if (e->branch_first_pending != POOL_NO_USE &&
+        e->cur + ISLAND_MARGIN - e->branch_first_pending >= (1U<<(isa->branch_bits-1)))
+    {
+        flush_pool(e, 1);
+    }
+
+    if (e->pool_first_use == POOL_NO_USE) {
+        return;
+    }
 
-    b->buffer[b->cur] = val;
-    b->cur++;
+    /* bytes from first load to end of pool placed after margin (b over + pad, words) */
+    unsigned int dist = (e->cur - e->pool_first_use) * isa->unit +
+        (2 + e->data_cur + POOL_MARGIN) * INST_SIZE;
+    if (dist > isa->literal_range) {
+        flush_pool(e, 0);
+    }
+}
+
+void
+ag_emit4(struct ag_Emitter *e, uint32_t val)
+{
+    ag_check_pool(e);
+    put4(e, val);
+}
+
+void
+ag_emit2(struct ag_Emitter *e, uint16_t val)
+{
+    ag_check_pool(e);
+    put2(e, val);
+}
+
+void
+ag_add_label_ref(struct ag_Emitter *e, enum labelref_type type, ag_label_id_t label)
+{
+    struct LabelRef ref;
+    ref.type = type;
+    ref.label_id = label;
+    ref.inst_offset = e->cur;
+
+    VA_PUSH(struct LabelRef, &e->label_refs, ref);
+}
+
+void
+ag_emit4_ref(struct ag_Emitter *e, uint32_t val, enum labelref_type type, ag_label_id_t label)
+{
+    /* pool flush would move the instruction after ref is recorded */
+    ag_check_pool(e);
+
+    /* after flush, it allocates labels */
+    struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, label);
+
+    ag_add_label_ref(e, type, label);
+
+    if (type == isa_table[e->isa].branch_ref &&
+        l->state == LABEL_STATE_NOT_EMITTED &&
+        e->branch_first_pending == POOL_NO_USE)
+    {
+        e->branch_first_pending = e->cur;
+    }
+
+    put4(e, val);
+}
+
+int
+ag_label_offset(struct ag_Emitter *e, ag_label_id_t label, uint32_t *offset)
+{
+    struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, label);
+
+    if (l->state != LABEL_STATE_EMITTED) {
+        return 0;
+    }
+
+    *offset = l->offset;
+    return 1;
+}
+
+static void
+ag_emit4_data(struct ag_Emitter *e, uint32_t val)
+{
+    if ((e->data_cur+1) * INST_SIZE > e->data_buffer_size) {
+        e->data_buffer_size *= 2;
+        e->data_buffer = (uint32_t*)realloc(e->data_buffer, e->data_buffer_size);
+    }
+
+    e->data_buffer[e->data_cur] = val;
     e->data_cur++;
 }
 
 #define emit4 ag_emit4
 
+void
+ag_emit_simd(struct ag_Emitter *e, uint32_t val)
+{
+    if (e->isa == AG_ISA_T32) {
+        val = AG_SIMD_T32(val);
+    }
+
+    ag_emit4(e, val);
+}
+
 void
 ag_emit_bx(struct ag_Emitter *e, enum ag_cond cc, int reg)
 {
     ag_emit4(e, (cc << 28) | 0x012fff10 | reg);
 }
 
+/* ag_emit_pool_load without ag_check_pool, caller checked pool */
+static void
+put_pool_load(struct ag_Emitter *e, uint32_t inst, enum labelref_type type,
+              uint32_t val, ag_label_id_t target)
+{
+    label_id_t l = 0;
+    unsigned int i;
+
+    /* share pool entry with same value */
+    for (i=0; i<e->data_cur; i++) {
+        if (e->data_buffer[i] == val &&
+            VA_ELEM(label_id_t, &e->pool_targets, i) == target)
+        {
+            l = VA_ELEM(label_id_t, &e->pool_labels, i);
+            break;
+        }
+    }
+
+    if (i == e->data_cur) {
+        l = ag_emit_new_data_label(e, NULL);
+        VA_PUSH(label_id_t, &e->pool_labels, l);
+        VA_PUSH(label_id_t, &e->pool_targets, target);
+        ag_emit4_data(e, val);
+    }
+
+    if (e->pool_first_use == POOL_NO_USE) {
+        e->pool_first_use = e->cur;
+    }
+
+    struct LabelRef ref;
+    ref.type = type;
+    ref.label_id = l;
+    ref.inst_offset = e->cur;
+
+    VA_PUSH(struct LabelRef, &e->label_refs, ref);
+
+    /* put4 : pool must not be flushed between ref and load */
+    put4(e, inst);
+}
+
+void
+ag_emit_pool_load(struct ag_Emitter *e, uint32_t inst, enum labelref_type type,
+                  uint32_t val, ag_label_id_t target)
+{
+    ag_check_pool(e);
+    put_pool_load(e, inst, type, val, target);
+}
+
+/* ldr rd, [pc, #pool_entry] */
+static void
+pool_load(struct ag_Emitter *e, enum ag_cond cc, int rd, uint32_t val, label_id_t target)
+{
+    ag_emit_pool_load(e, AG_LDR_IMM | AG_OFFSET_ADDR | (cc<<28) | (1<<23) | (AG_PC<<16) | (rd<<12),
+                      LABELREF_TYPE_LDR, val, target);
+}
+
 void
 ag_emit_branch(struct ag_Emitter *e, enum ag_cond cc, int l, label_id_t dst)
 {
-    struct Label *label = VA_ELEM_PTR(struct Label, &e->labels, dst);
     int32_t off = 0;
 
+    /* pool flush would move the branch after offset is computed.
+     * flush allocates labels, take label pointer after it */
+    ag_check_pool(e);
+
+    struct Label *label = VA_ELEM_PTR(struct Label, &e->labels, dst);
+
     if (label->state == LABEL_STATE_EMITTED) {
         off = label->offset - e->cur - 2;
-    } else {
-        struct LabelRef ref;
-        ref.type = LABELREF_TYPE_BRANCH;
-        ref.label_id = dst;
-        ref.inst_offset = e->cur;
+    }
 
-        VA_PUSH(struct LabelRef, &e->label_refs, ref);
+    if (label->state == LABEL_STATE_EMITTED && !BRANCH_IN_RANGE(off)) {
+        /* long branch : [add lr, pc, #0]; ldr pc, =target.
+         * pool was checked above (POOL_MARGIN covers both words and new
+         * pool word). flush between them would make lr point into pool */
+        if (l) {
+            put4(e, (cc<<28) | (1<<25) | (AG_ADD<<21) | (AG_PC<<16) | (AG_LR<<12));
+        }
+        put_pool_load(e, AG_LDR_IMM | AG_OFFSET_ADDR | (cc<<28) | (1<<23) | (AG_PC<<16) | (AG_PC<<12),
+                      LABELREF_TYPE_LDR, 0, dst);
+        return;
     }
 
-    emit4(e, (cc<<28) | (0x5<<25) | (l<<24) | (off&0x00ffffff));
+    uint32_t inst = (cc<<28) | (0x5<<25) | (l<<24);
+
+    if (label->state != LABEL_STATE_EMITTED) {
+        ag_emit4_ref(e, inst, LABELREF_TYPE_BRANCH, dst);
+    } else {
+        put4(e, inst | (off&0x00ffffff));
+    }
 }
 
 void
@@ -133,16 +590,30 @@ ag_emit_data_process_reg(struct ag_Emitter *e, enum ag_cond cc, enum ag_data_pro
     emit4(e, (cc<<28) | (opc<<21) | (s<<20) | (rn<<16) | (rd<<12) | (shift<<4) | rm);
 }
 
+int
+ag_encode_modified_imm(uint32_t imm)
+{
+    /* imm = imm8 ror (rot*2) */
+    for (int rot=0; rot<16; rot++) {
+        uint32_t v = (imm << (rot*2)) | (imm >> ((32 - rot*2) & 31));
+        if ((v & 0xffffff00) == 0) {
+            return (rot<<8) | v;
+        }
+    }
+
+    return -1;
+}
+
 int
 ag_emit_data_process_imm(struct ag_Emitter *e, enum ag_cond cc, enum ag_data_process_opcode opc,
                          int s, int rd, int rn, int32_t imm)
 {
-    if (imm & 0xffffff00) {
-        /* fixme shift */
+    int field = ag_encode_modified_imm(imm);
+    if (field < 0) {
         return -1;
     }
 
-    emit4(e, (cc<<28) | (1<<25) | (opc<<21) | (s<<20) | (rn<<16) | (rd<<12) | imm);
+    emit4(e, (cc<<28) | (1<<25) | (opc<<21) | (s<<20) | (rn<<16) | (rd<<12) | field);
 
     return 0;
 }
@@ -168,8 +639,21 @@ DATA_PROCESS(adc, AG_ADC)
 DATA_PROCESS(sbc, AG_SBC)
 DATA_PROCESS(rsc, AG_RSC)
 
-DATA_PROCESS(tst, AG_TST)
-DATA_PROCESS(teq, AG_TEQ)
+/* S=0 of tst..cmn is miscellaneous instruction space */
+#define DATA_PROCESS_TEST(name, opc)                                    \
+    void                                                                \
+    ag_emit_##name##_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift) \
+    {                                                                   \
+        ag_emit_data_process_reg(e, cc, opc, 1, 0, rn, rm, shift);      \
+    }                                                                   \
+    int                                                                 \
+    ag_emit_##name##_imm(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int imm) \
+    {                                                                   \
+        return ag_emit_data_process_imm(e, cc, opc, 1, 0, rn, imm);     \
+    }
+
+DATA_PROCESS_TEST(tst, AG_TST)
+DATA_PROCESS_TEST(teq, AG_TEQ)
 //DATA_PROCESS(cmp, AG_CMP)
 
 void
@@ -197,11 +681,38 @@ ag_emit_cmn_imm(struct ag_Emitter *e, enum ag_cond cc,int rn, int imm)
 }
 
 DATA_PROCESS(orr, AG_ORR)
-DATA_PROCESS(mov, AG_MOV)
+/* Rn of mov, mvn should be zero */
+#define DATA_PROCESS_MOVE(name, opc)                                    \
+    void                                                                \
+    ag_emit_##name##_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift) \
+    {                                                                   \
+        ag_emit_data_process_reg(e, cc, opc, s, rd, 0, rm, shift);      \
+    }                                                                   \
+    int                                                                 \
+    ag_emit_##name##_imm(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int imm) \
+    {                                                                   \
+        return ag_emit_data_process_imm(e, cc, opc, s, rd, 0, imm);     \
+    }
+
+DATA_PROCESS_MOVE(mov, AG_MOV)
 DATA_PROCESS(bic, AG_BIC)
-DATA_PROCESS(mvn, AG_MVN)
+DATA_PROCESS_MOVE(mvn, AG_MVN)
 
 
+/* d register operand (q : q<n> as d<2n>) must fit D:Vd field */
+static void
+check_dreg(const char *insn, int q, int d)
+{
+    if (d < 0 || d > 31 || (q && (d & 1))) {
+        if (q) {
+            fprintf(stderr, "NEON %s : q register %d out of range\n", insn, d/2);
+        } else {
+            fprintf(stderr, "NEON %s : d register %d out of range\n", insn, d);
+        }
+        abort();
+    }
+}
+
 void
 ag_emit_vr3(struct ag_Emitter *e, int opc, int q, int size, int vd, int vn, int vm)
 {
@@ -211,125 +722,271 @@ ag_emit_vr3(struct ag_Emitter *e, int opc, int q, int size, int vd, int vn, int
         vm <<= 1;
     }
 
-    int dh = (vd >> 4)&1;
-    int dl = vd & 0xf;
+    check_dreg("vr3", q, vd);
+    check_dreg("vr3", q, vn);
+    check_dreg("vr3", q, vm);
 
-    int nh = (vn >> 4)&1;
-    int nl = vn & 0xf;
+    ag_emit_simd(e, AG_NEON_VR3_WORD(opc, q, size, vd, vn, vm));
+}
 
-    int mh = (vm >> 4)&1;
-    int ml = vm & 0xf;
+void
+ag_emit_vdup(struct ag_Emitter *e, enum ag_cond cc, int opc, int q, int vd, int  rt)
+{
+    check_dreg("vdup", q, vd);
 
-    emit4(e,
-          (0xf<<28) | (dh<<22) | (size<<20) | (nl<<16) |
-          (dl<<12)   | (opc) | (nh<<7) | (q<<6) | (mh<<5) | (ml));
+    ag_emit_simd(e, AG_NEON_DUP_WORD(cc, opc, q, vd, rt));
 }
 
+void
+ag_emit_vcvt(struct ag_Emitter *e, int opc, int q, int vd, int vm)
+{
+    check_dreg("vcvt", q, vd);
+    check_dreg("vcvt", q, vm);
 
-#define IMPL_NEON_VR3_INT(name, opc, prefix)                            \
+    ag_emit_simd(e, AG_NEON_CVT_WORD(opc, q, vd, vm));
+}
+
+/* emitters of ag_a32.def rows */
+#define IMPL_NEON_3SAME(dt, size, rsv, name, U, A, B, C, regs, isa)     \
 void                                                                    \
-ag_emit_##name##_##prefix##32(struct ag_Emitter *e, int q, int vd, int vn, int vm)   \
+ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vn, int vm) \
 {                                                                       \
-    ag_emit_vr3(e, opc, q, 2, vd, vn, vm);                             \
-}                                                                       \
+    if (q && !AG_NEON_Q_OK_##regs) {                                    \
+        fprintf(stderr, "NEON " #name " : q form is reserved\n");       \
+        abort();                                                        \
+    }                                                                   \
+    ag_emit_vr3(e, AG_NEON_3SAME_OPC(U, A, B, C), q, size, vd, vn, vm); \
+}
+
+/* q argument against D_OK / Q_OK of regs column */
+static void
+check_regs_q(const char *insn, int q, int d_ok, int q_ok)
+{
+    if (q ? !q_ok : !d_ok) {
+        fprintf(stderr, "NEON %s : %s form is reserved\n", insn, q ? "q" : "d");
+        abort();
+    }
+}
+
+#define IMPL_NEON_3DIFF(dt, size, rsv, name, U, A, regs, isa)           \
 void                                                                    \
-ag_emit_##name##_##prefix##16(struct ag_Emitter *e, int q, int vd, int vn, int vm)    \
+ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vn, int vm) \
 {                                                                       \
-    ag_emit_vr3(e, opc, q, 1, vd, vn, vm);                             \
-}                                                                       \
+    check_regs_q(#name, q, 1, 0);                                       \
+    check_dreg(#name, AG_NEON_QD_##regs, vd);                           \
+    check_dreg(#name, AG_NEON_QN_##regs, vn);                           \
+    check_dreg(#name, AG_NEON_QM_##regs, vm);                           \
+    ag_emit_simd(e, AG_NEON_VR3_WORD(AG_NEON_3DIFF_OPC(U, A), 0, size, vd, vn, vm)); \
+}
+
+#define IMPL_NEON_DUP(name, size, B, E, isa)                            \
 void                                                                    \
-ag_emit_##name##_##prefix##8(struct ag_Emitter *e, int q, int vd, int vn, int vm) \
+ag_emit_##name##size(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt) \
 {                                                                       \
-    ag_emit_vr3(e, opc, q, 0, vd, vn, vm);                             \
+    ag_emit_vdup(e, cc, AG_NEON_DUP_OPC(B, E), q, vd, rt);              \
 }
 
-#define IMPL_NEON_VR3_FLT(name, opc)                                    \
+#define IMPL_NEON_CVT(name, dt, op, isa)                                \
 void                                                                    \
-ag_emit_##name##_f32(struct ag_Emitter *e, int q, int vd, int vn, int vm)   \
+ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm)      \
 {                                                                       \
-    ag_emit_vr3(e, opc, q, 0, vd, vn, vm);                             \
-}                                                                       \
+    ag_emit_vcvt(e, AG_NEON_CVT_OPC(op), q, vd, vm);                    \
+}
+
+#define IMPL_NEON_LDST_LANE(type, size, name, nelem, L, isa)            \
 void                                                                    \
-ag_emit_##name##_f64(struct ag_Emitter *e, int q, int vd, int vn, int vm)    \
+ag_emit_##name##nelem##_##type(struct ag_Emitter *e, int vd, int rn, int rm, int align) \
 {                                                                       \
-    ag_emit_vr3(e, opc, q, 1, vd, vn, vm);                             \
+    ag_emit_vldst1(e, vd, rn, rm, align, AG_NEON_LDST_LANE_OPC(nelem, L), size); \
 }
 
+#define IMPL_NEON_LDST_MULTI(type, size, name, L, isa)                  \
+int                                                                     \
+ag_emit_##name##_multi_##type(struct ag_Emitter *e, int vd, int nreg, int rn, int rm, int align) \
+{                                                                       \
+    return ag_emit_vldst1_multi(e, vd, nreg, rn, rm, align, AG_NEON_LDST_MULTI_OPC(L), size); \
+}
 
+#define IMPL_NEON_SHIFT(dt, size, rsv, name, U, A, right, regs, isa)   \
+void                                                                    \
+ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm, int n) \
+{                                                                       \
+    check_regs_q(#name, q, AG_NEON_D_OK_##regs, AG_NEON_Q_OK_##regs);   \
+    check_dreg(#name, q | AG_NEON_QD_##regs, vd);                       \
+    check_dreg(#name, q | AG_NEON_QM_##regs, vm);                       \
+    if (right ? (n < 1 || n > (8<<size)) : (n < 0 || n >= (8<<size))) { \
+        fprintf(stderr, "NEON " #name " : shift %d out of range\n", n); \
+        abort();                                                        \
+    }                                                                   \
+    ag_emit_simd(e, AG_NEON_SHIFT_WORD(AG_NEON_SHIFT_OPC(U, A), right, q, size, vd, vm, n)); \
+}
 
-#define IMPL_NEON_VR3_IF(name, opci, opcf)                              \
-    IMPL_NEON_VR3_INT(name, opci, i);                                   \
-    IMPL_NEON_VR3_FLT(name, opcf);
+#define IMPL_NEON_2MISC(dt, size, rsv, name, A, B, regs, isa)           \
+void                                                                    \
+ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm)      \
+{                                                                       \
+    check_regs_q(#name, q, AG_NEON_D_OK_##regs, AG_NEON_Q_OK_##regs);   \
+    check_dreg(#name, q | AG_NEON_QD_##regs, vd);                       \
+    check_dreg(#name, q | AG_NEON_QM_##regs, vm);                       \
+    ag_emit_simd(e, AG_NEON_2MISC_WORD(AG_NEON_2MISC_OPC(A, B), q, size, vd, vm)); \
+}
 
-AG_FOR_EACH_VR3_IF(IMPL_NEON_VR3_IF);
+#define IMPL_NEON_VTBL(name, op, isa)                                   \
+int                                                                     \
+ag_emit_##name##_8(struct ag_Emitter *e, int vd, int vn, int nreg, int vm) \
+{                                                                       \
+    if (nreg < 1 || nreg > 4 || vn < 0 || vn + nreg > 32) {             \
+        return -1;                                                      \
+    }                                                                   \
+    check_dreg(#name, 0, vd);                                           \
+    check_dreg(#name, 0, vm);                                           \
+    ag_emit_simd(e, AG_NEON_VTBL_WORD(AG_NEON_VTBL_OPC(op), vd, vn, nreg, vm)); \
+    return 0;                                                           \
+}
 
-#define IMPL_NEON_VR3_USF(name, opcu, opcs, opcf)                        \
-    IMPL_NEON_VR3_INT(name, opcu, u);                                   \
-    IMPL_NEON_VR3_INT(name, opcs, s);                                   \
-    IMPL_NEON_VR3_FLT(name, opcf);
+/* VFP register : s0..s31 (sz = 0), d0..d31 */
+static void
+check_vfp_reg(const char *insn, int sz, int r)
+{
+    if (r < 0 || r > 31) {
+        fprintf(stderr, "VFP %s : %c%d out of range\n", insn, sz ? 'd' : 's', r);
+        abort();
+    }
+}
 
-AG_FOR_EACH_VR3_USF(IMPL_NEON_VR3_USF);
+#define IMPL_VFP_3(dt, sz, rsv, name, A, op, isa)                       \
+void                                                                    \
+ag_emit_vfp_##name##_##dt(struct ag_Emitter *e, enum ag_cond cc, int vd, int vn, int vm) \
+{                                                                       \
+    check_vfp_reg("v" #name, sz, vd);                                   \
+    check_vfp_reg("v" #name, sz, vn);                                   \
+    check_vfp_reg("v" #name, sz, vm);                                   \
+    ag_emit_simd(e, AG_VFP_WORD(cc, AG_VFP_3_OPC(A, op), sz, vd, vn, vm)); \
+}
 
-#define IMPL_NEON_VR3_IPF(name, opci, opcp, opcf)                        \
-    IMPL_NEON_VR3_INT(name, opci, i);                                   \
-    IMPL_NEON_VR3_INT(name, opcp, p);                                   \
-    IMPL_NEON_VR3_FLT(name, opcf);                                      \
+#define IMPL_VFP_2(dt, sz, rsv, name, A, B, isa)                        \
+void                                                                    \
+ag_emit_vfp_##name##_##dt(struct ag_Emitter *e, enum ag_cond cc, int vd, int vm) \
+{                                                                       \
+    check_vfp_reg("v" #name, sz, vd);                                   \
+    check_vfp_reg("v" #name, sz, vm);                                   \
+    ag_emit_simd(e, AG_VFP_WORD(cc, AG_VFP_2_OPC(A, B), sz, vd, 0, vm)); \
+}
 
-AG_FOR_EACH_VR3_IPF(IMPL_NEON_VR3_IPF);
+#define AG_NEON_3SAME(name, dt, ...) AG_NEON_DT_##dt(IMPL_NEON_3SAME, name, __VA_ARGS__)
+#define AG_NEON_3DIFF(name, dt, ...) AG_NEON_DT_##dt(IMPL_NEON_3DIFF, name, __VA_ARGS__)
+#define AG_NEON_DUP IMPL_NEON_DUP
+#define AG_NEON_CVT IMPL_NEON_CVT
+#define AG_NEON_LDST_LANE(...) AG_NEON_LANE_SIZES(IMPL_NEON_LDST_LANE, __VA_ARGS__)
+#define AG_NEON_LDST_MULTI(...) AG_NEON_MULTI_SIZES(IMPL_NEON_LDST_MULTI, __VA_ARGS__)
+#define AG_NEON_SHIFT(name, dt, ...) AG_NEON_DT_##dt(IMPL_NEON_SHIFT, name, __VA_ARGS__)
+#define AG_NEON_2MISC(name, dt, ...) AG_NEON_DT_##dt(IMPL_NEON_2MISC, name, __VA_ARGS__)
+#define AG_NEON_VTBL IMPL_NEON_VTBL
+#define AG_VFP_3(name, ...) AG_VFP_DT(IMPL_VFP_3, name, __VA_ARGS__)
+#define AG_VFP_2(name, ...) AG_VFP_DT(IMPL_VFP_2, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+
+/* rt of vmov between core and SIMD registers */
+static void
+check_vmov_rt(int rt)
+{
+    if (rt < 0 || rt > 14) {
+        fprintf(stderr, "vmov : core register r%d out of range\n", rt);
+        abort();
+    }
+}
 
-#define IMPL_NEON_VR3_USIP(name, opcu, opcs, opci, opcp)                 \
-    IMPL_NEON_VR3_INT(name, opcu, u);                                   \
-    IMPL_NEON_VR3_INT(name, opcs, s);                                   \
-    IMPL_NEON_VR3_INT(name, opci, i);                                   \
-    IMPL_NEON_VR3_INT(name, opcp, p);
+void
+ag_emit_vmov_d_rr(struct ag_Emitter *e, enum ag_cond cc, int vm, int rt, int rt2)
+{
+    check_dreg("vmov", 0, vm);
+    check_vmov_rt(rt);
+    check_vmov_rt(rt2);
 
-AG_FOR_EACH_VR3_USIP(IMPL_NEON_VR3_USIP);
+    ag_emit_simd(e, AG_VMOV_RR_WORD(cc, 0, vm, rt, rt2));
+}
 
 void
-ag_emit_vdup(struct ag_Emitter *e, enum ag_cond cc, int opc, int q, int vd, int  rt)
+ag_emit_vmov_rr_d(struct ag_Emitter *e, enum ag_cond cc, int rt, int rt2, int vm)
 {
-    int dh = (vd>>4)&1;
-    int dl = vd & 0xf;
-    emit4(e, (cc<<28) | opc | (q<<21) | (dl<<16) | (rt<<12) | (dh<<7));
+    check_dreg("vmov", 0, vm);
+    check_vmov_rt(rt);
+    check_vmov_rt(rt2);
+    if (rt == rt2) {
+        fprintf(stderr, "vmov : rt and rt2 are same register\n");
+        abort();
+    }
+
+    ag_emit_simd(e, AG_VMOV_RR_WORD(cc, 1, vm, rt, rt2));
 }
 
 void
-ag_emit_vdup8(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt)
+ag_emit_vmov_s_r(struct ag_Emitter *e, enum ag_cond cc, int sn, int rt)
 {
-    ag_emit_vdup(e, cc, 0x0e800b10 | 0x00400000, q, vd, rt);
+    check_vfp_reg("vmov", 0, sn);
+    check_vmov_rt(rt);
+
+    ag_emit_simd(e, AG_VMOV_S_WORD(cc, 0, sn, rt));
 }
+
 void
-ag_emit_vdup16(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt)
+ag_emit_vmov_r_s(struct ag_Emitter *e, enum ag_cond cc, int rt, int sn)
 {
-    ag_emit_vdup(e, cc, 0x0e800b10 | 0x00000020, q, vd, rt);
+    check_vfp_reg("vmov", 0, sn);
+    check_vmov_rt(rt);
+
+    ag_emit_simd(e, AG_VMOV_S_WORD(cc, 1, sn, rt));
 }
+
 void
-ag_emit_vdup32(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt)
+ag_emit_vmov_32_d_r(struct ag_Emitter *e, enum ag_cond cc, int vn, int x, int rt)
 {
-    ag_emit_vdup(e, cc, 0x0e800b10 | 0x00000000, q, vd, rt);
-}
+    check_dreg("vmov", 0, vn);
+    check_vmov_rt(rt);
+    if (x < 0 || x > 1) {
+        fprintf(stderr, "vmov.32 : lane %d out of range\n", x);
+        abort();
+    }
 
+    ag_emit_simd(e, AG_VMOV_SCALAR_WORD(cc, 0, vn, x, rt));
+}
 
 void
-ag_emit_vcvt(struct ag_Emitter *e, int opc, int q, int vd, int vm)
+ag_emit_vmov_32_r_d(struct ag_Emitter *e, enum ag_cond cc, int rt, int vn, int x)
 {
-    int dh = (vd>>4)&1;
-    int dl = vd&0xf;
-    int mh = (vm>>4)&1;
-    int ml = vm&0xf;
+    check_dreg("vmov", 0, vn);
+    check_vmov_rt(rt);
+    if (x < 0 || x > 1) {
+        fprintf(stderr, "vmov.32 : lane %d out of range\n", x);
+        abort();
+    }
 
-    emit4(e, opc | (dh<<22) | dl<<12 | (q<<6) | (mh<<5) | ml);
+    ag_emit_simd(e, AG_VMOV_SCALAR_WORD(cc, 1, vn, x, rt));
+}
+
+static void
+check_vreg_list(const char *insn, int vd, int n)
+{
+    if (n < 1 || n > 16 || vd < 0 || vd + n > 32) {
+        fprintf(stderr, "%s : d%d, %d registers out of range\n", insn, vd, n);
+        abort();
+    }
 }
 
 void
-ag_emit_vcvt_f32_s32(struct ag_Emitter *e, int q, int vd, int vm)
+ag_emit_vpush(struct ag_Emitter *e, enum ag_cond cc, int vd, int n)
 {
-    ag_emit_vcvt(e, 0xf3bb0600, q, vd, vm);
+    check_vreg_list("vpush", vd, n);
+
+    ag_emit_simd(e, AG_VPUSH_WORD(cc, vd, n));
 }
+
 void
-ag_emit_vcvt_s32_f32(struct ag_Emitter *e, int q, int vd, int vm)
+ag_emit_vpop(struct ag_Emitter *e, enum ag_cond cc, int vd, int n)
 {
-    ag_emit_vcvt(e, 0xf3bb0700, q, vd, vm);
+    check_vreg_list("vpop", vd, n);
+
+    ag_emit_simd(e, AG_VPOP_WORD(cc, vd, n));
 }
 
 void
@@ -424,7 +1081,10 @@ ag_emit_ldrstr_imm(struct ag_Emitter *e, int opc, enum ag_cond cc, int rt, int r
         imm *= -1;
     }
 
-    imm &= (1<<13)-1;
+    if (imm > 0xfff) {
+        fprintf(stderr, "A32 : load/store offset %d out of range\n", u ? imm : -imm);
+        abort();
+    }
 
     emit4(e, incr | opc | (cc<<28) | u | (rn<<16) | (rt<<12) | imm);
 }
@@ -452,24 +1112,77 @@ ag_emit_strb_imm(struct ag_Emitter *e, enum ag_cond cc, int rt, int rn, int imm,
 }
 
 void
-ag_emit_movldr_imm(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm)
+ag_emit_movw(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm16)
 {
-    if (imm > 255 || imm < -256) {
-        label_id_t l = ag_emit_new_data_label(e, NULL);
+    emit4(e, 0x03000000 | (cc<<28) | ((imm16>>12)&0xf)<<16 | (rd<<12) | (imm16&0xfff));
+}
 
-        struct LabelRef ref;
-        ref.type = LABELREF_TYPE_LDR;
-        ref.label_id = l;
-        ref.inst_offset = e->cur;
+void
+ag_emit_movt(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm16)
+{
+    emit4(e, 0x03400000 | (cc<<28) | ((imm16>>12)&0xf)<<16 | (rd<<12) | (imm16&0xfff));
+}
 
-        VA_PUSH(struct LabelRef, &e->label_refs, ref);
+enum ag_imm_seq
+ag_imm_seq_select(const struct ag_Emitter *e, uint32_t imm, int *cost)
+{
+    if (ag_encode_modified_imm(imm) >= 0) {
+        *cost = 1;
+        return AG_IMM_SEQ_MOV;
+    }
+    if (ag_encode_modified_imm(~imm) >= 0) {
+        *cost = 1;
+        return AG_IMM_SEQ_MVN;
+    }
 
-        ag_emit_ldr_imm(e, cc, rd, AG_PC, 0, 0);
-        ag_emit4_data(e, imm);
-    } else if (imm >= 0) {
-        ag_emit_mov_imm(e, cc, 0, rd, 0, imm);
-    } else {
-        ag_emit_mvn_imm(e, cc, 0, rd, 0, ~imm);
+    if (e->has_movw) {
+        if (imm <= 0xffff) {
+            *cost = 1;
+            return AG_IMM_SEQ_MOVW;
+        }
+
+        *cost = 2;
+        return AG_IMM_SEQ_MOVW_MOVT;
+    }
+
+    /* ldr + pool word + data access */
+    *cost = 3;
+    return AG_IMM_SEQ_LITERAL;
+}
+
+void
+ag_emit_ldr_literal(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm)
+{
+    pool_load(e, cc, rd, imm, AG_NO_LABEL);
+}
+
+void
+ag_emit_movldr_imm(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm)
+{
+    int cost;
+    uint32_t v = imm;
+
+    switch (ag_imm_seq_select(e, v, &cost)) {
+    case AG_IMM_SEQ_MOV:
+        ag_emit_mov_imm(e, cc, 0, rd, 0, v);
+        break;
+
+    case AG_IMM_SEQ_MVN:
+        ag_emit_mvn_imm(e, cc, 0, rd, 0, ~v);
+        break;
+
+    case AG_IMM_SEQ_MOVW:
+        ag_emit_movw(e, cc, rd, v);
+        break;
+
+    case AG_IMM_SEQ_MOVW_MOVT:
+        ag_emit_movw(e, cc, rd, v & 0xffff);
+        ag_emit_movt(e, cc, rd, v >> 16);
+        break;
+
+    case AG_IMM_SEQ_LITERAL:
+        ag_emit_ldr_literal(e, cc, rd, imm);
+        break;
     }
 }
 
@@ -489,18 +1202,22 @@ ag_emit_strex(struct ag_Emitter *e, enum ag_cond cc, int rd, int rm, int rn)
 void
 ag_emit_vldst1(struct ag_Emitter *e, int vd, int rn, int rm, int align, int opc, int size)
 {
-    int dh = (vd >> 4)&1;
-    int dl = vd & 0xf;
-    emit4(e, opc|(dh<<22)|(rn<<16)|(dl<<12)|(size<<10)|(align<<4)|rm);
-}
+    check_dreg("vld/vst", 0, vd);
 
+    ag_emit_simd(e, AG_NEON_LDST_LANE_WORD(opc, size, vd, rn, rm, align));
+}
 
-#define IMPL_VLDST(name, nelem, type, opc, size_bits)               \
-    void ag_emit_##name##nelem##_##type(struct ag_Emitter *e, int vd, int rn, int rm, int align) { \
-        ag_emit_vldst1(e, vd, rn, rm, align, opc, size_bits);           \
+int
+ag_emit_vldst1_multi(struct ag_Emitter *e, int vd, int nreg, int rn, int rm, int align, int opc, int size)
+{
+    if (nreg < 1 || nreg > 4 || vd + nreg > 32) {
+        return -1;
     }
 
-AG_FOR_EACH_VLDST(IMPL_VLDST);
+    ag_emit_simd(e, AG_NEON_LDST_MULTI_WORD(opc, size, vd, nreg, rn, rm, align));
+
+    return 0;
+}
 
 void
 ag_emit_label(struct ag_Emitter *e, ag_label_id_t label)
@@ -557,35 +1274,28 @@ ag_emitter_init(struct ag_Emitter *e)
     e->data_cur = 0;
     e->code = NULL;
     e->code_size = 0;
+    e->has_movw = 1;
+    e->narrow = 1;
+    e->it_remaining = 0;
+    e->isa = AG_ISA_A32;
 
-    alloc_1block(&e->code_last, NULL);
-    alloc_1block(&e->const_last, NULL);
+    arena_get(&e->code_mem, CODE_BUFFER_INIT_SIZE);
+    e->code_buffer = (uint32_t*)e->code_mem.rw;
+
+    e->data_buffer_size = DATA_BUFFER_INIT_SIZE;
+    e->data_buffer = (uint32_t*)malloc(e->data_buffer_size);
+    npr_varray_init(&e->pool_labels, 16, sizeof(label_id_t));
+    npr_varray_init(&e->pool_targets, 16, sizeof(label_id_t));
+    e->pool_first_use = POOL_NO_USE;
+    e->branch_first_pending = POOL_NO_USE;
 
     npr_varray_init(&e->labels, 16, sizeof(struct Label));
     npr_varray_init(&e->label_refs, 16, sizeof(struct LabelRef));
 }
 
 static void
-free_chain(struct CodeBufferBlock *cb)
-{
-    while (cb) {
-        struct CodeBufferBlock *cbn = cb->chain;
-        free(cb);
-        cb = cbn;
-    }
-}
-
-
-void
-ag_emitter_fini(struct ag_Emitter *e)
+free_label_str(struct ag_Emitter *e)
 {
-    if (e->code) {
-        munmap(e->code, e->code_size);
-    }
-
-    free_chain(e->code_last);
-    free_chain(e->const_last);
-
     int n = e->labels.nelem;
     struct Label *labels = (struct Label*)e->labels.elements;
     for (int i=0; i<n; i++) {
@@ -593,57 +1303,81 @@ ag_emitter_fini(struct ag_Emitter *e)
             free(labels[i].label_str);
         }
     }
-
-    npr_varray_discard(&e->labels);
-    npr_varray_discard(&e->label_refs);
 }
 
-static size_t
-block_list_count_byte(struct CodeBufferBlock *cb)
+void
+ag_emitter_reset(struct ag_Emitter *e)
 {
-    size_t byte_count = 0;
+    free_label_str(e);
 
-    while (cb) {
-        byte_count += cb->cur * INST_SIZE;
-        cb = cb->chain;
-    }
+    e->labels.nelem = 0;
+    e->label_refs.nelem = 0;
 
-    return byte_count;
+    e->cur = 0;
+    e->data_cur = 0;
+    e->pool_labels.nelem = 0;
+    e->pool_targets.nelem = 0;
+    e->pool_first_use = POOL_NO_USE;
+    e->branch_first_pending = POOL_NO_USE;
+    e->it_remaining = 0;
+    e->code = NULL;
+    e->code_size = 0;
 }
 
-
-static void
-emit_code_block(unsigned char *p, struct CodeBufferBlock *cb0, size_t base)
+void
+ag_emitter_fini(struct ag_Emitter *e)
 {
-    struct CodeBufferBlock *cb;
-    unsigned int block_count = 0;
+    /* e->code is in code_mem after ag_alloc_code */
+    arena_put(&e->code_mem);
+    free(e->data_buffer);
+    npr_varray_discard(&e->pool_labels);
+    npr_varray_discard(&e->pool_targets);
 
-    cb = cb0;
-    while (cb) {
-        block_count++;
-        cb = cb->chain;
-    }
+    free_label_str(e);
 
-    cb = cb0;
-    for (int i=0; i<block_count; i++) {
-        int d = (block_count - i)-1;
-        size_t offset = d * CODEBUFFER_SIZE * INST_SIZE;
+    npr_varray_discard(&e->labels);
+    npr_varray_discard(&e->label_refs);
+}
 
-        memcpy(p + offset + base, cb->buffer, cb->cur * INST_SIZE);
+static void
+label_error(struct ag_Emitter *e, label_id_t id, const char *msg)
+{
+    struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, id);
+    fprintf(stderr, "ag: label %d (%s): %s\n", (int)id,
+            l->label_str ? l->label_str : "anonymous", msg);
+    abort();
+}
 
-        struct CodeBufferBlock *cbn = cb->chain;
-        free(cb);
-        cb = cbn;
+/* in units of ISA */
+static uint32_t
+label_pos(struct ag_Emitter *e, label_id_t id, size_t code_units)
+{
+    struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, id);
+
+    switch (l->state) {
+    case LABEL_STATE_EMITTED_DATA:
+        return POOL_UNITS(&isa_table[e->isa], l->offset) + code_units;
+    case LABEL_STATE_EMITTED:
+        return l->offset;
+    default:
+        label_error(e, id, "referenced but not emitted");
+        return 0;
     }
 }
 
-
 void
-ag_alloc_code(void **ret, size_t *ret_size,
-              struct ag_Emitter *e)
+ag_finalize_code(void **ret, size_t *ret_size,
+                 struct ag_Emitter *e)
 {
-    size_t byte_count_code = block_list_count_byte(e->code_last);
-    size_t byte_count_const = block_list_count_byte(e->const_last);
+    unsigned int unit = isa_table[e->isa].unit;
+
+    if (e->data_cur && (e->cur * unit) % INST_SIZE) {
+        /* T32 : pool words are word aligned */
+        put2(e, T32_NOP16);
+    }
+
+    size_t byte_count_code = e->cur * unit;
+    size_t byte_count_const = e->data_cur * INST_SIZE;
     size_t byte_count = byte_count_code + byte_count_const;
 
     if (byte_count == 0) {
@@ -652,61 +1386,306 @@ ag_alloc_code(void **ret, size_t *ret_size,
         return;
     }
 
-    unsigned int page_size = sysconf(_SC_PAGE_SIZE);
-    unsigned int alloc_size = ((byte_count+(page_size-1))/page_size) * page_size;
+    /* x86 has no pool */
+    size_t code_units = e->cur;
+
+    /* code is already in place, append literal pool */
+    reserve_code(e, byte_count);
 
-    unsigned char *p = (unsigned char*)mmap(0, alloc_size,
-                                            PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANONYMOUS|MAP_PRIVATE,
-                                            0, 0);
+    /* write through rw view, run from rx view */
+    unsigned char *p = e->code_mem.rw;
+    memcpy(p + byte_count_code, e->data_buffer, byte_count_const);
 
-    emit_code_block(p, e->code_last, 0);
-    emit_code_block(p, e->const_last, byte_count_code);
+    for (unsigned int i=0; i<e->data_cur; i++) {
+        label_id_t target = VA_ELEM(label_id_t, &e->pool_targets, i);
+        if (target != AG_NO_LABEL) {
+            struct LabelRef ref;
+            ref.type = LABELREF_TYPE_ABS32;
+            ref.label_id = target;
+            ref.inst_offset = code_units + POOL_UNITS(&isa_table[e->isa], i);
+            VA_PUSH(struct LabelRef, &e->label_refs, ref);
+        }
+    }
 
-    e->code_last = NULL;
-    e->const_last = NULL;
+    size_t alloc_size = page_round_up(byte_count);
 
-    e->code = p;
+    e->code = e->code_mem.rx;
     e->code_size = alloc_size;
 
-    *ret = p;
+    *ret = e->code;
     *ret_size = byte_count;
 
-    uint32_t *inst_list = (uint32_t*)p;
     /* resolve label */
     int nref = e->label_refs.nelem;
     for (int ri=0; ri<nref; ri++) {
         struct LabelRef *lr = VA_ELEM_PTR(struct LabelRef, &e->label_refs, ri);
-        struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, lr->label_id);
-        uint32_t *inst;
+        uint32_t *inst = (uint32_t*)(p + lr->inst_offset * unit);
+        uint16_t *hw = (uint16_t*)inst; /* T32 : hw[0] is first halfword */
         uint32_t inst_val;
 
-        uint32_t label_pos;
-
-        if (l->state == LABEL_STATE_EMITTED_DATA) {
-            label_pos = l->offset + (byte_count_code>>2);
-        } else {
-            label_pos = l->offset;
-        }
-
-        int d = label_pos - lr->inst_offset;
+        uint32_t pos = label_pos(e, lr->label_id, code_units);
+        int64_t d = (int64_t)pos - lr->inst_offset;
 
         switch (lr->type) {
         case LABELREF_TYPE_BRANCH:
-            inst = &inst_list[lr->inst_offset];
             inst_val = (*inst) & 0xff000000;
             d -= 2;
+            if (! BRANCH_IN_RANGE(d)) {
+                label_error(e, lr->label_id, "branch out of range");
+            }
             inst_val |= d&0x00ffffff;
             *inst = inst_val;
             break;
 
         case LABELREF_TYPE_LDR:
-            inst = &inst_list[lr->inst_offset];
-            inst_val = (*inst) & (~0<<12);
+            inst_val = (*inst) & ~((1<<23) | 0xfff);
             d -= 2;
             d *= 4;
-            inst_val |= d&0x001fff;
+            if (d < 0) {
+                d = -d;
+            } else {
+                inst_val |= (1<<23);
+            }
+            if (d > 4095) {
+                label_error(e, lr->label_id, "literal out of ldr range");
+            }
+            inst_val |= d;
             *inst = inst_val;
             break;
+
+        case LABELREF_TYPE_ABS32:
+            *inst = (uint32_t)(uintptr_t)(e->code + pos * unit);
+            break;
+
+        case LABELREF_TYPE_A64_B26:
+            if (! OFFSET_IN_RANGE(d, 26)) {
+                label_error(e, lr->label_id, "branch out of range");
+            }
+            *inst = (*inst & ~0x03ffffffU) | (d & 0x03ffffff);
+            break;
+
+        case LABELREF_TYPE_A64_B19:
+            if (! OFFSET_IN_RANGE(d, 19)) {
+                label_error(e, lr->label_id, "19bit offset out of range");
+            }
+            *inst = (*inst & ~(0x7ffffU<<5)) | ((d & 0x7ffff)<<5);
+            break;
+
+        case LABELREF_TYPE_A64_B14:
+            if (! OFFSET_IN_RANGE(d, 14)) {
+                label_error(e, lr->label_id, "14bit offset out of range");
+            }
+            *inst = (*inst & ~(0x3fffU<<5)) | ((d & 0x3fff)<<5);
+            break;
+
+        case LABELREF_TYPE_X86_REL32:
+            /* from end of rel32 field, may be unaligned */
+            d -= 4;
+            if (d < INT32_MIN || d > INT32_MAX) {
+                label_error(e, lr->label_id, "rel32 out of range");
+            }
+            inst_val = (uint32_t)d;
+            memcpy(inst, &inst_val, 4);
+            break;
+
+        case LABELREF_TYPE_T32_B24:
+            /* halfwords from pc (+4 bytes). S:I1:I2:imm10:imm11, J = ~I ^ S */
+            d -= 2;
+            if (! OFFSET_IN_RANGE(d, 24)) {
+                label_error(e, lr->label_id, "branch out of range");
+            } else {
+                uint32_t s = (d >> 23) & 1;
+                uint32_t j1 = (~(d >> 22) & 1) ^ s;
+                uint32_t j2 = (~(d >> 21) & 1) ^ s;
+                hw[0] = (hw[0] & 0xf800) | (s<<10) | ((d >> 11) & 0x3ff);
+                hw[1] = (hw[1] & 0xd000) | (j1<<13) | (j2<<11) | (d & 0x7ff);
+            }
+            break;
+
+        case LABELREF_TYPE_T32_B20:
+            /* S:J2:J1:imm6:imm11 */
+            d -= 2;
+            if (! OFFSET_IN_RANGE(d, 20)) {
+                label_error(e, lr->label_id, "conditional branch out of range");
+            } else {
+                hw[0] = (hw[0] & 0xfbc0) | (((d >> 19) & 1)<<10) | ((d >> 11) & 0x3f);
+                hw[1] = (hw[1] & 0xd000) | (((d >> 17) & 1)<<13) | (((d >> 18) & 1)<<11) | (d & 0x7ff);
+            }
+            break;
+
+        case LABELREF_TYPE_T32_LDR:
+            /* bytes from Align(pc, 4) */
+            d = (int64_t)pos * 2 - (((int64_t)lr->inst_offset * 2 + 4) & ~3);
+            hw[0] &= ~(1<<7);
+            if (d < 0) {
+                d = -d;
+            } else {
+                hw[0] |= (1<<7);
+            }
+            if (d > 4095) {
+                label_error(e, lr->label_id, "literal out of ldr range");
+            }
+            hw[1] = (hw[1] & 0xf000) | d;
+            break;
+
+        case LABELREF_TYPE_T32_CB:
+            /* cbz/cbnz : forward only, i:imm5 halfwords */
+            d -= 2;
+            if (d < 0 || d > 63) {
+                label_error(e, lr->label_id, "cbz target out of range");
+            }
+            hw[0] = (hw[0] & ~0x02f8) | (((d >> 5) & 1)<<9) | ((d & 0x1f)<<3);
+            break;
+        }
+    }
+}
+
+static int
+symbol_cmp(const void *a, const void *b)
+{
+    const struct Label *la = *(const struct Label * const *)a;
+    const struct Label *lb = *(const struct Label * const *)b;
+
+    if (la->offset < lb->offset) {
+        return -1;
+    }
+    return la->offset > lb->offset;
+}
+
+int
+ag_get_symbols(struct ag_Emitter *e, struct npr_varray *ret)
+{
+    unsigned int unit = isa_table[e->isa].unit;
+    int nl = e->labels.nelem;
+    int ns = 0;
+
+    if (e->code == NULL) {
+        return -1;
+    }
+
+    struct Label **syms = (struct Label**)malloc(sizeof(struct Label*) * (nl + 1));
+
+    for (int i=0; i<nl; i++) {
+        struct Label *l = VA_ELEM_PTR(struct Label, &e->labels, i);
+        if (l->label_str && l->state == LABEL_STATE_EMITTED) {
+            syms[ns++] = l;
+        }
+    }
+
+    qsort(syms, ns, sizeof(syms[0]), symbol_cmp);
+
+    for (int i=0; i<ns; i++) {
+        uint32_t end = (i+1 < ns) ? syms[i+1]->offset : e->cur;
+        if (end == syms[i]->offset) {
+            /* two names at same address, keep last one */
+            continue;
+        }
+
+        struct ag_symbol sym;
+        sym.offset = syms[i]->offset * unit;
+        sym.size = (end - syms[i]->offset) * unit;
+        sym.name = syms[i]->label_str;
+        VA_PUSH(struct ag_symbol, ret, sym);
+    }
+
+    free(syms);
+
+    return 0;
+}
+
+int
+ag_write_symbol_map(FILE *fp, struct ag_Emitter *e, const char *prefix)
+{
+    struct npr_varray syms;
+
+    npr_varray_init(&syms, 16, sizeof(struct ag_symbol));
+
+    if (ag_get_symbols(e, &syms) < 0) {
+        npr_varray_discard(&syms);
+        return -1;
+    }
+
+    for (size_t i=0; i<syms.nelem; i++) {
+        struct ag_symbol *sym = VA_ELEM_PTR(struct ag_symbol, &syms, i);
+
+        fprintf(fp, "%lx %lx %s%s%s\n",
+                (unsigned long)(uintptr_t)(e->code + sym->offset),
+                (unsigned long)sym->size,
+                prefix ? prefix : "",
+                prefix ? "." : "",
+                sym->name);
+    }
+
+    npr_varray_discard(&syms);
+
+    return 0;
+}
+
+int
+ag_code_is_position_independent(const struct ag_Emitter *e)
+{
+    int nref = e->label_refs.nelem;
+
+    for (int ri=0; ri<nref; ri++) {
+        const struct LabelRef *lr = VA_ELEM_PTR(const struct LabelRef, &e->label_refs, ri);
+        if (lr->type == LABELREF_TYPE_ABS32) {
+            return 0;
         }
     }
+
+    return 1;
+}
+
+void *
+ag_code_entry(const struct ag_Emitter *e, void *code)
+{
+    if (e->isa == AG_ISA_T32) {
+        return (char*)code + 1;
+    }
+
+    return code;
+}
+
+void
+ag_alloc_code(void **ret, size_t *ret_size,
+              struct ag_Emitter *e)
+{
+    ag_finalize_code(ret, ret_size, e);
+
+    if (*ret_size) {
+        npr_exec_mem_publish(&e->code_mem, 0, *ret_size);
+    }
+}
+
+void
+ag_publish_batch_init(struct ag_publish_batch *b)
+{
+    npr_varray_init(&b->ranges, 16, sizeof(struct npr_exec_range));
+}
+
+void
+ag_publish_batch_add(struct ag_publish_batch *b, void *code, size_t size)
+{
+    struct npr_exec_range r;
+
+    if (size == 0) {
+        return;
+    }
+
+    r.begin = code;
+    r.end = (char*)code + size;
+    VA_PUSH(struct npr_exec_range, &b->ranges, r);
+}
+
+void
+ag_publish_batch_commit(struct ag_publish_batch *b)
+{
+    npr_exec_sync_ranges((struct npr_exec_range*)b->ranges.elements, b->ranges.nelem);
+    b->ranges.nelem = 0;
+}
+
+void
+ag_publish_batch_fini(struct ag_publish_batch *b)
+{
+    npr_varray_discard(&b->ranges);
 }
@@ -5,23 +5,53 @@
 extern "C" {
 #endif
 
+#include <stdio.h>
 #include <stdint.h>
 #include "npr/varray.h"
+#include "npr/exec-mem.h"
 #include "ag/ag_insns.h"
 
 
+enum ag_isa {
+    AG_ISA_A32,
+    AG_ISA_A64,                 /* ag64_gen.h */
+    AG_ISA_X86_64,              /* agx86_gen.h */
+    AG_ISA_T32,                 /* agt32_gen.h */
+};
+
 struct ag_Emitter {
-    unsigned int cur;
+    enum ag_isa isa;
+
+    unsigned int cur;           /* in instruction words (x86-64 : bytes, T32 : halfwords) */
     unsigned int data_cur;
 
-    struct CodeBufferBlock *code_last;
-    struct CodeBufferBlock *const_last;
+    /* instructions are written in place (rw view), ag_alloc_code does not copy them */
+    struct npr_exec_mem code_mem;
+    uint32_t *code_buffer;      /* code_mem.rw */
+
+    /* pending literal pool. flushed into code (with a branch over it)
+     * before the first ldr using it goes out of range, rest is appended
+     * to code by ag_alloc_code */
+    uint32_t *data_buffer;
+    size_t data_buffer_size;
+    struct npr_varray pool_labels; /* label id of each data_buffer word */
+    struct npr_varray pool_targets; /* AG_NO_LABEL, or label whose address is the word */
+    unsigned int pool_first_use;   /* offset of first ldr to pending pool */
+    unsigned int branch_first_pending; /* offset of first branch to label not emitted yet */
 
     struct npr_varray labels;
     struct npr_varray label_refs;
 
     unsigned char *code;
     size_t code_size;
+
+    /* movw/movt available (ARMv6T2 and later). default 1 */
+    int has_movw;
+
+    /* T32 : pick 16bit encoding when one exists. default 1 */
+    int narrow;
+    /* T32 : instructions left in current IT block, pool is not flushed inside */
+    unsigned int it_remaining;
 };
 
 enum ag_cond {
@@ -80,19 +110,30 @@ enum ag_cond {
 #define AG_LSL_AM(am) AG_SHIFT_AMOUNT(am, AG_SHIFT_LOG_LEFT)
 #define AG_LSR_AM(am) AG_SHIFT_AMOUNT(am, AG_SHIFT_LOG_RIGHT)
 #define AG_ASR_AM(am) AG_SHIFT_AMOUNT(am, AG_SHIFT_ARITH_RIGHT)
-#define AG_ROR_AM(am) AG_SHIFT_AMOUNT(am, AG_ROTATE_RIGHT)
+#define AG_ROR_AM(am) AG_SHIFT_AMOUNT(am, AG_SHIFT_ROTATE_RIGHT)
 
 #define AG_SHIFT_REG(reg, type) (((reg)<<4) | ((type)<<1) | 1)
 
 #define AG_LSL_REG(r) AG_SHIFT_REG(r, AG_SHIFT_LOG_LEFT)
 #define AG_LSR_REG(r) AG_SHIFT_REG(r, AG_SHIFT_LOG_RIGHT)
 #define AG_ASR_REG(r) AG_SHIFT_REG(r, AG_SHIFT_ARITH_RIGHT)
-#define AG_ROR_REG(r) AG_SHIFT_REG(r, AG_ROTATE_RIGHT)
+#define AG_ROR_REG(r) AG_SHIFT_REG(r, AG_SHIFT_ROTATE_RIGHT)
 
 void ag_emitter_init(struct ag_Emitter *e);
 void ag_emitter_fini(struct ag_Emitter *e);
 
+/* start next code, keeping buffers and label arrays.
+ * code returned by previous ag_alloc_code is overwritten.
+ */
+void ag_emitter_reset(struct ag_Emitter *e);
+
+/* code buffers are recycled between emitters (init/fini).
+ * unmap cached buffers, e.g. after a suite finished.
+ */
+void ag_code_arena_trim(void);
+
 typedef unsigned int ag_label_id_t;
+#define AG_NO_LABEL (~0U)
 
 void ag_emit_label(struct ag_Emitter *e, ag_label_id_t label);
 void ag_emit_data_label(struct ag_Emitter *e, ag_label_id_t label);
@@ -132,23 +173,25 @@ enum ag_data_process_opcode {
 void ag_emit_data_process_reg(struct ag_Emitter *e, enum ag_cond cc, enum ag_data_process_opcode opc,
                               int s, int rd, int rn, int rm, int shift);
 
-void ag_emit_and_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_eor_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_sub_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_rsb_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_add_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_adc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_sbc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_rsc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-
-void ag_emit_tst_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_teq_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
+void ag_emit_and_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_eor_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_sub_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_rsb_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_add_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_adc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_sbc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_rsc_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+
+/* tst, teq always set flags (s = 0 is another instruction), s and rd are ignored */
+void ag_emit_tst_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_teq_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
 void ag_emit_cmp_reg(struct ag_Emitter *e, enum ag_cond cc, int rm, int rn, int shift);
 void ag_emit_cmn_reg(struct ag_Emitter *e, enum ag_cond cc, int rm, int rn, int shift);
-void ag_emit_orr_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_mov_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_bic_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
-void ag_emit_mvn_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rn, int shift);
+void ag_emit_orr_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+/* mov, mvn : rn is ignored */
+void ag_emit_mov_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_bic_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+void ag_emit_mvn_reg(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
 
 void ag_emit_mul(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rs);
 void ag_emit_mla(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rm, int rs, int rn);
@@ -174,74 +217,122 @@ int ag_emit_mov_imm(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn
 int ag_emit_bic_imm(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int imm);
 int ag_emit_mvn_imm(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int imm);
 
-/* ldr rd, =imm */
-void ag_emit_movldr_imm(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm);
+/* return 12bit modified immediate field (rot<<8 | imm8), negative if imm can't be encoded */
+int ag_encode_modified_imm(uint32_t imm);
 
-void ag_emit_vr3(struct ag_Emitter *E, int opc, int q, int size, int vd, int vn, int vm);
+void ag_emit_movw(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm16);
+void ag_emit_movt(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm16);
 
-#define AG_VR3_IF_GEN_PROTO(name, opci, opcf)                           \
-    void ag_emit_##name##_i32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f64(struct ag_Emitter *E, int q, int vd, int vn, int vm);
-
-AG_FOR_EACH_VR3_IF(AG_VR3_IF_GEN_PROTO);
-
-
-#define AG_VR3_USF_GEN_PROTO(name, opcu, opcs, opcf)                    \
-    void ag_emit_##name##_s32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_s16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_s8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_u32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_u16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_u8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f64(struct ag_Emitter *E, int q, int vd, int vn, int vm);
-
-AG_FOR_EACH_VR3_USF(AG_VR3_USF_GEN_PROTO);
-
-#define AG_VR3_IPF_GEN_PROTO(name, opci, opcp, opcf)                    \
-    void ag_emit_##name##_i32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_f64(struct ag_Emitter *E, int q, int vd, int vn, int vm);
-
-AG_FOR_EACH_VR3_IPF(AG_VR3_IPF_GEN_PROTO);
-
-
-#define AG_VR3_USIP_GEN_PROTO(name, opcu, opcs, opci, opcp)             \
-    void ag_emit_##name##_u32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_u16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_u8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_s32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_s16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_s8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_i8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p32(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p16(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-    void ag_emit_##name##_p8(struct ag_Emitter *E, int q, int vd, int vn, int vm); \
-
-AG_FOR_EACH_VR3_USIP(AG_VR3_USIP_GEN_PROTO);
+/* sequence to materialize a constant, cheapest first */
+enum ag_imm_seq {
+    AG_IMM_SEQ_MOV,             /* mov rd, #rot_imm */
+    AG_IMM_SEQ_MVN,             /* mvn rd, #rot_imm */
+    AG_IMM_SEQ_MOVW,            /* movw rd, #imm16 */
+    AG_IMM_SEQ_MOVW_MOVT,       /* movw + movt */
+    AG_IMM_SEQ_LITERAL,         /* ldr rd, [pc, #off] + pool word */
+};
 
+/* choose sequence for imm. *cost is number of instruction words,
+ * literal counts one more for the data access (its cache line and the load latency) */
+enum ag_imm_seq ag_imm_seq_select(const struct ag_Emitter *e, uint32_t imm, int *cost);
 
-void ag_emit_vdup(struct ag_Emitter *e, enum ag_cond cc, int opc, int q, int vd, int  rt);
-void ag_emit_vdup8(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt);
-void ag_emit_vdup16(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt);
-void ag_emit_vdup32(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt);
+/* rd = imm, with the sequence selected by ag_imm_seq_select */
+void ag_emit_movldr_imm(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm);
 
+/* ldr rd, =imm (always literal pool) */
+void ag_emit_ldr_literal(struct ag_Emitter *e, enum ag_cond cc, int rd, int imm);
+
+/* NEON emitters (ag_emit_v*) also accept T32 emitter (agt32_gen.h).
+ *
+ * vr3 : q = 1 : vd, vn, vm are q register numbers (0..15), d register
+ * numbers (0..31) otherwise. out of range registers abort.
+ * _f64, _p16 and _p32 forms are reserved encodings (ag_dis.h does not decode them)
+ *
+ * 2 register forms (vcvt, shifts, 2 registers misc, vtbl) and VFP take
+ * d register numbers (q<n> is d<2n>), VFP f32 takes s register numbers.
+ *
+ * opc of vr3, vdup, vcvt, vldst1 : AG_NEON_*_OPC (ag_insns.h)
+ */
+void ag_emit_vr3(struct ag_Emitter *E, int opc, int q, int size, int vd, int vn, int vm);
+void ag_emit_vdup(struct ag_Emitter *e, enum ag_cond cc, int opc, int q, int vd, int  rt);
 void ag_emit_vcvt(struct ag_Emitter *e, int opc, int q, int vd, int vm);
-void ag_emit_vcvt_f32_s32(struct ag_Emitter *e, int q, int vd, int vm);
-void ag_emit_vcvt_s32_f32(struct ag_Emitter *e, int q, int vd, int vm);
 
+/* Advanced SIMD / VFP instruction given in A32 encoding (T32 emitter
+ * translates it, AG_SIMD_T32) */
+void ag_emit_simd(struct ag_Emitter *e, uint32_t a32);
+
+/* emitters of ag_a32.def rows :
+ *   ag_emit_vadd_i32(e, q, vd, vn, vm) .. 3 registers. D only rows abort with q = 1
+ *   ag_emit_vmull_s32(e, q, vd, vn, vm)   vmull qd, dn, dm : q = 0, vd is d register number of qd (even)
+ *                                         (vaddw qd, qn, dm, vaddhn dd, qn, qm likewise)
+ *   ag_emit_vdup32(e, cc, q, vd, rt)
+ *   ag_emit_vcvt_f32_s32(e, q, vd, vm)    vd, vm are d register numbers
+ *   ag_emit_vld1_32(e, vd, rn, rm, index_align)
+ *   ag_emit_vld1_multi_32(e, vd, nreg, rn, rm, align)
+ *   ag_emit_vshr_s32(e, q, vd, vm, n)     shift by immediate. vshrn dd, qm / vshll qd, dm : q = 0
+ *   ag_emit_vzip_16(e, q, vd, vm)         vmovn dd, qm, vqmovn .. : q = 0
+ *   ag_emit_vtbl_8(e, vd, vn, nreg, vm)   return negative if nreg is out of range
+ *   ag_emit_vfp_add_f32(e, cc, vd, vn, vm)
+ *   ag_emit_vfp_sqrt_f64(e, cc, vd, vm)
+ * out of range operands abort.
+ */
+#define AG_NEON_VR3_PROTO(dt, size, rsv, name, ...)                      \
+    void ag_emit_##name##_##dt(struct ag_Emitter *E, int q, int vd, int vn, int vm);
+#define AG_NEON_SHIFT_PROTO(dt, size, rsv, name, ...)                    \
+    void ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm, int n);
+#define AG_NEON_2MISC_PROTO(dt, size, rsv, name, ...)                    \
+    void ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm);
+#define AG_NEON_VTBL_PROTO(name, op, isa)                               \
+    int ag_emit_##name##_8(struct ag_Emitter *e, int vd, int vn, int nreg, int vm);
+#define AG_VFP_3_PROTO(dt, sz, rsv, name, ...)                          \
+    void ag_emit_vfp_##name##_##dt(struct ag_Emitter *e, enum ag_cond cc, int vd, int vn, int vm);
+#define AG_VFP_2_PROTO(dt, sz, rsv, name, ...)                          \
+    void ag_emit_vfp_##name##_##dt(struct ag_Emitter *e, enum ag_cond cc, int vd, int vm);
+#define AG_NEON_DUP_PROTO(name, size, B, E, isa)                        \
+    void ag_emit_##name##size(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int  rt);
+#define AG_NEON_CVT_PROTO(name, dt, op, isa)                            \
+    void ag_emit_##name##_##dt(struct ag_Emitter *e, int q, int vd, int vm);
+#define AG_NEON_LDST_LANE_PROTO(type, size, name, nelem, L, isa)        \
+    void ag_emit_##name##nelem##_##type(struct ag_Emitter *e, int vd, int rn, int rm, int align);
+#define AG_NEON_LDST_MULTI_PROTO(type, size, name, L, isa)              \
+    int ag_emit_##name##_multi_##type(struct ag_Emitter *e, int vd, int nreg, int rn, int rm, int align);
+
+#define AG_NEON_3SAME(name, dt, ...) AG_NEON_DT_##dt(AG_NEON_VR3_PROTO, name, __VA_ARGS__)
+#define AG_NEON_3DIFF(name, dt, ...) AG_NEON_DT_##dt(AG_NEON_VR3_PROTO, name, __VA_ARGS__)
+#define AG_NEON_DUP AG_NEON_DUP_PROTO
+#define AG_NEON_CVT AG_NEON_CVT_PROTO
+#define AG_NEON_LDST_LANE(...) AG_NEON_LANE_SIZES(AG_NEON_LDST_LANE_PROTO, __VA_ARGS__)
+#define AG_NEON_LDST_MULTI(...) AG_NEON_MULTI_SIZES(AG_NEON_LDST_MULTI_PROTO, __VA_ARGS__)
+#define AG_NEON_SHIFT(name, dt, ...) AG_NEON_DT_##dt(AG_NEON_SHIFT_PROTO, name, __VA_ARGS__)
+#define AG_NEON_2MISC(name, dt, ...) AG_NEON_DT_##dt(AG_NEON_2MISC_PROTO, name, __VA_ARGS__)
+#define AG_NEON_VTBL AG_NEON_VTBL_PROTO
+#define AG_VFP_3(name, ...) AG_VFP_DT(AG_VFP_3_PROTO, name, __VA_ARGS__)
+#define AG_VFP_2(name, ...) AG_VFP_DT(AG_VFP_2_PROTO, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+
+/* moves between core and VFP/NEON registers
+ *   ag_emit_vmov_d_rr(e, cc, vm, rt, rt2)   vmov dm, rt, rt2
+ *   ag_emit_vmov_rr_d(e, cc, rt, rt2, vm)   vmov rt, rt2, dm
+ *   ag_emit_vmov_s_r(e, cc, sn, rt)         vmov sn, rt
+ *   ag_emit_vmov_r_s(e, cc, rt, sn)         vmov rt, sn
+ *   ag_emit_vmov_32_d_r(e, cc, vn, x, rt)   vmov.32 dn[x], rt
+ *   ag_emit_vmov_32_r_d(e, cc, rt, vn, x)   vmov.32 rt, dn[x]
+ * rt is r0 .. r14. out of range operands abort.
+ */
+void ag_emit_vmov_d_rr(struct ag_Emitter *e, enum ag_cond cc, int vm, int rt, int rt2);
+void ag_emit_vmov_rr_d(struct ag_Emitter *e, enum ag_cond cc, int rt, int rt2, int vm);
+void ag_emit_vmov_s_r(struct ag_Emitter *e, enum ag_cond cc, int sn, int rt);
+void ag_emit_vmov_r_s(struct ag_Emitter *e, enum ag_cond cc, int rt, int sn);
+void ag_emit_vmov_32_d_r(struct ag_Emitter *e, enum ag_cond cc, int vn, int x, int rt);
+void ag_emit_vmov_32_r_d(struct ag_Emitter *e, enum ag_cond cc, int rt, int vn, int x);
+
+/* vpush {dvd-d(vd+n-1)} / vpop, n is 1 .. 16. out of range operands abort */
+void ag_emit_vpush(struct ag_Emitter *e, enum ag_cond cc, int vd, int n);
+void ag_emit_vpop(struct ag_Emitter *e, enum ag_cond cc, int vd, int n);
+
+/* P, W bits. post increment is P=0 W=0, P=0 W=1 is ldrt/strt */
 #define AG_PRE_INCR    0x01200000
-#define AG_POST_INCR   0x00200000
+#define AG_POST_INCR   0x00000000
 #define AG_OFFSET_ADDR 0x01000000
 
 void ag_emit_ldstm(struct ag_Emitter *E, enum ag_cond cc, int p, int u, int s, int w, int l, int rn, int reg_bits);
@@ -268,10 +359,14 @@ void ag_emit_pop(struct ag_Emitter *e, enum ag_cond cc, int reg_bits);
 
 void ag_emit_vldst1(struct ag_Emitter *e, int vd, int rn, int rm, int align, int opc, int size_bits);
 
-#define AG_VLDST_GEN_PROTO(name, nelem, type, opc, size_bits)           \
-    void ag_emit_##name##nelem##_##type(struct ag_Emitter *e, int vd, int rn, int rm, int align);
+/* rm for vld/vst addressing */
+#define AG_VLDST_NO_WRITEBACK 15   /* [rn] */
+#define AG_VLDST_POST_INCR 13      /* [rn]! : rn += transfer size */
 
-AG_FOR_EACH_VLDST(AG_VLDST_GEN_PROTO);
+/* vld1/vst1 {vd .. vd+nreg-1}, [rn], rm. nreg = 1..4.
+ * return negative if nreg is out of range.
+ */
+int ag_emit_vldst1_multi(struct ag_Emitter *e, int vd, int nreg, int rn, int rm, int align, int opc, int size_bits);
 
 void ag_emit_ldrstr_reg(struct ag_Emitter *e, int opc, enum ag_cond cc, int rt, int rn, int rm, int shift, int add, int incr);
 
@@ -293,8 +388,67 @@ void ag_emit_strb_imm(struct ag_Emitter *e, enum ag_cond cc, int rt, int rn, int
 void ag_emit_ldrex(struct ag_Emitter *e, enum ag_cond cc, int rd, int rn);
 void ag_emit_strex(struct ag_Emitter *e, enum ag_cond cc, int rd, int rm, int rn);
 
+/* return executable address of code (rx view of code_mem),
+ * instruction cache is already synchronized.
+ * forward branches are kept in range with "b target" veneer islands
+ * emitted along the code, backward branches out of range use "ldr pc, =target".
+ * unresolvable references abort with the label name.
+ * code is valid until ag_emitter_reset or ag_emitter_fini.
+ * call once per code (reset before next one)
+ */
 void ag_alloc_code(void **ret, size_t *ret_size,
-                   struct ag_Emitter *e); /* do not call twice per ag_Emitter */
+                   struct ag_Emitter *e);
+
+/* address to call code at. T32 : code | 1, blx to it enters Thumb state */
+void *ag_code_entry(const struct ag_Emitter *e, void *code);
+
+/* write layout of named code labels after ag_alloc_code, one line per
+ * label, in perf map format ("start size name", hex).
+ * a label covers up to the next named label. name is "prefix.label" if prefix != NULL.
+ */
+int ag_write_symbol_map(FILE *fp, struct ag_Emitter *e, const char *prefix);
+
+/* named code label after ag_alloc_code, same layout as ag_write_symbol_map */
+struct ag_symbol {
+    uint32_t offset;            /* bytes from code */
+    uint32_t size;
+    const char *name;           /* owned by emitter, valid until reset/fini */
+};
+
+/* append struct ag_symbol of each named label to ret (initialized by caller).
+ * return negative before ag_alloc_code
+ */
+int ag_get_symbols(struct ag_Emitter *e, struct npr_varray *ret);
+
+/* 1 if code does not contain its own address (literal pool word with
+ * label address), it may be copied to another address after ag_alloc_code
+ */
+int ag_code_is_position_independent(const struct ag_Emitter *e);
+
+/* same as ag_alloc_code, without instruction cache maintenance.
+ * code must be published by ag_publish_batch_commit before it runs.
+ */
+void ag_finalize_code(void **ret, size_t *ret_size,
+                      struct ag_Emitter *e);
+
+/* publish many finalized codes with one cache maintenance sequence.
+ *
+ *   ag_finalize_code(&c0, &s0, &e0); ag_publish_batch_add(&b, c0, s0);
+ *   ag_finalize_code(&c1, &s1, &e1); ag_publish_batch_add(&b, c1, s1);
+ *   ag_publish_batch_commit(&b);
+ *
+ * commit makes codes executable on the calling thread. other threads
+ * must call npr_exec_mem_acquire() after they synchronized with the
+ * committer (pthread barrier, mutex, ..) and before running the codes.
+ */
+struct ag_publish_batch {
+    struct npr_varray ranges;   /* npr_exec_range */
+};
+
+void ag_publish_batch_init(struct ag_publish_batch *b);
+void ag_publish_batch_add(struct ag_publish_batch *b, void *code, size_t size);
+void ag_publish_batch_commit(struct ag_publish_batch *b); /* clears ranges */
+void ag_publish_batch_fini(struct ag_publish_batch *b);
 
 
 #ifdef __cplusplus
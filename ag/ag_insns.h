@@ -1,68 +1,162 @@
 #ifndef AG_INSNS_H
 #define AG_INSNS_H
 
-#define AG_NEON_VR3_ADDI 0x02000800
-#define AG_NEON_VR3_ADDF 0x02000d00
+/* fields of ag_a32.def rows */
 
+/* isa column */
+#define AG_A32_FEAT_NEON 1      /* ARMv7 Advanced SIMD */
+#define AG_A32_FEAT_VFP 2       /* VFPv3, 32 d registers with NEON */
+#define AG_A32_FEAT_VFPV4 4     /* fused multiply add (VFPv4, Advanced SIMDv2) */
 
-#define AG_FOR_EACH_VR3_IF(F)                      \
-    F(vadd, AG_NEON_VR3_ADDI, AG_NEON_VR3_ADDF)    \
-    F(vmla, AG_NEON_VR3_ADDI, AG_NEON_VR3_ADDF)    \
-
-
-#define AG_NEON_VR3_VPMAXS 0x02000a00
-#define AG_NEON_VR3_VPMAXU 0x03000a00
-#define AG_NEON_VR3_VPMAXF 0x03000f00
-
-#define AG_NEON_VR3_VPMINS 0x02000a10
-#define AG_NEON_VR3_VPMINU 0x03000a10
-#define AG_NEON_VR3_VPMINF 0x03200f00
-
-#define AG_FOR_EACH_VR3_USF(F)                       \
-    F(vpmax, AG_NEON_VR3_VPMAXU, AG_NEON_VR3_VPMAXS, AG_NEON_VR3_VPMAXF) \
-    F(vpmin, AG_NEON_VR3_VPMINU, AG_NEON_VR3_VPMINS, AG_NEON_VR3_VPMINF)
-
-
-#define AG_NEON_VR3_VMULI 0x02000910
-#define AG_NEON_VR3_VMULP 0x03000910
-#define AG_NEON_VR3_VMULF 0x03000d10
-
-#define AG_FOR_EACH_VR3_IPF(F)                                          \
-    F(vmul, AG_NEON_VR3_VMULI, AG_NEON_VR3_VMULP, AG_NEON_VR3_VMULF)
-
-#define AG_NEON_VR3_VMULLU 0x03800c00
-#define AG_NEON_VR3_VMULLS 0x02800c00
-#define AG_NEON_VR3_VMULLI 0x03800e00
-#define AG_NEON_VR3_VMULLP 0x02800e00
-
-#define AG_FOR_EACH_VR3_USIP(F)                                         \
-    F(vmull, AG_NEON_VR3_VMULLU, AG_NEON_VR3_VMULLS, AG_NEON_VR3_VMULLI, AG_NEON_VR3_VMULLP)
-
-#define AG_VLD1_1 0xf4a00000
-#define AG_VLD2_1 0xf4a00100
-#define AG_VLD3_1 0xf4a00200
-#define AG_VLD4_1 0xf4a00300
-
-#define AG_VST1_1 0xf4800000
-#define AG_VST2_1 0xf4800100
-#define AG_VST3_1 0xf4800200
-#define AG_VST4_1 0xf4800300
-
-
-#define AG_FOR_EACH_VLDST_NELEM(F, type, size_bits)      \
-    F(vld, 1, type, AG_VLD1_1, size_bits)                           \
-    F(vld, 2, type, AG_VLD2_1, size_bits)                            \
-    F(vld, 3, type, AG_VLD3_1, size_bits)                            \
-    F(vld, 4, type, AG_VLD4_1, size_bits)                            \
-    F(vst, 1, type, AG_VST1_1, size_bits)                           \
-    F(vst, 2, type, AG_VST2_1, size_bits)                            \
-    F(vst, 3, type, AG_VST3_1, size_bits)                            \
-    F(vst, 4, type, AG_VST4_1, size_bits)
-
-#define AG_FOR_EACH_VLDST(F)                                         \
-    AG_FOR_EACH_VLDST_NELEM(F, 8, 0)                                     \
-    AG_FOR_EACH_VLDST_NELEM(F, 16, 1)                                     \
-    AG_FOR_EACH_VLDST_NELEM(F, 32, 2)
+/* regs column
+ *   Q_OK, D_OK : q / d form is allowed (q argument)
+ *   QD, QN, QM : with q = 0, operand is a q register given by its d
+ *                register number (long, wide, narrow forms)
+ */
+#define AG_NEON_Q_OK_DQ 1
+#define AG_NEON_Q_OK_D 0
+#define AG_NEON_Q_OK_Q 1
+#define AG_NEON_Q_OK_L 0
+#define AG_NEON_Q_OK_W 0
+#define AG_NEON_Q_OK_N 0
+
+#define AG_NEON_D_OK_DQ 1
+#define AG_NEON_D_OK_D 1
+#define AG_NEON_D_OK_Q 0
+#define AG_NEON_D_OK_L 1
+#define AG_NEON_D_OK_W 1
+#define AG_NEON_D_OK_N 1
+
+#define AG_NEON_QD_DQ 0
+#define AG_NEON_QD_D 0
+#define AG_NEON_QD_Q 0
+#define AG_NEON_QD_L 1
+#define AG_NEON_QD_W 1
+#define AG_NEON_QD_N 0
+
+#define AG_NEON_QN_DQ 0
+#define AG_NEON_QN_D 0
+#define AG_NEON_QN_Q 0
+#define AG_NEON_QN_L 0
+#define AG_NEON_QN_W 1
+#define AG_NEON_QN_N 1
+
+#define AG_NEON_QM_DQ 0
+#define AG_NEON_QM_D 0
+#define AG_NEON_QM_Q 0
+#define AG_NEON_QM_L 0
+#define AG_NEON_QM_W 0
+#define AG_NEON_QM_N 1
+
+/* dt column. T(dt, size, reserved, ...) for each data type of class */
+#define AG_NEON_DT_I(T, ...) T(i8, 0, 0, __VA_ARGS__) T(i16, 1, 0, __VA_ARGS__) T(i32, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_S(T, ...) T(s8, 0, 0, __VA_ARGS__) T(s16, 1, 0, __VA_ARGS__) T(s32, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_U(T, ...) T(u8, 0, 0, __VA_ARGS__) T(u16, 1, 0, __VA_ARGS__) T(u32, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_P(T, ...) T(p8, 0, 0, __VA_ARGS__) T(p16, 1, 1, __VA_ARGS__) T(p32, 2, 1, __VA_ARGS__)
+#define AG_NEON_DT_F(T, ...) T(f32, 0, 0, __VA_ARGS__) T(f64, 1, 1, __VA_ARGS__)
+#define AG_NEON_DT_ID(T, ...) AG_NEON_DT_I(T, __VA_ARGS__) T(i64, 3, 0, __VA_ARGS__)
+#define AG_NEON_DT_SD(T, ...) AG_NEON_DT_S(T, __VA_ARGS__) T(s64, 3, 0, __VA_ARGS__)
+#define AG_NEON_DT_UD(T, ...) AG_NEON_DT_U(T, __VA_ARGS__) T(u64, 3, 0, __VA_ARGS__)
+#define AG_NEON_DT_SH(T, ...) T(s16, 1, 0, __VA_ARGS__) T(s32, 2, 0, __VA_ARGS__)
+/* narrowing, size is of the result */
+#define AG_NEON_DT_NI(T, ...) T(i16, 0, 0, __VA_ARGS__) T(i32, 1, 0, __VA_ARGS__) T(i64, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_NS(T, ...) T(s16, 0, 0, __VA_ARGS__) T(s32, 1, 0, __VA_ARGS__) T(s64, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_NU(T, ...) T(u16, 0, 0, __VA_ARGS__) T(u32, 1, 0, __VA_ARGS__) T(u64, 2, 0, __VA_ARGS__)
+/* untyped, 2 registers misc */
+#define AG_NEON_DT_B(T, ...) T(8, 0, 0, __VA_ARGS__) T(16, 1, 0, __VA_ARGS__)
+#define AG_NEON_DT_B32(T, ...) T(32, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_U32(T, ...) T(u32, 2, 0, __VA_ARGS__)
+#define AG_NEON_DT_F32(T, ...) T(f32, 2, 0, __VA_ARGS__)
+
+/* VFP rows, size is sz field. f32 operands are s registers, f64 d registers */
+#define AG_VFP_DT(T, ...) T(f32, 0, 0, __VA_ARGS__) T(f64, 1, 0, __VA_ARGS__)
+
+/* element sizes of vld/vst. T(type, size, ...) */
+#define AG_NEON_LANE_SIZES(T, ...) T(8, 0, __VA_ARGS__) T(16, 1, __VA_ARGS__) T(32, 2, __VA_ARGS__)
+#define AG_NEON_MULTI_SIZES(T, ...) AG_NEON_LANE_SIZES(T, __VA_ARGS__) T(64, 3, __VA_ARGS__)
+
+/* opcode of row (operand fields are 0) */
+#define AG_NEON_3SAME_OPC(U, A, B, C) (0xf2000000 | ((U)<<24) | ((C)<<20) | ((A)<<8) | ((B)<<4))
+#define AG_NEON_3DIFF_OPC(U, A) (0xf2800000 | ((U)<<24) | ((A)<<8))
+#define AG_NEON_DUP_OPC(B, E) (0x0e800b10 | ((B)<<22) | ((E)<<5))
+#define AG_NEON_CVT_OPC(op) (0xf3bb0600 | ((op)<<7))
+#define AG_NEON_LDST_LANE_OPC(nelem, L) (0xf4800000 | ((L)<<21) | (((nelem)-1)<<8))
+#define AG_NEON_LDST_MULTI_OPC(L) (0xf4000000 | ((L)<<21))
+#define AG_NEON_SHIFT_OPC(U, A) (0xf2800010 | ((U)<<24) | ((A)<<8))
+#define AG_NEON_2MISC_OPC(A, B) (0xf3b00000 | ((A)<<16) | ((B)<<6))
+#define AG_NEON_VTBL_OPC(op) (0xf3b00800 | ((op)<<6))
+#define AG_VFP_3_OPC(A, op) (0x0e000a00 | ((A)<<20) | ((op)<<6))
+#define AG_VFP_2_OPC(A, B) (0x0eb00a00 | ((A)<<16) | ((B)<<6))
+
+/* type field (11:8) of vld1/vst1 multi, indexed by number of registers - 1 */
+#define AG_VLDST1_MULTI_TYPE(nreg) \
+    ((nreg)==1 ? 0x7 : (nreg)==2 ? 0xa : (nreg)==3 ? 0x6 : 0x2)
+
+/* D:Vd, N:Vn, M:Vm fields of d register number */
+#define AG_NEON_VD(d) (((((d)>>4)&1)<<22) | (((d)&0xf)<<12))
+#define AG_NEON_VN(n) (((((n)>>4)&1)<<7) | (((n)&0xf)<<16))
+#define AG_NEON_VM(m) (((((m)>>4)&1)<<5) | ((m)&0xf))
+
+/* D:Vd field value of VFP register, s<n> is Vd:D */
+#define AG_VFP_REG(sz, r) ((sz) ? (r) : ((((r)&1)<<4) | (((r)>>1)&0xf)))
+
+/* d register number (q<n> : d<2n>) fits the field */
+#define AG_NEON_DREG_OK(q, d) ((d) >= 0 && (d) <= 31 && !((q) && ((d)&1)))
+
+/* A32 word of instruction, register operands are d register numbers.
+ * shared by C emitters (ag_gen.c) and C++ encoders (ag_a32enc.h) */
+#define AG_NEON_VR3_WORD(opc, q, size, vd, vn, vm) \
+    ((opc) | ((size)<<20) | ((q)<<6) | AG_NEON_VD(vd) | AG_NEON_VN(vn) | AG_NEON_VM(vm))
+#define AG_NEON_DUP_WORD(cc, opc, q, vd, rt) \
+    (((cc)<<28) | (opc) | ((q)<<21) | (((vd)&0xf)<<16) | ((rt)<<12) | ((((vd)>>4)&1)<<7))
+#define AG_NEON_CVT_WORD(opc, q, vd, vm) \
+    ((opc) | ((q)<<6) | AG_NEON_VD(vd) | AG_NEON_VM(vm))
+#define AG_NEON_LDST_LANE_WORD(opc, size, vd, rn, rm, align) \
+    ((opc) | AG_NEON_VD(vd) | ((rn)<<16) | ((size)<<10) | ((align)<<4) | (rm))
+#define AG_NEON_LDST_MULTI_WORD(opc, size, vd, nreg, rn, rm, align) \
+    ((opc) | AG_NEON_VD(vd) | ((rn)<<16) | (AG_VLDST1_MULTI_TYPE(nreg)<<8) | ((size)<<6) | ((align)<<4) | (rm))
+
+/* L:imm6 of shift by n, element of 8<<size bits (result of narrowing) */
+#define AG_NEON_SHIFT_IMM(right, size, n) ((right) ? (16<<(size)) - (n) : (8<<(size)) + (n))
+#define AG_NEON_SHIFT_WORD(opc, right, q, size, vd, vm, n) \
+    ((opc) | (((AG_NEON_SHIFT_IMM(right, size, n)>>6)&1)<<7) | ((AG_NEON_SHIFT_IMM(right, size, n)&0x3f)<<16) | \
+     ((q)<<6) | AG_NEON_VD(vd) | AG_NEON_VM(vm))
+#define AG_NEON_2MISC_WORD(opc, q, size, vd, vm) \
+    ((opc) | ((size)<<18) | ((q)<<6) | AG_NEON_VD(vd) | AG_NEON_VM(vm))
+#define AG_NEON_VTBL_WORD(opc, vd, vn, nreg, vm) \
+    ((opc) | (((nreg)-1)<<8) | AG_NEON_VD(vd) | AG_NEON_VN(vn) | AG_NEON_VM(vm))
+#define AG_VFP_WORD(cc, opc, sz, vd, vn, vm) \
+    (((cc)<<28) | (opc) | ((sz)<<8) | AG_NEON_VD(AG_VFP_REG(sz, vd)) | \
+     AG_NEON_VN(AG_VFP_REG(sz, vn)) | AG_NEON_VM(AG_VFP_REG(sz, vm)))
+
+/* moves between core and VFP/NEON registers, op = 1 : to core registers
+ *   vmov dm, rt, rt2 / vmov rt, rt2, dm   cccc 1100 010o uuuu tttt 1011 00M1 mmmm
+ *   vmov sn, rt / vmov rt, sn             cccc 1110 000o nnnn tttt 1010 N001 0000
+ *   vmov.32 dn[x], rt / vmov.32 rt, dn[x] cccc 1110 00xo nnnn tttt 1011 N001 0000
+ */
+#define AG_VMOV_RR_WORD(cc, op, vm, rt, rt2) \
+    (((cc)<<28) | 0x0c400b10 | ((op)<<20) | ((rt2)<<16) | ((rt)<<12) | AG_NEON_VM(vm))
+#define AG_VMOV_S_WORD(cc, op, sn, rt) \
+    (((cc)<<28) | 0x0e000a10 | ((op)<<20) | ((rt)<<12) | AG_NEON_VN(AG_VFP_REG(0, sn)))
+#define AG_VMOV_SCALAR_WORD(cc, op, vn, x, rt) \
+    (((cc)<<28) | 0x0e000b10 | ((x)<<21) | ((op)<<20) | ((rt)<<12) | AG_NEON_VN(vn))
+
+/* vpush / vpop of n consecutive d registers from vd (vstmdb / vldmia sp!)
+ *   vpush {dd-..}   cccc 1101 0D10 1101 dddd 1011 iiii iiii   imm8 = 2n
+ *   vpop {dd-..}    cccc 1100 1D11 1101 dddd 1011 iiii iiii
+ */
+#define AG_VPUSH_WORD(cc, vd, n) \
+    (((cc)<<28) | 0x0d2d0b00 | AG_NEON_VD(vd) | ((n)*2))
+#define AG_VPOP_WORD(cc, vd, n) \
+    (((cc)<<28) | 0x0cbd0b00 | AG_NEON_VD(vd) | ((n)*2))
+
+/* T32 form of Advanced SIMD / VFP word given in A32 encoding, first
+ * halfword in low 16bit. same fields with different top byte
+ * (f2/f3 -> ef/ff, f4 -> f9), VFP and vdup (cond = AL) are same */
+#define AG_SIMD_T32_HI(v)                                               \
+    ((((v) >> 25) == 0x79) ? (0xef000000 | ((((v) >> 24) & 1) << 28) | ((v) & 0x00ffffff)) : \
+     (((v) >> 24) == 0xf4) ? (0xf9000000 | ((v) & 0x00ffffff)) : (v))
+#define AG_SIMD_T32(v) ((AG_SIMD_T32_HI(v) >> 16) | (AG_SIMD_T32_HI(v) << 16))
 
 /* 20:L, 6:S, 5:H *
  *   28   24   20   16     12    8    4    0
@@ -87,9 +181,10 @@
 #define AG_LDRB_REG (0x06500000)
 #define AG_STRB_REG (0x06400000)
 
-#define AG_LDR_IMM  (0x05100000)
-#define AG_STR_IMM  (0x05000000)
-#define AG_LDRB_IMM (0x05500000)
-#define AG_STRB_IMM (0x05400000)
+/* P, W are given by incr (AG_OFFSET_ADDR ..) */
+#define AG_LDR_IMM  (0x04100000)
+#define AG_STR_IMM  (0x04000000)
+#define AG_LDRB_IMM (0x04500000)
+#define AG_STRB_IMM (0x04400000)
 
 #endif
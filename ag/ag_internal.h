@@ -0,0 +1,62 @@
+#ifndef AG_INTERNAL_H
+#define AG_INTERNAL_H
+
+/* shared by ISA backends (ag_gen.c, ag64_gen.c, agx86_gen.c, agt32_gen.c) */
+
+#include "ag/ag_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum labelref_type {
+    LABELREF_TYPE_BRANCH, /* A32 b/bl : low 24bit, offset -8, shift 2 */
+    LABELREF_TYPE_LDR,    /* A32 ldr : low 12bit + U bit, offset -8, shift 0 */
+    LABELREF_TYPE_ABS32,  /* 32bit absolute address (rx view) */
+
+    LABELREF_TYPE_A64_B26, /* A64 b/bl : bit 0-25, shift 2 */
+    LABELREF_TYPE_A64_B19, /* A64 b.cond, cbz, ldr literal : bit 5-23, shift 2 */
+    LABELREF_TYPE_A64_B14, /* A64 tbz : bit 5-18, shift 2 */
+
+    LABELREF_TYPE_X86_REL32, /* x86 jmp/jcc/call/rip : 32bit field, from end of field */
+
+    LABELREF_TYPE_T32_B24, /* T32 b.w/bl : S:I1:I2:imm10:imm11, offset -4 bytes */
+    LABELREF_TYPE_T32_B20, /* T32 b<c>.w : S:J2:J1:imm6:imm11 */
+    LABELREF_TYPE_T32_LDR, /* T32 ldr.w literal : imm12 + U bit, from Align(pc, 4) */
+    LABELREF_TYPE_T32_CB,  /* T32 cbz/cbnz : i:imm5, forward only */
+};
+
+/* emit one instruction (T32 : 32bit instruction, first halfword in low 16bit) */
+void ag_emit4(struct ag_Emitter *e, uint32_t val);
+
+/* emit one T32 16bit instruction */
+void ag_emit2(struct ag_Emitter *e, uint16_t val);
+
+/* flush pool / veneer island here if it is due. ag_emit* do this before
+ * each instruction, call it before computing pc relative offset of next
+ * instruction. calling twice is same as once */
+void ag_check_pool(struct ag_Emitter *e);
+
+/* byte stream ISA (x86-64) : e->cur and label offsets are in bytes */
+void ag_emit_bytes(struct ag_Emitter *e, const void *p, unsigned int n);
+
+/* record that field at current position refers to label */
+void ag_add_label_ref(struct ag_Emitter *e, enum labelref_type type, ag_label_id_t label);
+
+/* emit instruction whose offset field refers to label, fixed by ag_alloc_code */
+void ag_emit4_ref(struct ag_Emitter *e, uint32_t val, enum labelref_type type, ag_label_id_t label);
+
+/* emit inst loading literal pool word val, offset field is fixed with ref type.
+ * target != AG_NO_LABEL : word is absolute address of target
+ */
+void ag_emit_pool_load(struct ag_Emitter *e, uint32_t inst, enum labelref_type type,
+                       uint32_t val, ag_label_id_t target);
+
+/* return 1 and set *offset (in words, x86 : bytes, T32 : halfwords) if label is emitted in code */
+int ag_label_offset(struct ag_Emitter *e, ag_label_id_t label, uint32_t *offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,745 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ag/agt32_gen.h"
+#include "ag/ag_internal.h"
+
+#define emit2 ag_emit2
+
+#define LO(r) ((unsigned int)(r) < 8)
+
+#define OFFSET_IN_RANGE(d, bits) ((d) >= -(1<<((bits)-1)) && (d) < (1<<((bits)-1)))
+
+/* hw1:hw2 (as written in ARM ARM) <-> memory order (hw1 first) */
+static uint32_t
+swap_hw(uint32_t v)
+{
+    return (v >> 16) | (v << 16);
+}
+
+/* 32bit instruction, hw1 in upper 16bit */
+static void
+emit32(struct ag_Emitter *e, uint32_t v)
+{
+    ag_emit4(e, swap_hw(v));
+}
+
+void
+agt32_emitter_init(struct ag_Emitter *e)
+{
+    ag_emitter_init(e);
+    e->isa = AG_ISA_T32;
+}
+
+/* 16bit forms of adds, subs, movs, ... set flags outside IT block, and
+ * keep them inside IT block */
+static int
+narrow_setflags_ok(const struct ag_Emitter *e, enum agt32_flags s)
+{
+    if (! e->narrow) {
+        return 0;
+    }
+    if (s == AGT32_FLAGS_ANY) {
+        return 1;
+    }
+    if (e->it_remaining) {
+        return s == AGT32_FLAGS_KEEP;
+    }
+    return s == AGT32_FLAGS_SET;
+}
+
+/* 16bit forms which never set flags (add rdn, rm / mov rd, rm) */
+static int
+narrow_keepflags_ok(const struct ag_Emitter *e, enum agt32_flags s)
+{
+    return e->narrow && s != AGT32_FLAGS_SET;
+}
+
+static void
+check_shift(int shift)
+{
+    if (shift & 1) {
+        fprintf(stderr, "T32 : register shifted register operand is not encodable\n");
+        abort();
+    }
+}
+
+/* data processing (shifted register) */
+static void
+emit_wide_dp_reg(struct ag_Emitter *e, int op, int S, int rd, int rn, int rm, int shift)
+{
+    int type = (shift>>1) & 3;
+    int amount = (shift>>3) & 0x1f;
+
+    check_shift(shift);
+
+    emit32(e, 0xea000000 | (op<<21) | (S<<20) | (rn<<16) | ((amount>>2)<<12) |
+           (rd<<8) | ((amount&3)<<6) | (type<<4) | rm);
+}
+
+/* data processing (modified immediate). m : agt32_encode_modified_imm() */
+static void
+emit_wide_dp_imm(struct ag_Emitter *e, int op, int S, int rd, int rn, int m)
+{
+    emit32(e, 0xf0000000 | ((m>>11)<<26) | (op<<21) | (S<<20) | (rn<<16) |
+           (((m>>8)&7)<<12) | (rd<<8) | (m&0xff));
+}
+
+int
+agt32_encode_modified_imm(uint32_t imm)
+{
+    uint32_t b = imm & 0xff;
+
+    if (imm <= 0xff) {
+        return imm;
+    }
+    if (imm == ((b<<16) | b)) {
+        return 0x100 | b;
+    }
+    if (imm == b * 0x01010101U) {
+        return 0x300 | b;
+    }
+
+    b = (imm >> 8) & 0xff;
+    if (imm == ((b<<24) | (b<<8))) {
+        return 0x200 | b;
+    }
+
+    /* 1bcdefgh ror n, n = 8..31 */
+    for (int rot=8; rot<32; rot++) {
+        uint32_t v = (imm << rot) | (imm >> (32 - rot));
+        if (v >= 0x80 && v <= 0xff) {
+            return (rot<<7) | (v & 0x7f);
+        }
+    }
+
+    return -1;
+}
+
+#define DP_AND 0
+#define DP_ORR 2
+#define DP_ORN 3
+#define DP_EOR 4
+#define DP_ADD 8
+#define DP_ADC 10
+#define DP_SUB 13
+#define DP_RSB 14
+
+static int
+dp_commutative(int op)
+{
+    return op == DP_AND || op == DP_ORR || op == DP_EOR || op == DP_ADD || op == DP_ADC;
+}
+
+static void
+emit_dp_reg(struct ag_Emitter *e, int op, int op16, enum agt32_flags s,
+            int rd, int rn, int rm, int shift)
+{
+    int lo = LO(rd) && LO(rn) && LO(rm);
+
+    if (shift == 0) {
+        if (op == DP_ADD) {
+            if (lo && narrow_setflags_ok(e, s)) {
+                emit2(e, 0x1800 | (rm<<6) | (rn<<3) | rd);
+                return;
+            }
+            if (rd != 15 && (rd == rn || rd == rm) && narrow_keepflags_ok(e, s)) {
+                int r = (rd == rn) ? rm : rn;
+                emit2(e, 0x4400 | ((rd&8)<<4) | (r<<3) | (rd&7));
+                return;
+            }
+        }
+
+        if (op == DP_SUB && lo && narrow_setflags_ok(e, s)) {
+            emit2(e, 0x1a00 | (rm<<6) | (rn<<3) | rd);
+            return;
+        }
+
+        if (op16 >= 0 && lo && narrow_setflags_ok(e, s)) {
+            if (rd == rn) {
+                emit2(e, 0x4000 | (op16<<6) | (rm<<3) | rd);
+                return;
+            }
+            if (rd == rm && dp_commutative(op)) {
+                emit2(e, 0x4000 | (op16<<6) | (rn<<3) | rd);
+                return;
+            }
+        }
+    }
+
+    emit_wide_dp_reg(e, op, s == AGT32_FLAGS_SET, rd, rn, rm, shift);
+}
+
+static int
+emit_dp_imm(struct ag_Emitter *e, int op, enum agt32_flags s, int rd, int rn, uint32_t imm)
+{
+    int m;
+
+    if (op == DP_ADD || op == DP_SUB) {
+        int sub = (op == DP_SUB);
+
+        if (LO(rd) && LO(rn) && narrow_setflags_ok(e, s)) {
+            if (imm <= 7) {
+                emit2(e, (sub ? 0x1e00 : 0x1c00) | (imm<<6) | (rn<<3) | rd);
+                return 0;
+            }
+            if (rd == rn && imm <= 0xff) {
+                emit2(e, (sub ? 0x3800 : 0x3000) | (rd<<8) | imm);
+                return 0;
+            }
+        }
+
+        /* add sp, sp, #imm */
+        if (rd == 13 && rn == 13 && (imm & 3) == 0 && imm <= 508 &&
+            narrow_keepflags_ok(e, s))
+        {
+            emit2(e, (sub ? 0xb080 : 0xb000) | (imm>>2));
+            return 0;
+        }
+    }
+
+    if (op == DP_RSB && imm == 0 && LO(rd) && LO(rn) && narrow_setflags_ok(e, s)) {
+        /* negs */
+        emit2(e, 0x4240 | (rn<<3) | rd);
+        return 0;
+    }
+
+    m = agt32_encode_modified_imm(imm);
+    if (m >= 0) {
+        emit_wide_dp_imm(e, op, s == AGT32_FLAGS_SET, rd, rn, m);
+        return 0;
+    }
+
+    if ((op == DP_ADD || op == DP_SUB) && s != AGT32_FLAGS_SET && imm <= 0xfff) {
+        /* addw / subw */
+        emit32(e, (op == DP_ADD ? 0xf2000000 : 0xf2a00000) | ((imm>>11)<<26) | (rn<<16) |
+               (((imm>>8)&7)<<12) | (rd<<8) | (imm&0xff));
+        return 0;
+    }
+
+    return -1;
+}
+
+#define IMPL_DP(name, op, op16)                                         \
+    void                                                                \
+    agt32_emit_##name##_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, int rm, int shift) \
+    {                                                                   \
+        emit_dp_reg(e, op, op16, s, rd, rn, rm, shift);                 \
+    }                                                                   \
+    int                                                                 \
+    agt32_emit_##name##_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, uint32_t imm) \
+    {                                                                   \
+        return emit_dp_imm(e, op, s, rd, rn, imm);                      \
+    }
+
+AGT32_FOR_EACH_DP(IMPL_DP);
+
+/* compare : wide form is dp with S and rd = pc */
+static void
+emit_cmp_reg(struct ag_Emitter *e, int op, int narrow_op, int rn, int rm, int shift)
+{
+    if (e->narrow && shift == 0 && narrow_op >= 0 && LO(rn) && LO(rm)) {
+        emit2(e, narrow_op | (rm<<3) | rn);
+        return;
+    }
+
+    emit_wide_dp_reg(e, op, 1, 15, rn, rm, shift);
+}
+
+static int
+emit_cmp_imm(struct ag_Emitter *e, int op, int rn, uint32_t imm)
+{
+    int m = agt32_encode_modified_imm(imm);
+
+    if (m < 0) {
+        return -1;
+    }
+
+    emit_wide_dp_imm(e, op, 1, 15, rn, m);
+    return 0;
+}
+
+void
+agt32_emit_cmp_reg(struct ag_Emitter *e, int rn, int rm, int shift)
+{
+    if (e->narrow && shift == 0 && !(LO(rn) && LO(rm)) && !(rn == 15 && rm == 15)) {
+        /* high registers */
+        emit2(e, 0x4500 | ((rn&8)<<4) | (rm<<3) | (rn&7));
+        return;
+    }
+
+    emit_cmp_reg(e, DP_SUB, 0x4280, rn, rm, shift);
+}
+
+void
+agt32_emit_cmn_reg(struct ag_Emitter *e, int rn, int rm, int shift)
+{
+    emit_cmp_reg(e, DP_ADD, 0x42c0, rn, rm, shift);
+}
+
+void
+agt32_emit_tst_reg(struct ag_Emitter *e, int rn, int rm, int shift)
+{
+    emit_cmp_reg(e, DP_AND, 0x4200, rn, rm, shift);
+}
+
+void
+agt32_emit_teq_reg(struct ag_Emitter *e, int rn, int rm, int shift)
+{
+    emit_cmp_reg(e, DP_EOR, -1, rn, rm, shift);
+}
+
+int
+agt32_emit_cmp_imm(struct ag_Emitter *e, int rn, uint32_t imm)
+{
+    if (e->narrow && LO(rn) && imm <= 0xff) {
+        emit2(e, 0x2800 | (rn<<8) | imm);
+        return 0;
+    }
+
+    return emit_cmp_imm(e, DP_SUB, rn, imm);
+}
+
+int
+agt32_emit_cmn_imm(struct ag_Emitter *e, int rn, uint32_t imm)
+{
+    return emit_cmp_imm(e, DP_ADD, rn, imm);
+}
+
+int
+agt32_emit_tst_imm(struct ag_Emitter *e, int rn, uint32_t imm)
+{
+    return emit_cmp_imm(e, DP_AND, rn, imm);
+}
+
+int
+agt32_emit_teq_imm(struct ag_Emitter *e, int rn, uint32_t imm)
+{
+    return emit_cmp_imm(e, DP_EOR, rn, imm);
+}
+
+void
+agt32_emit_mov_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rm, int shift)
+{
+    int type = (shift>>1) & 3;
+
+    if (shift == 0 && narrow_keepflags_ok(e, s)) {
+        emit2(e, 0x4600 | ((rd&8)<<4) | (rm<<3) | (rd&7));
+        return;
+    }
+
+    /* lsls/lsrs/asrs rd, rm, #n (movs rd, rm : lsls #0) */
+    if (!(shift & 1) && type != AG_SHIFT_ROTATE_RIGHT && LO(rd) && LO(rm) &&
+        narrow_setflags_ok(e, s))
+    {
+        emit2(e, (type<<11) | (((shift>>3)&0x1f)<<6) | (rm<<3) | rd);
+        return;
+    }
+
+    /* orr rd, pc, rm = mov.w */
+    emit_wide_dp_reg(e, DP_ORR, s == AGT32_FLAGS_SET, rd, 15, rm, shift);
+}
+
+void
+agt32_emit_mvn_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rm, int shift)
+{
+    if (shift == 0 && LO(rd) && LO(rm) && narrow_setflags_ok(e, s)) {
+        emit2(e, 0x43c0 | (rm<<3) | rd);
+        return;
+    }
+
+    emit_wide_dp_reg(e, DP_ORN, s == AGT32_FLAGS_SET, rd, 15, rm, shift);
+}
+
+int
+agt32_emit_mov_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, uint32_t imm)
+{
+    int m;
+
+    if (LO(rd) && imm <= 0xff && narrow_setflags_ok(e, s)) {
+        emit2(e, 0x2000 | (rd<<8) | imm);
+        return 0;
+    }
+
+    m = agt32_encode_modified_imm(imm);
+    if (m >= 0) {
+        emit_wide_dp_imm(e, DP_ORR, s == AGT32_FLAGS_SET, rd, 15, m);
+        return 0;
+    }
+
+    if (s != AGT32_FLAGS_SET && imm <= 0xffff) {
+        agt32_emit_movw(e, rd, imm);
+        return 0;
+    }
+
+    return -1;
+}
+
+int
+agt32_emit_mvn_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, uint32_t imm)
+{
+    int m = agt32_encode_modified_imm(imm);
+
+    if (m < 0) {
+        return -1;
+    }
+
+    emit_wide_dp_imm(e, DP_ORN, s == AGT32_FLAGS_SET, rd, 15, m);
+    return 0;
+}
+
+void
+agt32_emit_shift_reg(struct ag_Emitter *e, enum agt32_flags s, int type, int rd, int rn, int rm)
+{
+    static const int op16[4] = {2, 3, 4, 7};
+
+    if (rd == rn && LO(rd) && LO(rm) && narrow_setflags_ok(e, s)) {
+        emit2(e, 0x4000 | (op16[type]<<6) | (rm<<3) | rd);
+        return;
+    }
+
+    emit32(e, 0xfa00f000 | (type<<21) | ((s == AGT32_FLAGS_SET)<<20) | (rn<<16) | (rd<<8) | rm);
+}
+
+static void
+emit_mov16(struct ag_Emitter *e, uint32_t opc, int rd, int imm16)
+{
+    emit32(e, opc | (((imm16>>11)&1)<<26) | (((imm16>>12)&0xf)<<16) |
+           (((imm16>>8)&7)<<12) | (rd<<8) | (imm16&0xff));
+}
+
+void
+agt32_emit_movw(struct ag_Emitter *e, int rd, int imm16)
+{
+    emit_mov16(e, 0xf2400000, rd, imm16);
+}
+
+void
+agt32_emit_movt(struct ag_Emitter *e, int rd, int imm16)
+{
+    emit_mov16(e, 0xf2c00000, rd, imm16);
+}
+
+void
+agt32_emit_movldr_imm(struct ag_Emitter *e, int rd, uint32_t imm)
+{
+    if (agt32_emit_mov_imm(e, AGT32_FLAGS_KEEP, rd, imm) == 0) {
+        return;
+    }
+    if (agt32_emit_mvn_imm(e, AGT32_FLAGS_KEEP, rd, ~imm) == 0) {
+        return;
+    }
+
+    agt32_emit_movw(e, rd, imm & 0xffff);
+    agt32_emit_movt(e, rd, imm >> 16);
+}
+
+void
+agt32_emit_ldr_literal(struct ag_Emitter *e, int rd, uint32_t imm)
+{
+    /* ldr.w rd, [pc, #+-imm12], offset is fixed by T32_LDR ref */
+    ag_emit_pool_load(e, swap_hw(0xf85f0000 | (rd<<12)), LABELREF_TYPE_T32_LDR,
+                      imm, AG_NO_LABEL);
+}
+
+void
+agt32_emit_mul(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, int rm)
+{
+    if (LO(rd) && LO(rn) && LO(rm) && (rd == rn || rd == rm) && narrow_setflags_ok(e, s)) {
+        /* muls rdm, rn, rdm */
+        emit2(e, 0x4340 | (((rd == rm) ? rn : rm)<<3) | rd);
+        return;
+    }
+
+    if (s == AGT32_FLAGS_SET) {
+        fprintf(stderr, "T32 : muls needs rd = rn or rm, low registers, outside IT block\n");
+        abort();
+    }
+
+    emit32(e, 0xfb00f000 | (rn<<16) | (rd<<8) | rm);
+}
+
+void
+agt32_emit_mla(struct ag_Emitter *e, int rd, int rn, int rm, int ra)
+{
+    emit32(e, 0xfb000000 | (rn<<16) | (ra<<12) | (rd<<8) | rm);
+}
+
+void
+agt32_emit_sdiv(struct ag_Emitter *e, int rd, int rn, int rm)
+{
+    emit32(e, 0xfb90f0f0 | (rn<<16) | (rd<<8) | rm);
+}
+
+void
+agt32_emit_udiv(struct ag_Emitter *e, int rd, int rn, int rm)
+{
+    emit32(e, 0xfbb0f0f0 | (rn<<16) | (rd<<8) | rm);
+}
+
+static void
+emit_ldst_imm(struct ag_Emitter *e, int size, int l, int rt, int rn, int imm, int incr)
+{
+    uint32_t hw1 = 0xf800 | (size<<5) | (l<<4) | rn;
+
+    if (e->narrow && incr == AG_OFFSET_ADDR && imm >= 0 && (imm & ((1<<size)-1)) == 0) {
+        int scaled = imm >> size;
+
+        if (LO(rt) && LO(rn) && scaled <= 31) {
+            static const uint16_t base[3] = {0x7000, 0x8000, 0x6000};
+            emit2(e, base[size] | (l<<11) | (scaled<<6) | (rn<<3) | rt);
+            return;
+        }
+        if (size == 2 && rn == 13 && LO(rt) && scaled <= 0xff) {
+            emit2(e, 0x9000 | (l<<11) | (rt<<8) | scaled);
+            return;
+        }
+    }
+
+    if (incr == AG_OFFSET_ADDR && imm >= 0 && imm <= 0xfff) {
+        emit32(e, ((hw1 | 0x80)<<16) | (rt<<12) | imm);
+        return;
+    }
+
+    if (imm >= -255 && imm <= 255) {
+        int p = (incr != AG_POST_INCR);
+        int w = (incr != AG_OFFSET_ADDR);
+        int u = (imm >= 0);
+
+        emit32(e, (hw1<<16) | (rt<<12) | 0x800 | (p<<10) | (u<<9) | (w<<8) |
+               (u ? imm : -imm));
+        return;
+    }
+
+    fprintf(stderr, "T32 : load/store offset %d out of range\n", imm);
+    abort();
+}
+
+static void
+emit_ldst_reg(struct ag_Emitter *e, int size, int l, int op16, int rt, int rn, int rm, int lsl)
+{
+    if (e->narrow && lsl == 0 && LO(rt) && LO(rn) && LO(rm)) {
+        emit2(e, 0x5000 | (op16<<9) | (rm<<6) | (rn<<3) | rt);
+        return;
+    }
+
+    emit32(e, ((0xf800 | (size<<5) | (l<<4) | rn)<<16) | (rt<<12) | (lsl<<4) | rm);
+}
+
+#define IMPL_LDST(name, size, load, op16)                               \
+    void                                                                \
+    agt32_emit_##name##_imm(struct ag_Emitter *e, int rt, int rn, int imm, int incr) \
+    {                                                                   \
+        emit_ldst_imm(e, size, load, rt, rn, imm, incr);                \
+    }                                                                   \
+    void                                                                \
+    agt32_emit_##name##_reg(struct ag_Emitter *e, int rt, int rn, int rm, int lsl) \
+    {                                                                   \
+        emit_ldst_reg(e, size, load, op16, rt, rn, rm, lsl);            \
+    }
+
+AGT32_FOR_EACH_LDST(IMPL_LDST);
+
+static void
+emit_ldstm(struct ag_Emitter *e, int l, int w, int rn, int reg_bits)
+{
+    if (__builtin_popcount(reg_bits) == 1) {
+        /* ldm/stm.w with one register is unpredictable */
+        emit_ldst_imm(e, 2, l, __builtin_ctz(reg_bits), rn,
+                      w ? 4 : 0, w ? AG_POST_INCR : AG_OFFSET_ADDR);
+        return;
+    }
+
+    if (e->narrow && LO(rn) && reg_bits <= 0xff) {
+        /* 16bit stmia always writes back, 16bit ldmia writes back unless rn is loaded */
+        int rn_in_list = (reg_bits >> rn) & 1;
+        if ((l == 0 && w) || (l && w == !rn_in_list)) {
+            emit2(e, (l ? 0xc800 : 0xc000) | (rn<<8) | reg_bits);
+            return;
+        }
+    }
+
+    emit32(e, ((0xe880 | (w<<5) | (l<<4) | rn)<<16) | reg_bits);
+}
+
+void
+agt32_emit_ldmia(struct ag_Emitter *e, int w, int rn, int reg_bits)
+{
+    emit_ldstm(e, 1, w, rn, reg_bits);
+}
+
+void
+agt32_emit_stmia(struct ag_Emitter *e, int w, int rn, int reg_bits)
+{
+    emit_ldstm(e, 0, w, rn, reg_bits);
+}
+
+void
+agt32_emit_push(struct ag_Emitter *e, int reg_bits)
+{
+    if (e->narrow && (reg_bits & ~(0xff | (1<<AG_LR))) == 0) {
+        emit2(e, 0xb400 | (((reg_bits>>AG_LR)&1)<<8) | (reg_bits&0xff));
+        return;
+    }
+
+    if (__builtin_popcount(reg_bits) == 1) {
+        emit_ldst_imm(e, 2, 0, __builtin_ctz(reg_bits), AG_SP, -4, AG_PRE_INCR);
+        return;
+    }
+
+    /* stmdb sp!, {..} */
+    emit32(e, 0xe92d0000 | reg_bits);
+}
+
+void
+agt32_emit_pop(struct ag_Emitter *e, int reg_bits)
+{
+    if (e->narrow && (reg_bits & ~(0xff | (1<<AG_PC))) == 0) {
+        emit2(e, 0xbc00 | (((reg_bits>>AG_PC)&1)<<8) | (reg_bits&0xff));
+        return;
+    }
+
+    if (__builtin_popcount(reg_bits) == 1) {
+        emit_ldst_imm(e, 2, 1, __builtin_ctz(reg_bits), AG_SP, 4, AG_POST_INCR);
+        return;
+    }
+
+    /* ldmia sp!, {..} */
+    emit32(e, 0xe8bd0000 | reg_bits);
+}
+
+void
+agt32_emit_ldrex(struct ag_Emitter *e, int rt, int rn)
+{
+    emit32(e, 0xe8500f00 | (rn<<16) | (rt<<12));
+}
+
+void
+agt32_emit_strex(struct ag_Emitter *e, int rd, int rt, int rn)
+{
+    emit32(e, 0xe8400000 | (rn<<16) | (rt<<12) | (rd<<8));
+}
+
+void
+agt32_emit_b(struct ag_Emitter *e, enum ag_cond cc, ag_label_id_t dst)
+{
+    uint32_t pos;
+
+    /* pool flush would move the branch after offset is computed */
+    ag_check_pool(e);
+
+    if (ag_label_offset(e, dst, &pos)) {
+        /* halfwords from pc (+4 bytes) */
+        int32_t d = (int32_t)pos - (int32_t)e->cur - 2;
+
+        if (e->narrow && cc == AG_COND_AL && OFFSET_IN_RANGE(d, 11)) {
+            emit2(e, 0xe000 | (d & 0x7ff));
+            return;
+        }
+        if (e->narrow && cc != AG_COND_AL && !e->it_remaining && OFFSET_IN_RANGE(d, 8)) {
+            emit2(e, 0xd000 | (cc<<8) | (d & 0xff));
+            return;
+        }
+
+        if (cc != AG_COND_AL && !OFFSET_IN_RANGE(d, 20)) {
+            /* b<!cc> skip; b.w dst; skip: */
+            ag_label_id_t skip = ag_alloc_label(e, NULL);
+            agt32_emit_b(e, (enum ag_cond)(cc ^ 1), skip);
+            agt32_emit_b(e, AG_COND_AL, dst);
+            ag_emit_label(e, skip);
+            return;
+        }
+    }
+
+    if (cc == AG_COND_AL) {
+        ag_emit4_ref(e, swap_hw(0xf0009000), LABELREF_TYPE_T32_B24, dst);
+    } else {
+        ag_emit4_ref(e, swap_hw(0xf0008000 | (cc<<22)), LABELREF_TYPE_T32_B20, dst);
+    }
+}
+
+void
+agt32_emit_bl(struct ag_Emitter *e, ag_label_id_t dst)
+{
+    ag_emit4_ref(e, swap_hw(0xf000d000), LABELREF_TYPE_T32_B24, dst);
+}
+
+static void
+emit_cb(struct ag_Emitter *e, int nonzero, int rn, ag_label_id_t dst)
+{
+    if (! LO(rn)) {
+        fprintf(stderr, "T32 : cbz/cbnz needs low register\n");
+        abort();
+    }
+
+    ag_check_pool(e);
+    ag_add_label_ref(e, LABELREF_TYPE_T32_CB, dst);
+    emit2(e, 0xb100 | (nonzero<<11) | rn);
+}
+
+void
+agt32_emit_cbz(struct ag_Emitter *e, int rn, ag_label_id_t dst)
+{
+    emit_cb(e, 0, rn, dst);
+}
+
+void
+agt32_emit_cbnz(struct ag_Emitter *e, int rn, ag_label_id_t dst)
+{
+    emit_cb(e, 1, rn, dst);
+}
+
+void
+agt32_emit_bx(struct ag_Emitter *e, int rm)
+{
+    emit2(e, 0x4700 | (rm<<3));
+}
+
+void
+agt32_emit_blx_reg(struct ag_Emitter *e, int rm)
+{
+    emit2(e, 0x4780 | (rm<<3));
+}
+
+void
+agt32_emit_it(struct ag_Emitter *e, enum ag_cond cc, const char *then_else)
+{
+    int n = strlen(then_else);
+    int mask = 0;
+
+    if (n > 3 || (cc == AG_COND_AL && strchr(then_else, 'e'))) {
+        fprintf(stderr, "T32 : bad it block \"it%s\"\n", then_else);
+        abort();
+    }
+
+    /* x, y, z : 't' is firstcond[0], 'e' is inverted, then terminating 1 */
+    for (int i=0; i<n; i++) {
+        int bit;
+        if (then_else[i] == 't') {
+            bit = cc & 1;
+        } else if (then_else[i] == 'e') {
+            bit = !(cc & 1);
+        } else {
+            fprintf(stderr, "T32 : bad it block \"it%s\"\n", then_else);
+            abort();
+        }
+        mask |= bit << (3-i);
+    }
+    mask |= 1 << (3-n);
+
+    emit2(e, 0xbf00 | (cc<<4) | mask);
+
+    /* no pool flush until end of block */
+    e->it_remaining = n + 1;
+}
+
+void
+agt32_emit_nop(struct ag_Emitter *e)
+{
+    if (e->narrow) {
+        emit2(e, 0xbf00);
+    } else {
+        emit32(e, 0xf3af8000);
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef AGT32_GEN_H
+#define AGT32_GEN_H
+
+/* Thumb-2 (T32) backend.
+ *
+ * uses struct ag_Emitter and its label / literal pool / publication
+ * functions (ag_gen.h). initialize with agt32_emitter_init instead of
+ * ag_emitter_init. e->cur and label offsets are in halfwords. call
+ * generated code at ag_code_entry() (code | 1).
+ *
+ * 16bit encoding is picked when operands fit and e->narrow is set,
+ * 32bit encoding otherwise. NEON emitters of ag_gen.h (ag_emit_v*)
+ * can be used with T32 emitter, other ag_emit_* are A32 only.
+ *
+ * conditional execution is done with IT block (agt32_emit_it),
+ * instructions have no condition field except b.
+ *
+ * s : enum agt32_flags
+ * shift : AG_LSL_AM(n) .. (immediate shift only, no register shift)
+ * incr : AG_OFFSET_ADDR, AG_PRE_INCR, AG_POST_INCR
+ */
+
+#include "ag/ag_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum agt32_flags {
+    AGT32_FLAGS_KEEP = 0,       /* condition flags must not change */
+    AGT32_FLAGS_SET = 1,        /* flags are set ("s" suffix) */
+    AGT32_FLAGS_ANY = 2,        /* don't care, any encoding (shortest) */
+};
+
+void agt32_emitter_init(struct ag_Emitter *e);
+
+/* data processing : F(name, op of 32bit encodings, op of 16bit "rdn op= rm" form or -1) */
+#define AGT32_FOR_EACH_DP(F)                    \
+    F(and, 0, 0)                                \
+    F(bic, 1, 14)                               \
+    F(orr, 2, 12)                               \
+    F(orn, 3, -1)                               \
+    F(eor, 4, 1)                                \
+    F(add, 8, -1)                               \
+    F(adc, 10, 5)                               \
+    F(sbc, 11, 6)                               \
+    F(sub, 13, -1)                              \
+    F(rsb, 14, -1)
+
+/* rd = rn op (rm shift). imm : return negative if imm can't be encoded */
+#define AGT32_DP_GEN_PROTO(name, op, op16)                              \
+    void agt32_emit_##name##_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, int rm, int shift); \
+    int agt32_emit_##name##_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, uint32_t imm);
+
+AGT32_FOR_EACH_DP(AGT32_DP_GEN_PROTO);
+
+/* return 12bit i:imm3:imm8 field of modified immediate, negative if imm can't be encoded */
+int agt32_encode_modified_imm(uint32_t imm);
+
+void agt32_emit_cmp_reg(struct ag_Emitter *e, int rn, int rm, int shift);
+void agt32_emit_cmn_reg(struct ag_Emitter *e, int rn, int rm, int shift);
+void agt32_emit_tst_reg(struct ag_Emitter *e, int rn, int rm, int shift);
+void agt32_emit_teq_reg(struct ag_Emitter *e, int rn, int rm, int shift);
+int agt32_emit_cmp_imm(struct ag_Emitter *e, int rn, uint32_t imm);
+int agt32_emit_cmn_imm(struct ag_Emitter *e, int rn, uint32_t imm);
+int agt32_emit_tst_imm(struct ag_Emitter *e, int rn, uint32_t imm);
+int agt32_emit_teq_imm(struct ag_Emitter *e, int rn, uint32_t imm);
+
+/* rd = rm shift (lsl/lsr/asr #n : 16bit lsls.. when flags may be set) */
+void agt32_emit_mov_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rm, int shift);
+void agt32_emit_mvn_reg(struct ag_Emitter *e, enum agt32_flags s, int rd, int rm, int shift);
+int agt32_emit_mov_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, uint32_t imm);
+int agt32_emit_mvn_imm(struct ag_Emitter *e, enum agt32_flags s, int rd, uint32_t imm);
+
+/* rd = rn shift rm. type : AG_SHIFT_* */
+void agt32_emit_shift_reg(struct ag_Emitter *e, enum agt32_flags s, int type, int rd, int rn, int rm);
+
+void agt32_emit_movw(struct ag_Emitter *e, int rd, int imm16);
+void agt32_emit_movt(struct ag_Emitter *e, int rd, int imm16);
+
+/* rd = imm, flags are kept. mov / mvn / movw / movw+movt, shortest first */
+void agt32_emit_movldr_imm(struct ag_Emitter *e, int rd, uint32_t imm);
+
+/* ldr.w rd, =imm (always literal pool) */
+void agt32_emit_ldr_literal(struct ag_Emitter *e, int rd, uint32_t imm);
+
+/* muls (AGT32_FLAGS_SET) has only 16bit form : rd and rn or rm same, low registers */
+void agt32_emit_mul(struct ag_Emitter *e, enum agt32_flags s, int rd, int rn, int rm);
+/* rd = rn * rm + ra */
+void agt32_emit_mla(struct ag_Emitter *e, int rd, int rn, int rm, int ra);
+/* ARMv7VE (Cortex-A7/A15 and later) */
+void agt32_emit_sdiv(struct ag_Emitter *e, int rd, int rn, int rm);
+void agt32_emit_udiv(struct ag_Emitter *e, int rd, int rn, int rm);
+
+/* load / store : F(name, size (0:byte, 1:half, 2:word), load, op of 16bit register form) */
+#define AGT32_FOR_EACH_LDST(F)                  \
+    F(ldr, 2, 1, 4)                             \
+    F(ldrh, 1, 1, 5)                            \
+    F(ldrb, 0, 1, 6)                            \
+    F(str, 2, 0, 0)                             \
+    F(strh, 1, 0, 1)                            \
+    F(strb, 0, 0, 2)
+
+/* imm : -255..4095 (offset), -255..255 (pre/post increment). lsl : 0..3 */
+#define AGT32_LDST_GEN_PROTO(name, size, load, op16)                    \
+    void agt32_emit_##name##_imm(struct ag_Emitter *e, int rt, int rn, int imm, int incr); \
+    void agt32_emit_##name##_reg(struct ag_Emitter *e, int rt, int rn, int rm, int lsl);
+
+AGT32_FOR_EACH_LDST(AGT32_LDST_GEN_PROTO);
+
+/* w : write back. one register list is emitted as ldr/str */
+void agt32_emit_ldmia(struct ag_Emitter *e, int w, int rn, int reg_bits);
+void agt32_emit_stmia(struct ag_Emitter *e, int w, int rn, int reg_bits);
+void agt32_emit_push(struct ag_Emitter *e, int reg_bits);
+void agt32_emit_pop(struct ag_Emitter *e, int reg_bits);
+
+void agt32_emit_ldrex(struct ag_Emitter *e, int rt, int rn);
+/* rd = status */
+void agt32_emit_strex(struct ag_Emitter *e, int rd, int rt, int rn);
+
+/* b<cc> : 16bit when label is emitted and close, b.w / b<cc>.w otherwise.
+ * forward b<cc>.w reaches +-1MiB. inside IT block use AG_COND_AL (last instruction only) */
+void agt32_emit_b(struct ag_Emitter *e, enum ag_cond cc, ag_label_id_t dst);
+void agt32_emit_bl(struct ag_Emitter *e, ag_label_id_t dst);
+/* forward only, up to 126 bytes, low register */
+void agt32_emit_cbz(struct ag_Emitter *e, int rn, ag_label_id_t dst);
+void agt32_emit_cbnz(struct ag_Emitter *e, int rn, ag_label_id_t dst);
+void agt32_emit_bx(struct ag_Emitter *e, int rm);
+void agt32_emit_blx_reg(struct ag_Emitter *e, int rm);
+
+/* it<x><y><z> cc. then_else : "" .. "eee", 't' or 'e' for 2nd..4th instruction */
+void agt32_emit_it(struct ag_Emitter *e, enum ag_cond cc, const char *then_else);
+
+void agt32_emit_nop(struct ag_Emitter *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,654 @@
+#include <stdint.h>
+#include "ag/agx86_gen.h"
+#include "ag/ag_internal.h"
+
+#define REX_W 0x08
+#define REX_R 0x04
+#define REX_X 0x02
+#define REX_B 0x01
+
+/* one instruction is built here, then copied to code */
+struct insn {
+    uint8_t buf[16];
+    int n;
+};
+
+#define HI(r) ((r) >= 8)
+#define FITS_INT8(v) ((v) >= -128 && (v) <= 127)
+
+void
+agx86_emitter_init(struct ag_Emitter *e)
+{
+    ag_emitter_init(e);
+    e->isa = AG_ISA_X86_64;
+}
+
+static void
+put1(struct insn *i, int v)
+{
+    i->buf[i->n++] = v;
+}
+
+static void
+put_imm(struct insn *i, uint64_t v, int bytes)
+{
+    for (int b=0; b<bytes; b++) {
+        put1(i, (v >> (b*8)) & 0xff);
+    }
+}
+
+static void
+flush(struct ag_Emitter *e, struct insn *i)
+{
+    ag_emit_bytes(e, i->buf, i->n);
+}
+
+/* ModRM (+ SIB, disp). m == NULL : rm is register */
+static void
+put_modrm(struct insn *i, int reg, int rm, const struct agx86_mem *m)
+{
+    if (m == NULL) {
+        put1(i, 0xc0 | ((reg&7)<<3) | (rm&7));
+        return;
+    }
+
+    int base = m->base;
+    int index = m->index;
+    int mod;
+
+    if (base == AGX86_NO_REG) {
+        mod = 0;                /* SIB base=101 : disp32 without base */
+    } else if (m->disp == 0 && (base&7) != AGX86_RBP) {
+        mod = 0;
+    } else if (FITS_INT8(m->disp)) {
+        mod = 1;
+    } else {
+        mod = 2;
+    }
+
+    if (index != AGX86_NO_REG || base == AGX86_NO_REG || (base&7) == AGX86_RSP) {
+        int ss = (m->scale == 8) ? 3 : (m->scale == 4) ? 2 : (m->scale == 2) ? 1 : 0;
+        int idx = (index == AGX86_NO_REG) ? AGX86_RSP : index;
+        int b = (base == AGX86_NO_REG) ? AGX86_RBP : base;
+
+        put1(i, (mod<<6) | ((reg&7)<<3) | 4);
+        put1(i, (ss<<6) | ((idx&7)<<3) | (b&7));
+    } else {
+        put1(i, (mod<<6) | ((reg&7)<<3) | (base&7));
+    }
+
+    if (base == AGX86_NO_REG || mod == 2) {
+        put_imm(i, (uint32_t)m->disp, 4);
+    } else if (mod == 1) {
+        put1(i, m->disp & 0xff);
+    }
+}
+
+/* legacy encoding : [prefix] [REX] opcode ModRM.
+ * opc : 1-3 bytes, first byte in highest position.
+ * byte_reg : REX is needed to address spl, bpl, sil, dil.
+ */
+static void
+put_op(struct insn *i, int prefix, int w, uint32_t opc, int reg, int rm,
+       const struct agx86_mem *m, int byte_reg)
+{
+    int rex = 0x40;
+
+    if (prefix) {
+        put1(i, prefix);
+    }
+
+    if (w) {
+        rex |= REX_W;
+    }
+    if (HI(reg)) {
+        rex |= REX_R;
+    }
+    if (m) {
+        if (m->index != AGX86_NO_REG && HI(m->index)) {
+            rex |= REX_X;
+        }
+        if (m->base != AGX86_NO_REG && HI(m->base)) {
+            rex |= REX_B;
+        }
+    } else if (HI(rm)) {
+        rex |= REX_B;
+    }
+
+    if (rex != 0x40 || byte_reg) {
+        put1(i, rex);
+    }
+
+    if (opc > 0xffff) {
+        put1(i, opc >> 16);
+    }
+    if (opc > 0xff) {
+        put1(i, (opc >> 8) & 0xff);
+    }
+    put1(i, opc & 0xff);
+
+    put_modrm(i, reg, rm, m);
+}
+
+static void
+emit_op(struct ag_Emitter *e, int prefix, int w, uint32_t opc, int reg, int rm,
+        const struct agx86_mem *m)
+{
+    struct insn i = {{0}, 0};
+    put_op(&i, prefix, w, opc, reg, rm, m, 0);
+    flush(e, &i);
+}
+
+static const uint32_t map_escape[4] = {0, 0x0f, 0x0f38, 0x0f3a};
+
+static int
+vex_pp(int prefix)
+{
+    switch (prefix) {
+    case 0x66:
+        return 1;
+    case 0xf3:
+        return 2;
+    case 0xf2:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+/* VEX encoding. vvvv : second source (0 if unused) */
+static void
+put_vex(struct insn *i, int prefix, int map, int w, int l, int opc,
+        int reg, int vvvv, int rm, const struct agx86_mem *m)
+{
+    int r = HI(reg);
+    int x = 0, b = 0;
+
+    if (m) {
+        x = (m->index != AGX86_NO_REG) && HI(m->index);
+        b = (m->base != AGX86_NO_REG) && HI(m->base);
+    } else {
+        b = HI(rm);
+    }
+
+    int tail = ((~vvvv & 15)<<3) | (l<<2) | vex_pp(prefix);
+
+    if (!x && !b && !w && map == 1) {
+        put1(i, 0xc5);
+        put1(i, (!r<<7) | tail);
+    } else {
+        put1(i, 0xc4);
+        put1(i, (!r<<7) | (!x<<6) | (!b<<5) | map);
+        put1(i, (w<<7) | tail);
+    }
+
+    put1(i, opc);
+    put_modrm(i, reg, rm, m);
+}
+
+static void
+emit_vex(struct ag_Emitter *e, int prefix, int map, int w, int l, int opc,
+         int reg, int vvvv, int rm, const struct agx86_mem *m)
+{
+    struct insn i = {{0}, 0};
+    put_vex(&i, prefix, map, w, l, opc, reg, vvvv, rm, m);
+    flush(e, &i);
+}
+
+/* 81 /digit id, or 83 /digit ib */
+static void
+emit_alu_imm(struct ag_Emitter *e, int digit, int w, int dst, int32_t imm)
+{
+    struct insn i = {{0}, 0};
+
+    if (FITS_INT8(imm)) {
+        put_op(&i, 0, w, 0x83, digit, dst, NULL, 0);
+        put1(&i, imm & 0xff);
+    } else {
+        put_op(&i, 0, w, 0x81, digit, dst, NULL, 0);
+        put_imm(&i, (uint32_t)imm, 4);
+    }
+
+    flush(e, &i);
+}
+
+#define IMPL_ALU(name, digit, opc)                                      \
+    void                                                                \
+    agx86_emit_##name##_rr(struct ag_Emitter *e, int w, int dst, int src) \
+    {                                                                   \
+        emit_op(e, 0, w, opc, src, dst, NULL);                          \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_##name##_ri(struct ag_Emitter *e, int w, int dst, int32_t imm) \
+    {                                                                   \
+        emit_alu_imm(e, digit, w, dst, imm);                            \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_##name##_rm(struct ag_Emitter *e, int w, int dst, struct agx86_mem m) \
+    {                                                                   \
+        emit_op(e, 0, w, (opc)+2, dst, 0, &m);                          \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_##name##_mr(struct ag_Emitter *e, int w, struct agx86_mem m, int src) \
+    {                                                                   \
+        emit_op(e, 0, w, opc, src, 0, &m);                              \
+    }
+
+AGX86_FOR_EACH_ALU(IMPL_ALU);
+
+#define IMPL_SHIFT(name, digit)                                         \
+    void                                                                \
+    agx86_emit_##name##_ri(struct ag_Emitter *e, int w, int dst, int imm) \
+    {                                                                   \
+        struct insn i = {{0}, 0};                                       \
+        put_op(&i, 0, w, 0xc1, digit, dst, NULL, 0);                    \
+        put1(&i, imm);                                                  \
+        flush(e, &i);                                                   \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_##name##_rcl(struct ag_Emitter *e, int w, int dst)      \
+    {                                                                   \
+        emit_op(e, 0, w, 0xd3, digit, dst, NULL);                       \
+    }
+
+AGX86_FOR_EACH_SHIFT(IMPL_SHIFT);
+
+void
+agx86_emit_test_rr(struct ag_Emitter *e, int w, int dst, int src)
+{
+    emit_op(e, 0, w, 0x85, src, dst, NULL);
+}
+
+void
+agx86_emit_inc(struct ag_Emitter *e, int w, int dst)
+{
+    emit_op(e, 0, w, 0xff, 0, dst, NULL);
+}
+
+void
+agx86_emit_dec(struct ag_Emitter *e, int w, int dst)
+{
+    emit_op(e, 0, w, 0xff, 1, dst, NULL);
+}
+
+void
+agx86_emit_neg(struct ag_Emitter *e, int w, int dst)
+{
+    emit_op(e, 0, w, 0xf7, 3, dst, NULL);
+}
+
+void
+agx86_emit_imul_rr(struct ag_Emitter *e, int w, int dst, int src)
+{
+    emit_op(e, 0, w, 0x0faf, dst, src, NULL);
+}
+
+void
+agx86_emit_imul_rri(struct ag_Emitter *e, int w, int dst, int src, int32_t imm)
+{
+    struct insn i = {{0}, 0};
+
+    if (FITS_INT8(imm)) {
+        put_op(&i, 0, w, 0x6b, dst, src, NULL, 0);
+        put1(&i, imm & 0xff);
+    } else {
+        put_op(&i, 0, w, 0x69, dst, src, NULL, 0);
+        put_imm(&i, (uint32_t)imm, 4);
+    }
+
+    flush(e, &i);
+}
+
+void
+agx86_emit_div(struct ag_Emitter *e, int w, int src)
+{
+    emit_op(e, 0, w, 0xf7, 6, src, NULL);
+}
+
+void
+agx86_emit_idiv(struct ag_Emitter *e, int w, int src)
+{
+    emit_op(e, 0, w, 0xf7, 7, src, NULL);
+}
+
+void
+agx86_emit_popcnt(struct ag_Emitter *e, int w, int dst, int src)
+{
+    emit_op(e, 0xf3, w, 0x0fb8, dst, src, NULL);
+}
+
+void
+agx86_emit_mov_rr(struct ag_Emitter *e, int w, int dst, int src)
+{
+    emit_op(e, 0, w, 0x89, src, dst, NULL);
+}
+
+void
+agx86_emit_mov_imm(struct ag_Emitter *e, int w, int dst, uint64_t imm)
+{
+    struct insn i = {{0}, 0};
+    int64_t s = (int64_t)imm;
+
+    if (! w) {
+        imm &= 0xffffffff;
+    }
+
+    if (imm <= 0xffffffff) {
+        /* b8+r id : zero extended to 64bit */
+        if (HI(dst)) {
+            put1(&i, 0x40 | REX_B);
+        }
+        put1(&i, 0xb8 + (dst&7));
+        put_imm(&i, imm, 4);
+    } else if (s >= INT32_MIN && s <= INT32_MAX) {
+        /* REX.W c7 /0 id : sign extended */
+        put_op(&i, 0, 1, 0xc7, 0, dst, NULL, 0);
+        put_imm(&i, imm, 4);
+    } else {
+        put1(&i, 0x40 | REX_W | (HI(dst) ? REX_B : 0));
+        put1(&i, 0xb8 + (dst&7));
+        put_imm(&i, imm, 8);
+    }
+
+    flush(e, &i);
+}
+
+void
+agx86_emit_lea(struct ag_Emitter *e, int w, int dst, struct agx86_mem m)
+{
+    emit_op(e, 0, w, 0x8d, dst, 0, &m);
+}
+
+void
+agx86_emit_load(struct ag_Emitter *e, int size, int dst, struct agx86_mem m)
+{
+    static const uint32_t opc[4] = {0x0fb6, 0x0fb7, 0x8b, 0x8b};
+    emit_op(e, 0, size == 3, opc[size], dst, 0, &m);
+}
+
+void
+agx86_emit_store(struct ag_Emitter *e, int size, struct agx86_mem m, int src)
+{
+    struct insn i = {{0}, 0};
+
+    switch (size) {
+    case 0:
+        put_op(&i, 0, 0, 0x88, src, 0, &m, src >= 4);
+        break;
+    case 1:
+        put_op(&i, 0x66, 0, 0x89, src, 0, &m, 0);
+        break;
+    default:
+        put_op(&i, 0, size == 3, 0x89, src, 0, &m, 0);
+        break;
+    }
+
+    flush(e, &i);
+}
+
+void
+agx86_emit_push(struct ag_Emitter *e, int reg)
+{
+    struct insn i = {{0}, 0};
+    if (HI(reg)) {
+        put1(&i, 0x40 | REX_B);
+    }
+    put1(&i, 0x50 + (reg&7));
+    flush(e, &i);
+}
+
+void
+agx86_emit_pop(struct ag_Emitter *e, int reg)
+{
+    struct insn i = {{0}, 0};
+    if (HI(reg)) {
+        put1(&i, 0x40 | REX_B);
+    }
+    put1(&i, 0x58 + (reg&7));
+    flush(e, &i);
+}
+
+void
+agx86_emit_ret(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0xc3};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_nop(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0x90};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_pause(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0xf3, 0x90};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_mfence(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0x0f, 0xae, 0xf0};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_lock(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0xf0};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_xadd_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src)
+{
+    emit_op(e, 0, size == 3, 0x0fc1, src, 0, &m);
+}
+
+void
+agx86_emit_cmpxchg_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src)
+{
+    emit_op(e, 0, size == 3, 0x0fb1, src, 0, &m);
+}
+
+void
+agx86_emit_xchg_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src)
+{
+    emit_op(e, 0, size == 3, 0x87, src, 0, &m);
+}
+
+/* short : opcode of rel8 form, near : opcode bytes of rel32 form */
+static void
+emit_branch(struct ag_Emitter *e, int short_opc, const uint8_t *near_opc, int near_len,
+            ag_label_id_t dst)
+{
+    uint32_t off;
+
+    if (short_opc && ag_label_offset(e, dst, &off)) {
+        int64_t d = (int64_t)off - (e->cur + 2);
+        if (FITS_INT8(d)) {
+            uint8_t c[2] = {(uint8_t)short_opc, (uint8_t)(d & 0xff)};
+            ag_emit_bytes(e, c, 2);
+            return;
+        }
+    }
+
+    static const uint8_t zero[4] = {0};
+
+    ag_emit_bytes(e, near_opc, near_len);
+    ag_add_label_ref(e, LABELREF_TYPE_X86_REL32, dst);
+    ag_emit_bytes(e, zero, 4);
+}
+
+void
+agx86_emit_jmp(struct ag_Emitter *e, ag_label_id_t dst)
+{
+    static const uint8_t c[] = {0xe9};
+    emit_branch(e, 0xeb, c, 1, dst);
+}
+
+void
+agx86_emit_jcc(struct ag_Emitter *e, enum agx86_cond cc, ag_label_id_t dst)
+{
+    uint8_t c[] = {0x0f, (uint8_t)(0x80 + cc)};
+    emit_branch(e, 0x70 + cc, c, 2, dst);
+}
+
+void
+agx86_emit_call(struct ag_Emitter *e, ag_label_id_t dst)
+{
+    static const uint8_t c[] = {0xe8};
+    emit_branch(e, 0, c, 1, dst);
+}
+
+#define IMPL_SIMD(name, prefix, map, opc, w)                            \
+    void                                                                \
+    agx86_emit_##name(struct ag_Emitter *e, int dst, int src)          \
+    {                                                                   \
+        emit_op(e, prefix, w, (map_escape[map]<<8) | (opc), dst, src, NULL); \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_##name##_load(struct ag_Emitter *e, int dst, struct agx86_mem m) \
+    {                                                                   \
+        emit_op(e, prefix, w, (map_escape[map]<<8) | (opc), dst, 0, &m); \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_v##name(struct ag_Emitter *e, int l, int dst, int src1, int src2) \
+    {                                                                   \
+        emit_vex(e, prefix, map, w, l, opc, dst, src1, src2, NULL);     \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_v##name##_load(struct ag_Emitter *e, int l, int dst, int src1, struct agx86_mem m) \
+    {                                                                   \
+        emit_vex(e, prefix, map, w, l, opc, dst, src1, 0, &m);          \
+    }
+
+AGX86_FOR_EACH_SIMD(IMPL_SIMD);
+
+#define IMPL_SIMD1(name, prefix, map, opc, w)                           \
+    void                                                                \
+    agx86_emit_##name(struct ag_Emitter *e, int dst, int src)          \
+    {                                                                   \
+        emit_op(e, prefix, w, (map_escape[map]<<8) | (opc), dst, src, NULL); \
+    }                                                                   \
+    void                                                                \
+    agx86_emit_v##name(struct ag_Emitter *e, int l, int dst, int src)  \
+    {                                                                   \
+        emit_vex(e, prefix, map, w, l, opc, dst, 0, src, NULL);         \
+    }
+
+AGX86_FOR_EACH_SIMD1(IMPL_SIMD1);
+
+#define IMPL_VEX(name, prefix, map, opc, w)                             \
+    void                                                                \
+    agx86_emit_##name(struct ag_Emitter *e, int l, int dst, int src1, int src2) \
+    {                                                                   \
+        emit_vex(e, prefix, map, w, l, opc, dst, src1, src2, NULL);     \
+    }
+
+AGX86_FOR_EACH_VEX(IMPL_VEX);
+
+void
+agx86_emit_movdqu_load(struct ag_Emitter *e, int dst, struct agx86_mem m)
+{
+    emit_op(e, 0xf3, 0, 0x0f6f, dst, 0, &m);
+}
+
+void
+agx86_emit_movdqu_store(struct ag_Emitter *e, struct agx86_mem m, int src)
+{
+    emit_op(e, 0xf3, 0, 0x0f7f, src, 0, &m);
+}
+
+void
+agx86_emit_movups_load(struct ag_Emitter *e, int dst, struct agx86_mem m)
+{
+    emit_op(e, 0, 0, 0x0f10, dst, 0, &m);
+}
+
+void
+agx86_emit_movups_store(struct ag_Emitter *e, struct agx86_mem m, int src)
+{
+    emit_op(e, 0, 0, 0x0f11, src, 0, &m);
+}
+
+void
+agx86_emit_vmovdqu_load(struct ag_Emitter *e, int l, int dst, struct agx86_mem m)
+{
+    emit_vex(e, 0xf3, 1, 0, l, 0x6f, dst, 0, 0, &m);
+}
+
+void
+agx86_emit_vmovdqu_store(struct ag_Emitter *e, int l, struct agx86_mem m, int src)
+{
+    emit_vex(e, 0xf3, 1, 0, l, 0x7f, src, 0, 0, &m);
+}
+
+void
+agx86_emit_vmovups_load(struct ag_Emitter *e, int l, int dst, struct agx86_mem m)
+{
+    emit_vex(e, 0, 1, 0, l, 0x10, dst, 0, 0, &m);
+}
+
+void
+agx86_emit_vmovups_store(struct ag_Emitter *e, int l, struct agx86_mem m, int src)
+{
+    emit_vex(e, 0, 1, 0, l, 0x11, src, 0, 0, &m);
+}
+
+void
+agx86_emit_movq_to_xmm(struct ag_Emitter *e, int dst, int src)
+{
+    emit_op(e, 0x66, 1, 0x0f6e, dst, src, NULL);
+}
+
+void
+agx86_emit_movq_from_xmm(struct ag_Emitter *e, int dst, int src)
+{
+    emit_op(e, 0x66, 1, 0x0f7e, src, dst, NULL);
+}
+
+void
+agx86_emit_pshufd(struct ag_Emitter *e, int dst, int src, int imm)
+{
+    struct insn i = {{0}, 0};
+    put_op(&i, 0x66, 0, 0x0f70, dst, src, NULL, 0);
+    put1(&i, imm);
+    flush(e, &i);
+}
+
+void
+agx86_emit_vbroadcastss(struct ag_Emitter *e, int l, int dst, int src)
+{
+    emit_vex(e, 0x66, 2, 0, l, 0x18, dst, 0, src, NULL);
+}
+
+void
+agx86_emit_cvtsi2sd(struct ag_Emitter *e, int dst, int src)
+{
+    emit_op(e, 0xf2, 1, 0x0f2a, dst, src, NULL);
+}
+
+void
+agx86_emit_cvttsd2si(struct ag_Emitter *e, int dst, int src)
+{
+    emit_op(e, 0xf2, 1, 0x0f2c, dst, src, NULL);
+}
+
+void
+agx86_emit_vzeroupper(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0xc5, 0xf8, 0x77};
+    ag_emit_bytes(e, c, sizeof(c));
+}
+
+void
+agx86_emit_vzeroall(struct ag_Emitter *e)
+{
+    static const uint8_t c[] = {0xc5, 0xfc, 0x77};
+    ag_emit_bytes(e, c, sizeof(c));
+}
@@ -0,0 +1,276 @@
+#ifndef AGX86_GEN_H
+#define AGX86_GEN_H
+
+/* x86-64 backend.
+ *
+ * uses struct ag_Emitter and its label / publication functions
+ * (ag_gen.h). initialize with agx86_emitter_init instead of
+ * ag_emitter_init. e->cur and label offsets are in bytes, there is no
+ * literal pool (immediates are encoded in instructions).
+ *
+ * w : 1 = 64bit (REX.W), 0 = 32bit
+ * size : 0 = 8bit, 1 = 16bit, 2 = 32bit, 3 = 64bit
+ * l : 1 = 256bit (ymm), 0 = 128bit (xmm)
+ * register numbers are 0..15 (xmm/ymm too), see AGX86_RAX..
+ */
+
+#include "ag/ag_gen.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AGX86_RAX 0
+#define AGX86_RCX 1
+#define AGX86_RDX 2
+#define AGX86_RBX 3
+#define AGX86_RSP 4
+#define AGX86_RBP 5
+#define AGX86_RSI 6
+#define AGX86_RDI 7
+#define AGX86_R8 8
+#define AGX86_R9 9
+#define AGX86_R10 10
+#define AGX86_R11 11
+#define AGX86_R12 12
+#define AGX86_R13 13
+#define AGX86_R14 14
+#define AGX86_R15 15
+
+#define AGX86_NO_REG (-1)
+
+/* [base + index*scale + disp] */
+struct agx86_mem {
+    int base;                   /* AGX86_NO_REG : none */
+    int index;                  /* AGX86_NO_REG : none. rsp can't be index */
+    int scale;                  /* 1, 2, 4, 8 */
+    int32_t disp;
+};
+
+static __inline struct agx86_mem
+agx86_mem_base(int base, int32_t disp)
+{
+    struct agx86_mem m;
+    m.base = base;
+    m.index = AGX86_NO_REG;
+    m.scale = 1;
+    m.disp = disp;
+    return m;
+}
+
+static __inline struct agx86_mem
+agx86_mem_index(int base, int index, int scale, int32_t disp)
+{
+    struct agx86_mem m;
+    m.base = base;
+    m.index = index;
+    m.scale = scale;
+    m.disp = disp;
+    return m;
+}
+
+enum agx86_cond {
+    AGX86_CC_O=0,
+    AGX86_CC_NO=1,
+    AGX86_CC_B=2,
+    AGX86_CC_AE=3,
+    AGX86_CC_E=4,
+    AGX86_CC_NE=5,
+    AGX86_CC_BE=6,
+    AGX86_CC_A=7,
+    AGX86_CC_S=8,
+    AGX86_CC_NS=9,
+    AGX86_CC_P=10,
+    AGX86_CC_NP=11,
+    AGX86_CC_L=12,
+    AGX86_CC_GE=13,
+    AGX86_CC_LE=14,
+    AGX86_CC_G=15,
+};
+
+void agx86_emitter_init(struct ag_Emitter *e);
+
+/* integer ALU : F(name, /digit of 81/83, opcode of "op r/m, r" form) */
+#define AGX86_FOR_EACH_ALU(F)                   \
+    F(add, 0, 0x01)                             \
+    F(or, 1, 0x09)                              \
+    F(adc, 2, 0x11)                             \
+    F(sbb, 3, 0x19)                             \
+    F(and, 4, 0x21)                             \
+    F(sub, 5, 0x29)                             \
+    F(xor, 6, 0x31)                             \
+    F(cmp, 7, 0x39)
+
+/* rr : dst op= src, ri : dst op= imm, rm : dst op= [m], mr : [m] op= src */
+#define AGX86_ALU_GEN_PROTO(name, digit, opc)                           \
+    void agx86_emit_##name##_rr(struct ag_Emitter *e, int w, int dst, int src); \
+    void agx86_emit_##name##_ri(struct ag_Emitter *e, int w, int dst, int32_t imm); \
+    void agx86_emit_##name##_rm(struct ag_Emitter *e, int w, int dst, struct agx86_mem m); \
+    void agx86_emit_##name##_mr(struct ag_Emitter *e, int w, struct agx86_mem m, int src);
+
+AGX86_FOR_EACH_ALU(AGX86_ALU_GEN_PROTO);
+
+/* shift / rotate : F(name, /digit of c1/d3) */
+#define AGX86_FOR_EACH_SHIFT(F)                 \
+    F(rol, 0)                                   \
+    F(ror, 1)                                   \
+    F(shl, 4)                                   \
+    F(shr, 5)                                   \
+    F(sar, 7)
+
+/* ri : by imm, rcl : by cl */
+#define AGX86_SHIFT_GEN_PROTO(name, digit)                              \
+    void agx86_emit_##name##_ri(struct ag_Emitter *e, int w, int dst, int imm); \
+    void agx86_emit_##name##_rcl(struct ag_Emitter *e, int w, int dst);
+
+AGX86_FOR_EACH_SHIFT(AGX86_SHIFT_GEN_PROTO);
+
+void agx86_emit_test_rr(struct ag_Emitter *e, int w, int dst, int src);
+void agx86_emit_inc(struct ag_Emitter *e, int w, int dst);
+void agx86_emit_dec(struct ag_Emitter *e, int w, int dst);
+void agx86_emit_neg(struct ag_Emitter *e, int w, int dst);
+
+void agx86_emit_imul_rr(struct ag_Emitter *e, int w, int dst, int src);
+void agx86_emit_imul_rri(struct ag_Emitter *e, int w, int dst, int src, int32_t imm);
+/* rdx:rax / src -> rax, rdx */
+void agx86_emit_div(struct ag_Emitter *e, int w, int src);
+void agx86_emit_idiv(struct ag_Emitter *e, int w, int src);
+void agx86_emit_popcnt(struct ag_Emitter *e, int w, int dst, int src);
+
+void agx86_emit_mov_rr(struct ag_Emitter *e, int w, int dst, int src);
+/* dst = imm with shortest form : mov r32, imm32 / mov r64, simm32 / movabs */
+void agx86_emit_mov_imm(struct ag_Emitter *e, int w, int dst, uint64_t imm);
+void agx86_emit_lea(struct ag_Emitter *e, int w, int dst, struct agx86_mem m);
+
+/* 8/16bit loads are zero extended (movzx) */
+void agx86_emit_load(struct ag_Emitter *e, int size, int dst, struct agx86_mem m);
+void agx86_emit_store(struct ag_Emitter *e, int size, struct agx86_mem m, int src);
+
+void agx86_emit_push(struct ag_Emitter *e, int reg);
+void agx86_emit_pop(struct ag_Emitter *e, int reg);
+void agx86_emit_ret(struct ag_Emitter *e);
+void agx86_emit_nop(struct ag_Emitter *e);
+void agx86_emit_pause(struct ag_Emitter *e);
+void agx86_emit_mfence(struct ag_Emitter *e);
+
+/* atomics. lock prefix applies to next instruction (add_mr, xadd, cmpxchg ..) */
+void agx86_emit_lock(struct ag_Emitter *e);
+/* tmp = [m]; [m] += src; src = tmp. size : 2 or 3 */
+void agx86_emit_xadd_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src);
+/* if ([m] == rax) [m] = src else rax = [m] */
+void agx86_emit_cmpxchg_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src);
+/* always locked */
+void agx86_emit_xchg_mr(struct ag_Emitter *e, int size, struct agx86_mem m, int src);
+
+/* branch. rel8 is used for emitted label in range, rel32 otherwise */
+void agx86_emit_jmp(struct ag_Emitter *e, ag_label_id_t dst);
+void agx86_emit_jcc(struct ag_Emitter *e, enum agx86_cond cc, ag_label_id_t dst);
+void agx86_emit_call(struct ag_Emitter *e, ag_label_id_t dst);
+
+/* SSE/AVX, 2 source : F(name, prefix, map, opcode, w)
+ * prefix : 0, 0x66, 0xf3, 0xf2. map : 1 = 0f, 2 = 0f38, 3 = 0f3a
+ *
+ * agx86_emit_NAME(e, dst, src)            legacy SSE, dst op= src
+ * agx86_emit_NAME_load(e, dst, m)         legacy SSE, dst op= [m]
+ * agx86_emit_vNAME(e, l, dst, src1, src2) VEX, dst = src1 op src2
+ * agx86_emit_vNAME_load(e, l, dst, src1, m)
+ */
+#define AGX86_FOR_EACH_SIMD(F)                  \
+    F(addps, 0, 1, 0x58, 0)                     \
+    F(addpd, 0x66, 1, 0x58, 0)                  \
+    F(addss, 0xf3, 1, 0x58, 0)                  \
+    F(addsd, 0xf2, 1, 0x58, 0)                  \
+    F(mulps, 0, 1, 0x59, 0)                     \
+    F(mulpd, 0x66, 1, 0x59, 0)                  \
+    F(mulss, 0xf3, 1, 0x59, 0)                  \
+    F(mulsd, 0xf2, 1, 0x59, 0)                  \
+    F(subps, 0, 1, 0x5c, 0)                     \
+    F(subpd, 0x66, 1, 0x5c, 0)                  \
+    F(divps, 0, 1, 0x5e, 0)                     \
+    F(divpd, 0x66, 1, 0x5e, 0)                  \
+    F(divss, 0xf3, 1, 0x5e, 0)                  \
+    F(divsd, 0xf2, 1, 0x5e, 0)                  \
+    F(andps, 0, 1, 0x54, 0)                     \
+    F(orps, 0, 1, 0x56, 0)                      \
+    F(xorps, 0, 1, 0x57, 0)                     \
+    F(paddb, 0x66, 1, 0xfc, 0)                  \
+    F(paddw, 0x66, 1, 0xfd, 0)                  \
+    F(paddd, 0x66, 1, 0xfe, 0)                  \
+    F(paddq, 0x66, 1, 0xd4, 0)                  \
+    F(psubd, 0x66, 1, 0xfa, 0)                  \
+    F(pmullw, 0x66, 1, 0xd5, 0)                 \
+    F(pmuludq, 0x66, 1, 0xf4, 0)                \
+    F(pmaddwd, 0x66, 1, 0xf5, 0)                \
+    F(pand, 0x66, 1, 0xdb, 0)                   \
+    F(por, 0x66, 1, 0xeb, 0)                    \
+    F(pxor, 0x66, 1, 0xef, 0)                   \
+    F(pcmpeqd, 0x66, 1, 0x76, 0)                \
+    F(pmulld, 0x66, 2, 0x40, 0)                 \
+    F(pshufb, 0x66, 2, 0x00, 0)
+
+#define AGX86_SIMD_GEN_PROTO(name, prefix, map, opc, w)                 \
+    void agx86_emit_##name(struct ag_Emitter *e, int dst, int src);    \
+    void agx86_emit_##name##_load(struct ag_Emitter *e, int dst, struct agx86_mem m); \
+    void agx86_emit_v##name(struct ag_Emitter *e, int l, int dst, int src1, int src2); \
+    void agx86_emit_v##name##_load(struct ag_Emitter *e, int l, int dst, int src1, struct agx86_mem m);
+
+AGX86_FOR_EACH_SIMD(AGX86_SIMD_GEN_PROTO);
+
+/* 1 source, same naming : agx86_emit_NAME(e, dst, src), agx86_emit_vNAME(e, l, dst, src) */
+#define AGX86_FOR_EACH_SIMD1(F)                 \
+    F(cvtdq2ps, 0, 1, 0x5b, 0)                  \
+    F(cvttps2dq, 0xf3, 1, 0x5b, 0)              \
+    F(sqrtps, 0, 1, 0x51, 0)                    \
+    F(sqrtpd, 0x66, 1, 0x51, 0)                 \
+    F(rcpps, 0, 1, 0x53, 0)                     \
+    F(movaps, 0, 1, 0x28, 0)
+
+#define AGX86_SIMD1_GEN_PROTO(name, prefix, map, opc, w)                \
+    void agx86_emit_##name(struct ag_Emitter *e, int dst, int src);    \
+    void agx86_emit_v##name(struct ag_Emitter *e, int l, int dst, int src);
+
+AGX86_FOR_EACH_SIMD1(AGX86_SIMD1_GEN_PROTO);
+
+/* VEX only (FMA, AVX2), 3 operand : agx86_emit_NAME(e, l, dst, src1, src2) */
+#define AGX86_FOR_EACH_VEX(F)                   \
+    F(vfmadd231ps, 0x66, 2, 0xb8, 0)            \
+    F(vfmadd231pd, 0x66, 2, 0xb8, 1)            \
+    F(vfmadd231ss, 0x66, 2, 0xb9, 0)            \
+    F(vfmadd231sd, 0x66, 2, 0xb9, 1)            \
+    F(vpermd, 0x66, 2, 0x36, 0)                 \
+    F(vpsllvd, 0x66, 2, 0x47, 0)
+
+#define AGX86_VEX_GEN_PROTO(name, prefix, map, opc, w)                  \
+    void agx86_emit_##name(struct ag_Emitter *e, int l, int dst, int src1, int src2);
+
+AGX86_FOR_EACH_VEX(AGX86_VEX_GEN_PROTO);
+
+/* moves between xmm/ymm and memory */
+void agx86_emit_movdqu_load(struct ag_Emitter *e, int dst, struct agx86_mem m);
+void agx86_emit_movdqu_store(struct ag_Emitter *e, struct agx86_mem m, int src);
+void agx86_emit_movups_load(struct ag_Emitter *e, int dst, struct agx86_mem m);
+void agx86_emit_movups_store(struct ag_Emitter *e, struct agx86_mem m, int src);
+void agx86_emit_vmovdqu_load(struct ag_Emitter *e, int l, int dst, struct agx86_mem m);
+void agx86_emit_vmovdqu_store(struct ag_Emitter *e, int l, struct agx86_mem m, int src);
+void agx86_emit_vmovups_load(struct ag_Emitter *e, int l, int dst, struct agx86_mem m);
+void agx86_emit_vmovups_store(struct ag_Emitter *e, int l, struct agx86_mem m, int src);
+
+/* movq xmm, r64 / movq r64, xmm */
+void agx86_emit_movq_to_xmm(struct ag_Emitter *e, int dst, int src);
+void agx86_emit_movq_from_xmm(struct ag_Emitter *e, int dst, int src);
+/* dst.dword[i] = src.dword[(imm >> 2*i) & 3] */
+void agx86_emit_pshufd(struct ag_Emitter *e, int dst, int src, int imm);
+/* broadcast low float of xmm src (AVX2) */
+void agx86_emit_vbroadcastss(struct ag_Emitter *e, int l, int dst, int src);
+/* xmm = (double)r64, r64 = (int64)xmm */
+void agx86_emit_cvtsi2sd(struct ag_Emitter *e, int dst, int src);
+void agx86_emit_cvttsd2si(struct ag_Emitter *e, int dst, int src);
+
+void agx86_emit_vzeroupper(struct ag_Emitter *e);
+void agx86_emit_vzeroall(struct ag_Emitter *e);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "bench.h"
+#include "kgen.h"
+
+static char *
+zero_mem_map(void)
+{
+    /* hint, other address is used if it is occupied */
+    void *p = mmap((void*)ZERO_MEM_HINT, ZERO_MEM_SIZE, PROT_READ|PROT_WRITE,
+                   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    return (char*)p;
+}
+
+char *zero_mem = zero_mem_map();
+
+const char *lt_op_name_table[LT_NUM_OP] = {
+    "latency",
+    "throughput",
+    "rename"
+};
+
+static struct npr_varray *
+registry(void)
+{
+    /* may be called from other static initializers */
+    static struct npr_varray r;
+    static int initialized;
+
+    if (! initialized) {
+        npr_varray_init(&r, 64, sizeof(const struct bench_desc*));
+        initialized = 1;
+    }
+
+    return &r;
+}
+
+void
+bench_register(const struct bench_desc *d)
+{
+    struct npr_varray *r = registry();
+
+    for (size_t i=0; i<r->nelem; i++) {
+        const struct bench_desc *p = VA_ELEM(const struct bench_desc*, r, i);
+        if (p->rt == d->rt && strcmp(p->name, d->name) == 0) {
+            fprintf(stderr, "kernel '%s' (%s) is registered twice, ignored\n",
+                    d->name, regtype_name_table[d->rt]);
+            return;
+        }
+    }
+
+    VA_PUSH(const struct bench_desc*, r, d);
+}
+
+const struct npr_varray *
+bench_registry(void)
+{
+    return registry();
+}
+
+static void
+gen(struct ag_Emitter *e, bench_emit_t f,
+    int num_loop, int num_insn, enum lt_op o)
+{
+    ag_label_id_t loop_head = bench_gen_prologue(e, num_loop);
+
+    switch (o) {
+    case LT_LATENCY:
+        for (int ii=0; ii<num_insn; ii++) {
+            f(e, 0, 0);
+        }
+        break;
+
+    case LT_THROUGHPUT:
+        for (int ii=0; ii<num_insn/8; ii++) {
+            f(e, 0, 1);
+            f(e, 0, 2);
+            f(e, 0, 3);
+            f(e, 0, 4);
+
+            f(e, 0, 5);
+            f(e, 0, 6);
+            f(e, 0, 7);
+            f(e, 0, 8);
+        }
+        break;
+
+    case LT_THROUGHPUT_RENAME:
+        for (int ii=0; ii<num_insn/8; ii++) {
+            f(e, 0, 0);
+            f(e, 1, 1);
+            f(e, 2, 2);
+            f(e, 3, 3);
+
+            f(e, 4, 4);
+            f(e, 5, 5);
+            f(e, 6, 6);
+            f(e, 7, 7);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    bench_gen_epilogue(e, loop_head);
+}
+
+void
+bench_gen(struct ag_Emitter *e, const struct bench_desc *d,
+          int num_loop, int num_insn, enum lt_op o)
+{
+    gen(e, d->emit, num_loop, num_insn, o);
+}
+
+static void
+empty_body(struct ag_Emitter *e, int dst, int src)
+{
+}
+
+void
+bench_gen_empty(struct ag_Emitter *e, int num_loop, int num_insn, enum lt_op o)
+{
+    gen(e, empty_body, num_loop, num_insn, o);
+}
+
+int
+bench_gen_mix(struct ag_Emitter *e, const struct bench_mix_item *items, int num_item,
+              int num_loop, int num_insn)
+{
+    int group_size = 0;
+    int max_ratio = 0;
+
+    for (int i=0; i<num_item; i++) {
+        group_size += items[i].ratio;
+        if (items[i].ratio > max_ratio) {
+            max_ratio = items[i].ratio;
+        }
+    }
+
+    int num_group = num_insn / group_size;
+    if (num_group < 1) {
+        num_group = 1;
+    }
+
+    ag_label_id_t loop_head = bench_gen_prologue(e, num_loop);
+
+    /* same operands as LT_THROUGHPUT : dst=0, src=1..8.
+     * spread each item over group : 2:1 -> A B A
+     */
+    int src = 0;
+    for (int gi=0; gi<num_group; gi++) {
+        for (int r=0; r<max_ratio; r++) {
+            for (int i=0; i<num_item; i++) {
+                if (r < items[i].ratio) {
+                    items[i].d->emit(e, 0, 1 + src);
+                    src = (src + 1) % 8;
+                }
+            }
+        }
+    }
+
+    bench_gen_epilogue(e, loop_head);
+
+    return num_group * group_size;
+}
+
+#ifndef EMIT_ONLY
+struct loop_baseline {
+    int num_loop;
+    int num_insn;
+    enum lt_op o;
+    struct measure_result r;
+};
+
+static struct npr_varray loop_baseline_cache;
+
+const struct measure_result *
+bench_loop_baseline(int num_loop, int num_insn, enum lt_op o)
+{
+    if (loop_baseline_cache.elements == NULL) {
+        npr_varray_init(&loop_baseline_cache, 16, sizeof(struct loop_baseline));
+    }
+
+    for (size_t i=0; i<loop_baseline_cache.nelem; i++) {
+        struct loop_baseline *b = VA_ELEM_PTR(struct loop_baseline, &loop_baseline_cache, i);
+        if (b->num_loop == num_loop && b->num_insn == num_insn && b->o == o) {
+            return &b->r;
+        }
+    }
+
+    /* from kcache if enabled, no exec memory needed on hit */
+    struct kgen_kernel k;
+    kgen_generate(&k, NULL, num_loop, num_insn, o);
+
+    struct loop_baseline b;
+    b.num_loop = num_loop;
+    b.num_insn = num_insn;
+    b.o = o;
+    measure_run(&b.r, (measure_func_t)k.entry);
+
+    kgen_free(&k);
+
+    VA_PUSH(struct loop_baseline, &loop_baseline_cache, b);
+
+    return &VA_TOP(struct loop_baseline, &loop_baseline_cache).r;
+}
+
+void
+bench_loop_baseline_clear(void)
+{
+    loop_baseline_cache.nelem = 0;
+}
+#endif
+
+const char *stream_op_name_table[STREAM_NUM_OP] = {
+    "read",
+    "write",
+    "copy",
+    "triad",
+};
+
+int
+stream_op_num_array(enum stream_op op)
+{
+    switch (op) {
+    case STREAM_COPY:
+        return 2;
+    case STREAM_TRIAD:
+        return 3;
+    default:
+        return 1;
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "ag/ag_gen.h"
+#include "npr/varray.h"
+#include "measure.h"
+
+enum lt_op {
+    LT_LATENCY,
+    LT_THROUGHPUT,
+    LT_THROUGHPUT_RENAME,
+
+    LT_NUM_OP
+};
+
+#define LT_MODE(o) (1U<<(o))
+#define LT_MODE_ALL (LT_MODE(LT_LATENCY) | LT_MODE(LT_THROUGHPUT) | LT_MODE(LT_THROUGHPUT_RENAME))
+#define LT_MODE_THROUGHPUT (LT_MODE(LT_THROUGHPUT) | LT_MODE(LT_THROUGHPUT_RENAME))
+
+enum operand_type {
+    OT_INT,
+    OT_FP32,
+    OT_FP64,
+    OT_F32x1,
+    OT_F32x2,
+    OT_F32x4,
+    OT_F32x8
+};
+
+enum regtype {
+    REG_GEN,
+    REG_NEON_64b,               /* x86 : scalar sse */
+    REG_NEON_128b,              /* x86 : xmm */
+    REG_SIMD_256b,              /* x86 : ymm */
+
+    REG_NUM_TYPE
+};
+
+/* names are ISA specific (bench_a32.cpp, ..) */
+extern const char *regtype_name_table[REG_NUM_TYPE];
+extern const char *lt_op_name_table[LT_NUM_OP];
+
+/* ZERO_MEM_SIZE bytes of zero. mapped at fixed address (ZERO_MEM_HINT) when
+ * possible, kernels embed its address and stay same across runs (kcache)
+ */
+#define ZERO_MEM_SIZE (4096*8)
+#define ZERO_MEM_HINT ((uintptr_t)0x10000000)
+extern char *zero_mem;
+
+#define ZEROMEM_PTR_REG 11
+
+/* emit one instruction (or short sequence) of kernel body */
+typedef void (*bench_emit_t)(struct ag_Emitter *e, int dst, int src);
+
+struct bench_desc {
+    const char *name;
+    enum regtype rt;
+    enum operand_type ot;
+    unsigned int modes;         /* LT_MODE(lt_op) */
+    bench_emit_t emit;
+};
+
+/* kernels with same name and regtype are registered only once */
+void bench_register(const struct bench_desc *d);
+
+/* array of const struct bench_desc *, in registration order */
+const struct npr_varray *bench_registry(void);
+
+/* ISA specific parts are in bench_a32.cpp / bench_t32.cpp / bench_a64.cpp / bench_x86.cpp, selected by Makefile */
+
+/* ag_emitter_init, agt32_emitter_init, ag64_emitter_init or agx86_emitter_init */
+void bench_emitter_init(struct ag_Emitter *e);
+
+/* runtime cpu features which change generated skeleton ("avx"), "" if none */
+const char *bench_gen_features(void);
+
+/* save registers, init operands. return loop head */
+ag_label_id_t bench_gen_prologue(struct ag_Emitter *e, int num_loop);
+/* decrement loop counter, branch to loop head, restore registers and return */
+void bench_gen_epilogue(struct ag_Emitter *e, ag_label_id_t loop_head);
+
+/* generate kernel : void (*)(void) */
+void bench_gen(struct ag_Emitter *e, const struct bench_desc *d,
+               int num_loop, int num_insn, enum lt_op o);
+
+/* same skeleton without body */
+void bench_gen_empty(struct ag_Emitter *e, int num_loop, int num_insn, enum lt_op o);
+
+#ifndef EMIT_ONLY
+/* measure bench_gen_empty(), kernel goes through kcache like others.
+ * result is cached per (num_loop, num_insn, o).
+ * clear cache after moving to another core type.
+ */
+const struct measure_result *bench_loop_baseline(int num_loop, int num_insn, enum lt_op o);
+void bench_loop_baseline_clear(void);
+#endif
+
+struct bench_mix_item {
+    const struct bench_desc *d;
+    int ratio;
+};
+
+/* interleave items by ratio in one loop body (throughput operands).
+ * return number of instructions in loop body,
+ * num_insn rounded down to multiple of sum of ratio.
+ */
+int bench_gen_mix(struct ag_Emitter *e, const struct bench_mix_item *items, int num_item,
+                  int num_loop, int num_insn);
+
+/* pointer chase kernel : unroll * (ldr r0, [r0]) per loop, r0 starts from head */
+void bench_gen_chase(struct ag_Emitter *e, void *head, int num_loop, int unroll);
+
+/* streaming kernels for bandwidth */
+enum stream_op {
+    STREAM_READ,                /* sum(a) */
+    STREAM_WRITE,               /* a = x */
+    STREAM_COPY,                /* a = b */
+    STREAM_TRIAD,               /* a = b + s*c */
+
+    STREAM_NUM_OP
+};
+
+enum stream_insn {
+    STREAM_INSN_VLDST1,         /* vld1.32/vst1.32 {d0-d3}, [rn]! (A64 : ld1/st1 {v0.4s-v1.4s}, [xn], #32) */
+    STREAM_INSN_LDSTM,          /* ldmia/stmia rn!, {8 regs} (A64 : 2 * ldp/stp xt1, xt2, [xn], #16) */
+
+    STREAM_NUM_INSN
+};
+
+extern const char *stream_op_name_table[STREAM_NUM_OP];
+extern const char *stream_insn_name_table[STREAM_NUM_INSN];
+
+/* bytes of each array processed by one iteration of inner loop */
+#define STREAM_ITER_BYTES 64
+
+/* number of arrays touched by op (a, b, c) */
+int stream_op_num_array(enum stream_op op);
+
+/* walk size bytes of each array num_pass times.
+ * size must be a multiple of STREAM_ITER_BYTES.
+ * return negative if op is not supported by insn.
+ */
+int bench_gen_stream(struct ag_Emitter *e, enum stream_op op, enum stream_insn insn,
+                     char *a, const char *b, const char *c, size_t size, int num_pass);
+
+/* ping-pong : num_loop times, wait until (*line & 1) == parity, then increment *line.
+ * two threads with parity 0 and 1 pass the line to each other.
+ */
+void bench_gen_pingpong(struct ag_Emitter *e, uint32_t *line, int parity, int num_loop);
+
+/* num_loop times, exclusive load/add/store increment of *counter (retry on failure) */
+void bench_gen_atomic_inc(struct ag_Emitter *e, uint32_t *counter, int num_loop);
+
+struct bench_registrar {
+    /* available : instruction is implemented by this cpu */
+    bench_registrar(const struct bench_desc *d, int available) {
+        if (available) {
+            bench_register(d);
+        }
+    }
+};
+
+#define BENCH_CONCAT1(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT1(a, b)
+
+/* register descriptor at static-init time if available is nonzero */
+#define BENCH_REGISTER_IF(available, rt, name, expr, ot, modes)         \
+    static const struct bench_desc BENCH_CONCAT(bench_desc_, __LINE__) = { \
+        name, rt, ot, modes,                                            \
+        [](struct ag_Emitter *e, int dst, int src){expr;},              \
+    };                                                                  \
+    static bench_registrar BENCH_CONCAT(bench_registrar_, __LINE__)(&BENCH_CONCAT(bench_desc_, __LINE__), available);
+
+#define BENCH_REGISTER(rt, name, expr, ot, modes) BENCH_REGISTER_IF(1, rt, name, expr, ot, modes)
+
+#define GEN(rt, name, expr, ot) BENCH_REGISTER(rt, name, expr, ot, LT_MODE_ALL)
+#define GEN_latency(rt, name, expr, ot) BENCH_REGISTER(rt, name, expr, ot, LT_MODE(LT_LATENCY))
+#define GEN_throughput(rt, name, expr, ot) BENCH_REGISTER(rt, name, expr, ot, LT_MODE_THROUGHPUT)
+
+#endif
@@ -0,0 +1,276 @@
+#include "bench.h"
+#include "ag/ag64_gen.h"
+
+/* A64 skeleton and generators. kernels are in kernels_a64.cpp */
+
+const char *regtype_name_table[REG_NUM_TYPE] = {
+    "generic",
+    "neon64",
+    "neon128",
+    "simd256",                  /* no kernel */
+};
+
+void
+bench_emitter_init(struct ag_Emitter *e)
+{
+    ag64_emitter_init(e);
+}
+
+const char *
+bench_gen_features(void)
+{
+    return "";
+}
+
+ag_label_id_t
+bench_gen_prologue(struct ag_Emitter *e, int num_loop)
+{
+    /* A64 register usage
+     * http://infocenter.arm.com/help/topic/com.arm.doc.ihi0055b/IHI0055B_aapcs64.pdf
+     *
+     * x0-x17      argument, scratch (caller save)
+     * x18         platform
+     * x19-x28     variable (callee save)
+     * x29, x30    fp, lr
+     * v8-v15      low 64bit is callee save
+     */
+
+    /* x0-x9 : operand register
+     * x10 : loop counter
+     * x11 : ptr to zero mem
+     * v0-v8 : operand register
+     */
+
+    /* named labels show up in symbol map (-P) */
+    ag_emit_new_label(e, "entry");
+
+    /* save d8-d15 */
+    ag64_emit_stp_v(e, 3, 8, 9, AG64_SP, -64, AG64_PRE_INDEX);
+    ag64_emit_stp_v(e, 3, 10, 11, AG64_SP, 16, AG64_OFFSET);
+    ag64_emit_stp_v(e, 3, 12, 13, AG64_SP, 32, AG64_OFFSET);
+    ag64_emit_stp_v(e, 3, 14, 15, AG64_SP, 48, AG64_OFFSET);
+
+    ag64_emit_mov_imm(e, 1, 10, num_loop);
+    ag64_emit_mov_imm(e, 1, ZEROMEM_PTR_REG, (uintptr_t)zero_mem);
+
+    for (int i=0; i<10; i++) {
+        ag64_emit_mov_imm(e, 1, i, 0);
+    }
+
+    for (int i=0; i<32; i++) {
+        ag64_emit_movi_zero(e, 1, i);
+    }
+
+    return ag_emit_new_label(e, "loop");
+}
+
+void
+bench_gen_epilogue(struct ag_Emitter *e, ag_label_id_t loop_head)
+{
+    ag64_emit_subs_imm(e, 1, 10, 10, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, loop_head);
+
+    ag_emit_new_label(e, "exit");
+
+    ag64_emit_ldp_v(e, 3, 10, 11, AG64_SP, 16, AG64_OFFSET);
+    ag64_emit_ldp_v(e, 3, 12, 13, AG64_SP, 32, AG64_OFFSET);
+    ag64_emit_ldp_v(e, 3, 14, 15, AG64_SP, 48, AG64_OFFSET);
+    ag64_emit_ldp_v(e, 3, 8, 9, AG64_SP, 64, AG64_POST_INDEX);
+
+    ag64_emit_ret(e);
+}
+
+void
+bench_gen_chase(struct ag_Emitter *e, void *head, int num_loop, int unroll)
+{
+    /* x0  : current node
+     * x10 : loop counter
+     */
+    ag64_emit_mov_imm(e, 1, 10, num_loop);
+    ag64_emit_mov_imm(e, 1, 0, (uintptr_t)head);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    for (int ii=0; ii<unroll; ii++) {
+        ag64_emit_ldr_imm(e, 3, 0, 0, 0);
+    }
+
+    ag64_emit_subs_imm(e, 1, 10, 10, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, loop_head);
+
+    ag64_emit_ret(e);
+}
+
+const char *stream_insn_name_table[STREAM_NUM_INSN] = {
+    "ld1",
+    "ldp",
+};
+
+static void
+stream_body_ldst1(struct ag_Emitter *e, enum stream_op op)
+{
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            ag64_emit_ld1_multi(e, 1, 2, 0, 2, 0, 1);
+            break;
+
+        case STREAM_WRITE:
+            ag64_emit_st1_multi(e, 1, 2, 0, 2, 0, 1);
+            break;
+
+        case STREAM_COPY:
+            ag64_emit_ld1_multi(e, 1, 2, 0, 2, 1, 1);
+            ag64_emit_st1_multi(e, 1, 2, 0, 2, 0, 1);
+            break;
+
+        case STREAM_TRIAD:
+            /* v0,v1 = b, v2,v3 = c, v16 = s */
+            ag64_emit_ld1_multi(e, 1, 2, 0, 2, 1, 1);
+            ag64_emit_ld1_multi(e, 1, 2, 2, 2, 2, 1);
+            ag64_emit_vfmla(e, 1, 0, 0, 2, 16);
+            ag64_emit_vfmla(e, 1, 0, 1, 3, 16);
+            ag64_emit_st1_multi(e, 1, 2, 0, 2, 0, 1);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/* x4-x7 : 32byte per 2 ldp/stp */
+static void
+stream_body_ldstp(struct ag_Emitter *e, enum stream_op op)
+{
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            ag64_emit_ldp(e, 1, 4, 5, 0, 16, AG64_POST_INDEX);
+            ag64_emit_ldp(e, 1, 6, 7, 0, 16, AG64_POST_INDEX);
+            break;
+
+        case STREAM_WRITE:
+            ag64_emit_stp(e, 1, 4, 5, 0, 16, AG64_POST_INDEX);
+            ag64_emit_stp(e, 1, 6, 7, 0, 16, AG64_POST_INDEX);
+            break;
+
+        case STREAM_COPY:
+            ag64_emit_ldp(e, 1, 4, 5, 1, 16, AG64_POST_INDEX);
+            ag64_emit_ldp(e, 1, 6, 7, 1, 16, AG64_POST_INDEX);
+            ag64_emit_stp(e, 1, 4, 5, 0, 16, AG64_POST_INDEX);
+            ag64_emit_stp(e, 1, 6, 7, 0, 16, AG64_POST_INDEX);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+int
+bench_gen_stream(struct ag_Emitter *e, enum stream_op op, enum stream_insn insn,
+                 char *a, const char *b, const char *c, size_t size, int num_pass)
+{
+    if (insn == STREAM_INSN_LDSTM && op == STREAM_TRIAD) {
+        /* same set of kernels as A32 */
+        return -1;
+    }
+
+    /* x0 : a, x1 : b, x2 : c
+     * x3 : inner loop counter
+     * x10 : pass counter
+     */
+    ag64_emit_mov_imm(e, 1, 10, num_pass);
+
+    if (op == STREAM_TRIAD) {
+        ag64_emit_mov_imm(e, 0, 4, 0x40400000); /* 3.0f */
+        ag64_emit_dup_gen(e, 1, 2, 16, 4);
+    }
+
+    ag_label_id_t pass_head = ag_emit_new_label(e, NULL);
+
+    ag64_emit_mov_imm(e, 1, 0, (uintptr_t)a);
+    ag64_emit_mov_imm(e, 1, 1, (uintptr_t)b);
+    ag64_emit_mov_imm(e, 1, 2, (uintptr_t)c);
+    ag64_emit_mov_imm(e, 1, 3, size / STREAM_ITER_BYTES);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    switch (insn) {
+    case STREAM_INSN_VLDST1:
+        stream_body_ldst1(e, op);
+        break;
+    case STREAM_INSN_LDSTM:
+        stream_body_ldstp(e, op);
+        break;
+    default:
+        break;
+    }
+
+    ag64_emit_subs_imm(e, 1, 3, 3, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, loop_head);
+
+    ag64_emit_subs_imm(e, 1, 10, 10, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, pass_head);
+
+    ag64_emit_ret(e);
+
+    return 0;
+}
+
+void
+bench_gen_pingpong(struct ag_Emitter *e, uint32_t *line, int parity, int num_loop)
+{
+    /* x0 : line
+     * w1 : value
+     * w2 : parity
+     * w3 : scratch
+     * x10 : loop counter
+     */
+    ag64_emit_mov_imm(e, 1, 10, num_loop);
+    ag64_emit_mov_imm(e, 1, 0, (uintptr_t)line);
+    ag64_emit_mov_imm(e, 0, 2, parity);
+
+    ag_label_id_t wait = ag_emit_new_label(e, NULL);
+
+    /* spin with plain load, not to steal line by exclusive access */
+    ag64_emit_ldr_imm(e, 2, 1, 0, 0);
+    ag64_emit_and_imm(e, 0, 3, 1, 1);
+    ag64_emit_cmp_reg(e, 0, 2, 3);
+    ag64_emit_b_cond(e, AG_COND_NE, wait);
+
+    ag64_emit_ldxr(e, 2, 1, 0);
+    ag64_emit_add_imm(e, 0, 1, 1, 1);
+    ag64_emit_stxr(e, 2, 3, 1, 0);
+    ag64_emit_cbnz(e, 0, 3, wait);
+
+    ag64_emit_subs_imm(e, 1, 10, 10, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, wait);
+
+    ag64_emit_ret(e);
+}
+
+void
+bench_gen_atomic_inc(struct ag_Emitter *e, uint32_t *counter, int num_loop)
+{
+    /* x0 : counter
+     * w1 : value
+     * w3 : stxr status
+     * x10 : loop counter
+     */
+    ag64_emit_mov_imm(e, 1, 10, num_loop);
+    ag64_emit_mov_imm(e, 1, 0, (uintptr_t)counter);
+
+    ag_label_id_t retry = ag_emit_new_label(e, NULL);
+
+    ag64_emit_ldxr(e, 2, 1, 0);
+    ag64_emit_add_imm(e, 0, 1, 1, 1);
+    ag64_emit_stxr(e, 2, 3, 1, 0);
+    ag64_emit_cbnz(e, 0, 3, retry);
+
+    ag64_emit_subs_imm(e, 1, 10, 10, 1);
+    ag64_emit_b_cond(e, AG_COND_NE, retry);
+
+    ag64_emit_ret(e);
+}
@@ -0,0 +1,280 @@
+#include "bench.h"
+#include "ag/agt32_gen.h"
+
+/* T32 (Thumb-2) skeleton and generators. kernels are in kernels_t32.cpp
+ *
+ * same register usage as A32 (bench_a32.cpp). generated code is entered
+ * at ag_code_entry() (code | 1), blx switches to Thumb state.
+ */
+
+const char *regtype_name_table[REG_NUM_TYPE] = {
+    "generic",
+    "neon64",
+    "neon128",
+    "simd256",                  /* no kernel */
+};
+
+void
+bench_emitter_init(struct ag_Emitter *e)
+{
+    agt32_emitter_init(e);
+}
+
+const char *
+bench_gen_features(void)
+{
+    return "";
+}
+
+ag_label_id_t
+bench_gen_prologue(struct ag_Emitter *e, int num_loop)
+{
+    /* r0-r9 : operand register (kernels_t32.cpp uses r0-r7)
+     * r10 : loop counter
+     * r11 : ptr to zero mem
+     */
+
+    /* named labels show up in symbol map (-P) */
+    ag_emit_new_label(e, "entry");
+
+    /* save r4-r11 */
+    /*                     109876543210 */
+    agt32_emit_push(e, 0b111111110000);
+
+    /* save d8-d15 (callee save), every q register is written below */
+    ag_emit_vpush(e, AG_COND_AL, 8, 8);
+
+    agt32_emit_movldr_imm(e, 10, num_loop);
+    agt32_emit_movldr_imm(e, ZEROMEM_PTR_REG, (uintptr_t)zero_mem);
+
+    for (int i=0; i<10; i++) {
+        agt32_emit_movldr_imm(e, i, 0);
+    }
+
+    for (int i=0; i<16; i++) {
+        ag_emit_vdup32(e, AG_COND_AL, 1, i*2, 0);
+    }
+
+    return ag_emit_new_label(e, "loop");
+}
+
+void
+bench_gen_epilogue(struct ag_Emitter *e, ag_label_id_t loop_head)
+{
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 10, 10, 1);
+    agt32_emit_b(e, AG_COND_NE, loop_head);
+
+    ag_emit_new_label(e, "exit");
+
+    ag_emit_vpop(e, AG_COND_AL, 8, 8);
+    agt32_emit_pop(e, 0b111111110000);
+
+    agt32_emit_bx(e, AG_LR);
+}
+
+void
+bench_gen_chase(struct ag_Emitter *e, void *head, int num_loop, int unroll)
+{
+    /* r0  : current node
+     * r10 : loop counter
+     */
+    agt32_emit_push(e, 0b111111110000);
+    agt32_emit_movldr_imm(e, 10, num_loop);
+    agt32_emit_movldr_imm(e, 0, (uintptr_t)head);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    for (int ii=0; ii<unroll; ii++) {
+        agt32_emit_ldr_imm(e, 0, 0, 0, AG_OFFSET_ADDR);
+    }
+
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 10, 10, 1);
+    agt32_emit_b(e, AG_COND_NE, loop_head);
+
+    agt32_emit_pop(e, 0b111111110000);
+
+    agt32_emit_bx(e, AG_LR);
+}
+
+const char *stream_insn_name_table[STREAM_NUM_INSN] = {
+    "vld1",
+    "ldm",
+};
+
+/* r4-r9, r11, r12 : 32byte per ldm/stm */
+#define STREAM_LDSTM_REGS 0b1101111110000
+
+static void
+stream_body_vldst1(struct ag_Emitter *e, enum stream_op op)
+{
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            ag_emit_vld1_multi_32(e, 0, 4, 0, AG_VLDST_POST_INCR, 0);
+            break;
+
+        case STREAM_WRITE:
+            ag_emit_vst1_multi_32(e, 0, 4, 0, AG_VLDST_POST_INCR, 0);
+            break;
+
+        case STREAM_COPY:
+            ag_emit_vld1_multi_32(e, 0, 4, 1, AG_VLDST_POST_INCR, 0);
+            ag_emit_vst1_multi_32(e, 0, 4, 0, AG_VLDST_POST_INCR, 0);
+            break;
+
+        case STREAM_TRIAD:
+            /* q0,q1 = b, q2,q3 = c, q8 = s */
+            ag_emit_vld1_multi_32(e, 0, 4, 1, AG_VLDST_POST_INCR, 0);
+            ag_emit_vld1_multi_32(e, 4, 4, 2, AG_VLDST_POST_INCR, 0);
+            ag_emit_vmla_f32(e, 1, 0, 2, 8);
+            ag_emit_vmla_f32(e, 1, 1, 3, 8);
+            ag_emit_vst1_multi_32(e, 0, 4, 0, AG_VLDST_POST_INCR, 0);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+static void
+stream_body_ldstm(struct ag_Emitter *e, enum stream_op op)
+{
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            agt32_emit_ldmia(e, 1, 0, STREAM_LDSTM_REGS);
+            break;
+
+        case STREAM_WRITE:
+            agt32_emit_stmia(e, 1, 0, STREAM_LDSTM_REGS);
+            break;
+
+        case STREAM_COPY:
+            agt32_emit_ldmia(e, 1, 1, STREAM_LDSTM_REGS);
+            agt32_emit_stmia(e, 1, 0, STREAM_LDSTM_REGS);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+int
+bench_gen_stream(struct ag_Emitter *e, enum stream_op op, enum stream_insn insn,
+                 char *a, const char *b, const char *c, size_t size, int num_pass)
+{
+    if (insn == STREAM_INSN_LDSTM && op == STREAM_TRIAD) {
+        /* no multiply-add on 8 core registers */
+        return -1;
+    }
+
+    /* r0 : a, r1 : b, r2 : c
+     * r3 : inner loop counter
+     * r10 : pass counter
+     */
+    agt32_emit_push(e, 0b111111110000);
+    agt32_emit_movldr_imm(e, 10, num_pass);
+
+    if (op == STREAM_TRIAD) {
+        agt32_emit_movldr_imm(e, 4, 0x40400000); /* 3.0f */
+        ag_emit_vdup32(e, AG_COND_AL, 1, 16, 4);
+    }
+
+    ag_label_id_t pass_head = ag_emit_new_label(e, NULL);
+
+    agt32_emit_movldr_imm(e, 0, (uintptr_t)a);
+    agt32_emit_movldr_imm(e, 1, (uintptr_t)b);
+    agt32_emit_movldr_imm(e, 2, (uintptr_t)c);
+    agt32_emit_movldr_imm(e, 3, size / STREAM_ITER_BYTES);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    switch (insn) {
+    case STREAM_INSN_VLDST1:
+        stream_body_vldst1(e, op);
+        break;
+    case STREAM_INSN_LDSTM:
+        stream_body_ldstm(e, op);
+        break;
+    default:
+        break;
+    }
+
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 3, 3, 1);
+    agt32_emit_b(e, AG_COND_NE, loop_head);
+
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 10, 10, 1);
+    agt32_emit_b(e, AG_COND_NE, pass_head);
+
+    agt32_emit_pop(e, 0b111111110000);
+
+    agt32_emit_bx(e, AG_LR);
+
+    return 0;
+}
+
+void
+bench_gen_pingpong(struct ag_Emitter *e, uint32_t *line, int parity, int num_loop)
+{
+    /* r0 : line
+     * r1 : value
+     * r2 : parity
+     * r3 : scratch
+     * r10 : loop counter
+     */
+    agt32_emit_push(e, 0b111111110000);
+    agt32_emit_movldr_imm(e, 10, num_loop);
+    agt32_emit_movldr_imm(e, 0, (uintptr_t)line);
+    agt32_emit_movldr_imm(e, 2, parity);
+
+    ag_label_id_t wait = ag_emit_new_label(e, NULL);
+
+    /* spin with plain load, not to steal line by exclusive access */
+    agt32_emit_ldr_imm(e, 1, 0, 0, AG_OFFSET_ADDR);
+    agt32_emit_and_imm(e, AGT32_FLAGS_ANY, 3, 1, 1);
+    agt32_emit_cmp_reg(e, 3, 2, 0);
+    agt32_emit_b(e, AG_COND_NE, wait);
+
+    agt32_emit_ldrex(e, 1, 0);
+    agt32_emit_add_imm(e, AGT32_FLAGS_ANY, 1, 1, 1);
+    agt32_emit_strex(e, 3, 1, 0);
+    agt32_emit_cmp_imm(e, 3, 0);
+    agt32_emit_b(e, AG_COND_NE, wait);
+
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 10, 10, 1);
+    agt32_emit_b(e, AG_COND_NE, wait);
+
+    agt32_emit_pop(e, 0b111111110000);
+
+    agt32_emit_bx(e, AG_LR);
+}
+
+void
+bench_gen_atomic_inc(struct ag_Emitter *e, uint32_t *counter, int num_loop)
+{
+    /* r0 : counter
+     * r1 : value
+     * r3 : strex status
+     * r10 : loop counter
+     */
+    agt32_emit_push(e, 0b111111110000);
+    agt32_emit_movldr_imm(e, 10, num_loop);
+    agt32_emit_movldr_imm(e, 0, (uintptr_t)counter);
+
+    ag_label_id_t retry = ag_emit_new_label(e, NULL);
+
+    agt32_emit_ldrex(e, 1, 0);
+    agt32_emit_add_imm(e, AGT32_FLAGS_ANY, 1, 1, 1);
+    agt32_emit_strex(e, 3, 1, 0);
+    agt32_emit_cmp_imm(e, 3, 0);
+    agt32_emit_b(e, AG_COND_NE, retry);
+
+    agt32_emit_sub_imm(e, AGT32_FLAGS_SET, 10, 10, 1);
+    agt32_emit_b(e, AG_COND_NE, retry);
+
+    agt32_emit_pop(e, 0b111111110000);
+
+    agt32_emit_bx(e, AG_LR);
+}
@@ -0,0 +1,334 @@
+#include "bench.h"
+#include "ag/agx86_gen.h"
+
+/* x86-64 skeleton and generators. kernels are in kernels_x86.cpp */
+
+const char *regtype_name_table[REG_NUM_TYPE] = {
+    "generic",
+    "scalar",
+    "xmm",
+    "ymm",
+};
+
+/* callee save registers, pushed in this order */
+static const int saved_regs[] = {
+    AGX86_RBX, AGX86_RBP, AGX86_R12, AGX86_R13, AGX86_R14, AGX86_R15,
+};
+#define NUM_SAVED_REGS (int)(sizeof(saved_regs)/sizeof(saved_regs[0]))
+
+static int
+has_avx(void)
+{
+#ifdef EMIT_ONLY
+    return 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+
+void
+bench_emitter_init(struct ag_Emitter *e)
+{
+    agx86_emitter_init(e);
+}
+
+const char *
+bench_gen_features(void)
+{
+    return has_avx() ? "avx" : "";
+}
+
+ag_label_id_t
+bench_gen_prologue(struct ag_Emitter *e, int num_loop)
+{
+    /* System V AMD64 ABI register usage
+     *
+     * rax, rcx, rdx, rsi, rdi, r8-r11   scratch (caller save)
+     * rbx, rbp, r12-r15                 variable (callee save)
+     * rsp                               stack
+     * xmm0-xmm15                        scratch (caller save)
+     */
+
+    /* all gpr except rsp, r10, r11 : operand register (kernels_x86.cpp maps 0-9)
+     * r10 : loop counter
+     * r11 : ptr to zero mem
+     * xmm0-xmm8 : operand register
+     */
+
+    /* named labels show up in symbol map (-P) */
+    ag_emit_new_label(e, "entry");
+
+    for (int i=0; i<NUM_SAVED_REGS; i++) {
+        agx86_emit_push(e, saved_regs[i]);
+    }
+
+    agx86_emit_mov_imm(e, 1, AGX86_R10, num_loop);
+    agx86_emit_mov_imm(e, 1, ZEROMEM_PTR_REG, (uintptr_t)zero_mem);
+
+    for (int i=0; i<16; i++) {
+        if (i != AGX86_RSP && i != AGX86_R10 && i != ZEROMEM_PTR_REG) {
+            agx86_emit_mov_imm(e, 0, i, 0);
+        }
+    }
+
+    if (has_avx()) {
+        agx86_emit_vzeroall(e);
+    } else {
+        for (int i=0; i<16; i++) {
+            agx86_emit_pxor(e, i, i);
+        }
+    }
+
+    return ag_emit_new_label(e, "loop");
+}
+
+void
+bench_gen_epilogue(struct ag_Emitter *e, ag_label_id_t loop_head)
+{
+    agx86_emit_dec(e, 1, AGX86_R10);
+    agx86_emit_jcc(e, AGX86_CC_NE, loop_head);
+
+    ag_emit_new_label(e, "exit");
+
+    if (has_avx()) {
+        /* avoid SSE/AVX transition penalty in caller */
+        agx86_emit_vzeroupper(e);
+    }
+
+    for (int i=NUM_SAVED_REGS-1; i>=0; i--) {
+        agx86_emit_pop(e, saved_regs[i]);
+    }
+
+    agx86_emit_ret(e);
+}
+
+void
+bench_gen_chase(struct ag_Emitter *e, void *head, int num_loop, int unroll)
+{
+    /* rax : current node
+     * r10 : loop counter
+     */
+    agx86_emit_mov_imm(e, 1, AGX86_R10, num_loop);
+    agx86_emit_mov_imm(e, 1, AGX86_RAX, (uintptr_t)head);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    for (int ii=0; ii<unroll; ii++) {
+        agx86_emit_load(e, 3, AGX86_RAX, agx86_mem_base(AGX86_RAX, 0));
+    }
+
+    agx86_emit_dec(e, 1, AGX86_R10);
+    agx86_emit_jcc(e, AGX86_CC_NE, loop_head);
+
+    agx86_emit_ret(e);
+}
+
+const char *stream_insn_name_table[STREAM_NUM_INSN] = {
+    "movdqu",
+    "mov",
+};
+
+static void
+stream_body_movdqu(struct ag_Emitter *e, enum stream_op op)
+{
+    struct agx86_mem a0 = agx86_mem_base(AGX86_RDI, 0), a1 = agx86_mem_base(AGX86_RDI, 16);
+    struct agx86_mem b0 = agx86_mem_base(AGX86_RSI, 0), b1 = agx86_mem_base(AGX86_RSI, 16);
+    struct agx86_mem c0 = agx86_mem_base(AGX86_RDX, 0), c1 = agx86_mem_base(AGX86_RDX, 16);
+
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            agx86_emit_movdqu_load(e, 0, a0);
+            agx86_emit_movdqu_load(e, 1, a1);
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        case STREAM_WRITE:
+            agx86_emit_movdqu_store(e, a0, 0);
+            agx86_emit_movdqu_store(e, a1, 1);
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        case STREAM_COPY:
+            agx86_emit_movdqu_load(e, 0, b0);
+            agx86_emit_movdqu_load(e, 1, b1);
+            agx86_emit_movdqu_store(e, a0, 0);
+            agx86_emit_movdqu_store(e, a1, 1);
+            agx86_emit_add_ri(e, 1, AGX86_RSI, 32);
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        case STREAM_TRIAD:
+            /* xmm0,xmm1 = b, xmm2,xmm3 = c, xmm8 = s. no fma in SSE */
+            agx86_emit_movdqu_load(e, 0, b0);
+            agx86_emit_movdqu_load(e, 1, b1);
+            agx86_emit_movdqu_load(e, 2, c0);
+            agx86_emit_movdqu_load(e, 3, c1);
+            agx86_emit_mulps(e, 2, 8);
+            agx86_emit_mulps(e, 3, 8);
+            agx86_emit_addps(e, 0, 2);
+            agx86_emit_addps(e, 1, 3);
+            agx86_emit_movdqu_store(e, a0, 0);
+            agx86_emit_movdqu_store(e, a1, 1);
+            agx86_emit_add_ri(e, 1, AGX86_RSI, 32);
+            agx86_emit_add_ri(e, 1, AGX86_RDX, 32);
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+/* rax, r8, r9, r11 : 32byte per 4 mov */
+static const int stream_mov_regs[4] = {AGX86_RAX, AGX86_R8, AGX86_R9, AGX86_R11};
+
+static void
+stream_body_mov(struct ag_Emitter *e, enum stream_op op)
+{
+    for (int half=0; half<2; half++) {
+        switch (op) {
+        case STREAM_READ:
+            for (int i=0; i<4; i++) {
+                agx86_emit_load(e, 3, stream_mov_regs[i], agx86_mem_base(AGX86_RDI, i*8));
+            }
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        case STREAM_WRITE:
+            for (int i=0; i<4; i++) {
+                agx86_emit_store(e, 3, agx86_mem_base(AGX86_RDI, i*8), stream_mov_regs[i]);
+            }
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        case STREAM_COPY:
+            for (int i=0; i<4; i++) {
+                agx86_emit_load(e, 3, stream_mov_regs[i], agx86_mem_base(AGX86_RSI, i*8));
+            }
+            for (int i=0; i<4; i++) {
+                agx86_emit_store(e, 3, agx86_mem_base(AGX86_RDI, i*8), stream_mov_regs[i]);
+            }
+            agx86_emit_add_ri(e, 1, AGX86_RSI, 32);
+            agx86_emit_add_ri(e, 1, AGX86_RDI, 32);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+int
+bench_gen_stream(struct ag_Emitter *e, enum stream_op op, enum stream_insn insn,
+                 char *a, const char *b, const char *c, size_t size, int num_pass)
+{
+    if (insn == STREAM_INSN_LDSTM && op == STREAM_TRIAD) {
+        /* same set of kernels as A32 */
+        return -1;
+    }
+
+    /* rdi : a, rsi : b, rdx : c
+     * rcx : inner loop counter
+     * r10 : pass counter
+     */
+    agx86_emit_mov_imm(e, 1, AGX86_R10, num_pass);
+
+    if (op == STREAM_TRIAD) {
+        agx86_emit_mov_imm(e, 0, AGX86_RAX, 0x40400000); /* 3.0f */
+        agx86_emit_movq_to_xmm(e, 8, AGX86_RAX);
+        agx86_emit_pshufd(e, 8, 8, 0);
+    }
+
+    ag_label_id_t pass_head = ag_emit_new_label(e, NULL);
+
+    agx86_emit_mov_imm(e, 1, AGX86_RDI, (uintptr_t)a);
+    agx86_emit_mov_imm(e, 1, AGX86_RSI, (uintptr_t)b);
+    agx86_emit_mov_imm(e, 1, AGX86_RDX, (uintptr_t)c);
+    agx86_emit_mov_imm(e, 1, AGX86_RCX, size / STREAM_ITER_BYTES);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    switch (insn) {
+    case STREAM_INSN_VLDST1:
+        stream_body_movdqu(e, op);
+        break;
+    case STREAM_INSN_LDSTM:
+        stream_body_mov(e, op);
+        break;
+    default:
+        break;
+    }
+
+    agx86_emit_dec(e, 1, AGX86_RCX);
+    agx86_emit_jcc(e, AGX86_CC_NE, loop_head);
+
+    agx86_emit_dec(e, 1, AGX86_R10);
+    agx86_emit_jcc(e, AGX86_CC_NE, pass_head);
+
+    agx86_emit_ret(e);
+
+    return 0;
+}
+
+void
+bench_gen_pingpong(struct ag_Emitter *e, uint32_t *line, int parity, int num_loop)
+{
+    /* rdi : line
+     * eax : value (cmpxchg comparand)
+     * esi : parity
+     * ecx : value + 1
+     * edx : scratch
+     * r10 : loop counter
+     */
+    struct agx86_mem m = agx86_mem_base(AGX86_RDI, 0);
+
+    agx86_emit_mov_imm(e, 1, AGX86_R10, num_loop);
+    agx86_emit_mov_imm(e, 1, AGX86_RDI, (uintptr_t)line);
+    agx86_emit_mov_imm(e, 0, AGX86_RSI, parity);
+
+    ag_label_id_t wait = ag_emit_new_label(e, NULL);
+
+    /* spin with plain load, not to steal line by locked access */
+    agx86_emit_load(e, 2, AGX86_RAX, m);
+    agx86_emit_mov_rr(e, 0, AGX86_RDX, AGX86_RAX);
+    agx86_emit_and_ri(e, 0, AGX86_RDX, 1);
+    agx86_emit_cmp_rr(e, 0, AGX86_RDX, AGX86_RSI);
+    agx86_emit_jcc(e, AGX86_CC_NE, wait);
+
+    agx86_emit_lea(e, 0, AGX86_RCX, agx86_mem_base(AGX86_RAX, 1));
+    agx86_emit_lock(e);
+    agx86_emit_cmpxchg_mr(e, 2, m, AGX86_RCX);
+    agx86_emit_jcc(e, AGX86_CC_NE, wait);
+
+    agx86_emit_dec(e, 1, AGX86_R10);
+    agx86_emit_jcc(e, AGX86_CC_NE, wait);
+
+    agx86_emit_ret(e);
+}
+
+void
+bench_gen_atomic_inc(struct ag_Emitter *e, uint32_t *counter, int num_loop)
+{
+    /* rdi : counter
+     * ecx : 1
+     * r10 : loop counter
+     *
+     * lock add never fails, no retry loop
+     */
+    agx86_emit_mov_imm(e, 1, AGX86_R10, num_loop);
+    agx86_emit_mov_imm(e, 1, AGX86_RDI, (uintptr_t)counter);
+    agx86_emit_mov_imm(e, 0, AGX86_RCX, 1);
+
+    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+
+    agx86_emit_lock(e);
+    agx86_emit_add_mr(e, 0, agx86_mem_base(AGX86_RDI, 0), AGX86_RCX);
+
+    agx86_emit_dec(e, 1, AGX86_R10);
+    agx86_emit_jcc(e, AGX86_CC_NE, loop_head);
+
+    agx86_emit_ret(e);
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "c2c.h"
+#include "bench.h"
+#include "measure.h"
+#include "output.h"
+#include "cpu.h"
+#include "team.h"
+
+#ifdef EMIT_ONLY
+void
+c2c_run(const struct c2c_config *c)
+{
+    (void)c;
+    fprintf(stderr, "c2c : not supported in EMIT_ONLY build\n");
+}
+#else
+
+/* larger than cache line of any core, includes adjacent line prefetch */
+#define PAD_SIZE 128
+
+/* false sharing needs every counter in one line */
+#define MAX_FALSE_SHARING_THREAD 16
+
+enum contention_layout {
+    LAYOUT_SHARED,
+    LAYOUT_FALSE_SHARING,
+    LAYOUT_PADDED,
+
+    LAYOUT_NUM
+};
+
+static const char *layout_name_table[LAYOUT_NUM] = {
+    "shared",
+    "false_sharing",
+    "padded",
+};
+
+/* median ns of one team_run() */
+static double
+run_team(struct team *t, const measure_func_t *funcs, double *cv)
+{
+    int num_rep = measure_config.num_rep;
+    double *ns = (double*)malloc(sizeof(double) * num_rep);
+
+    /* warm up */
+    team_run(t, funcs);
+
+    for (int rep=0; rep<num_rep; rep++) {
+        ns[rep] = team_run(t, funcs);
+    }
+
+    struct measure_stat st;
+    measure_compute_stat(&st, ns, num_rep);
+    free(ns);
+
+    *cv = st.cv;
+    return st.median;
+}
+
+/* return one way transfer in ns */
+static double
+pingpong(int cpu_a, int cpu_b, uint32_t *line, const struct c2c_config *c)
+{
+    int cpus[2] = {cpu_a, cpu_b};
+    struct ag_Emitter e[2];
+    measure_func_t funcs[2];
+    struct ag_publish_batch batch;
+
+    *line = 0;
+    ag_publish_batch_init(&batch);
+
+    for (int i=0; i<2; i++) {
+        void *code;
+        size_t code_size;
+
+        bench_emitter_init(&e[i]);
+        bench_gen_pingpong(&e[i], line, i, c->num_loop);
+        ag_finalize_code(&code, &code_size, &e[i]);
+        ag_publish_batch_add(&batch, code, code_size);
+        funcs[i] = (measure_func_t)ag_code_entry(&e[i], code);
+    }
+
+    ag_publish_batch_commit(&batch);
+    ag_publish_batch_fini(&batch);
+
+    struct team *t = team_create(cpus, 2, NULL, NULL);
+    double cv;
+    double ns = run_team(t, funcs, &cv);
+    team_destroy(t);
+
+    for (int i=0; i<2; i++) {
+        ag_emitter_fini(&e[i]);
+    }
+
+    /* each round trip is two transfers */
+    double ns_per_transfer = ns / (c->num_loop * 2.0);
+
+    output_row_begin();
+    output_label("suite", "%s", "c2c");
+    output_label("test", "%s", "pingpong");
+    output_value("cpu_a", "cpu %2.0f", cpu_a);
+    output_value("cpu_b", "<-> cpu %2.0f", cpu_b);
+    output_value("ns_per_transfer", "%8.2f ns", ns_per_transfer);
+    output_value("cv_percent", "CV=%5.2f%%", cv*100.0);
+    output_flag("unstable", cv > measure_config.cv_threshold);
+    output_row_end();
+
+    return ns_per_transfer;
+}
+
+static void
+run_pingpong(const int *cpus, int num_cpu, char *mem, const struct c2c_config *c)
+{
+    uint32_t *line = (uint32_t*)mem;
+    double *matrix = (double*)calloc(num_cpu * num_cpu, sizeof(double));
+
+    output_comment("== c2c : pingpong ==");
+
+    for (int a=0; a<num_cpu; a++) {
+        for (int b=a+1; b<num_cpu; b++) {
+            double ns = pingpong(cpus[a], cpus[b], line, c);
+            matrix[a*num_cpu + b] = ns;
+            matrix[b*num_cpu + a] = ns;
+        }
+    }
+
+    /* matrix in ns, text only */
+    char buf[16 + 8*256];
+    int len;
+
+    len = snprintf(buf, sizeof(buf), "%6s", "cpu");
+    for (int b=0; b<num_cpu && b<256; b++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "%8d", cpus[b]);
+    }
+    output_comment("%s", buf);
+
+    for (int a=0; a<num_cpu; a++) {
+        len = snprintf(buf, sizeof(buf), "%6d", cpus[a]);
+        for (int b=0; b<num_cpu && b<256; b++) {
+            if (a == b) {
+                len += snprintf(buf + len, sizeof(buf) - len, "%8s", "-");
+            } else {
+                len += snprintf(buf + len, sizeof(buf) - len, "%8.1f", matrix[a*num_cpu + b]);
+            }
+        }
+        output_comment("%s", buf);
+    }
+
+    free(matrix);
+}
+
+static void
+contention(const int *cpus, int num_thread, enum contention_layout layout,
+           char *mem, const struct c2c_config *c)
+{
+    struct ag_Emitter *e = (struct ag_Emitter*)malloc(sizeof(struct ag_Emitter) * num_thread);
+    measure_func_t *funcs = (measure_func_t*)malloc(sizeof(measure_func_t) * num_thread);
+    struct ag_publish_batch batch;
+
+    memset(mem, 0, PAD_SIZE * num_thread);
+    ag_publish_batch_init(&batch);
+
+    for (int i=0; i<num_thread; i++) {
+        uint32_t *counter;
+        void *code;
+        size_t code_size;
+
+        switch (layout) {
+        case LAYOUT_FALSE_SHARING:
+            counter = (uint32_t*)mem + i;
+            break;
+        case LAYOUT_PADDED:
+            counter = (uint32_t*)(mem + PAD_SIZE * i);
+            break;
+        default:
+            counter = (uint32_t*)mem;
+            break;
+        }
+
+        bench_emitter_init(&e[i]);
+        bench_gen_atomic_inc(&e[i], counter, c->num_loop);
+        ag_finalize_code(&code, &code_size, &e[i]);
+        ag_publish_batch_add(&batch, code, code_size);
+        funcs[i] = (measure_func_t)ag_code_entry(&e[i], code);
+    }
+
+    ag_publish_batch_commit(&batch);
+    ag_publish_batch_fini(&batch);
+
+    struct team *t = team_create(cpus, num_thread, NULL, NULL);
+    double cv;
+    double ns = run_team(t, funcs, &cv);
+    team_destroy(t);
+
+    for (int i=0; i<num_thread; i++) {
+        ag_emitter_fini(&e[i]);
+    }
+    free(e);
+    free(funcs);
+
+    double num_op = (double)c->num_loop * num_thread;
+
+    output_row_begin();
+    output_label("suite", "%s", "c2c");
+    output_label("test", "%s", "contention");
+    output_label("layout", "%13s", layout_name_table[layout]);
+    output_value("threads", "%2.0f threads", num_thread);
+    output_value("ns_per_op", "%8.2f ns/op/thread", ns / c->num_loop);
+    output_value("mops", "%8.2f Mop/s", num_op * 1e3 / ns);
+    output_value("cv_percent", "CV=%5.2f%%", cv*100.0);
+    output_flag("unstable", cv > measure_config.cv_threshold);
+    output_row_end();
+}
+
+void
+c2c_run(const struct c2c_config *c)
+{
+    struct npr_varray cpus;
+    cpu_list_select(&cpus, c->cluster, c->max_thread);
+
+    int num_cpu = (int)cpus.nelem;
+    const int *cpu_list = (const int*)cpus.elements;
+
+    char *mem = (char*)mmap(NULL, PAD_SIZE * num_cpu, PROT_READ|PROT_WRITE,
+                            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    if (num_cpu < 2) {
+        output_comment("c2c : pingpong needs 2 or more cpus, skipped");
+    } else {
+        run_pingpong(cpu_list, num_cpu, mem, c);
+    }
+
+    for (int l=0; l<LAYOUT_NUM; l++) {
+        output_comment("== c2c : contention, %s ==", layout_name_table[l]);
+
+        for (int nt=1; nt<=num_cpu; nt++) {
+            if (l == LAYOUT_FALSE_SHARING && nt > MAX_FALSE_SHARING_THREAD) {
+                break;
+            }
+            contention(cpu_list, nt, (enum contention_layout)l, mem, c);
+        }
+    }
+
+    munmap(mem, PAD_SIZE * num_cpu);
+    npr_varray_discard(&cpus);
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef C2C_H
+#define C2C_H
+
+/* core to core cache line transfer.
+ *
+ * pingpong : two threads pass one line to each other with ldrex/strex,
+ *            for every pair of cpus. result is also shown as matrix.
+ * contention : 1..N threads increment with ldrex/strex,
+ *              shared : same word
+ *              false_sharing : own word in same line
+ *              padded : own line
+ */
+struct c2c_config {
+    int num_loop;               /* round trips (pingpong) or increments per thread */
+    int max_thread;             /* 0 : all selected cpus */
+    int cluster;                /* -1 : all cpus */
+};
+
+#define C2C_DEFAULT_NUM_LOOP 65536
+
+void c2c_run(const struct c2c_config *c);
+
+#endif
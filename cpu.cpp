@@ -0,0 +1,187 @@
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cpu.h"
+
+int
+cpu_pin(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int
+cpu_pin_except(int cpu)
+{
+    struct npr_varray cpus;
+    cpu_set_t set;
+    int num = 0;
+
+    cpu_list_select(&cpus, -1, 0);
+
+    CPU_ZERO(&set);
+    for (size_t i=0; i<cpus.nelem; i++) {
+        int c = VA_ELEM(int, &cpus, i);
+        if (c != cpu && c < CPU_SETSIZE) {
+            CPU_SET(c, &set);
+            num++;
+        }
+    }
+
+    npr_varray_discard(&cpus);
+
+    if (num == 0 || sched_setaffinity(0, sizeof(set), &set) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int
+read_sysfs_u64(uint64_t *ret, const char *fmt, int cpu)
+{
+    char path[256];
+    snprintf(path, sizeof(path), fmt, cpu);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    unsigned long long v;
+    int n = fscanf(fp, "%llx", &v);
+    fclose(fp);
+
+    if (n != 1) {
+        return -1;
+    }
+
+    *ret = v;
+    return 0;
+}
+
+static int
+read_sysfs_int(int *ret, const char *fmt, int cpu)
+{
+    char path[256];
+    snprintf(path, sizeof(path), fmt, cpu);
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    int n = fscanf(fp, "%d", ret);
+    fclose(fp);
+
+    return (n == 1) ? 0 : -1;
+}
+
+static void
+push_cpu(struct npr_varray *ret, int cpu)
+{
+    struct cpu_info ci;
+
+    ci.cpu = cpu;
+    ci.cluster = -1;
+
+    if (read_sysfs_u64(&ci.midr, "/sys/devices/system/cpu/cpu%d/regs/identification/midr_el1", cpu) < 0) {
+        ci.midr = 0;
+    }
+    if (read_sysfs_int(&ci.capacity, "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu) < 0) {
+        ci.capacity = -1;
+    }
+
+    VA_PUSH(struct cpu_info, ret, ci);
+}
+
+int
+cpu_list_online(struct npr_varray *ret)
+{
+    npr_varray_init(ret, 16, sizeof(struct cpu_info));
+
+    /* "0-3,5,7-8" */
+    FILE *fp = fopen("/sys/devices/system/cpu/online", "rb");
+    if (fp) {
+        int first, last;
+        char sep;
+
+        while (fscanf(fp, "%d", &first) == 1) {
+            last = first;
+            if (fscanf(fp, "%c", &sep) == 1 && sep == '-') {
+                if (fscanf(fp, "%d", &last) != 1) {
+                    break;
+                }
+                if (fscanf(fp, "%c", &sep) != 1) {
+                    sep = '\n';
+                }
+            }
+
+            for (int cpu=first; cpu<=last; cpu++) {
+                push_cpu(ret, cpu);
+            }
+
+            if (sep != ',') {
+                break;
+            }
+        }
+        fclose(fp);
+    }
+
+    if (ret->nelem == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu=0; cpu<n; cpu++) {
+            push_cpu(ret, cpu);
+        }
+    }
+
+    int num_cluster = 0;
+    struct cpu_info *cpus = (struct cpu_info*)ret->elements;
+
+    for (size_t i=0; i<ret->nelem; i++) {
+        for (size_t j=0; j<i; j++) {
+            if (cpus[j].midr == cpus[i].midr && cpus[j].capacity == cpus[i].capacity) {
+                cpus[i].cluster = cpus[j].cluster;
+                break;
+            }
+        }
+
+        if (cpus[i].cluster == -1) {
+            cpus[i].cluster = num_cluster++;
+        }
+    }
+
+    return num_cluster;
+}
+
+void
+cpu_list_select(struct npr_varray *ret, int cluster, int max_cpu)
+{
+    struct npr_varray all;
+    cpu_list_online(&all);
+
+    npr_varray_init(ret, 16, sizeof(int));
+
+    for (size_t i=0; i<all.nelem; i++) {
+        struct cpu_info *ci = VA_ELEM_PTR(struct cpu_info, &all, i);
+        if (cluster >= 0 && ci->cluster != cluster) {
+            continue;
+        }
+        if (max_cpu > 0 && (int)ret->nelem == max_cpu) {
+            break;
+        }
+        VA_PUSH(int, ret, ci->cpu);
+    }
+
+    npr_varray_discard(&all);
+}
@@ -0,0 +1,34 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdint.h>
+#include "npr/varray.h"
+
+struct cpu_info {
+    int cpu;
+    uint64_t midr;              /* 0 if not available */
+    int capacity;               /* -1 if not available */
+    int cluster;
+};
+
+/* pin calling thread. return negative on error */
+int cpu_pin(int cpu);
+
+/* allow calling thread on every online cpu except cpu.
+ * return negative on error or if no other cpu is online.
+ */
+int cpu_pin_except(int cpu);
+
+/* fill ret with struct cpu_info of every online cpu.
+ * cpus with same MIDR and capacity are put into same cluster.
+ * return number of clusters.
+ */
+int cpu_list_online(struct npr_varray *ret);
+
+/* fill ret with int cpu numbers of online cpus.
+ * cluster : -1 for all clusters.
+ * max_cpu : 0 for no limit.
+ */
+void cpu_list_select(struct npr_varray *ret, int cluster, int max_cpu);
+
+#endif
@@ -1,6 +1,7 @@
 #define AG_USE_SHORT_REG
 
 #include "ag/ag_gen.h"
+#include "ag/ag_dis.h"
 #include <stdio.h>
 
 int
@@ -46,7 +47,7 @@ main()
         ag_emit_vmull_p8(&e, 0, 0, 1, 2);
 
         ag_emit_ldr_reg(&e, AG_COND_AL, 3, 3, 3, 0, 1, AG_OFFSET_ADDR);
-        ag_emit_str_reg(&e, AG_COND_AL, 3, 3, 3, AG_ASR_AM(1), 1, 0);
+        ag_emit_str_reg(&e, AG_COND_AL, 3, 3, 3, AG_ASR_AM(1), 1, AG_OFFSET_ADDR);
         ag_emit_ldr_imm(&e, AG_COND_AL, 3, 3, 128, AG_POST_INCR);
         ag_emit_str_imm(&e, AG_COND_AL, 3, 3, -1, AG_POST_INCR);
 
@@ -114,5 +115,13 @@ main()
     fwrite(code, 1, code_size, fp);
     fclose(fp);
 
+    /* listing, pc relative operands are shown as offset in test.bin */
+    const uint32_t *words = (const uint32_t*)code;
+    for (size_t i=0; i<code_size/4; i++) {
+        char buf[128];
+        ag_disasm_a32(buf, sizeof(buf), words[i], i*4);
+        printf("%6x: %08x  %s\n", (unsigned)(i*4), words[i], buf);
+    }
+
     ag_emitter_fini(&e);
 }
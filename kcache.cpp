@@ -0,0 +1,296 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "kcache.h"
+
+#ifndef KCACHE_GEN_ID
+#error "KCACHE_GEN_ID is defined by Makefile"
+#endif
+
+#define KCACHE_MAGIC "IBKCACHE"
+#define KCACHE_VERSION 1
+
+/* last bytes of file */
+struct kcache_trailer {
+    char magic[8];
+    uint32_t version;
+    uint32_t code_size;
+    uint32_t entry_offset;
+    uint32_t sym_size;
+    uint32_t key_size;
+    uint32_t reserved;
+};
+
+static char *cache_dir;
+static unsigned int tmp_seq;
+
+int
+kcache_open(const char *dir)
+{
+    if (mkdir(dir, 0777) < 0 && errno != EEXIST) {
+        perror(dir);
+        return -1;
+    }
+
+    free(cache_dir);
+    cache_dir = strdup(dir);
+
+    return 0;
+}
+
+int
+kcache_enabled(void)
+{
+    return cache_dir != NULL;
+}
+
+void
+kcache_key(char *buf, size_t len, const struct bench_desc *d,
+           int num_loop, int num_insn, enum lt_op o)
+{
+    snprintf(buf, len, "gen=%s features=%s rt=%s name=%s num_insn=%d mode=%s num_loop=%d zero_mem=%llx",
+             KCACHE_GEN_ID, bench_gen_features(),
+             d ? regtype_name_table[(int)d->rt] : "-", d ? d->name : "(empty)",
+             num_insn, lt_op_name_table[(int)o], num_loop,
+             (unsigned long long)(uintptr_t)zero_mem);
+}
+
+/* FNV-1a */
+static uint64_t
+key_hash(const char *key)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (const unsigned char *p=(const unsigned char*)key; *p; p++) {
+        h ^= *p;
+        h *= 0x100000001b3ULL;
+    }
+
+    return h;
+}
+
+static void
+key_path(char *buf, size_t len, const char *key)
+{
+    snprintf(buf, len, "%s/%016llx.kc", cache_dir, (unsigned long long)key_hash(key));
+}
+
+static int
+read_full(int fd, void *buf, size_t size, off_t offset)
+{
+    ssize_t r = pread(fd, buf, size, offset);
+    return (r == (ssize_t)size) ? 0 : -1;
+}
+
+/* "offset size name\n" lines, names are terminated in place */
+static int
+parse_syms(struct kcache_entry *ent, char *text, size_t size)
+{
+    char *p = text;
+    char *end = text + size;
+
+    while (p < end) {
+        char *nl = (char*)memchr(p, '\n', end - p);
+        char *q;
+        struct ag_symbol sym;
+
+        if (nl == NULL) {
+            return -1;
+        }
+        *nl = '\0';
+
+        sym.offset = strtoul(p, &q, 16);
+        if (*q != ' ') {
+            return -1;
+        }
+        sym.size = strtoul(q+1, &q, 16);
+        if (*q != ' ' || sym.offset + sym.size > ent->code_size) {
+            return -1;
+        }
+        sym.name = q+1;
+        VA_PUSH(struct ag_symbol, &ent->syms, sym);
+
+        p = nl + 1;
+    }
+
+    return 0;
+}
+
+int
+kcache_load(struct kcache_entry *ent, const char *key)
+{
+    char path[1024];
+    struct stat st;
+    struct kcache_trailer t;
+    size_t key_len = strlen(key);
+
+    if (cache_dir == NULL) {
+        return -1;
+    }
+
+    key_path(path, sizeof(path), key);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(t) ||
+        read_full(fd, &t, sizeof(t), st.st_size - sizeof(t)) < 0 ||
+        memcmp(t.magic, KCACHE_MAGIC, sizeof(t.magic)) != 0 ||
+        t.version != KCACHE_VERSION ||
+        t.code_size == 0 ||
+        t.entry_offset >= t.code_size ||     /* corrupted, jump outside code */
+        (uint64_t)t.code_size + t.sym_size + t.key_size + sizeof(t) != (uint64_t)st.st_size ||
+        t.key_size != key_len)
+    {
+        close(fd);
+        return -1;
+    }
+
+    /* hash collision */
+    char *stored_key = (char*)malloc(key_len);
+    int match = (read_full(fd, stored_key, key_len, t.code_size + t.sym_size) == 0 &&
+                 memcmp(stored_key, key, key_len) == 0);
+    free(stored_key);
+
+    if (! match) {
+        close(fd);
+        return -1;
+    }
+
+    ent->code_size = t.code_size;
+    ent->entry_offset = t.entry_offset;
+    ent->sym_text = (char*)malloc(t.sym_size + 1);
+    npr_varray_init(&ent->syms, 16, sizeof(struct ag_symbol));
+
+    if (read_full(fd, ent->sym_text, t.sym_size, t.code_size) < 0 ||
+        parse_syms(ent, ent->sym_text, t.sym_size) < 0)
+    {
+        npr_varray_discard(&ent->syms);
+        free(ent->sym_text);
+        close(fd);
+        return -1;
+    }
+
+    ent->copied = 0;
+    ent->map_size = t.code_size;
+    ent->code = mmap(NULL, ent->map_size, PROT_READ|PROT_EXEC, MAP_PRIVATE, fd, 0);
+
+    if (ent->code == MAP_FAILED) {
+        /* noexec mount */
+        ent->copied = 1;
+        if (npr_exec_mem_alloc(&ent->mem, t.code_size) < 0 ||
+            read_full(fd, ent->mem.rw, t.code_size, 0) < 0)
+        {
+            npr_varray_discard(&ent->syms);
+            free(ent->sym_text);
+            close(fd);
+            return -1;
+        }
+
+        npr_exec_mem_publish(&ent->mem, 0, t.code_size);
+        ent->code = ent->mem.rx;
+    }
+
+    close(fd);
+
+    return 0;
+}
+
+void
+kcache_release(struct kcache_entry *ent)
+{
+    if (ent->copied) {
+        npr_exec_mem_free(&ent->mem);
+    } else {
+        munmap(ent->code, ent->map_size);
+    }
+
+    npr_varray_discard(&ent->syms);
+    free(ent->sym_text);
+}
+
+int
+kcache_store(const char *key, struct ag_Emitter *e, void *code, size_t code_size)
+{
+    char path[1024], tmp[1024+32];
+
+    if (cache_dir == NULL || code_size == 0 || !ag_code_is_position_independent(e)) {
+        return -1;
+    }
+
+    key_path(path, sizeof(path), key);
+    snprintf(tmp, sizeof(tmp), "%s.%d.%u.tmp", path, (int)getpid(),
+             __sync_fetch_and_add(&tmp_seq, 1));
+
+    FILE *fp = fopen(tmp, "wb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    struct npr_varray syms;
+    npr_varray_init(&syms, 16, sizeof(struct ag_symbol));
+    ag_get_symbols(e, &syms);
+
+    struct kcache_trailer t;
+    memset(&t, 0, sizeof(t));
+    memcpy(t.magic, KCACHE_MAGIC, sizeof(t.magic));
+    t.version = KCACHE_VERSION;
+    t.code_size = code_size;
+    t.entry_offset = (char*)ag_code_entry(e, code) - (char*)code;
+    t.key_size = strlen(key);
+
+    fwrite(code, 1, code_size, fp);
+    for (size_t i=0; i<syms.nelem; i++) {
+        struct ag_symbol *sym = VA_ELEM_PTR(struct ag_symbol, &syms, i);
+        int n = fprintf(fp, "%x %x %s\n", sym->offset, sym->size, sym->name);
+        if (n > 0) {
+            t.sym_size += n;
+        }
+    }
+    fwrite(key, 1, t.key_size, fp);
+    fwrite(&t, 1, sizeof(t), fp);
+
+    npr_varray_discard(&syms);
+
+    int err = ferror(fp);
+    if (fclose(fp) != 0 || err) {
+        unlink(tmp);
+        return -1;
+    }
+
+    /* readers never see partial file */
+    if (rename(tmp, path) < 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+void *
+kcache_entry_point(const struct kcache_entry *ent)
+{
+    return (char*)ent->code + ent->entry_offset;
+}
+
+void
+kcache_write_symbol_map(FILE *fp, const struct kcache_entry *ent, const char *prefix)
+{
+    for (size_t i=0; i<ent->syms.nelem; i++) {
+        const struct ag_symbol *sym = VA_ELEM_PTR(const struct ag_symbol, &ent->syms, i);
+
+        fprintf(fp, "%lx %lx %s%s%s\n",
+                (unsigned long)((uintptr_t)ent->code + sym->offset),
+                (unsigned long)sym->size,
+                prefix ? prefix : "",
+                prefix ? "." : "",
+                sym->name);
+    }
+}
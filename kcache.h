@@ -0,0 +1,63 @@
+#ifndef KCACHE_H
+#define KCACHE_H
+
+#include <stdio.h>
+#include "bench.h"
+#include "npr/exec-mem.h"
+
+/* on-disk cache of generated kernels (-K DIR).
+ *
+ * one file per kernel, named by hash of its key. key is every input of
+ * bench_gen : generator build id (ISA and hash of generator sources, see
+ * Makefile), bench_gen_features(), kernel name and regtype, num_insn,
+ * lt_op, num_loop and zero_mem address. empty loop of bench_loop_baseline()
+ * is stored under its own name, so a device without exec memory can
+ * subtract loop overhead too.
+ *
+ * file : code | symbols ("offset size name" lines) | key | trailer.
+ * code is at file offset 0, a hit is mapped from the file as executable
+ * memory without copy (copied to exec memory if the mount is noexec).
+ */
+
+#define KCACHE_KEY_LEN 512
+
+struct kcache_entry {
+    void *code;
+    size_t code_size;
+    uint32_t entry_offset;      /* entry is code + entry_offset (T32 : 1) */
+
+    struct npr_varray syms;     /* struct ag_symbol, names point into sym_text */
+    char *sym_text;
+
+    /* mapped from file, or copied to mem */
+    size_t map_size;
+    int copied;
+    struct npr_exec_mem mem;
+};
+
+/* create dir if needed. return negative on error */
+int kcache_open(const char *dir);
+
+/* 1 after kcache_open succeeded */
+int kcache_enabled(void);
+
+/* d NULL : bench_gen_empty() kernel (loop baseline) */
+void kcache_key(char *buf, size_t len, const struct bench_desc *d,
+                int num_loop, int num_insn, enum lt_op o);
+
+/* return 0 and fill ent on hit, negative on miss */
+int kcache_load(struct kcache_entry *ent, const char *key);
+void kcache_release(struct kcache_entry *ent);
+
+/* store code of e after ag_alloc_code. code with its own address
+ * (!ag_code_is_position_independent) is not stored.
+ * return negative if not stored
+ */
+int kcache_store(const char *key, struct ag_Emitter *e, void *code, size_t code_size);
+
+void *kcache_entry_point(const struct kcache_entry *ent);
+
+/* same format as ag_write_symbol_map */
+void kcache_write_symbol_map(FILE *fp, const struct kcache_entry *ent, const char *prefix);
+
+#endif
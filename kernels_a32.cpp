@@ -0,0 +1,319 @@
+#include "bench.h"
+
+#ifndef EMIT_ONLY
+#include <sys/auxv.h>
+#endif
+
+/* A32 / NEON kernels. registered at static-init time, see bench.h */
+
+/* vfma, vfms (VFPv4 / Advanced SIMDv2) */
+#ifdef EMIT_ONLY
+#define HAS_VFPV4 1
+#else
+#ifndef HWCAP_VFPv4
+#define HWCAP_VFPv4 (1<<16)
+#endif
+#define HAS_VFPV4 ((getauxval(AT_HWCAP) & HWCAP_VFPv4) != 0)
+#endif
+
+#define GEN_vfpv4(rt, name, expr, ot) BENCH_REGISTER_IF(HAS_VFPV4, rt, name, expr, ot, LT_MODE_ALL)
+
+/* VFP f32 operand : s<2n>, low half of d<n> */
+#define S(n) ((n)*2)
+
+GEN(REG_GEN, "add rd, rm, rn",
+    ag_emit_add_reg(e, AG_COND_AL, 0, dst, src, src, 0),
+    OT_INT)
+
+GEN(REG_GEN, "adds rd, rm, rn",
+    ag_emit_add_reg(e, AG_COND_AL, 1, dst, src, src, 0),
+    OT_INT)
+
+GEN(REG_GEN, "add rd, rm, rn, lsl #4",
+    ag_emit_add_reg(e, AG_COND_AL, 0, dst, src, src, AG_LSL_AM(4)),
+    OT_INT)
+
+GEN(REG_GEN, "add rd, rm, imm",
+    ag_emit_add_imm(e, AG_COND_AL, 0, dst, src, 100),
+    OT_INT)
+
+GEN(REG_GEN, "add rd, rm, pc",
+    ag_emit_add_reg(e, AG_COND_AL, 0, dst, src, AG_PC, AG_LSL_AM(4)),
+    OT_INT)
+
+GEN_latency(REG_GEN, "add pc, pc, 0",
+            ag_emit_add_imm(e, AG_COND_AL, 0, AG_PC, AG_PC, 0),
+            OT_INT)
+
+GEN(REG_GEN, "orr rd, rm, rn",
+    ag_emit_orr_reg(e, AG_COND_AL, 0, dst, src, src, 0),
+    OT_INT)
+
+GEN(REG_GEN, "eor rd, rm, rn",
+    ag_emit_eor_reg(e, AG_COND_AL, 0, dst, src, src, 0),
+    OT_INT)
+
+GEN(REG_GEN, "mul rd, rm, rs",
+    ag_emit_mul(e, AG_COND_AL, 0, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "mla rd, rm, rs, rn",
+    ag_emit_mla(e, AG_COND_AL, 0, dst, src, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "ldr rt, [rn, rm]",
+    ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, src, 0, 1, AG_OFFSET_ADDR),
+    OT_INT)
+
+GEN(REG_GEN, "ldr rt, [rn, rm, lsl #4]",
+    ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, src, AG_LSL_AM(4), 1, AG_OFFSET_ADDR),
+    OT_INT)
+
+GEN_throughput(REG_GEN, "ldm rt, {r0}",
+               ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b1),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldm rt, {r0-r3}",
+               ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b1111),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldm rt, {r0-r7}",
+               ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b11111111),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldrex rd, [rn]",
+               ag_emit_ldrex(e, AG_COND_AL, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+GEN_throughput(REG_GEN, "strex rd, rm, [rn]",
+               ag_emit_strex(e, AG_COND_AL, 0, 1, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldrex r0, [rn]; strex rd, r0, [rn] ",
+               ag_emit_ldrex(e, AG_COND_AL, 0, ZEROMEM_PTR_REG);
+               ag_emit_strex(e, AG_COND_AL, 1, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "str rt, [rn, #0]",
+               ag_emit_str_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 0, AG_OFFSET_ADDR),
+               OT_INT)
+
+
+GEN_latency(REG_GEN, "{str->ldr}->...",
+            ag_emit_str_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 0, AG_OFFSET_ADDR);
+            ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, dst, 0, 1, AG_OFFSET_ADDR),
+            OT_INT)
+
+GEN_latency(REG_GEN, "{strb->ldr}->...",
+            ag_emit_strb_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 1, AG_OFFSET_ADDR);
+            ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, dst, 0, 1, AG_OFFSET_ADDR),
+            OT_INT)
+
+GEN(REG_NEON_64b, "vadd.f32 d, d, d",
+    ag_emit_vadd_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vadd.f32 q, q, q",
+    ag_emit_vadd_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "vmul.f32 d, d, d",
+    ag_emit_vmul_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vmul.f32 q, q, q",
+    ag_emit_vmul_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "vmla.f32 d, d, d",
+    ag_emit_vmla_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vmla.f32 q, q, q",
+    ag_emit_vmla_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vld1.32 d, [rn]",
+               ag_emit_vld1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x1)
+GEN_throughput(REG_NEON_64b, "vld2.32 d, [rn]",
+               ag_emit_vld2_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "vld4.32 q, [rn]",
+               ag_emit_vld4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vst1.32 d, [rn]",
+               ag_emit_vst1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x1)
+GEN_throughput(REG_NEON_64b, "vst2.32 d, [rn]",
+               ag_emit_vst2_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "vst4.32 q, [rn]",
+               ag_emit_vst4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vcvt.f32.s32 d, d",
+               ag_emit_vcvt_f32_s32(e, 0, dst, src),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "vcvt.f32.s32 q, q",
+               ag_emit_vcvt_f32_s32(e, 1, dst*2, src*2),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vcvt.s32.f32 d, d",
+               ag_emit_vcvt_s32_f32(e, 0, dst, src),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "vcvt.s32.f32 q, q",
+               ag_emit_vcvt_s32_f32(e, 1, dst*2, src*2),
+               OT_F32x4)
+
+/* VFP scalar. operands are 0, 0/0 is NaN */
+GEN(REG_NEON_64b, "vadd.f32 s, s, s",
+    ag_emit_vfp_add_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vadd.f64 d, d, d",
+    ag_emit_vfp_add_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+
+GEN(REG_NEON_64b, "vmul.f32 s, s, s",
+    ag_emit_vfp_mul_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vmul.f64 d, d, d",
+    ag_emit_vfp_mul_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+
+GEN(REG_NEON_64b, "vmla.f32 s, s, s",
+    ag_emit_vfp_mla_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vmla.f64 d, d, d",
+    ag_emit_vfp_mla_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+
+GEN_vfpv4(REG_NEON_64b, "vfma.f32 s, s, s",
+          ag_emit_vfp_fma_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+          OT_FP32)
+GEN_vfpv4(REG_NEON_64b, "vfma.f64 d, d, d",
+          ag_emit_vfp_fma_f64(e, AG_COND_AL, dst, src, src),
+          OT_FP64)
+
+GEN(REG_NEON_64b, "vdiv.f32 s, s, s",
+    ag_emit_vfp_div_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vdiv.f64 d, d, d",
+    ag_emit_vfp_div_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+
+GEN(REG_NEON_64b, "vsqrt.f32 s, s",
+    ag_emit_vfp_sqrt_f32(e, AG_COND_AL, S(dst), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vsqrt.f64 d, d",
+    ag_emit_vfp_sqrt_f64(e, AG_COND_AL, dst, src),
+    OT_FP64)
+
+GEN_vfpv4(REG_NEON_64b, "vfma.f32 d, d, d",
+          ag_emit_vfma_f32(e, 0, dst, src, src),
+          OT_F32x2)
+GEN_vfpv4(REG_NEON_128b, "vfma.f32 q, q, q",
+          ag_emit_vfma_f32(e, 1, dst, src, src),
+          OT_F32x4)
+
+GEN(REG_NEON_64b, "vqadd.s16 d, d, d",
+    ag_emit_vqadd_s16(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vqadd.s16 q, q, q",
+    ag_emit_vqadd_s16(e, 1, dst, src, src),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vqsub.u8 q, q, q",
+    ag_emit_vqsub_u8(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_128b, "vshl.s32 q, q, q",
+    ag_emit_vshl_s32(e, 1, dst, src, src),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vshl.i32 q, q, #3",
+    ag_emit_vshl_i32(e, 1, dst*2, src*2, 3),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vshr.s32 q, q, #3",
+    ag_emit_vshr_s32(e, 1, dst*2, src*2, 3),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vshr.u64 q, q, #3",
+    ag_emit_vshr_u64(e, 1, dst*2, src*2, 3),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "vtbl.8 d, {d, d+1}, d",
+    ag_emit_vtbl_8(e, dst, src, 2, src),
+    OT_F32x2)
+GEN(REG_NEON_64b, "vtbx.8 d, {d .. d+3}, d",
+    ag_emit_vtbx_8(e, dst, src, 4, src),
+    OT_F32x2)
+
+/* vzip, vuzp write both operands */
+GEN(REG_NEON_128b, "vzip.16 q, q",
+    ag_emit_vzip_16(e, 1, dst*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vuzp.16 q, q",
+    ag_emit_vuzp_16(e, 1, dst*2, src*2),
+    OT_F32x4)
+
+GEN(REG_NEON_128b, "vrecpe.f32 q, q",
+    ag_emit_vrecpe_f32(e, 1, dst*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vrsqrte.f32 q, q",
+    ag_emit_vrsqrte_f32(e, 1, dst*2, src*2),
+    OT_F32x4)
+
+/* widening / narrowing. q operands, d operand is low half of q */
+GEN(REG_NEON_128b, "vaddl.s16 q, d, d",
+    ag_emit_vaddl_s16(e, 0, dst*2, src*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vaddw.s16 q, q, d",
+    ag_emit_vaddw_s16(e, 0, dst*2, src*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vaddhn.i32 d, q, q",
+    ag_emit_vaddhn_i32(e, 0, dst*2, src*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vmlal.s16 q, d, d",
+    ag_emit_vmlal_s16(e, 0, dst*2, src*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vqdmull.s16 q, d, d",
+    ag_emit_vqdmull_s16(e, 0, dst*2, src*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vmovl.s16 q, d",
+    ag_emit_vshll_s16(e, 0, dst*2, src*2, 0),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vshll.s16 q, d, #3",
+    ag_emit_vshll_s16(e, 0, dst*2, src*2, 3),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vmovn.i32 d, q",
+    ag_emit_vmovn_i32(e, 0, dst*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vqmovn.s32 d, q",
+    ag_emit_vqmovn_s32(e, 0, dst*2, src*2),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vshrn.i32 d, q, #3",
+    ag_emit_vshrn_i32(e, 0, dst*2, src*2, 3),
+    OT_F32x4)
+
+/* core <-> SIMD. r0, r1 are not operands of NEON kernels */
+GEN_throughput(REG_NEON_64b, "vmov d, r0, r1",
+               ag_emit_vmov_d_rr(e, AG_COND_AL, dst, 0, 1),
+               OT_F32x2)
+GEN_throughput(REG_NEON_64b, "vmov r0, r1, d",
+               ag_emit_vmov_rr_d(e, AG_COND_AL, 0, 1, src),
+               OT_F32x2)
+GEN_latency(REG_NEON_64b, "{vmov r0, r1, d->vmov d, r0, r1}->...",
+            ag_emit_vmov_rr_d(e, AG_COND_AL, 0, 1, src);
+            ag_emit_vmov_d_rr(e, AG_COND_AL, dst, 0, 1),
+            OT_F32x2)
+
+GEN_throughput(REG_NEON_64b, "vmov.32 d[0], r0",
+               ag_emit_vmov_32_d_r(e, AG_COND_AL, dst, 0, 0),
+               OT_F32x1)
+GEN_throughput(REG_NEON_64b, "vmov.32 r0, d[0]",
+               ag_emit_vmov_32_r_d(e, AG_COND_AL, 0, src, 0),
+               OT_F32x1)
+GEN_latency(REG_NEON_64b, "{vmov.32 r0, d[0]->vmov.32 d[0], r0}->...",
+            ag_emit_vmov_32_r_d(e, AG_COND_AL, 0, src, 0);
+            ag_emit_vmov_32_d_r(e, AG_COND_AL, dst, 0, 0),
+            OT_F32x1)
+
+GEN_latency(REG_NEON_64b, "{vmov r0, s->vmov s, r0}->...",
+            ag_emit_vmov_r_s(e, AG_COND_AL, 0, S(src));
+            ag_emit_vmov_s_r(e, AG_COND_AL, S(dst), 0),
+            OT_FP32)
@@ -0,0 +1,231 @@
+#include "bench.h"
+#include "ag/ag64_gen.h"
+
+#ifndef EMIT_ONLY
+#include <sys/auxv.h>
+#endif
+
+/* A64 / AdvSIMD kernels. registered at static-init time, see bench.h */
+
+#ifndef HWCAP_ATOMICS
+#define HWCAP_ATOMICS (1<<8)
+#endif
+
+/* ARMv8.1 LSE atomics */
+static int
+has_lse(void)
+{
+#ifdef EMIT_ONLY
+    return 1;
+#else
+    return (getauxval(AT_HWCAP) & HWCAP_ATOMICS) != 0;
+#endif
+}
+
+#define GEN_lse(rt, name, expr, ot) BENCH_REGISTER_IF(has_lse(), rt, name, expr, ot, LT_MODE_ALL)
+
+GEN(REG_GEN, "add xd, xn, xm",
+    ag64_emit_add_reg(e, 1, dst, src, src, AG_SHIFT_LOG_LEFT, 0),
+    OT_INT)
+
+GEN(REG_GEN, "add wd, wn, wm",
+    ag64_emit_add_reg(e, 0, dst, src, src, AG_SHIFT_LOG_LEFT, 0),
+    OT_INT)
+
+GEN(REG_GEN, "adds xd, xn, xm",
+    ag64_emit_adds_reg(e, 1, dst, src, src, AG_SHIFT_LOG_LEFT, 0),
+    OT_INT)
+
+GEN(REG_GEN, "add xd, xn, xm, lsl #4",
+    ag64_emit_add_reg(e, 1, dst, src, src, AG_SHIFT_LOG_LEFT, 4),
+    OT_INT)
+
+GEN(REG_GEN, "add xd, xn, imm",
+    ag64_emit_add_imm(e, 1, dst, src, 100),
+    OT_INT)
+
+GEN(REG_GEN, "orr xd, xn, xm",
+    ag64_emit_orr_reg(e, 1, dst, src, src, AG_SHIFT_LOG_LEFT, 0),
+    OT_INT)
+
+GEN(REG_GEN, "eor xd, xn, xm",
+    ag64_emit_eor_reg(e, 1, dst, src, src, AG_SHIFT_LOG_LEFT, 0),
+    OT_INT)
+
+GEN(REG_GEN, "and xd, xn, imm",
+    ag64_emit_and_imm(e, 1, dst, src, 0xff),
+    OT_INT)
+
+GEN(REG_GEN, "lsl xd, xn, xm",
+    ag64_emit_lslv(e, 1, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "mul xd, xn, xm",
+    ag64_emit_mul(e, 1, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "mul wd, wn, wm",
+    ag64_emit_mul(e, 0, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "madd xd, xn, xm, xa",
+    ag64_emit_madd(e, 1, dst, src, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "udiv xd, xn, xm",
+    ag64_emit_udiv(e, 1, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "sdiv wd, wn, wm",
+    ag64_emit_sdiv(e, 0, dst, src, src),
+    OT_INT)
+
+GEN(REG_GEN, "ldr xt, [xn, xm]",
+    ag64_emit_ldr_reg(e, 3, dst, ZEROMEM_PTR_REG, src, 0),
+    OT_INT)
+
+GEN(REG_GEN, "ldr xt, [xn, xm, lsl #3]",
+    ag64_emit_ldr_reg(e, 3, dst, ZEROMEM_PTR_REG, src, 1),
+    OT_INT)
+
+GEN_throughput(REG_GEN, "ldr xt, [xn, #0]",
+               ag64_emit_ldr_imm(e, 3, dst, ZEROMEM_PTR_REG, 0),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldp xt1, xt2, [xn]",
+               ag64_emit_ldp(e, 1, dst, dst+1, ZEROMEM_PTR_REG, 0, AG64_OFFSET),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldxr xt, [xn]",
+               ag64_emit_ldxr(e, 3, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+GEN_throughput(REG_GEN, "stxr ws, xt, [xn]",
+               ag64_emit_stxr(e, 3, 0, 1, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldxr x0, [xn]; stxr ws, x0, [xn] ",
+               ag64_emit_ldxr(e, 3, 0, ZEROMEM_PTR_REG);
+               ag64_emit_stxr(e, 3, 1, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "str xt, [xn, #0]",
+               ag64_emit_str_imm(e, 3, dst, ZEROMEM_PTR_REG, 0),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "stp xt1, xt2, [xn]",
+               ag64_emit_stp(e, 1, dst, dst+1, ZEROMEM_PTR_REG, 0, AG64_OFFSET),
+               OT_INT)
+
+GEN_latency(REG_GEN, "{str->ldr}->...",
+            ag64_emit_str_imm(e, 3, dst, ZEROMEM_PTR_REG, 0);
+            ag64_emit_ldr_reg(e, 3, dst, ZEROMEM_PTR_REG, dst, 0),
+            OT_INT)
+
+GEN_latency(REG_GEN, "{strb->ldr}->...",
+            ag64_emit_str_imm(e, 0, dst, ZEROMEM_PTR_REG, 1);
+            ag64_emit_ldr_reg(e, 3, dst, ZEROMEM_PTR_REG, dst, 0),
+            OT_INT)
+
+/* operands are 0, zero_mem stays zero */
+GEN_lse(REG_GEN, "ldadd xs, xt, [xn]",
+        ag64_emit_ldadd(e, 3, 0, src, dst, ZEROMEM_PTR_REG),
+        OT_INT)
+GEN_lse(REG_GEN, "ldaddal xs, xt, [xn]",
+        ag64_emit_ldadd(e, 3, AG64_ACQ|AG64_REL, src, dst, ZEROMEM_PTR_REG),
+        OT_INT)
+GEN_lse(REG_GEN, "swp xs, xt, [xn]",
+        ag64_emit_swp(e, 3, 0, src, dst, ZEROMEM_PTR_REG),
+        OT_INT)
+GEN_lse(REG_GEN, "cas xs, xt, [xn]",
+        ag64_emit_cas(e, 3, 0, dst, src, ZEROMEM_PTR_REG),
+        OT_INT)
+GEN_lse(REG_GEN, "casal xs, xt, [xn]",
+        ag64_emit_cas(e, 3, AG64_ACQ|AG64_REL, dst, src, ZEROMEM_PTR_REG),
+        OT_INT)
+
+GEN(REG_NEON_64b, "fadd d, d, d",
+    ag64_emit_fadd(e, 1, dst, src, src),
+    OT_FP64)
+GEN(REG_NEON_64b, "fmul d, d, d",
+    ag64_emit_fmul(e, 1, dst, src, src),
+    OT_FP64)
+GEN(REG_NEON_64b, "fmadd d, d, d, d",
+    ag64_emit_fmadd(e, 1, dst, src, src, src),
+    OT_FP64)
+GEN(REG_NEON_64b, "fdiv d, d, d",
+    ag64_emit_fdiv(e, 1, dst, src, src),
+    OT_FP64)
+
+GEN(REG_NEON_64b, "fadd v.2s, v.2s, v.2s",
+    ag64_emit_vfadd(e, 0, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "fadd v.4s, v.4s, v.4s",
+    ag64_emit_vfadd(e, 1, 0, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "fmul v.2s, v.2s, v.2s",
+    ag64_emit_vfmul(e, 0, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "fmul v.4s, v.4s, v.4s",
+    ag64_emit_vfmul(e, 1, 0, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "fmla v.2s, v.2s, v.2s",
+    ag64_emit_vfmla(e, 0, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "fmla v.4s, v.4s, v.4s",
+    ag64_emit_vfmla(e, 1, 0, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_128b, "add v.4s, v.4s, v.4s",
+    ag64_emit_vadd(e, 1, 2, dst, src, src),
+    OT_INT)
+GEN(REG_NEON_128b, "mul v.4s, v.4s, v.4s",
+    ag64_emit_vmul(e, 1, 2, dst, src, src),
+    OT_INT)
+GEN(REG_NEON_128b, "mla v.4s, v.4s, v.4s",
+    ag64_emit_vmla(e, 1, 2, dst, src, src),
+    OT_INT)
+GEN(REG_NEON_128b, "eor v.16b, v.16b, v.16b",
+    ag64_emit_veor(e, 1, dst, src, src),
+    OT_INT)
+
+GEN_throughput(REG_NEON_64b, "ld1 {v.2s}, [xn]",
+               ag64_emit_ld1_multi(e, 0, 2, dst, 1, ZEROMEM_PTR_REG, 0),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "ld1 {v.4s}, [xn]",
+               ag64_emit_ld1_multi(e, 1, 2, dst, 1, ZEROMEM_PTR_REG, 0),
+               OT_F32x4)
+GEN_throughput(REG_NEON_128b, "ld1 {v.4s x 4}, [xn]",
+               ag64_emit_ld1_multi(e, 1, 2, dst, 4, ZEROMEM_PTR_REG, 0),
+               OT_F32x4)
+GEN_throughput(REG_NEON_128b, "ldr q, [xn]",
+               ag64_emit_ldr_v_imm(e, 4, dst, ZEROMEM_PTR_REG, 0),
+               OT_F32x4)
+GEN_throughput(REG_NEON_128b, "ldp q, q, [xn]",
+               ag64_emit_ldp_v(e, 4, dst, dst+1, ZEROMEM_PTR_REG, 0, AG64_OFFSET),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "st1 {v.2s}, [xn]",
+               ag64_emit_st1_multi(e, 0, 2, dst, 1, ZEROMEM_PTR_REG, 0),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "st1 {v.4s}, [xn]",
+               ag64_emit_st1_multi(e, 1, 2, dst, 1, ZEROMEM_PTR_REG, 0),
+               OT_F32x4)
+GEN_throughput(REG_NEON_128b, "str q, [xn]",
+               ag64_emit_str_v_imm(e, 4, dst, ZEROMEM_PTR_REG, 0),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "scvtf v.2s, v.2s",
+               ag64_emit_vscvtf(e, 0, 0, dst, src),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "scvtf v.4s, v.4s",
+               ag64_emit_vscvtf(e, 1, 0, dst, src),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "fcvtzs v.2s, v.2s",
+               ag64_emit_vfcvtzs(e, 0, 0, dst, src),
+               OT_F32x2)
+GEN_throughput(REG_NEON_128b, "fcvtzs v.4s, v.4s",
+               ag64_emit_vfcvtzs(e, 1, 0, dst, src),
+               OT_F32x4)
@@ -0,0 +1,264 @@
+#include "bench.h"
+#include "ag/agt32_gen.h"
+
+#ifndef EMIT_ONLY
+#include <sys/auxv.h>
+#endif
+
+/* T32 (Thumb-2) / NEON kernels. registered at static-init time, see bench.h
+ *
+ * kernels come in 16bit / 32bit (".w") pairs with the same operation, to
+ * compare fetch and decode of narrow and wide encodings. PC relative
+ * A32 kernels have no T32 form.
+ */
+
+/* operand 8 (LT_THROUGHPUT, mix) shares r1, all operands are low registers
+ * and have 16bit forms */
+#define R(n) ((n) < 8 ? (n) : (n) - 7)
+
+#define F_ANY AGT32_FLAGS_ANY
+#define F_SET AGT32_FLAGS_SET
+#define F_KEEP AGT32_FLAGS_KEEP
+
+/* 32bit encoding of stmt */
+#define WIDE(stmt) do { e->narrow = 0; stmt; e->narrow = 1; } while (0)
+
+/* dst is also a source (16bit 2 operand form). LT_THROUGHPUT always
+ * writes dst=0, that would be a latency chain. */
+#define GEN_rmw(rt, name, expr, ot)                                     \
+    BENCH_REGISTER(rt, name, expr, ot, LT_MODE(LT_LATENCY) | LT_MODE(LT_THROUGHPUT_RENAME))
+
+#ifdef EMIT_ONLY
+#define HAS_IDIV 1
+#else
+#ifndef HWCAP_IDIVT
+#define HWCAP_IDIVT (1<<18)
+#endif
+#define HAS_IDIV ((getauxval(AT_HWCAP) & HWCAP_IDIVT) != 0)
+#endif
+
+#ifdef EMIT_ONLY
+#define HAS_VFPV4 1
+#else
+#ifndef HWCAP_VFPv4
+#define HWCAP_VFPv4 (1<<16)
+#endif
+#define HAS_VFPV4 ((getauxval(AT_HWCAP) & HWCAP_VFPv4) != 0)
+#endif
+
+/* VFP f32 operand : s<2n>, low half of d<n> */
+#define S(n) ((n)*2)
+
+GEN_throughput(REG_GEN, "nop",
+               agt32_emit_nop(e),
+               OT_INT)
+GEN_throughput(REG_GEN, "nop.w",
+               WIDE(agt32_emit_nop(e)),
+               OT_INT)
+
+GEN(REG_GEN, "adds rd, rm, rn",
+    agt32_emit_add_reg(e, F_SET, R(dst), R(src), R(src), 0),
+    OT_INT)
+GEN(REG_GEN, "adds.w rd, rm, rn",
+    WIDE(agt32_emit_add_reg(e, F_SET, R(dst), R(src), R(src), 0)),
+    OT_INT)
+
+GEN(REG_GEN, "add.w rd, rm, rn",
+    WIDE(agt32_emit_add_reg(e, F_KEEP, R(dst), R(src), R(src), 0)),
+    OT_INT)
+
+GEN(REG_GEN, "add.w rd, rm, rn, lsl #4",
+    agt32_emit_add_reg(e, F_KEEP, R(dst), R(src), R(src), AG_LSL_AM(4)),
+    OT_INT)
+
+GEN(REG_GEN, "adds rd, rm, #7",
+    agt32_emit_add_imm(e, F_SET, R(dst), R(src), 7),
+    OT_INT)
+GEN(REG_GEN, "adds.w rd, rm, #7",
+    WIDE(agt32_emit_add_imm(e, F_SET, R(dst), R(src), 7)),
+    OT_INT)
+
+GEN(REG_GEN, "add.w rd, rm, #100",
+    agt32_emit_add_imm(e, F_KEEP, R(dst), R(src), 100),
+    OT_INT)
+
+GEN(REG_GEN, "mov rd, rm",
+    agt32_emit_mov_reg(e, F_KEEP, R(dst), R(src), 0),
+    OT_INT)
+GEN(REG_GEN, "mov.w rd, rm",
+    WIDE(agt32_emit_mov_reg(e, F_KEEP, R(dst), R(src), 0)),
+    OT_INT)
+
+GEN(REG_GEN, "lsls rd, rm, #4",
+    agt32_emit_mov_reg(e, F_SET, R(dst), R(src), AG_LSL_AM(4)),
+    OT_INT)
+GEN(REG_GEN, "lsls.w rd, rm, #4",
+    WIDE(agt32_emit_mov_reg(e, F_SET, R(dst), R(src), AG_LSL_AM(4))),
+    OT_INT)
+
+GEN_rmw(REG_GEN, "orrs rd, rm",
+        agt32_emit_orr_reg(e, F_SET, R(dst), R(dst), R(src), 0),
+        OT_INT)
+GEN(REG_GEN, "orr.w rd, rm, rn",
+    agt32_emit_orr_reg(e, F_KEEP, R(dst), R(src), R(src), 0),
+    OT_INT)
+
+GEN_rmw(REG_GEN, "eors rd, rm",
+        agt32_emit_eor_reg(e, F_SET, R(dst), R(dst), R(src), 0),
+        OT_INT)
+GEN(REG_GEN, "eor.w rd, rm, rn",
+    agt32_emit_eor_reg(e, F_KEEP, R(dst), R(src), R(src), 0),
+    OT_INT)
+
+/* loop counter is not zero, ne is always taken */
+GEN(REG_GEN, "it ne; addne rd, rm, rn",
+    agt32_emit_it(e, AG_COND_NE, "");
+    agt32_emit_add_reg(e, F_KEEP, R(dst), R(src), R(src), 0),
+    OT_INT)
+
+GEN_rmw(REG_GEN, "muls rd, rm",
+        agt32_emit_mul(e, F_SET, R(dst), R(src), R(dst)),
+        OT_INT)
+GEN(REG_GEN, "mul rd, rm, rs",
+    agt32_emit_mul(e, F_KEEP, R(dst), R(src), R(src)),
+    OT_INT)
+
+GEN(REG_GEN, "mla rd, rm, rs, rn",
+    agt32_emit_mla(e, R(dst), R(src), R(src), R(src)),
+    OT_INT)
+
+/* operands are 0, 0/0 is 0 */
+BENCH_REGISTER_IF(HAS_IDIV, REG_GEN, "sdiv rd, rm, rs",
+                  agt32_emit_sdiv(e, R(dst), R(src), R(src)),
+                  OT_INT, LT_MODE_ALL)
+BENCH_REGISTER_IF(HAS_IDIV, REG_GEN, "udiv rd, rm, rs",
+                  agt32_emit_udiv(e, R(dst), R(src), R(src)),
+                  OT_INT, LT_MODE_ALL)
+
+/* r11 (zero mem) is a high register, only 32bit forms */
+GEN(REG_GEN, "ldr.w rt, [rn, rm]",
+    agt32_emit_ldr_reg(e, R(dst), ZEROMEM_PTR_REG, R(src), 0),
+    OT_INT)
+
+GEN(REG_GEN, "ldr.w rt, [rn, rm, lsl #2]",
+    agt32_emit_ldr_reg(e, R(dst), ZEROMEM_PTR_REG, R(src), 2),
+    OT_INT)
+
+/* [sp] is saved r4 */
+GEN_throughput(REG_GEN, "ldr rt, [sp]",
+               agt32_emit_ldr_imm(e, R(dst), AG_SP, 0, AG_OFFSET_ADDR),
+               OT_INT)
+GEN_throughput(REG_GEN, "ldr.w rt, [sp]",
+               WIDE(agt32_emit_ldr_imm(e, R(dst), AG_SP, 0, AG_OFFSET_ADDR)),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldm.w rn, {r0-r3}",
+               agt32_emit_ldmia(e, 0, ZEROMEM_PTR_REG, 0b1111),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldm.w rn, {r0-r7}",
+               agt32_emit_ldmia(e, 0, ZEROMEM_PTR_REG, 0b11111111),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldrex rd, [rn]",
+               agt32_emit_ldrex(e, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+GEN_throughput(REG_GEN, "strex rd, rm, [rn]",
+               agt32_emit_strex(e, 0, 1, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "ldrex r0, [rn]; strex rd, r0, [rn] ",
+               agt32_emit_ldrex(e, 0, ZEROMEM_PTR_REG);
+               agt32_emit_strex(e, 1, 0, ZEROMEM_PTR_REG),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "str.w rt, [rn, #0]",
+               agt32_emit_str_imm(e, R(dst), ZEROMEM_PTR_REG, 0, AG_OFFSET_ADDR),
+               OT_INT)
+
+GEN_latency(REG_GEN, "{str->ldr}->...",
+            agt32_emit_str_imm(e, R(dst), ZEROMEM_PTR_REG, 0, AG_OFFSET_ADDR);
+            agt32_emit_ldr_reg(e, R(dst), ZEROMEM_PTR_REG, R(dst), 0),
+            OT_INT)
+
+GEN_latency(REG_GEN, "{strb->ldr}->...",
+            agt32_emit_strb_imm(e, R(dst), ZEROMEM_PTR_REG, 1, AG_OFFSET_ADDR);
+            agt32_emit_ldr_reg(e, R(dst), ZEROMEM_PTR_REG, R(dst), 0),
+            OT_INT)
+
+GEN(REG_NEON_64b, "vadd.f32 d, d, d",
+    ag_emit_vadd_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vadd.f32 q, q, q",
+    ag_emit_vadd_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "vmul.f32 d, d, d",
+    ag_emit_vmul_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vmul.f32 q, q, q",
+    ag_emit_vmul_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN(REG_NEON_64b, "vmla.f32 d, d, d",
+    ag_emit_vmla_f32(e, 0, dst, src, src),
+    OT_F32x2)
+GEN(REG_NEON_128b, "vmla.f32 q, q, q",
+    ag_emit_vmla_f32(e, 1, dst, src, src),
+    OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vld1.32 d, [rn]",
+               ag_emit_vld1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x1)
+GEN_throughput(REG_NEON_128b, "vld4.32 q, [rn]",
+               ag_emit_vld4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_64b, "vst1.32 d, [rn]",
+               ag_emit_vst1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x1)
+GEN_throughput(REG_NEON_128b, "vst4.32 q, [rn]",
+               ag_emit_vst4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
+               OT_F32x4)
+
+GEN_throughput(REG_NEON_128b, "vcvt.f32.s32 q, q",
+               ag_emit_vcvt_f32_s32(e, 1, dst*2, src*2),
+               OT_F32x4)
+GEN_throughput(REG_NEON_128b, "vcvt.s32.f32 q, q",
+               ag_emit_vcvt_s32_f32(e, 1, dst*2, src*2),
+               OT_F32x4)
+
+/* VFP and NEON words are same as A32 (ag_emit_simd), fewer kernels here */
+GEN(REG_NEON_64b, "vadd.f32 s, s, s",
+    ag_emit_vfp_add_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+    OT_FP32)
+GEN(REG_NEON_64b, "vmul.f64 d, d, d",
+    ag_emit_vfp_mul_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+BENCH_REGISTER_IF(HAS_VFPV4, REG_NEON_64b, "vfma.f32 s, s, s",
+                  ag_emit_vfp_fma_f32(e, AG_COND_AL, S(dst), S(src), S(src)),
+                  OT_FP32, LT_MODE_ALL)
+GEN(REG_NEON_64b, "vdiv.f64 d, d, d",
+    ag_emit_vfp_div_f64(e, AG_COND_AL, dst, src, src),
+    OT_FP64)
+GEN(REG_NEON_64b, "vsqrt.f32 s, s",
+    ag_emit_vfp_sqrt_f32(e, AG_COND_AL, S(dst), S(src)),
+    OT_FP32)
+
+BENCH_REGISTER_IF(HAS_VFPV4, REG_NEON_128b, "vfma.f32 q, q, q",
+                  ag_emit_vfma_f32(e, 1, dst, src, src),
+                  OT_F32x4, LT_MODE_ALL)
+GEN(REG_NEON_128b, "vqadd.s16 q, q, q",
+    ag_emit_vqadd_s16(e, 1, dst, src, src),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vmovl.s16 q, d",
+    ag_emit_vshll_s16(e, 0, dst*2, src*2, 0),
+    OT_F32x4)
+GEN(REG_NEON_128b, "vmovn.i32 d, q",
+    ag_emit_vmovn_i32(e, 0, dst*2, src*2),
+    OT_F32x4)
+
+GEN_latency(REG_NEON_64b, "{vmov r0, r1, d->vmov d, r0, r1}->...",
+            ag_emit_vmov_rr_d(e, AG_COND_AL, 0, 1, src);
+            ag_emit_vmov_d_rr(e, AG_COND_AL, dst, 0, 1),
+            OT_F32x2)
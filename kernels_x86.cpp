@@ -0,0 +1,247 @@
+#include "bench.h"
+#include "ag/agx86_gen.h"
+
+/* x86-64 / SSE / AVX kernels. registered at static-init time, see bench.h */
+
+/* operand 0-9 -> gpr. rsp, r10 (loop counter) and r11 (zero mem) are not operands */
+static const int gpr_table[10] = {
+    AGX86_RAX, AGX86_RCX, AGX86_RDX, AGX86_RBX, AGX86_RSI,
+    AGX86_RDI, AGX86_R8, AGX86_R9, AGX86_R12, AGX86_R13,
+};
+#define R(n) gpr_table[n]
+
+#define ZM agx86_mem_base(ZEROMEM_PTR_REG, 0)
+
+#ifdef EMIT_ONLY
+#define HAS_FEATURE(f) 1
+#else
+static int
+has_feature_init(void)
+{
+    __builtin_cpu_init();
+    return 1;
+}
+#define HAS_FEATURE(f) (has_feature_init() && __builtin_cpu_supports(f))
+#endif
+
+/* dst is also a source (2 operand form, fma). LT_THROUGHPUT always
+ * writes dst=0, that would be a latency chain. */
+#define GEN_rmw(rt, name, expr, ot)                                     \
+    BENCH_REGISTER(rt, name, expr, ot, LT_MODE(LT_LATENCY) | LT_MODE(LT_THROUGHPUT_RENAME))
+#define GEN_rmw_if(f, rt, name, expr, ot)                               \
+    BENCH_REGISTER_IF(HAS_FEATURE(f), rt, name, expr, ot, LT_MODE(LT_LATENCY) | LT_MODE(LT_THROUGHPUT_RENAME))
+#define GEN_if(f, rt, name, expr, ot)                                   \
+    BENCH_REGISTER_IF(HAS_FEATURE(f), rt, name, expr, ot, LT_MODE_ALL)
+#define GEN_throughput_if(f, rt, name, expr, ot)                        \
+    BENCH_REGISTER_IF(HAS_FEATURE(f), rt, name, expr, ot, LT_MODE_THROUGHPUT)
+
+GEN_rmw(REG_GEN, "add r64, r64",
+        agx86_emit_add_rr(e, 1, R(dst), R(src)),
+        OT_INT)
+GEN_rmw(REG_GEN, "add r32, r32",
+        agx86_emit_add_rr(e, 0, R(dst), R(src)),
+        OT_INT)
+GEN_rmw(REG_GEN, "add r64, imm",
+        agx86_emit_add_ri(e, 1, R(dst), 100),
+        OT_INT)
+GEN_rmw(REG_GEN, "adc r64, r64",
+        agx86_emit_adc_rr(e, 1, R(dst), R(src)),
+        OT_INT)
+GEN_rmw(REG_GEN, "or r64, r64",
+        agx86_emit_or_rr(e, 1, R(dst), R(src)),
+        OT_INT)
+GEN_rmw(REG_GEN, "and r64, imm",
+        agx86_emit_and_ri(e, 1, R(dst), 0xff),
+        OT_INT)
+GEN_rmw(REG_GEN, "shl r64, imm",
+        agx86_emit_shl_ri(e, 1, R(dst), 4),
+        OT_INT)
+GEN_rmw(REG_GEN, "add r64, [m]",
+        agx86_emit_add_rm(e, 1, R(dst), ZM),
+        OT_INT)
+
+GEN(REG_GEN, "mov r64, r64",
+    agx86_emit_mov_rr(e, 1, R(dst), R(src)),
+    OT_INT)
+GEN(REG_GEN, "lea r64, [r + r*4 + 8]",
+    agx86_emit_lea(e, 1, R(dst), agx86_mem_index(R(src), R(src), 4, 8)),
+    OT_INT)
+
+GEN_rmw(REG_GEN, "imul r64, r64",
+        agx86_emit_imul_rr(e, 1, R(dst), R(src)),
+        OT_INT)
+GEN_rmw(REG_GEN, "imul r32, r32",
+        agx86_emit_imul_rr(e, 0, R(dst), R(src)),
+        OT_INT)
+GEN(REG_GEN, "imul r64, r64, imm",
+    agx86_emit_imul_rri(e, 1, R(dst), R(src), 100),
+    OT_INT)
+GEN_if("popcnt", REG_GEN, "popcnt r64, r64",
+       agx86_emit_popcnt(e, 1, R(dst), R(src)),
+       OT_INT)
+
+GEN(REG_GEN, "mov r64, [r11 + r]",
+    agx86_emit_load(e, 3, R(dst), agx86_mem_index(ZEROMEM_PTR_REG, R(src), 1, 0)),
+    OT_INT)
+GEN(REG_GEN, "mov r64, [r11 + r*8]",
+    agx86_emit_load(e, 3, R(dst), agx86_mem_index(ZEROMEM_PTR_REG, R(src), 8, 0)),
+    OT_INT)
+GEN_throughput(REG_GEN, "mov r64, [r11]",
+               agx86_emit_load(e, 3, R(dst), ZM),
+               OT_INT)
+GEN_throughput(REG_GEN, "movzx r32, byte [r11]",
+               agx86_emit_load(e, 0, R(dst), ZM),
+               OT_INT)
+
+GEN_throughput(REG_GEN, "mov [r11], r64",
+               agx86_emit_store(e, 3, ZM, R(dst)),
+               OT_INT)
+
+GEN_latency(REG_GEN, "{mov [m],r->mov r,[m]}->...",
+            agx86_emit_store(e, 3, ZM, R(dst));
+            agx86_emit_load(e, 3, R(dst), agx86_mem_index(ZEROMEM_PTR_REG, R(dst), 1, 0)),
+            OT_INT)
+
+GEN_latency(REG_GEN, "{mov byte [m],r->mov r,[m]}->...",
+            agx86_emit_store(e, 0, agx86_mem_base(ZEROMEM_PTR_REG, 1), R(dst));
+            agx86_emit_load(e, 3, R(dst), agx86_mem_index(ZEROMEM_PTR_REG, R(dst), 1, 0)),
+            OT_INT)
+
+/* operands are 0, zero_mem stays zero */
+GEN(REG_GEN, "lock xadd [m], r64",
+    agx86_emit_lock(e);
+    agx86_emit_xadd_mr(e, 3, ZM, R(dst)),
+    OT_INT)
+GEN(REG_GEN, "lock add [m], r64",
+    agx86_emit_lock(e);
+    agx86_emit_add_mr(e, 1, ZM, R(src)),
+    OT_INT)
+/* rax (operand 0) == [m] == 0 always succeeds */
+GEN(REG_GEN, "lock cmpxchg [m], r64",
+    agx86_emit_lock(e);
+    agx86_emit_cmpxchg_mr(e, 3, ZM, R(src)),
+    OT_INT)
+GEN(REG_GEN, "xchg [m], r64",
+    agx86_emit_xchg_mr(e, 3, ZM, R(dst)),
+    OT_INT)
+GEN_throughput(REG_GEN, "mfence",
+               agx86_emit_mfence(e),
+               OT_INT)
+
+GEN_rmw(REG_NEON_64b, "addsd x, x",
+        agx86_emit_addsd(e, dst, src),
+        OT_FP64)
+GEN_rmw(REG_NEON_64b, "mulsd x, x",
+        agx86_emit_mulsd(e, dst, src),
+        OT_FP64)
+GEN_rmw(REG_NEON_64b, "divsd x, x",
+        agx86_emit_divsd(e, dst, src),
+        OT_FP64)
+GEN_rmw(REG_NEON_64b, "addss x, x",
+        agx86_emit_addss(e, dst, src),
+        OT_FP32)
+GEN_if("avx", REG_NEON_64b, "vaddsd x, x, x",
+       agx86_emit_vaddsd(e, 0, dst, src, src),
+       OT_FP64)
+GEN_rmw_if("fma", REG_NEON_64b, "vfmadd231sd x, x, x",
+           agx86_emit_vfmadd231sd(e, 0, dst, src, src),
+           OT_FP64)
+
+GEN_rmw(REG_NEON_128b, "addps x, x",
+        agx86_emit_addps(e, dst, src),
+        OT_F32x4)
+GEN_rmw(REG_NEON_128b, "mulps x, x",
+        agx86_emit_mulps(e, dst, src),
+        OT_F32x4)
+GEN_rmw(REG_NEON_128b, "addpd x, x",
+        agx86_emit_addpd(e, dst, src),
+        OT_FP64)
+GEN_rmw(REG_NEON_128b, "divps x, x",
+        agx86_emit_divps(e, dst, src),
+        OT_F32x4)
+GEN(REG_NEON_128b, "sqrtps x, x",
+    agx86_emit_sqrtps(e, dst, src),
+    OT_F32x4)
+GEN_rmw(REG_NEON_128b, "paddd x, x",
+        agx86_emit_paddd(e, dst, src),
+        OT_INT)
+GEN_rmw_if("sse4.1", REG_NEON_128b, "pmulld x, x",
+           agx86_emit_pmulld(e, dst, src),
+           OT_INT)
+GEN_rmw(REG_NEON_128b, "pmaddwd x, x",
+        agx86_emit_pmaddwd(e, dst, src),
+        OT_INT)
+GEN_rmw(REG_NEON_128b, "pand x, x",
+        agx86_emit_pand(e, dst, src),
+        OT_INT)
+GEN_rmw_if("ssse3", REG_NEON_128b, "pshufb x, x",
+           agx86_emit_pshufb(e, dst, src),
+           OT_INT)
+GEN(REG_NEON_128b, "cvtdq2ps x, x",
+    agx86_emit_cvtdq2ps(e, dst, src),
+    OT_F32x4)
+GEN(REG_NEON_128b, "cvttps2dq x, x",
+    agx86_emit_cvttps2dq(e, dst, src),
+    OT_F32x4)
+
+GEN_if("avx", REG_NEON_128b, "vaddps x, x, x",
+       agx86_emit_vaddps(e, 0, dst, src, src),
+       OT_F32x4)
+GEN_if("avx", REG_NEON_128b, "vmulps x, x, x",
+       agx86_emit_vmulps(e, 0, dst, src, src),
+       OT_F32x4)
+GEN_rmw_if("fma", REG_NEON_128b, "vfmadd231ps x, x, x",
+           agx86_emit_vfmadd231ps(e, 0, dst, src, src),
+           OT_F32x4)
+
+GEN_throughput(REG_NEON_128b, "movdqu x, [m]",
+               agx86_emit_movdqu_load(e, dst, ZM),
+               OT_F32x4)
+GEN_rmw(REG_NEON_128b, "addps x, [m]",
+        agx86_emit_addps_load(e, dst, ZM),
+        OT_F32x4)
+GEN_throughput(REG_NEON_128b, "movdqu [m], x",
+               agx86_emit_movdqu_store(e, ZM, dst),
+               OT_F32x4)
+
+GEN_if("avx", REG_SIMD_256b, "vaddps y, y, y",
+       agx86_emit_vaddps(e, 1, dst, src, src),
+       OT_F32x8)
+GEN_if("avx", REG_SIMD_256b, "vmulps y, y, y",
+       agx86_emit_vmulps(e, 1, dst, src, src),
+       OT_F32x8)
+GEN_if("avx", REG_SIMD_256b, "vdivps y, y, y",
+       agx86_emit_vdivps(e, 1, dst, src, src),
+       OT_F32x8)
+GEN_rmw_if("fma", REG_SIMD_256b, "vfmadd231ps y, y, y",
+           agx86_emit_vfmadd231ps(e, 1, dst, src, src),
+           OT_F32x8)
+GEN_rmw_if("fma", REG_SIMD_256b, "vfmadd231pd y, y, y",
+           agx86_emit_vfmadd231pd(e, 1, dst, src, src),
+           OT_FP64)
+
+GEN_if("avx2", REG_SIMD_256b, "vpaddd y, y, y",
+       agx86_emit_vpaddd(e, 1, dst, src, src),
+       OT_INT)
+GEN_if("avx2", REG_SIMD_256b, "vpmulld y, y, y",
+       agx86_emit_vpmulld(e, 1, dst, src, src),
+       OT_INT)
+GEN_if("avx2", REG_SIMD_256b, "vpxor y, y, y",
+       agx86_emit_vpxor(e, 1, dst, src, src),
+       OT_INT)
+GEN_if("avx2", REG_SIMD_256b, "vpermd y, y, y",
+       agx86_emit_vpermd(e, 1, dst, src, src),
+       OT_INT)
+GEN_if("avx2", REG_SIMD_256b, "vbroadcastss y, x",
+       agx86_emit_vbroadcastss(e, 1, dst, src),
+       OT_F32x8)
+
+GEN_throughput_if("avx", REG_SIMD_256b, "vmovdqu y, [m]",
+                  agx86_emit_vmovdqu_load(e, 1, dst, ZM),
+                  OT_F32x8)
+GEN_throughput_if("avx", REG_SIMD_256b, "vaddps y, y, [m]",
+                  agx86_emit_vaddps_load(e, 1, dst, src, ZM),
+                  OT_F32x8)
+GEN_throughput_if("avx", REG_SIMD_256b, "vmovdqu [m], y",
+                  agx86_emit_vmovdqu_store(e, 1, ZM, dst),
+                  OT_F32x8)
@@ -0,0 +1,271 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "kgen.h"
+#include "cpu.h"
+#include "npr/exec-mem.h"
+
+struct kgen {
+    const struct kgen_job *jobs;
+    int num_job;
+    int num_loop;
+
+    struct kgen_kernel *kernels; /* [num_job], kernels[i] is jobs[i] */
+    char *ready;                 /* [num_job] */
+
+    /* lock protects everything below. cond is broadcast when a kernel
+     * becomes ready, when the window moves and on quit
+     */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int next_job;               /* next job to be claimed by worker */
+    int next_out;               /* next job returned by kgen_next */
+    int quit;
+    int pin_warned;
+
+    int num_thread;
+    int avoid_cpu;
+    pthread_t *threads;
+
+    struct kgen_stat stat;
+};
+
+void
+kgen_generate(struct kgen_kernel *k, const struct bench_desc *d,
+              int num_loop, int num_insn, enum lt_op o)
+{
+    double t0 = measure_now_ns();
+    char key[KCACHE_KEY_LEN];
+
+    if (kcache_enabled()) {
+        kcache_key(key, sizeof(key), d, num_loop, num_insn, o);
+
+        if (kcache_load(&k->c, key) == 0) {
+            k->cached = 1;
+            k->code = k->c.code;
+            k->code_size = k->c.code_size;
+            k->entry = kcache_entry_point(&k->c);
+            k->gen_ns = measure_now_ns() - t0;
+            return;
+        }
+    }
+
+    k->cached = 0;
+    bench_emitter_init(&k->e);
+    if (d) {
+        bench_gen(&k->e, d, num_loop, num_insn, o);
+    } else {
+        bench_gen_empty(&k->e, num_loop, num_insn, o);
+    }
+    ag_alloc_code(&k->code, &k->code_size, &k->e);
+    k->entry = ag_code_entry(&k->e, k->code);
+
+    if (kcache_enabled()) {
+        kcache_store(key, &k->e, k->code, k->code_size);
+    }
+
+    k->gen_ns = measure_now_ns() - t0;
+}
+
+void
+kgen_free(struct kgen_kernel *k)
+{
+    if (k->cached) {
+        kcache_release(&k->c);
+    } else {
+        ag_emitter_fini(&k->e);
+    }
+}
+
+static void
+generate(struct kgen *g, int idx)
+{
+    struct kgen_kernel *k = &g->kernels[idx];
+    const struct kgen_job *j = &g->jobs[idx];
+
+    k->job = j;
+    kgen_generate(k, j->d, g->num_loop, j->num_insn, j->o);
+}
+
+static void
+count(struct kgen *g, int idx)
+{
+    g->ready[idx] = 1;
+    g->stat.num_kernel++;
+    g->stat.num_cached += g->kernels[idx].cached;
+    g->stat.gen_ns += g->kernels[idx].gen_ns;
+}
+
+static void *
+worker_main(void *p)
+{
+    struct kgen *g = (struct kgen*)p;
+
+    if (g->avoid_cpu >= 0 && cpu_pin_except(g->avoid_cpu) < 0) {
+        pthread_mutex_lock(&g->lock);
+        if (! g->pin_warned) {
+            fprintf(stderr, "kgen : cannot keep workers off cpu %d\n", g->avoid_cpu);
+            g->pin_warned = 1;
+        }
+        pthread_mutex_unlock(&g->lock);
+    }
+
+    pthread_mutex_lock(&g->lock);
+
+    while (1) {
+        while (!g->quit &&
+               g->next_job < g->num_job &&
+               g->next_job >= g->next_out + KGEN_WINDOW)
+        {
+            pthread_cond_wait(&g->cond, &g->lock);
+        }
+
+        if (g->quit || g->next_job >= g->num_job) {
+            break;
+        }
+
+        int idx = g->next_job++;
+
+        pthread_mutex_unlock(&g->lock);
+        generate(g, idx);
+        pthread_mutex_lock(&g->lock);
+
+        count(g, idx);
+        pthread_cond_broadcast(&g->cond);
+    }
+
+    pthread_mutex_unlock(&g->lock);
+
+    return NULL;
+}
+
+struct kgen *
+kgen_create(const struct kgen_job *jobs, int num_job,
+            int num_loop, int num_thread, int avoid_cpu)
+{
+    struct kgen *g = (struct kgen*)calloc(1, sizeof(struct kgen));
+
+    g->jobs = jobs;
+    g->num_job = num_job;
+    g->num_loop = num_loop;
+    g->kernels = (struct kgen_kernel*)calloc(num_job ? num_job : 1, sizeof(struct kgen_kernel));
+    g->ready = (char*)calloc(num_job ? num_job : 1, 1);
+
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->cond, NULL);
+
+    g->num_thread = num_thread;
+    g->avoid_cpu = avoid_cpu;
+    g->stat.num_thread = num_thread;
+    g->threads = (pthread_t*)calloc(num_thread ? num_thread : 1, sizeof(pthread_t));
+
+    for (int i=0; i<num_thread; i++) {
+        if (pthread_create(&g->threads[i], NULL, worker_main, g) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    return g;
+}
+
+struct kgen_kernel *
+kgen_next(struct kgen *g)
+{
+    if (g->next_out == g->num_job) {
+        return NULL;
+    }
+
+    double t0 = measure_now_ns();
+    struct kgen_kernel *k;
+
+    if (g->num_thread == 0) {
+        int idx = g->next_out++;
+
+        generate(g, idx);
+        count(g, idx);
+
+        k = &g->kernels[idx];
+    } else {
+        pthread_mutex_lock(&g->lock);
+        while (! g->ready[g->next_out]) {
+            pthread_cond_wait(&g->cond, &g->lock);
+        }
+        k = &g->kernels[g->next_out++];
+        /* window moved */
+        pthread_cond_broadcast(&g->cond);
+        pthread_mutex_unlock(&g->lock);
+
+        /* code was published by worker */
+        npr_exec_mem_acquire();
+    }
+
+    g->stat.wait_ns += measure_now_ns() - t0;
+
+    return k;
+}
+
+void
+kgen_release(struct kgen *g, struct kgen_kernel *k)
+{
+    (void)g;
+    kgen_free(k);
+}
+
+void
+kgen_write_symbol_map(FILE *fp, struct kgen_kernel *k, const char *prefix)
+{
+    if (k->cached) {
+        kcache_write_symbol_map(fp, &k->c, prefix);
+    } else {
+        ag_write_symbol_map(fp, &k->e, prefix);
+    }
+}
+
+void
+kgen_destroy(struct kgen *g, struct kgen_stat *stat)
+{
+    pthread_mutex_lock(&g->lock);
+    g->quit = 1;
+    pthread_cond_broadcast(&g->cond);
+    pthread_mutex_unlock(&g->lock);
+
+    for (int i=0; i<g->num_thread; i++) {
+        pthread_join(g->threads[i], NULL);
+    }
+
+    /* generated ahead, never taken */
+    for (int i=g->next_out; i<g->num_job; i++) {
+        if (g->ready[i]) {
+            kgen_free(&g->kernels[i]);
+        }
+    }
+
+    if (stat) {
+        *stat = g->stat;
+    }
+
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->cond);
+
+    free(g->threads);
+    free(g->ready);
+    free(g->kernels);
+    free(g);
+}
+
+int
+kgen_default_num_thread(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+
+    if (n < 0) {
+        n = 0;
+    }
+    if (n > KGEN_WINDOW) {
+        n = KGEN_WINDOW;
+    }
+
+    return (int)n;
+}
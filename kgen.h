@@ -0,0 +1,74 @@
+#ifndef KGEN_H
+#define KGEN_H
+
+#include "bench.h"
+#include "kcache.h"
+
+/* kernel generation pipeline.
+ *
+ * worker threads generate every job with bench_gen(), each kernel in its
+ * own emitter. the measuring thread takes kernels in job order, so output
+ * order does not depend on number of workers. at most KGEN_WINDOW kernels
+ * are generated ahead of the one being measured.
+ * with kcache enabled, kernels are loaded from cache or stored to it.
+ */
+#define KGEN_WINDOW 16
+
+struct kgen_job {
+    const struct bench_desc *d;
+    int num_insn;
+    enum lt_op o;
+};
+
+struct kgen_kernel {
+    const struct kgen_job *job;
+    int cached;                 /* loaded from kcache */
+    struct ag_Emitter e;        /* !cached */
+    struct kcache_entry c;      /* cached */
+
+    void *code;                 /* published */
+    size_t code_size;
+    void *entry;                /* address to call (T32 : code | 1) */
+    double gen_ns;              /* bench_gen + ag_alloc_code (or kcache_load) on worker */
+};
+
+struct kgen_stat {
+    int num_kernel;
+    int num_cached;             /* loaded from kcache */
+    int num_thread;
+    double gen_ns;              /* sum of kgen_kernel::gen_ns */
+    double wait_ns;             /* measuring thread blocked in kgen_next */
+};
+
+struct kgen;
+
+/* jobs must live until kgen_destroy.
+ * num_thread : 0 generates each kernel in kgen_next on calling thread.
+ * avoid_cpu  : workers run on every online cpu but this one, -1 : no restriction.
+ */
+struct kgen *kgen_create(const struct kgen_job *jobs, int num_job,
+                         int num_loop, int num_thread, int avoid_cpu);
+
+/* next kernel in job order, blocks until generated. NULL after last job */
+struct kgen_kernel *kgen_next(struct kgen *g);
+
+/* kernel is no longer used, its code buffer is recycled */
+void kgen_release(struct kgen *g, struct kgen_kernel *k);
+
+/* generate one kernel on calling thread, through kcache like jobs.
+ * d NULL : bench_gen_empty(). k->job is not set. free with kgen_free
+ */
+void kgen_generate(struct kgen_kernel *k, const struct bench_desc *d,
+                   int num_loop, int num_insn, enum lt_op o);
+void kgen_free(struct kgen_kernel *k);
+
+/* same format as ag_write_symbol_map */
+void kgen_write_symbol_map(FILE *fp, struct kgen_kernel *k, const char *prefix);
+
+/* join workers, fill stat if not NULL */
+void kgen_destroy(struct kgen *g, struct kgen_stat *stat);
+
+/* default number of workers : online cpus - 1 (0 on single cpu) */
+int kgen_default_num_thread(void);
+
+#endif
@@ -1,425 +1,774 @@
-#include <unistd.h>
-#include <fcntl.h>
-#include <sys/syscall.h>
 #include <string.h>
 #include <stdio.h>
-#include <linux/perf_event.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <sched.h>
 #include "ag/ag_gen.h"
+#include "bench.h"
+#include "perf_counter.h"
+#include "measure.h"
+#include "output.h"
+#include "cpu.h"
+#include "memlat.h"
+#include "membw.h"
+#include "c2c.h"
+#include "mix.h"
+#include "kgen.h"
 
-static int
-perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
-                int cpu, int group_fd, unsigned long flags )
-{
-    int ret;
+#define NUM_LOOP (16384*8)
+#define MAX_NUM_INSN_LIST 32
 
-    ret = syscall( __NR_perf_event_open, hw_event, pid, cpu,
-                   group_fd, flags );
-    return ret;
-}
+static struct options {
+    struct npr_varray name_globs; /* const char * */
+    unsigned int mode_mask;       /* 1<<lt_op */
+    unsigned int regtype_mask;    /* 1<<regtype */
+
+    int num_loop;
+    int num_insn_list[MAX_NUM_INSN_LIST];
+    int num_num_insn;
+
+    int list_only;
+    int num_loop_set;           /* -l is given */
+
+    struct memlat_config memlat;
+    struct membw_config membw;
+    struct c2c_config c2c;
+
+    struct mix_config mix;
+    /* -x GLOB[:RATIO], resolved after all options (-r) */
+    char *mix_globs[MIX_MAX_ITEM];
+    int mix_ratios[MIX_MAX_ITEM];
+    int num_mix_spec;
+
+    int subtract_loop_overhead;
 
-static int perf_fd;
+    int num_gen_thread;         /* -j, -1 : kgen_default_num_thread() */
 
-static uint64_t
-read_cycle(void)
+    FILE *perf_map;             /* -P */
+} opt;
+
+/* -1 : not pinned */
+static int cur_cpu = -1;
+static int cur_cluster = -1;
+
+static int
+kernel_selected(const struct bench_desc *d, enum lt_op o)
 {
-    uint64_t ret;
-    ssize_t rsz = read(perf_fd, &ret, 8);
-    if (rsz != 8) {
-        perror("read perf");
-        exit(1);
+    if (! (opt.mode_mask & LT_MODE(o))) {
+        return 0;
+    }
+    if (! (opt.regtype_mask & (1U<<d->rt))) {
+        return 0;
     }
 
-    return ret;
+    if (opt.name_globs.nelem == 0) {
+        return 1;
+    }
+
+    for (size_t i=0; i<opt.name_globs.nelem; i++) {
+        if (fnmatch(VA_ELEM(const char*, &opt.name_globs, i), d->name, 0) == 0) {
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
-char __attribute__((aligned(64))) zero_mem[4096*8];
+/* run kernel generated by kgen */
+static void
+lt(struct kgen_kernel *k, int num_loop)
+{
+    const struct bench_desc *d = k->job->d;
 
-enum lt_op {
-    LT_LATENCY,
-    LT_THROUGHPUT,
-    LT_THROUGHPUT_RENAME
-};
+    if (opt.perf_map) {
+        kgen_write_symbol_map(opt.perf_map, k, d->name);
+        fflush(opt.perf_map);
+    }
 
-enum operand_type {
-    OT_INT,
-    OT_FP32,
-    OT_FP64,
-    OT_F32x1,
-    OT_F32x2,
-    OT_F32x4
-};
+#ifdef EMIT_ONLY
+    /* with -K, every kernel is in cache already */
+    if (! kcache_enabled()) {
+        FILE *fp = fopen("test.bin", "wb");
+        fwrite(k->code, 1, k->code_size, fp);
+        fclose(fp);
+    } else if (opt.subtract_loop_overhead) {
+        /* empty loop of bench_loop_baseline() too */
+        struct kgen_kernel b;
+        kgen_generate(&b, NULL, num_loop, k->job->num_insn, k->job->o);
+        kgen_free(&b);
+    }
+#else
+    typedef void (*func_t)(void);
+    int num_insn = k->job->num_insn;
+    enum lt_op o = k->job->o;
 
-enum regtype {
-    REG_GEN,
-    REG_NEON_64b,
-    REG_NEON_128b
-};
+#ifdef __ANDROID__
+    FILE *fp = fopen("/sdcard/test.bin", "wb");
+    fwrite(k->code, 1, k->code_size, fp);
+    fclose(fp);
+#endif
 
-static const char *regtype_name_table[] = {
-    "generic",
-    "neon64",
-    "neon128"
-};
+    struct measure_result r;
+    measure_run(&r, (func_t)k->entry);
+
+    if (opt.subtract_loop_overhead) {
+        measure_subtract(&r, bench_loop_baseline(num_loop, num_insn, o));
+    }
+
+    const double *c = r.counters;
+    double cycles = r.cycles.median;
+    double num_kernel_insn = (double)num_insn * num_loop;
+
+    output_row_begin();
+    output_label("regtype", "%8s", regtype_name_table[(int)d->rt]);
+    output_label("name", "%50s", d->name);
+    output_label("mode", "%15s", lt_op_name_table[(int)o]);
+    output_value("num_insn", NULL, num_insn);
+    output_value("num_loop", NULL, num_loop);
+    output_value("cpi", "CPI=%8.2f", cycles/num_kernel_insn);
+    output_value("ipc", "IPC=%8.2f", num_kernel_insn/cycles);
+    output_value("cpi_min", "min=%8.2f", r.cycles.min/num_kernel_insn);
+    output_value("cpi_p90", "p90=%8.2f", r.cycles.p90/num_kernel_insn);
+    output_value("cpi_mad", "MAD=%6.3f", r.cycles.mad/num_kernel_insn);
+    output_value("cv_percent", "CV=%5.2f%%", r.cycles.cv*100.0);
+
+    if (perf_counter_enabled(PC_INSTRUCTIONS)) {
+        output_value("retired_ipc", "retired IPC=%6.2f", c[PC_INSTRUCTIONS]/cycles);
+    }
+    if (perf_counter_enabled(PC_STALLED_FRONTEND)) {
+        output_value("fe_stall_percent", "FE stall=%5.1f%%", c[PC_STALLED_FRONTEND]*100.0/cycles);
+    }
+    if (perf_counter_enabled(PC_STALLED_BACKEND)) {
+        output_value("be_stall_percent", "BE stall=%5.1f%%", c[PC_STALLED_BACKEND]*100.0/cycles);
+    }
+    if (perf_counter_enabled(PC_BRANCH_MISSES)) {
+        output_value("br_miss_per_iter", "br-miss/iter=%6.3f", c[PC_BRANCH_MISSES]/(double)num_loop);
+    }
+    if (perf_counter_enabled(PC_L1D_MISSES)) {
+        output_value("l1d_miss_per_iter", "l1d-miss/iter=%6.3f", c[PC_L1D_MISSES]/(double)num_loop);
+    }
+    output_flag("unstable", r.unstable);
+    output_row_end();
+#endif
+}
 
-#define ZEROMEM_PTR_REG 11
 
-template <typename F>
 static void
-gen(struct ag_Emitter *e,
-    enum regtype rt, F f,
-    int num_loop, int num_insn, enum lt_op o, enum operand_type ot)
+run_all(void)
 {
-    /* A32 regisuter usage
-     * http://infocenter.arm.com/help/topic/com.arm.doc.ihi0042e/IHI0042E_aapcs.pdf
-     *
-     * r0, r1, r2, r3                 argument, scratch (caller save)
-     * r4, r5, r6, r7, r8, r10, r11   variable (callee save)
-     * r9                             platform (callee??)
-     * r13                            stack    (callee save)
-     * r14                            lr       (callee save)
-     */
+    const struct npr_varray *r = bench_registry();
+
+    if (opt.list_only) {
+        for (size_t ki=0; ki<r->nelem; ki++) {
+            const struct bench_desc *d = VA_ELEM(const struct bench_desc*, r, ki);
+            for (int o=0; o<LT_NUM_OP; o++) {
+                if ((d->modes & LT_MODE(o)) && kernel_selected(d, (enum lt_op)o)) {
+                    printf("%-8s %-10s %s\n", regtype_name_table[(int)d->rt], lt_op_name_table[o], d->name);
+                }
+            }
+        }
+        return;
+    }
+
+    /* whole sweep, generated ahead by kgen workers */
+    struct npr_varray jobs;
+    npr_varray_init(&jobs, 256, sizeof(struct kgen_job));
+
+    for (int ni=0; ni<opt.num_num_insn; ni++) {
+        for (size_t ki=0; ki<r->nelem; ki++) {
+            const struct bench_desc *d = VA_ELEM(const struct bench_desc*, r, ki);
+            for (int o=0; o<LT_NUM_OP; o++) {
+                if ((d->modes & LT_MODE(o)) && kernel_selected(d, (enum lt_op)o)) {
+                    struct kgen_job j;
+                    j.d = d;
+                    j.num_insn = opt.num_insn_list[ni];
+                    j.o = (enum lt_op)o;
+                    VA_PUSH(struct kgen_job, &jobs, j);
+                }
+            }
+        }
+    }
+
+    int num_thread = opt.num_gen_thread;
+    if (num_thread < 0) {
+        num_thread = kgen_default_num_thread();
+    }
 
-    /* r0-r9 : operand register
-     * r10 : loop counter
-     * r11 : ptr to zero mem
+    /* measuring thread stays on one cpu, workers are kept off it.
+     * without -c, the cpu it is running on now
      */
+    if (cur_cpu < 0) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0 && cpu_pin(cpu) == 0) {
+            cur_cpu = cpu;
+            output_set_context("cpu", cur_cpu);
+        } else {
+            fprintf(stderr, "cannot pin measuring thread, generator threads may share its cpu\n");
+        }
+    }
+
+    struct kgen *g = kgen_create((const struct kgen_job*)jobs.elements, jobs.nelem,
+                                 opt.num_loop, num_thread, cur_cpu);
+    struct kgen_kernel *k;
+    int cur_num_insn = -1;
 
-    /* save r4-r11 */
-    /*                            109876543210 */
-    ag_emit_push(e, AG_COND_AL, 0b111111110000);
-    ag_emit_movldr_imm(e, AG_COND_AL, 10, num_loop);
-    ag_emit_movldr_imm(e, AG_COND_AL, ZEROMEM_PTR_REG, (uintptr_t)&zero_mem);
+    while ((k = kgen_next(g)) != NULL) {
+        if (k->job->num_insn != cur_num_insn) {
+            cur_num_insn = k->job->num_insn;
+            output_comment("== num_insn = %d ==", cur_num_insn);
+        }
+
+        lt(k, opt.num_loop);
+        kgen_release(g, k);
+    }
 
-    for (int i=0; i<10; i++) {
-        ag_emit_movldr_imm(e, AG_COND_AL, i, 0);
+    struct kgen_stat st;
+    kgen_destroy(g, &st);
+    npr_varray_discard(&jobs);
+
+    output_comment("generated %d kernels (%d from cache) on %d threads : %.2f ms, measurement waited %.2f ms",
+                   st.num_kernel, st.num_cached, st.num_thread, st.gen_ns*1e-6, st.wait_ns*1e-6);
+}
+
+static void
+run_memlat(void)
+{
+    if (opt.num_loop_set) {
+        opt.memlat.num_loop = opt.num_loop;
     }
 
-    for (int i=0; i<16; i++) {
-        ag_emit_vdup32(e, AG_COND_AL, 1, i*2, 0);
+    memlat_run(&opt.memlat);
+}
+
+static void
+run_membw(void)
+{
+    opt.membw.cluster = cur_cluster;
+    membw_run(&opt.membw);
+}
+
+static void
+run_c2c(void)
+{
+    if (opt.num_loop_set) {
+        opt.c2c.num_loop = opt.num_loop;
     }
 
+    opt.c2c.cluster = cur_cluster;
+    opt.c2c.max_thread = opt.membw.max_thread;
+    c2c_run(&opt.c2c);
+}
 
-    ag_label_id_t loop_head = ag_emit_new_label(e, NULL);
+/* first registered kernel which matches glob (and -r) */
+static const struct bench_desc *
+lookup_kernel(const char *glob)
+{
+    const struct npr_varray *r = bench_registry();
 
-    switch (o) {
-    case LT_LATENCY:
-        for (int ii=0; ii<num_insn; ii++) {
-            f(e, 0, 0);
+    for (size_t ki=0; ki<r->nelem; ki++) {
+        const struct bench_desc *d = VA_ELEM(const struct bench_desc*, r, ki);
+        if ((opt.regtype_mask & (1U<<d->rt)) && fnmatch(glob, d->name, 0) == 0) {
+            return d;
         }
-        break;
-
-    case LT_THROUGHPUT:
-        for (int ii=0; ii<num_insn/8; ii++) {
-            f(e, 0, 1);
-            f(e, 0, 2);
-            f(e, 0, 3);
-            f(e, 0, 4);
-
-            f(e, 0, 5);
-            f(e, 0, 6);
-            f(e, 0, 7);
-            f(e, 0, 8);
+    }
+
+    return NULL;
+}
+
+static void
+run_mix(void)
+{
+    struct mix_config *c = &opt.mix;
+
+    if (opt.num_mix_spec == 0) {
+        fprintf(stderr, "mix : no kernel. use -x GLOB[:RATIO]\n");
+        exit(1);
+    }
+
+    c->num_item = 0;
+    for (int i=0; i<opt.num_mix_spec; i++) {
+        const struct bench_desc *d = lookup_kernel(opt.mix_globs[i]);
+        if (d == NULL) {
+            fprintf(stderr, "-x : no kernel matches '%s'\n", opt.mix_globs[i]);
+            exit(1);
         }
-        break;
-
-    case LT_THROUGHPUT_RENAME:
-        for (int ii=0; ii<num_insn/8; ii++) {
-            f(e, 0, 0);
-            f(e, 1, 1);
-            f(e, 2, 2);
-            f(e, 3, 3);
-
-            f(e, 4, 4);
-            f(e, 5, 5);
-            f(e, 6, 6);
-            f(e, 7, 7);
+
+        c->items[c->num_item].d = d;
+        c->items[c->num_item].ratio = opt.mix_ratios[i];
+        c->num_item++;
+    }
+
+    c->num_loop = opt.num_loop;
+    c->subtract_loop_overhead = opt.subtract_loop_overhead;
+
+    /* largest of -n */
+    c->num_insn = 0;
+    for (int i=0; i<opt.num_num_insn; i++) {
+        if (opt.num_insn_list[i] > c->num_insn) {
+            c->num_insn = opt.num_insn_list[i];
         }
-        break;
     }
 
+    mix_run(c);
+}
+
+static const struct suite {
+    const char *name;
+    void (*run)(void);
+} suite_table[] = {
+    {"insn", run_all},
+    {"memlat", run_memlat},
+    {"membw", run_membw},
+    {"c2c", run_c2c},
+    {"mix", run_mix},
+};
 
-    ag_emit_sub_imm(e, AG_COND_AL, 1, 10, 10, 1);
-    ag_emit_b(e, AG_COND_NE, loop_head);
+#define NUM_SUITE (int)(sizeof(suite_table)/sizeof(suite_table[0]))
 
-    ag_emit_pop(e, AG_COND_AL, 0b111111110000);
+static const struct suite *
+lookup_suite(const char *name)
+{
+    for (int i=0; i<NUM_SUITE; i++) {
+        if (strcmp(suite_table[i].name, name) == 0) {
+            return &suite_table[i];
+        }
+    }
+
+    fprintf(stderr, "-S : unknown suite '%s'. available suites :", name);
+    for (int i=0; i<NUM_SUITE; i++) {
+        fprintf(stderr, " %s", suite_table[i].name);
+    }
+    fprintf(stderr, "\n");
+    exit(1);
+}
 
-    ag_emit_bx(e, AG_COND_AL, AG_LR);
+static void
+usage(const char *prog)
+{
+    printf("usage : %s [options]\n"
+           "  -S SUITE     insn (default), memlat, membw, c2c, mix\n"
+           "\n"
+           "insn suite :\n"
+           "  -k GLOB      run kernels whose name matches GLOB (may be repeated)\n"
+           "  -m MODES     comma separated list of latency,throughput,rename\n"
+           "  -r REGTYPES  comma separated list of %s,%s,%s,%s\n"
+           "  -n LIST      comma separated list of num_insn (default 16,32,64,128,256)\n"
+           "  -L           list selected kernels and exit\n"
+           "  -P           append symbol map of generated kernels to /tmp/perf-PID.map\n"
+           "               (kernels reuse buffers, perf attributes samples to latest map entry)\n"
+           "  -j THREADS   kernel generator threads, 0 : generate on measuring thread\n"
+           "               (default online cpus - 1, max %d)\n"
+           "  -K DIR       load kernels from cache directory DIR, store generated ones to it\n"
+           "               (EMIT_ONLY build : fill DIR instead of writing test.bin)\n"
+           "               empty loop for overhead subtraction is cached too, unless -R.\n"
+           "               mix suite kernels are not cached, they need exec memory\n"
+           "\n"
+           "mix suite :\n"
+           "  -x GLOB[:RATIO]  add first kernel matching GLOB (and -r) with RATIO (default 1).\n"
+           "               repeat for each kernel. loop body is largest of -n\n"
+           "\n"
+           "insn, mix suite :\n"
+           "  -R           do not subtract empty loop overhead\n"
+           "\n"
+           "memlat suite :\n"
+           "  -M SIZE      max footprint, K/M/G suffix allowed (default %dM)\n"
+           "  -s STRIDE    distance between nodes in bytes (default %d)\n"
+           "\n"
+           "membw suite :\n"
+           "  -B SIZES     comma separated list of array size per thread (default %s)\n"
+           "\n"
+           "membw, c2c suite :\n"
+           "  -T THREADS   max number of threads, run with 1..THREADS (default all cpus, or cpus of cluster with -C)\n"
+           "\n"
+           "common :\n"
+           "  -l NUM_LOOP  loop count of each kernel (default %d, memlat %d, c2c %d)\n"
+           "  -f FORMAT    output format : text, csv, json (default text)\n"
+           "  -e EVENTS    perf events (default %s)\n"
+           "  -N REP       timed repetitions per kernel (default %d)\n"
+           "  -c CPU       pin to CPU (insn suite default : cpu it starts on)\n"
+           "  -C           run on one cpu of each core type (same MIDR and cpu_capacity)\n"
+           "  -h           show this message\n",
+           prog,
+           regtype_name_table[REG_GEN], regtype_name_table[REG_NEON_64b],
+           regtype_name_table[REG_NEON_128b], regtype_name_table[REG_SIMD_256b],
+           KGEN_WINDOW,
+           MEMLAT_DEFAULT_MAX_SIZE/(1024*1024), MEMLAT_DEFAULT_STRIDE,
+           MEMBW_DEFAULT_SIZE_LIST,
+           NUM_LOOP, MEMLAT_DEFAULT_NUM_LOOP, C2C_DEFAULT_NUM_LOOP,
+           PERF_COUNTER_DEFAULT_EVENTS, measure_config.num_rep);
 }
 
+/* parse comma separated names into bitmask of indices into table */
+static unsigned int
+parse_name_list(const char *opt_name, const char *list, const char **table, int num_table)
+{
+    unsigned int ret = 0;
+    const char *p = list;
+
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        int found = 0;
+
+        for (int i=0; i<num_table; i++) {
+            if (strlen(table[i]) == len && strncmp(table[i], p, len) == 0) {
+                ret |= 1U<<i;
+                found = 1;
+            }
+        }
+
+        if (len && !found) {
+            fprintf(stderr, "%s : unknown name '%.*s'\n", opt_name, (int)len, p);
+            exit(1);
+        }
 
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    return ret;
+}
 
-template <typename F>
-void
-lt(const char *name,
-   const char *on,
-   enum regtype rt, F f,
-   int num_loop,
-   int num_insn,
-   enum lt_op o,
-   enum operand_type ot)
+static int
+parse_positive_int(const char *opt_name, const char *s)
 {
-    struct ag_Emitter e;
-    ag_emitter_init(&e);
+    char *end;
+    long v = strtol(s, &end, 0);
 
-    gen(&e, rt, f, num_loop, num_insn, o, ot);
+    if (*s == '\0' || *end != '\0' || v <= 0 || v > 0x7fffffff) {
+        fprintf(stderr, "%s : invalid number '%s'\n", opt_name, s);
+        exit(1);
+    }
 
-    void *code;
-    size_t code_size;
+    return (int)v;
+}
 
-    ag_alloc_code(&code, &code_size, &e);
+/* "64", "32K", "256M", "1G" */
+static size_t
+parse_size(const char *opt_name, const char *s)
+{
+    char *end;
+    unsigned long long v = strtoull(s, &end, 0);
+
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    default: break;
+    }
 
-#ifdef EMIT_ONLY
-    FILE *fp = fopen("test.bin", "wb");
-    fwrite(code, 1, code_size, fp);
-    fclose(fp);
-#else
-    typedef void (*func_t)(void);
+    if (*s == '\0' || *end != '\0' || v == 0 || v > (size_t)-1) {
+        fprintf(stderr, "%s : invalid size '%s'\n", opt_name, s);
+        exit(1);
+    }
 
-#ifdef __ANDROID__
-    FILE *fp = fopen("/sdcard/test.bin", "wb");
-    fwrite(code, 1, code_size, fp);
-    fclose(fp);
-#endif
+    return (size_t)v;
+}
 
-    func_t exec = (func_t)code;
-    exec();
+static void
+parse_size_list(const char *list)
+{
+    char buf[32];
+    const char *p = list;
 
-    uint64_t tb = read_cycle();
-    exec();
-    uint64_t te = read_cycle();
+    opt.membw.num_size = 0;
 
-    printf("%8s : %50s : %15s : CPI=%8.2f, IPC=%8.2f\n",
-           regtype_name_table[(int)rt],
-           name, on,
-           (te-tb)/(double)(num_insn * num_loop), 
-           (num_insn * num_loop)/(double)(te-tb));
-#endif
+    while (*p) {
+        size_t len = strcspn(p, ",");
 
+        if (len) {
+            if (len >= sizeof(buf) || opt.membw.num_size == MEMBW_MAX_SIZE) {
+                fprintf(stderr, "-B : invalid list '%s'\n", list);
+                exit(1);
+            }
 
-    ag_emitter_fini(&e);
-}
+            memcpy(buf, p, len);
+            buf[len] = '\0';
+            opt.membw.size_list[opt.membw.num_size++] = parse_size("-B", buf);
+        }
 
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
 
-#define NUM_LOOP (16384*8)
+    if (opt.membw.num_size == 0) {
+        fprintf(stderr, "-B : empty list\n");
+        exit(1);
+    }
+}
 
-template <typename F>
-void
-run(const char *name, enum regtype rt, F f, enum operand_type ot, int num_insn)
+/* "GLOB[:RATIO]" */
+static void
+parse_mix_spec(const char *spec)
 {
-    lt(name, "latency", rt, f, NUM_LOOP, num_insn, LT_LATENCY, ot);
-    lt(name, "throughput", rt, f, NUM_LOOP, num_insn, LT_THROUGHPUT, ot);
-    lt(name, "rename", rt, f, NUM_LOOP, num_insn, LT_THROUGHPUT_RENAME, ot);
+    if (opt.num_mix_spec == MIX_MAX_ITEM) {
+        fprintf(stderr, "-x : too many kernels (max %d)\n", MIX_MAX_ITEM);
+        exit(1);
+    }
+
+    const char *colon = strrchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+    opt.mix_globs[opt.num_mix_spec] = strndup(spec, len);
+    opt.mix_ratios[opt.num_mix_spec] = colon ? parse_positive_int("-x", colon+1) : 1;
+    opt.num_mix_spec++;
 }
 
-template <typename F>
-void
-run_latency(const char *name, enum regtype rt, F f, enum operand_type ot, int num_insn)
+static int
+parse_cpu(const char *opt_name, const char *s)
 {
-    lt(name, "latency", rt, f, NUM_LOOP, num_insn, LT_LATENCY, ot);
+    char *end;
+    long v = strtol(s, &end, 0);
+
+    if (*s == '\0' || *end != '\0' || v < 0 || v >= CPU_SETSIZE) {
+        fprintf(stderr, "%s : invalid cpu '%s'\n", opt_name, s);
+        exit(1);
+    }
+
+    return (int)v;
 }
 
-template <typename F>
-void
-run_throughput(const char *name, enum regtype rt, F f, enum operand_type ot, int num_insn)
+static void
+parse_num_insn_list(const char *list)
 {
-    lt(name, "throughput", rt, f, NUM_LOOP, num_insn, LT_THROUGHPUT_RENAME, ot);
-    lt(name, "rename", rt, f, NUM_LOOP, num_insn, LT_THROUGHPUT_RENAME, ot);
-}
+    char buf[32];
+    const char *p = list;
+
+    opt.num_num_insn = 0;
 
-#define GEN(rt, name, expr, ot)                                          \
-    run(                                                                \
-    name,                                                               \
-    rt,                                                                 \
-    [](struct ag_Emitter *e, int dst, int src){expr;},                  \
-    ot, num_insn);
+    while (*p) {
+        size_t len = strcspn(p, ",");
 
+        if (len) {
+            if (len >= sizeof(buf) || opt.num_num_insn == MAX_NUM_INSN_LIST) {
+                fprintf(stderr, "-n : invalid list '%s'\n", list);
+                exit(1);
+            }
 
-#define GEN_latency(rt, name, expr, ot)                               \
-    run_latency(                                                        \
-        name,                                                           \
-        rt,                                                             \
-        [](struct ag_Emitter *e, int dst, int src){expr;},              \
-        ot, num_insn);
+            memcpy(buf, p, len);
+            buf[len] = '\0';
+            opt.num_insn_list[opt.num_num_insn++] = parse_positive_int("-n", buf);
+        }
+
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
 
-#define GEN_throughput(rt, name, expr, ot)                               \
-    run_throughput(                                                     \
-        name,                                                           \
-        rt,                                                             \
-        [](struct ag_Emitter *e, int dst, int src){expr;},              \
-        ot, num_insn);
+    if (opt.num_num_insn == 0) {
+        fprintf(stderr, "-n : empty list\n");
+        exit(1);
+    }
+}
 
 int
-main()
+main(int argc, char **argv)
 {
-    struct perf_event_attr attr;
+    const char *events = NULL;
+    const struct suite *suite = &suite_table[0];
+    int per_core = 0;
+    int c;
+
+    npr_varray_init(&opt.name_globs, 4, sizeof(const char*));
+    opt.mode_mask = ~0U;
+    opt.regtype_mask = ~0U;
+    opt.num_loop = NUM_LOOP;
+    opt.list_only = 0;
+    opt.num_loop_set = 0;
+
+    opt.memlat.min_size = MEMLAT_DEFAULT_MIN_SIZE;
+    opt.memlat.max_size = MEMLAT_DEFAULT_MAX_SIZE;
+    opt.memlat.stride = MEMLAT_DEFAULT_STRIDE;
+    opt.memlat.num_loop = MEMLAT_DEFAULT_NUM_LOOP;
+
+    parse_size_list(MEMBW_DEFAULT_SIZE_LIST);
+    opt.membw.max_thread = 0;
+    opt.membw.cluster = -1;
+    opt.membw.bytes_per_run = MEMBW_DEFAULT_BYTES_PER_RUN;
+
+    opt.c2c.num_loop = C2C_DEFAULT_NUM_LOOP;
+
+    opt.num_mix_spec = 0;
+    opt.subtract_loop_overhead = 1;
+    opt.num_gen_thread = -1;
+
+    opt.num_num_insn = 0;
+    for (int n=16; n<=256; n*=2) {
+        opt.num_insn_list[opt.num_num_insn++] = n;
+    }
 
-    memset(&attr, 0, sizeof(attr));
+    while ((c = getopt(argc, argv, "S:k:m:r:l:n:f:e:N:c:M:s:B:T:x:j:K:CRLPh")) != -1) {
+        switch (c) {
+        case 'S':
+            suite = lookup_suite(optarg);
+            break;
+        case 'k':
+            VA_PUSH(const char*, &opt.name_globs, optarg);
+            break;
+        case 'm':
+            opt.mode_mask = parse_name_list("-m", optarg, lt_op_name_table, LT_NUM_OP);
+            break;
+        case 'r':
+            opt.regtype_mask = parse_name_list("-r", optarg, regtype_name_table, REG_NUM_TYPE);
+            break;
+        case 'l':
+            opt.num_loop = parse_positive_int("-l", optarg);
+            opt.num_loop_set = 1;
+            break;
+        case 'n':
+            parse_num_insn_list(optarg);
+            break;
+        case 'f':
+            if (output_set_format(optarg) < 0) {
+                fprintf(stderr, "-f : unknown format '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'e':
+            events = optarg;
+            break;
+        case 'N':
+            measure_config.num_rep = parse_positive_int("-N", optarg);
+            break;
+        case 'c':
+            cur_cpu = parse_cpu("-c", optarg);
+            break;
+        case 'M':
+            opt.memlat.max_size = parse_size("-M", optarg);
+            break;
+        case 's':
+            opt.memlat.stride = parse_size("-s", optarg);
+            break;
+        case 'B':
+            parse_size_list(optarg);
+            break;
+        case 'T':
+            opt.membw.max_thread = parse_positive_int("-T", optarg);
+            break;
+        case 'x':
+            parse_mix_spec(optarg);
+            break;
+        case 'j': {
+            char *end;
+            long v = strtol(optarg, &end, 0);
+            if (*optarg == '\0' || *end != '\0' || v < 0 || v > 1024) {
+                fprintf(stderr, "-j : invalid number '%s'\n", optarg);
+                exit(1);
+            }
+            opt.num_gen_thread = (int)v;
+            break;
+        }
+        case 'K':
+            if (kcache_open(optarg) < 0) {
+                exit(1);
+            }
+            break;
+        case 'C':
+            per_core = 1;
+            break;
+        case 'R':
+            opt.subtract_loop_overhead = 0;
+            break;
+        case 'L':
+            opt.list_only = 1;
+            break;
+        case 'P': {
+            char path[64];
+            snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+            opt.perf_map = fopen(path, "a");
+            if (opt.perf_map == NULL) {
+                perror(path);
+                return 1;
+            }
+            break;
+        }
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
 
-    attr.type = PERF_TYPE_HARDWARE;
-    attr.size = sizeof(attr);
-    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    if (opt.list_only) {
+        run_all();
+        return 0;
+    }
 
-    perf_fd = perf_event_open(&attr, 0, -1, -1, 0);
-    if (perf_fd == -1) {
-        perror("perf_event_open");
-        exit(1);
+    if (per_core) {
+        struct npr_varray cpus;
+        int num_cluster = cpu_list_online(&cpus);
+
+        for (int ci=0; ci<num_cluster; ci++) {
+            struct cpu_info *rep = NULL;
+            char cpu_list[1024];
+            int len = 0;
+
+            cpu_list[0] = '\0';
+            for (size_t i=0; i<cpus.nelem; i++) {
+                struct cpu_info *info = VA_ELEM_PTR(struct cpu_info, &cpus, i);
+                if (info->cluster != ci) {
+                    continue;
+                }
+                if (rep == NULL) {
+                    rep = info;
+                }
+                if (len < (int)sizeof(cpu_list)) {
+                    len += snprintf(cpu_list + len, sizeof(cpu_list) - len,
+                                    "%s%d", len?",":"", info->cpu);
+                }
+            }
+
+            if (cpu_pin(rep->cpu) < 0) {
+                fprintf(stderr, "cannot pin to cpu %d, cluster %d skipped\n", rep->cpu, ci);
+                continue;
+            }
+
+            cur_cpu = rep->cpu;
+            cur_cluster = ci;
+            output_set_context("cpu", cur_cpu);
+            output_set_context("cluster", cur_cluster);
+
+            output_comment("==== cluster %d : cpu %s, midr=0x%08llx, capacity=%d ====",
+                           ci, cpu_list, (unsigned long long)rep->midr, rep->capacity);
+
+            /* counters and loop overhead belong to the core type */
+#ifndef EMIT_ONLY
+            perf_counter_open(events);
+            bench_loop_baseline_clear();
+#endif
+            suite->run();
+            ag_code_arena_trim();
+#ifndef EMIT_ONLY
+            perf_counter_close();
+#endif
+        }
+
+        npr_varray_discard(&cpus);
+        return 0;
     }
 
-    int num_insn = 16;
-    while (num_insn <= 256) {
-        printf("== num_insn = %d ==\n", num_insn);
-
-        GEN(REG_GEN, "add rd, rm, rn",
-            ag_emit_add_reg(e, AG_COND_AL, 0, dst, src, src, 0),
-            OT_INT);
-
-        GEN(REG_GEN, "adds rd, rm, rn",
-            ag_emit_add_reg(e, AG_COND_AL, 1, dst, src, src, 0),
-            OT_INT);
-
-        GEN(REG_GEN, "add rd, rm, rn, lsl #4",
-            ag_emit_add_reg(e, AG_COND_AL, 1, dst, src, src, AG_LSL_AM(4)),
-            OT_INT);
-
-        GEN(REG_GEN, "add rd, rm, imm",
-            ag_emit_add_imm(e, AG_COND_AL, 0, dst, src, 100),
-            OT_INT);
-
-        GEN(REG_GEN, "add rd, rm, pc",
-            ag_emit_add_reg(e, AG_COND_AL, 0, dst, src, AG_PC, AG_LSL_AM(4)),
-            OT_INT);
-
-        GEN_latency(REG_GEN, "add pc, pc, 0",
-                    ag_emit_add_imm(e, AG_COND_AL, 0, AG_PC, AG_PC, 0),
-                    OT_INT);
-
-        GEN(REG_GEN, "orr rd, rm, rn",
-            ag_emit_orr_reg(e, AG_COND_AL, 0, dst, src, src, 0),
-            OT_INT);
-
-        GEN(REG_GEN, "eor rd, rm, rn",
-            ag_emit_orr_reg(e, AG_COND_AL, 0, dst, src, src, 0),
-            OT_INT);
-
-        GEN(REG_GEN, "mul rd, rm, rs",
-            ag_emit_mul(e, AG_COND_AL, 0, dst, src, src),
-            OT_INT);
-
-        GEN(REG_GEN, "mla rd, rm, rs, rn",
-            ag_emit_mla(e, AG_COND_AL, 0, dst, src, src, src),
-            OT_INT);
-
-        GEN(REG_GEN, "ldr rt, [rn, rm]",
-            ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, src, 0, 1, AG_OFFSET_ADDR),
-            OT_INT);
-
-        GEN(REG_GEN, "ldr rt, [rn, rm, lsl #4]",
-            ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, src, AG_LSL_AM(4), 1, AG_OFFSET_ADDR),
-            OT_INT);
-
-        GEN_throughput(REG_GEN, "ldm rt, {r0}",
-                       ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b1),
-                       OT_INT);
-
-        GEN_throughput(REG_GEN, "ldm rt, {r0-r3}",
-                       ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b1111),
-                       OT_INT);
-
-        GEN_throughput(REG_GEN, "ldm rt, {r0-r7}",
-                       ag_emit_ldmia(e, AG_COND_AL, 0, ZEROMEM_PTR_REG, 0b11111111),
-                       OT_INT);
-
-        GEN_throughput(REG_GEN, "ldrex rd, [rn]",
-                       ag_emit_ldrex(e, AG_COND_AL, 0, ZEROMEM_PTR_REG),
-                       OT_INT);
-        GEN_throughput(REG_GEN, "strex rd, rm, [rn]",
-                       ag_emit_strex(e, AG_COND_AL, 0, 1, ZEROMEM_PTR_REG),
-                       OT_INT);
-
-        GEN_throughput(REG_GEN, "ldrex r0, [rn]; strex rd, r0, [rn] ",
-                       ag_emit_ldrex(e, AG_COND_AL, 0, ZEROMEM_PTR_REG);
-                       ag_emit_strex(e, AG_COND_AL, 1, 0, ZEROMEM_PTR_REG),
-                       OT_INT);
-
-        GEN_throughput(REG_GEN, "str rt, [rn, #0]",
-                       ag_emit_str_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 0, 0),
-                       OT_INT);
-
-
-        GEN_latency(REG_GEN, "{str->ldr}->...",
-                    ag_emit_str_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 0, 0);
-                    ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, dst, 0, 1, AG_OFFSET_ADDR),
-                    OT_INT);
-
-        GEN_latency(REG_GEN, "{strb->ldr}->...",
-                    ag_emit_strb_imm(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, 1, 0);
-                    ag_emit_ldr_reg(e, AG_COND_AL, dst, ZEROMEM_PTR_REG, dst, 0, 1, AG_OFFSET_ADDR),
-                    OT_INT);
-
-        GEN(REG_NEON_64b, "vadd.f32 d, d, d",
-            ag_emit_vadd_f32(e, 0, dst, src, src),
-            OT_F32x2);
-        GEN(REG_NEON_128b, "vadd.f32 q, q, q",
-            ag_emit_vadd_f32(e, 1, dst, src, src),
-            OT_F32x4);
-
-        GEN(REG_NEON_64b, "vmul.f32 d, d, d",
-            ag_emit_vmul_f32(e, 0, dst, src, src),
-            OT_F32x2);
-        GEN(REG_NEON_128b, "vmul.f32 q, q, q",
-            ag_emit_vmul_f32(e, 1, dst, src, src),
-            OT_F32x4);
-
-        GEN(REG_NEON_64b, "vmul.f32 d, d, d",
-            ag_emit_vmul_f32(e, 0, dst, src, src),
-            OT_F32x2);
-        GEN(REG_NEON_128b, "vmul.f32 q, q, q",
-            ag_emit_vmul_f32(e, 1, dst, src, src),
-            OT_F32x4);
-
-        GEN(REG_NEON_64b, "vmla.f32 d, d, d",
-            ag_emit_vmla_f32(e, 0, dst, src, src),
-            OT_F32x2);
-        GEN(REG_NEON_128b, "vmla.f32 q, q, q",
-            ag_emit_vmla_f32(e, 1, dst, src, src),
-            OT_F32x4);
-
-        GEN_throughput(REG_NEON_64b, "vld1.32 d, [rn]",
-                       ag_emit_vld1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x1);
-        GEN_throughput(REG_NEON_64b, "vld2.32 d, [rn]",
-                       ag_emit_vld2_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x2);
-        GEN_throughput(REG_NEON_128b, "vld4.32 q, [rn]",
-                       ag_emit_vld4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x4);
-
-        GEN_throughput(REG_NEON_64b, "vst1.32 d, [rn]",
-                       ag_emit_vst1_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x1);
-        GEN_throughput(REG_NEON_64b, "vst2.32 d, [rn]",
-                       ag_emit_vst2_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x2);
-        GEN_throughput(REG_NEON_128b, "vst4.32 q, [rn]",
-                       ag_emit_vst4_32(e, dst, ZEROMEM_PTR_REG, 15, 0),
-                       OT_F32x4);
-
-        GEN_throughput(REG_NEON_64b, "vcvt.f32.s32 d, d",
-                       ag_emit_vcvt_f32_s32(e, 0, dst, src),
-                       OT_F32x2);
-        GEN_throughput(REG_NEON_128b, "vcvt.f32.s32 q, q",
-                       ag_emit_vcvt_f32_s32(e, 1, dst*2, src*2),
-                       OT_F32x4);
-
-        GEN_throughput(REG_NEON_64b, "vcvt.s32.f32 d, d",
-                       ag_emit_vcvt_s32_f32(e, 0, dst, src),
-                       OT_F32x2);
-        GEN_throughput(REG_NEON_128b, "vcvt.s32.f32 q, q",
-                       ag_emit_vcvt_s32_f32(e, 1, dst*2, src*2),
-                       OT_F32x4);
-
-        num_insn *= 2;
+    if (cur_cpu >= 0 && cpu_pin(cur_cpu) < 0) {
+        perror("sched_setaffinity");
+        exit(1);
     }
-}
 
+    output_set_context("cpu", cur_cpu);
+    output_set_context("cluster", cur_cluster);
+
+#ifndef EMIT_ONLY
+    perf_counter_open(events);
+#else
+    (void)events;               /* nothing is measured */
+#endif
+    suite->run();
+    ag_code_arena_trim();
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "measure.h"
+
+#define MAX_REP 1024
+
+struct measure_config measure_config = {
+    11,                         /* num_rep */
+    1,                          /* min_warmup */
+    32,                         /* max_warmup */
+    0.02,                       /* warmup_tolerance */
+    3.0,                        /* outlier_mad */
+    0.05,                       /* cv_threshold */
+};
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double da = *(const double*)a;
+    double db = *(const double*)b;
+
+    if (da < db) {
+        return -1;
+    } else if (da > db) {
+        return 1;
+    }
+    return 0;
+}
+
+static double
+sorted_median(const double *v, int n)
+{
+    if (n & 1) {
+        return v[n/2];
+    }
+
+    return (v[n/2-1] + v[n/2]) / 2.0;
+}
+
+void
+measure_compute_stat(struct measure_stat *ret, double *v, int n)
+{
+    double dev[MAX_REP];
+
+    qsort(v, n, sizeof(double), cmp_double);
+
+    ret->min = v[0];
+    ret->median = sorted_median(v, n);
+    ret->p90 = v[(n*9 + 9)/10 - 1];
+
+    for (int i=0; i<n; i++) {
+        dev[i] = fabs(v[i] - ret->median);
+    }
+    qsort(dev, n, sizeof(double), cmp_double);
+    ret->mad = sorted_median(dev, n);
+
+    double limit = ret->mad * measure_config.outlier_mad;
+    double sum = 0, sum2 = 0;
+    int num_inlier = 0;
+
+    for (int i=0; i<n; i++) {
+        if (ret->mad != 0 && fabs(v[i] - ret->median) > limit) {
+            continue;
+        }
+        sum += v[i];
+        sum2 += v[i] * v[i];
+        num_inlier++;
+    }
+
+    ret->num_outlier = n - num_inlier;
+    ret->mean = sum / num_inlier;
+
+    double var = sum2/num_inlier - ret->mean*ret->mean;
+    if (var < 0) {
+        var = 0;
+    }
+
+    if (ret->mean > 0) {
+        ret->cv = sqrt(var) / ret->mean;
+    } else {
+        ret->cv = 0;
+    }
+}
+
+double
+measure_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double
+run1(measure_func_t f, struct perf_counter_values *d, double *ns)
+{
+    struct perf_counter_values vb, ve;
+
+    double tb = measure_now_ns();
+    perf_counter_read(&vb);
+    f();
+    perf_counter_read(&ve);
+    double te = measure_now_ns();
+    perf_counter_sub(d, &ve, &vb);
+
+    *ns = te - tb;
+
+    return (double)d->v[PC_CYCLES];
+}
+
+static int
+warmup_stable(const double *last)
+{
+    double lo = last[0], hi = last[0];
+
+    for (int i=1; i<3; i++) {
+        if (last[i] < lo) lo = last[i];
+        if (last[i] > hi) hi = last[i];
+    }
+
+    return (hi - lo) <= lo * measure_config.warmup_tolerance;
+}
+
+void
+measure_run(struct measure_result *r, measure_func_t f)
+{
+    struct perf_counter_values d;
+    double ns;
+    int num_rep = measure_config.num_rep;
+
+    if (num_rep < 1) {
+        num_rep = 1;
+    }
+    if (num_rep > MAX_REP) {
+        num_rep = MAX_REP;
+    }
+
+    /* warm up until 3 consecutive runs agree */
+    double last[3] = {0, 0, 0};
+    int nw = 0;
+    while (nw < measure_config.max_warmup) {
+        last[nw%3] = run1(f, &d, &ns);
+        nw++;
+
+        if (nw >= 3 && nw >= measure_config.min_warmup && warmup_stable(last)) {
+            break;
+        }
+    }
+    r->num_warmup = nw;
+
+    static double samples[PC_NUM_EVENT][MAX_REP];
+    static double ns_samples[MAX_REP];
+
+    int scaled = 0;
+    for (int ri=0; ri<num_rep; ri++) {
+        run1(f, &d, &ns_samples[ri]);
+        scaled |= d.scaled;
+
+        for (int ei=0; ei<PC_NUM_EVENT; ei++) {
+            samples[ei][ri] = (double)d.v[ei];
+        }
+    }
+
+    measure_compute_stat(&r->cycles, samples[PC_CYCLES], num_rep);
+    measure_compute_stat(&r->ns, ns_samples, num_rep);
+
+    for (int ei=0; ei<PC_NUM_EVENT; ei++) {
+        if (ei == PC_CYCLES) {
+            r->counters[ei] = r->cycles.median;
+        } else {
+            qsort(samples[ei], num_rep, sizeof(double), cmp_double);
+            r->counters[ei] = sorted_median(samples[ei], num_rep);
+        }
+    }
+
+    r->num_rep = num_rep;
+    /* multiplexed counts are estimates */
+    r->unstable = r->cycles.cv > measure_config.cv_threshold || scaled;
+}
+
+static double
+sub_clamp(double v, double base)
+{
+    if (v < base) {
+        return 0;
+    }
+    return v - base;
+}
+
+void
+measure_subtract(struct measure_result *r, const struct measure_result *base)
+{
+    double b = base->cycles.median;
+
+    r->cycles.min = sub_clamp(r->cycles.min, b);
+    r->cycles.median = sub_clamp(r->cycles.median, b);
+    r->cycles.p90 = sub_clamp(r->cycles.p90, b);
+    r->cycles.mean = sub_clamp(r->cycles.mean, b);
+
+    double bns = base->ns.median;
+
+    r->ns.min = sub_clamp(r->ns.min, bns);
+    r->ns.median = sub_clamp(r->ns.median, bns);
+    r->ns.p90 = sub_clamp(r->ns.p90, bns);
+    r->ns.mean = sub_clamp(r->ns.mean, bns);
+
+    for (int ei=0; ei<PC_NUM_EVENT; ei++) {
+        r->counters[ei] = sub_clamp(r->counters[ei], base->counters[ei]);
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef MEASURE_H
+#define MEASURE_H
+
+#include "perf_counter.h"
+
+struct measure_config {
+    int num_rep;                /* timed repetitions */
+    int min_warmup;
+    int max_warmup;
+    double warmup_tolerance;    /* warm-up ends when last 3 runs are within this ratio */
+    double outlier_mad;         /* reject samples farther than this * MAD from median */
+    double cv_threshold;        /* flag row as unstable above this coefficient of variation */
+};
+
+extern struct measure_config measure_config;
+
+struct measure_stat {
+    double min;
+    double median;
+    double p90;
+    double mad;                 /* median absolute deviation */
+    double mean;                /* of samples after outlier rejection */
+    double cv;                  /* of samples after outlier rejection */
+    int num_outlier;
+};
+
+struct measure_result {
+    struct measure_stat cycles;
+    struct measure_stat ns;     /* wall clock of each run */
+
+    /* per event median of each repetition */
+    double counters[PC_NUM_EVENT];
+
+    int num_warmup;
+    int num_rep;
+    int unstable;               /* cycles cv above threshold, or counters multiplexed */
+};
+
+typedef void (*measure_func_t)(void);
+
+void measure_run(struct measure_result *r, measure_func_t f);
+
+/* subtract baseline (e.g. empty loop) from r.
+ * cv and unstable flag are kept as measured.
+ */
+void measure_subtract(struct measure_result *r, const struct measure_result *base);
+
+/* CLOCK_MONOTONIC in ns */
+double measure_now_ns(void);
+
+/* v is sorted in place */
+void measure_compute_stat(struct measure_stat *ret, double *v, int n);
+
+#endif
@@ -0,0 +1,175 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "membw.h"
+#include "bench.h"
+#include "measure.h"
+#include "output.h"
+#include "cpu.h"
+#include "team.h"
+
+#ifdef EMIT_ONLY
+void
+membw_run(const struct membw_config *c)
+{
+    (void)c;
+    fprintf(stderr, "membw : not supported in EMIT_ONLY build\n");
+}
+#else
+
+struct buffers {
+    char **buf;                 /* a, b, c of each thread */
+    size_t size;                /* of each array */
+};
+
+static void
+alloc_buffer(int idx, void *arg)
+{
+    struct buffers *b = (struct buffers*)arg;
+
+    char *p = (char*)mmap(NULL, b->size*3, PROT_READ|PROT_WRITE,
+                          MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    /* first touch on own cpu */
+    memset(p, 1, b->size*3);
+
+    b->buf[idx] = p;
+}
+
+/* one (op, insn) on all threads. return 0 if op is not supported */
+static int
+run_kernel(struct team *t, const struct buffers *b, int num_thread,
+           const struct membw_config *c, enum stream_op op, enum stream_insn insn)
+{
+    size_t size = b->size;
+    int num_pass = (int)(c->bytes_per_run / size);
+    if (num_pass < 1) {
+        num_pass = 1;
+    }
+
+    struct ag_Emitter *emitters = (struct ag_Emitter*)malloc(sizeof(struct ag_Emitter) * num_thread);
+    measure_func_t *funcs = (measure_func_t*)malloc(sizeof(measure_func_t) * num_thread);
+    int num_gen = 0;
+    int ok = 1;
+    struct ag_publish_batch batch;
+
+    ag_publish_batch_init(&batch);
+
+    for (int ti=0; ti<num_thread; ti++) {
+        char *buf = b->buf[ti];
+        void *code;
+        size_t code_size;
+
+        bench_emitter_init(&emitters[ti]);
+        num_gen++;
+
+        if (bench_gen_stream(&emitters[ti], op, insn, buf, buf + size, buf + size*2,
+                             size, num_pass) < 0)
+        {
+            ok = 0;
+            break;
+        }
+
+        ag_finalize_code(&code, &code_size, &emitters[ti]);
+        ag_publish_batch_add(&batch, code, code_size);
+        funcs[ti] = (measure_func_t)ag_code_entry(&emitters[ti], code);
+    }
+
+    ag_publish_batch_commit(&batch);
+    ag_publish_batch_fini(&batch);
+
+    if (ok) {
+        int num_rep = measure_config.num_rep;
+        double *gbps = (double*)malloc(sizeof(double) * num_rep);
+        double bytes = (double)size * stream_op_num_array(op) * num_pass * num_thread;
+
+        /* warm up */
+        team_run(t, funcs);
+
+        for (int rep=0; rep<num_rep; rep++) {
+            gbps[rep] = bytes / team_run(t, funcs);
+        }
+
+        struct measure_stat st;
+        measure_compute_stat(&st, gbps, num_rep);
+
+        output_row_begin();
+        output_label("suite", "%s", "membw");
+        output_label("op", "%6s", stream_op_name_table[op]);
+        output_label("insn", "%5s", stream_insn_name_table[insn]);
+        output_value("size_kib", "%8.0f KiB", size/1024.0);
+        output_value("threads", "%2.0f threads", num_thread);
+        output_value("gbps", "%8.2f GB/s", st.median);
+        output_value("gbps_per_thread", "%7.2f GB/s/thread", st.median/num_thread);
+        output_value("gbps_max", "max=%8.2f", gbps[num_rep-1]); /* sorted by measure_compute_stat */
+        output_value("cv_percent", "CV=%5.2f%%", st.cv*100.0);
+        output_flag("unstable", st.cv > measure_config.cv_threshold);
+        output_row_end();
+
+        free(gbps);
+    }
+
+    for (int ti=0; ti<num_gen; ti++) {
+        ag_emitter_fini(&emitters[ti]);
+    }
+    free(emitters);
+    free(funcs);
+
+    return ok;
+}
+
+static void
+run_size(const int *cpus, int num_thread, size_t size, const struct membw_config *c)
+{
+    struct buffers b;
+
+    b.size = size;
+    b.buf = (char**)calloc(num_thread, sizeof(char*));
+
+    struct team *t = team_create(cpus, num_thread, alloc_buffer, &b);
+
+    for (int op=0; op<STREAM_NUM_OP; op++) {
+        for (int insn=0; insn<STREAM_NUM_INSN; insn++) {
+            run_kernel(t, &b, num_thread, c, (enum stream_op)op, (enum stream_insn)insn);
+        }
+    }
+
+    team_destroy(t);
+
+    for (int ti=0; ti<num_thread; ti++) {
+        munmap(b.buf[ti], size*3);
+    }
+    free(b.buf);
+}
+
+void
+membw_run(const struct membw_config *c)
+{
+    struct npr_varray cpus;
+    cpu_list_select(&cpus, c->cluster, c->max_thread);
+
+    for (int si=0; si<c->num_size; si++) {
+        size_t size = c->size_list[si];
+
+        if (size % STREAM_ITER_BYTES) {
+            fprintf(stderr, "membw : size %llu is not a multiple of %d\n",
+                    (unsigned long long)size, STREAM_ITER_BYTES);
+            exit(1);
+        }
+
+        output_comment("== membw : %llu KiB per array ==", (unsigned long long)(size/1024));
+
+        for (int nt=1; nt<=(int)cpus.nelem; nt++) {
+            run_size((int*)cpus.elements, nt, size, c);
+        }
+    }
+
+    npr_varray_discard(&cpus);
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef MEMBW_H
+#define MEMBW_H
+
+#include <stddef.h>
+
+/* memory bandwidth with streaming kernels (bench_gen_stream()).
+ * each thread is pinned to a distinct cpu and walks its own arrays.
+ */
+#define MEMBW_MAX_SIZE 16
+
+struct membw_config {
+    size_t size_list[MEMBW_MAX_SIZE];   /* bytes of each array, per thread */
+    int num_size;
+
+    int max_thread;             /* 0 : all selected cpus */
+    int cluster;                /* -1 : all cpus, otherwise only cpus of this cluster */
+    size_t bytes_per_run;       /* per array, per thread. num_pass = bytes_per_run / size */
+};
+
+/* 16K, 256K, 4M, 64M : roughly L1, L2, LLC, DRAM */
+#define MEMBW_DEFAULT_SIZE_LIST "16K,256K,4M,64M"
+#define MEMBW_DEFAULT_BYTES_PER_RUN (64*1024*1024)
+
+void membw_run(const struct membw_config *c);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include "memlat.h"
+#include "bench.h"
+#include "measure.h"
+#include "output.h"
+
+/* loads per loop iteration, keeps loop overhead below noise */
+#define CHASE_UNROLL 16
+
+#ifdef EMIT_ONLY
+void
+memlat_run(const struct memlat_config *c)
+{
+    (void)c;
+    fprintf(stderr, "memlat : not supported in EMIT_ONLY build\n");
+}
+#else
+
+/* xorshift32, fixed seed for reproducible ring */
+static uint32_t
+next_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/* link num_node nodes in buf into one random cycle (Sattolo's algorithm).
+ * every node is visited once per lap, so hardware prefetcher can't follow it.
+ */
+static void *
+build_ring(char *buf, size_t num_node, size_t stride)
+{
+    size_t *perm = (size_t*)malloc(sizeof(size_t) * num_node);
+    uint32_t seed = 0x12345678;
+
+    if (perm == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (size_t i=0; i<num_node; i++) {
+        perm[i] = i;
+    }
+
+    for (size_t i=num_node-1; i>0; i--) {
+        size_t j = next_rand(&seed) % i;
+        size_t t = perm[i];
+        perm[i] = perm[j];
+        perm[j] = t;
+    }
+
+    for (size_t i=0; i<num_node; i++) {
+        *(void**)(buf + i*stride) = buf + perm[i]*stride;
+    }
+
+    free(perm);
+
+    return buf;
+}
+
+static void
+run1(char *buf, size_t size, const struct memlat_config *c)
+{
+    size_t num_node = size / c->stride;
+    void *head = build_ring(buf, num_node, c->stride);
+
+    /* each run walks whole ring at least once, or footprint above
+     * num_loop * CHASE_UNROLL nodes would measure only first part of it
+     */
+    size_t num_loop = (num_node + CHASE_UNROLL - 1) / CHASE_UNROLL;
+    if (num_loop < (size_t)c->num_loop) {
+        num_loop = c->num_loop;
+    }
+
+    struct ag_Emitter e;
+    bench_emitter_init(&e);
+    bench_gen_chase(&e, head, (int)num_loop, CHASE_UNROLL);
+
+    void *code;
+    size_t code_size;
+    ag_alloc_code(&code, &code_size, &e);
+
+    struct measure_result r;
+    measure_run(&r, (measure_func_t)ag_code_entry(&e, code));
+
+    double num_load = (double)num_loop * CHASE_UNROLL;
+
+    output_row_begin();
+    output_label("suite", "%s", "memlat");
+    output_value("size_kib", "%10.0f KiB", size/1024.0);
+    output_value("stride", NULL, (double)c->stride);
+    output_value("cycles_per_load", "%8.2f cycles", r.cycles.median/num_load);
+    output_value("ns_per_load", "%8.2f ns", r.ns.median/num_load);
+    output_value("cycles_min", "min=%8.2f", r.cycles.min/num_load);
+    output_value("cv_percent", "CV=%5.2f%%", r.cycles.cv*100.0);
+    output_flag("unstable", r.unstable);
+    output_row_end();
+
+    ag_emitter_fini(&e);
+}
+
+void
+memlat_run(const struct memlat_config *c)
+{
+    if (c->stride < sizeof(void*) || c->min_size < c->stride * 2 || c->max_size < c->min_size) {
+        fprintf(stderr, "memlat : invalid size or stride\n");
+        exit(1);
+    }
+
+    char *buf = (char*)mmap(NULL, c->max_size, PROT_READ|PROT_WRITE,
+                            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+
+    output_comment("== memlat : stride = %d ==", (int)c->stride);
+
+    /* 2^n and 1.5 * 2^n, to see edge of each level */
+    for (size_t size=c->min_size; size<=c->max_size; size*=2) {
+        run1(buf, size, c);
+
+        size_t mid = size + size/2;
+        if (mid <= c->max_size) {
+            run1(buf, mid, c);
+        }
+    }
+
+    munmap(buf, c->max_size);
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef MEMLAT_H
+#define MEMLAT_H
+
+#include <stddef.h>
+
+/* load-to-use latency of memory hierarchy.
+ * each footprint is a random single cycle ring of nodes (one per stride),
+ * walked by dependent loads generated by bench_gen_chase().
+ */
+struct memlat_config {
+    size_t min_size;            /* footprint in bytes */
+    size_t max_size;
+    size_t stride;              /* distance between nodes, >= sizeof(void*) */
+    int num_loop;               /* min loop count of chase kernel, raised to cover ring */
+};
+
+#define MEMLAT_DEFAULT_MIN_SIZE (4*1024)
+#define MEMLAT_DEFAULT_MAX_SIZE (256*1024*1024)
+#define MEMLAT_DEFAULT_STRIDE 64
+#define MEMLAT_DEFAULT_NUM_LOOP 16384
+
+void memlat_run(const struct memlat_config *c);
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "mix.h"
+#include "measure.h"
+#include "output.h"
+
+#ifdef EMIT_ONLY
+void
+mix_run(const struct mix_config *c)
+{
+    (void)c;
+    fprintf(stderr, "mix : not supported in EMIT_ONLY build\n");
+}
+#else
+
+/* overlap score above this : same resource */
+#define SHARED_THRESHOLD 0.5
+
+/* cycles per instruction of mix */
+static double
+measure_mix(const struct bench_mix_item *items, int num_item, const struct mix_config *c, int *unstable)
+{
+    struct ag_Emitter e;
+    bench_emitter_init(&e);
+
+    int num_insn = bench_gen_mix(&e, items, num_item, c->num_loop, c->num_insn);
+
+    void *code;
+    size_t code_size;
+    ag_alloc_code(&code, &code_size, &e);
+
+    struct measure_result r;
+    measure_run(&r, (measure_func_t)ag_code_entry(&e, code));
+
+    if (c->subtract_loop_overhead) {
+        measure_subtract(&r, bench_loop_baseline(c->num_loop, num_insn, LT_THROUGHPUT));
+    }
+
+    ag_emitter_fini(&e);
+
+    *unstable = r.unstable;
+
+    return r.cycles.median / ((double)num_insn * c->num_loop);
+}
+
+static void
+output_single(const struct bench_mix_item *item, double cpi, int unstable)
+{
+    output_row_begin();
+    output_label("suite", "%s", "mix");
+    output_label("test", "%6s", "single");
+    output_label("name", "%40s", item->d->name);
+    output_label("regtype", "(%s)", regtype_name_table[(int)item->d->rt]);
+    output_value("cpi", "CPI=%8.2f", cpi);
+    output_value("ipc", "IPC=%8.2f", 1.0/cpi);
+    output_flag("unstable", unstable);
+    output_row_end();
+}
+
+/* sum of (ratio * cpi) : every item on one resource
+ * max of (ratio * cpi) : every item on its own resource
+ */
+static void
+predict(const struct bench_mix_item *items, const double *cpi, int num_item,
+        double *same, double *indep)
+{
+    *same = 0;
+    *indep = 0;
+
+    for (int i=0; i<num_item; i++) {
+        double c = items[i].ratio * cpi[i];
+        *same += c;
+        if (c > *indep) {
+            *indep = c;
+        }
+    }
+}
+
+/* 0 : fully overlapped, 1 : fully serialized */
+static double
+overlap_score(double group_cycles, double same, double indep)
+{
+    if (same - indep < 1e-6) {
+        return 0;
+    }
+
+    double s = (group_cycles - indep) / (same - indep);
+
+    if (s < 0) {
+        return 0;
+    }
+    if (s > 1) {
+        return 1;
+    }
+    return s;
+}
+
+static int
+find_root(int *parent, int i)
+{
+    while (parent[i] != i) {
+        i = parent[i];
+    }
+    return i;
+}
+
+void
+mix_run(const struct mix_config *c)
+{
+    const struct bench_mix_item *items = c->items;
+    int n = c->num_item;
+    double cpi[MIX_MAX_ITEM];
+    int group_size = 0;
+    int unstable;
+
+    output_comment("== mix : single ==");
+
+    for (int i=0; i<n; i++) {
+        struct bench_mix_item one = items[i];
+        one.ratio = 1;
+
+        cpi[i] = measure_mix(&one, 1, c, &unstable);
+        output_single(&items[i], cpi[i], unstable);
+
+        group_size += items[i].ratio;
+    }
+
+    output_comment("== mix : all ==");
+    {
+        double same, indep;
+        double mix_cpi = measure_mix(items, n, c, &unstable);
+        predict(items, cpi, n, &same, &indep);
+
+        double group_cycles = mix_cpi * group_size;
+
+        output_row_begin();
+        output_label("suite", "%s", "mix");
+        output_label("test", "%6s", "all");
+        output_value("ipc", "IPC=%8.2f", 1.0/mix_cpi);
+        output_value("cycles_per_group", "cycles/group=%8.2f", group_cycles);
+        output_value("pred_same", "one resource=%8.2f", same);
+        output_value("pred_indep", "separate=%8.2f", indep);
+        output_value("overlap", "serialized=%5.2f", overlap_score(group_cycles, same, indep));
+        output_flag("unstable", unstable);
+        output_row_end();
+    }
+
+    if (n < 2) {
+        return;
+    }
+
+    output_comment("== mix : pair ==");
+
+    /* union-find of items which share resource */
+    int parent[MIX_MAX_ITEM];
+    for (int i=0; i<n; i++) {
+        parent[i] = i;
+    }
+
+    for (int i=0; i<n; i++) {
+        for (int j=i+1; j<n; j++) {
+            struct bench_mix_item pair[2] = {items[i], items[j]};
+            double pair_cpi[2] = {cpi[i], cpi[j]};
+            double same, indep;
+
+            double mix_cpi = measure_mix(pair, 2, c, &unstable);
+            predict(pair, pair_cpi, 2, &same, &indep);
+
+            double group_cycles = mix_cpi * (pair[0].ratio + pair[1].ratio);
+            double score = overlap_score(group_cycles, same, indep);
+            int shared = score > SHARED_THRESHOLD;
+
+            if (shared) {
+                parent[find_root(parent, j)] = find_root(parent, i);
+            }
+
+            output_row_begin();
+            output_label("suite", "%s", "mix");
+            output_label("test", "%6s", "pair");
+            output_label("a", "%40s", pair[0].d->name);
+            output_label("b", "%40s", pair[1].d->name);
+            output_value("ipc", "IPC=%8.2f", 1.0/mix_cpi);
+            output_value("overlap", "serialized=%5.2f", score);
+            output_flag("shared", shared);
+            output_flag("unstable", unstable);
+            output_row_end();
+        }
+    }
+
+    output_comment("== mix : inferred resource groups ==");
+
+    int group_id = 0;
+    for (int i=0; i<n; i++) {
+        if (find_root(parent, i) != i) {
+            continue;
+        }
+
+        output_comment("group %d :", group_id++);
+        for (int j=0; j<n; j++) {
+            if (find_root(parent, j) == i) {
+                output_comment("    %s (%s)", items[j].d->name, regtype_name_table[(int)items[j].d->rt]);
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef MIX_H
+#define MIX_H
+
+#include "bench.h"
+
+/* instruction mix throughput.
+ * items are measured alone, all together, and in every pair.
+ * pairs which do not overlap are assumed to contend for same execution resource.
+ */
+#define MIX_MAX_ITEM 16
+
+struct mix_config {
+    struct bench_mix_item items[MIX_MAX_ITEM];
+    int num_item;
+
+    int num_loop;
+    int num_insn;               /* loop body, rounded down to multiple of sum of ratio */
+    int subtract_loop_overhead;
+};
+
+void mix_run(const struct mix_config *c);
+
+#endif
@@ -37,11 +37,7 @@ static unsigned int
 npr_bsf32(unsigned int v)
 {
 #ifdef __GNUC__
-    unsigned int ret;
-    __asm__ ("bsf %1, %0"
-             :"=r"(ret)
-             :"rm"(v));
-    return ret;
+    return __builtin_ctz(v);
 #else
     unsigned long m = v;
     unsigned long idx;
@@ -55,11 +51,7 @@ static unsigned int
 npr_bsr32(unsigned int v)
 {
 #ifdef __GNUC__
-    unsigned int ret;
-    __asm__ ("bsr %1, %0"
-             :"=r"(ret)
-             :"g"(v));
-    return ret;
+    return 31 - __builtin_clz(v);
 #else
     unsigned long m = v;
     unsigned long idx;
@@ -0,0 +1,246 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "npr/exec-mem.h"
+
+/* set when memfd or PROT_EXEC on shared mapping is refused, not retried */
+static int dual_map_unavailable;
+
+static size_t
+round_up_page(size_t size)
+{
+    size_t ps = sysconf(_SC_PAGE_SIZE);
+    return ((size + (ps-1)) / ps) * ps;
+}
+
+static int
+create_memfd(void)
+{
+#ifdef __NR_memfd_create
+    return syscall(__NR_memfd_create, "npr-exec-mem", 0);
+#else
+    return -1;
+#endif
+}
+
+static int
+alloc_dual(struct npr_exec_mem *m, size_t size)
+{
+    int fd = create_memfd();
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *rw = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (rw == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    void *rx = mmap(NULL, size, PROT_READ|PROT_EXEC, MAP_SHARED, fd, 0);
+    if (rx == MAP_FAILED) {
+        munmap(rw, size);
+        close(fd);
+        return -1;
+    }
+
+    /* mappings keep the file */
+    close(fd);
+
+    m->rw = (unsigned char*)rw;
+    m->rx = (unsigned char*)rx;
+    m->size = size;
+
+    return 0;
+}
+
+int
+npr_exec_mem_alloc(struct npr_exec_mem *m, size_t size)
+{
+    size = round_up_page(size);
+
+    if (! dual_map_unavailable) {
+        if (alloc_dual(m, size) == 0) {
+            return 0;
+        }
+        dual_map_unavailable = 1;
+    }
+
+    void *p = mmap(NULL, size, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+
+    m->rw = m->rx = (unsigned char*)p;
+    m->size = size;
+
+    return 0;
+}
+
+void
+npr_exec_mem_free(struct npr_exec_mem *m)
+{
+    munmap(m->rw, m->size);
+    if (m->rx != m->rw) {
+        munmap(m->rx, m->size);
+    }
+
+    m->rw = m->rx = NULL;
+    m->size = 0;
+}
+
+int
+npr_exec_mem_resize(struct npr_exec_mem *m, size_t new_size)
+{
+    new_size = round_up_page(new_size);
+
+    if (new_size <= m->size) {
+        return 0;
+    }
+
+    if (m->rw == m->rx) {
+        void *p = mremap(m->rw, m->size, new_size, MREMAP_MAYMOVE);
+        if (p == MAP_FAILED) {
+            return -1;
+        }
+        m->rw = m->rx = (unsigned char*)p;
+        m->size = new_size;
+        return 0;
+    }
+
+    /* memfd is closed after mapping, copy to new one */
+    struct npr_exec_mem n;
+    if (npr_exec_mem_alloc(&n, new_size) < 0) {
+        return -1;
+    }
+
+    memcpy(n.rw, m->rw, m->size);
+    npr_exec_mem_free(m);
+    *m = n;
+
+    return 0;
+}
+
+static void
+isb(void)
+{
+#if defined __aarch64__ || (defined __arm__ && __ARM_ARCH >= 7)
+    __asm__ __volatile__ ("isb" ::: "memory");
+#else
+    __asm__ __volatile__ ("" ::: "memory");
+#endif
+}
+
+#ifdef __aarch64__
+static void
+ctr_line_size(size_t *dline, size_t *iline)
+{
+    uint64_t ctr;
+    __asm__ __volatile__ ("mrs %0, ctr_el0" : "=r"(ctr));
+    *dline = 4 << ((ctr >> 16) & 0xf);
+    *iline = 4 << (ctr & 0xf);
+}
+
+static void
+sync_merged(const struct npr_exec_range *r, int n)
+{
+    size_t dline, iline;
+    ctr_line_size(&dline, &iline);
+
+    for (int i=0; i<n; i++) {
+        uintptr_t p = (uintptr_t)r[i].begin & ~(dline-1);
+        for (; p<(uintptr_t)r[i].end; p+=dline) {
+            __asm__ __volatile__ ("dc cvau, %0" :: "r"(p) : "memory");
+        }
+    }
+    __asm__ __volatile__ ("dsb ish" ::: "memory");
+
+    for (int i=0; i<n; i++) {
+        uintptr_t p = (uintptr_t)r[i].begin & ~(iline-1);
+        for (; p<(uintptr_t)r[i].end; p+=iline) {
+            __asm__ __volatile__ ("ic ivau, %0" :: "r"(p) : "memory");
+        }
+    }
+    __asm__ __volatile__ ("dsb ish" ::: "memory");
+    isb();
+}
+#else
+static void
+sync_merged(const struct npr_exec_range *r, int n)
+{
+    /* arm linux : cacheflush syscall does clean+invalidate+barrier per range.
+     * x86 : no-op */
+    for (int i=0; i<n; i++) {
+        __builtin___clear_cache((char*)r[i].begin, (char*)r[i].end);
+    }
+    __sync_synchronize();
+    isb();
+}
+#endif
+
+static int
+range_cmp(const void *a, const void *b)
+{
+    uintptr_t pa = (uintptr_t)((const struct npr_exec_range*)a)->begin;
+    uintptr_t pb = (uintptr_t)((const struct npr_exec_range*)b)->begin;
+
+    if (pa < pb) {
+        return -1;
+    }
+    return pa > pb;
+}
+
+void
+npr_exec_sync_ranges(struct npr_exec_range *ranges, int num_range)
+{
+    if (num_range <= 0) {
+        return;
+    }
+
+    qsort(ranges, num_range, sizeof(ranges[0]), range_cmp);
+
+    /* merge overlapping and adjacent ranges */
+    int n = 0;
+    for (int i=1; i<num_range; i++) {
+        if ((uintptr_t)ranges[i].begin <= (uintptr_t)ranges[n].end) {
+            if ((uintptr_t)ranges[i].end > (uintptr_t)ranges[n].end) {
+                ranges[n].end = ranges[i].end;
+            }
+        } else {
+            ranges[++n] = ranges[i];
+        }
+    }
+
+    sync_merged(ranges, n+1);
+}
+
+void
+npr_exec_mem_publish(const struct npr_exec_mem *m, size_t offset, size_t size)
+{
+    struct npr_exec_range r;
+    r.begin = m->rx + offset;
+    r.end = m->rx + offset + size;
+    npr_exec_sync_ranges(&r, 1);
+}
+
+void
+npr_exec_mem_acquire(void)
+{
+    isb();
+}
+
+int
+npr_exec_mem_is_dual(const struct npr_exec_mem *m)
+{
+    return m->rw != m->rx;
+}
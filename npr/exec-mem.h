@@ -0,0 +1,59 @@
+#ifndef NPR_EXEC_MEM_H
+#define NPR_EXEC_MEM_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* executable memory without writable+executable pages.
+ *
+ * one memfd is mapped twice : rw for code generation, rx to run it.
+ * if memfd or shared executable mapping is refused, falls back to
+ * one RWX mapping (rw == rx).
+ */
+struct npr_exec_mem {
+    unsigned char *rw;
+    unsigned char *rx;
+    size_t size;
+};
+
+/* size is rounded up to page size. return negative on error */
+int npr_exec_mem_alloc(struct npr_exec_mem *m, size_t size);
+void npr_exec_mem_free(struct npr_exec_mem *m);
+
+/* grow to new_size, keeping contents. rw and rx may move */
+int npr_exec_mem_resize(struct npr_exec_mem *m, size_t new_size);
+
+/* make code written to rw[offset, offset+size) visible to instruction fetch from rx */
+void npr_exec_mem_publish(const struct npr_exec_mem *m, size_t offset, size_t size);
+
+/* address range in rx view, [begin, end) */
+struct npr_exec_range {
+    void *begin;
+    void *end;
+};
+
+/* publish many ranges at once.
+ * D-cache clean to PoU for all ranges, one barrier, I-cache invalidate
+ * for all ranges, one barrier + ISB. ranges are sorted and merged in place.
+ */
+void npr_exec_sync_ranges(struct npr_exec_range *ranges, int num_range);
+
+/* context synchronization (ISB) on the calling thread.
+ * a thread that did not publish the code must call this after it
+ * observed the publication (through lock, barrier, ..) and before jumping to it.
+ */
+void npr_exec_mem_acquire(void);
+
+/* 1 if rw and rx are different mappings */
+int npr_exec_mem_is_dual(const struct npr_exec_mem *m);
+
+#define NPR_EXEC_MEM_RX(m, p) ((m)->rx + ((unsigned char*)(p) - (m)->rw))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -19,17 +19,23 @@ static const int RWE = PAGE_EXECUTE_READWRITE;
 static const int RW = PAGE_READWRITE;
 
 static uintptr_t
-alloc_page(size_t sz, int prot) {
+alloc_page(size_t sz, int prot, intptr_t *exec_delta) {
+    *exec_delta = 0;
     return (uintptr_t)VirtualAlloc(NULL, sz, MEM_COMMIT, prot);
 }
 static void
-free_page(void *p, size_t sz) {
+free_page(void *p, size_t sz, intptr_t exec_delta) {
     VirtualFree(p, sz, MEM_FREE);
 }
+static void
+publish(void *p, size_t sz) {
+    FlushInstructionCache(GetCurrentProcess(), p, sz);
+}
 
 #else
 #include <sys/mman.h>
 #include <unistd.h>
+#include "npr/exec-mem.h"
 
 
 static int get_page_size() {
@@ -38,13 +44,32 @@ static int get_page_size() {
 static const int RWE = PROT_READ | PROT_WRITE | PROT_EXEC;
 static const int RW = PROT_READ | PROT_WRITE;
 
+/* exec pages are dual mapped (W^X), see npr/exec-mem.h */
 static uintptr_t
-alloc_page(size_t sz, int prot) {
-    return (uintptr_t)mmap(NULL, sz, prot, MAP_ANON|MAP_PRIVATE, 0, 0);
+alloc_page(size_t sz, int prot, intptr_t *exec_delta) {
+    *exec_delta = 0;
+
+    if (prot == RWE) {
+        struct npr_exec_mem m;
+        if (npr_exec_mem_alloc(&m, sz) < 0) {
+            return 0;
+        }
+        *exec_delta = m.rx - m.rw;
+        return (uintptr_t)m.rw;
+    }
+
+    return (uintptr_t)mmap(NULL, sz, prot, MAP_ANON|MAP_PRIVATE, -1, 0);
 }
 static void
-free_page(void *p, size_t sz) {
+free_page(void *p, size_t sz, intptr_t exec_delta) {
     munmap(p, sz);
+    if (exec_delta) {
+        munmap((char*)p + exec_delta, sz);
+    }
+}
+static void
+publish(void *p, size_t sz) {
+    __builtin___clear_cache((char*)p, (char*)p + sz);
 }
 #endif
 
@@ -53,7 +78,6 @@ static const int SIZEOF_PAGE_HEADER = 32;
 typedef uint32_t chunksize_t;
 static const chunksize_t NEXT_ALLOCATED_BIT = 0x80000000;
 static const chunksize_t THIS_ALLOCATED_BIT = 0x40000000;
-static const chunksize_t ALLOC_BIT_MASK = 0xc0000000;
 static const chunksize_t SIZE_MASK = 0x3fffffff;
 static const int CHUNK_ALIGN = 8;
 
@@ -128,10 +152,12 @@ npr_heap_alloc(struct npr_heap *h, size_t n)
         uintptr_t page;
         struct npr_heap_page_header *ph;
         alloc_size = ALIGN_UP(alloc_size+SIZEOF_PAGE_HEADER, h->page_size);
-        page = alloc_page(alloc_size, h->flags);
+        intptr_t exec_delta;
+        page = alloc_page(alloc_size, h->flags, &exec_delta);
         ph = (struct npr_heap_page_header*)page;
         ph->flags = NPR_LARGE_CHUNK;
         ph->page_size = alloc_size;
+        ph->exec_delta = exec_delta;
         add_page(h, ph);
         return (void*)(page+SIZEOF_PAGE_HEADER);
     } else {
@@ -148,11 +174,13 @@ npr_heap_alloc(struct npr_heap *h, size_t n)
 
         /* not found */
         {
+            /* one page per chunk, chunk boundary is found by pfn_mask */
             size_t cs = h->chunk_size;
-            uintptr_t page = alloc_page(cs, h->flags);
-            h->chunk_size *= 2;
+            intptr_t exec_delta;
+            uintptr_t page = alloc_page(cs, h->flags, &exec_delta);
             ph = (struct npr_heap_page_header*)page;
             ph->flags = 0;
+            ph->exec_delta = exec_delta;
             add_page(h, ph);
             f = (struct npr_free_chunk_header*)(page+SIZEOF_PAGE_HEADER);
             f->sz = cs-SIZEOF_PAGE_HEADER;
@@ -210,7 +238,7 @@ npr_heap_free(struct npr_heap *h, void *p, size_t n)
         struct npr_heap_page_header *ph = (struct npr_heap_page_header*)(free_addr & h->pfn_mask);
         del_page(h, ph);
         alloc_size = ALIGN_UP(alloc_size+SIZEOF_PAGE_HEADER, h->page_size);
-        free_page((void*)(free_addr-SIZEOF_PAGE_HEADER), alloc_size);
+        free_page((void*)(free_addr-SIZEOF_PAGE_HEADER), alloc_size, ph->exec_delta);
         return;
     }
     free_addr = (uintptr_t)p;
@@ -306,11 +334,24 @@ npr_heap_fini(struct npr_heap *h)
     while (ph != &h->page_tail) {
         struct npr_heap_page_header *next = ph->next;
         if (ph->flags & NPR_LARGE_CHUNK) {
-            free_page(ph, ph->page_size);
+            free_page(ph, ph->page_size, ph->exec_delta);
         } else {
-            free_page(ph, h->page_size);
+            free_page(ph, h->page_size, ph->exec_delta);
         }
         ph = next;
     }
 }
 
+
+void *
+npr_heap_exec_addr(struct npr_heap *h, void *p)
+{
+    struct npr_heap_page_header *ph = (struct npr_heap_page_header*)((uintptr_t)p & h->pfn_mask);
+    return (char*)p + ph->exec_delta;
+}
+
+void
+npr_heap_publish(struct npr_heap *h, void *p, size_t n)
+{
+    publish(npr_heap_exec_addr(h, p), n);
+}
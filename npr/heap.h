@@ -13,6 +13,7 @@ struct npr_heap_page_header {
     struct npr_heap_page_header *next, *prev; /* 16 */
     int flags;                   /* 20 */
     int page_size;               /* 24 to free large chunk */
+    intptr_t exec_delta;         /* 32 executable view - this page, 0 if not dual mapped */
 };
 struct npr_free_chunk_header {
     size_t sz;
@@ -29,10 +30,19 @@ struct npr_heap {
     struct npr_heap_page_header page_head, page_tail;
 };
 
+/* is_exec : pages come from npr_exec_mem, written through returned pointer
+ *           and executed at npr_heap_exec_addr()
+ */
 void npr_heap_init(struct npr_heap *h, int is_exec);
 void npr_heap_fini(struct npr_heap *h);
 void *npr_heap_alloc(struct npr_heap *h, size_t n);
 void npr_heap_free(struct npr_heap *h, void *p, size_t n);
 void npr_heap_dump(FILE *fp, struct npr_heap *h);
 
+/* address to execute p allocated from exec heap */
+void *npr_heap_exec_addr(struct npr_heap *h, void *p);
+
+/* synchronize instruction cache after writing code to p[0, n) */
+void npr_heap_publish(struct npr_heap *h, void *p, size_t n);
+
 #endif
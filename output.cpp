@@ -0,0 +1,320 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include "output.h"
+
+#define MAX_FIELD 64
+
+enum field_type {
+    FIELD_LABEL,
+    FIELD_VALUE,
+    FIELD_FLAG,
+};
+
+struct field {
+    enum field_type type;
+    const char *key;
+    const char *text_fmt;
+    const char *str;
+    double val;
+};
+
+static enum output_format format = OUTPUT_TEXT;
+
+static struct field row[MAX_FIELD];
+static int num_field;
+
+#define MAX_CONTEXT 8
+static struct field context[MAX_CONTEXT];
+static int num_context;
+
+/* keys of last csv header */
+static const char *header_keys[MAX_FIELD];
+static int num_header_key = -1;
+
+static const char *format_name_table[] = {
+    "text",
+    "csv",
+    "json",
+};
+
+int
+output_set_format(const char *name)
+{
+    for (int i=0; i<(int)(sizeof(format_name_table)/sizeof(format_name_table[0])); i++) {
+        if (strcmp(name, format_name_table[i]) == 0) {
+            format = (enum output_format)i;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+enum output_format
+output_get_format(void)
+{
+    return format;
+}
+
+void
+output_set_context(const char *key, double val)
+{
+    for (int i=0; i<num_context; i++) {
+        if (strcmp(context[i].key, key) == 0) {
+            context[i].val = val;
+            return;
+        }
+    }
+
+    if (num_context == MAX_CONTEXT) {
+        fprintf(stderr, "too many output context\n");
+        return;
+    }
+
+    struct field *f = &context[num_context++];
+    f->type = FIELD_VALUE;
+    f->key = key;
+    f->text_fmt = NULL;
+    f->val = val;
+}
+
+void
+output_row_begin(void)
+{
+    num_field = 0;
+}
+
+static struct field *
+new_field(enum field_type type, const char *key, const char *text_fmt)
+{
+    if (num_field == MAX_FIELD) {
+        fprintf(stderr, "too many output fields\n");
+        return NULL;
+    }
+
+    struct field *f = &row[num_field++];
+    f->type = type;
+    f->key = key;
+    f->text_fmt = text_fmt;
+    return f;
+}
+
+void
+output_label(const char *key, const char *text_fmt, const char *val)
+{
+    struct field *f = new_field(FIELD_LABEL, key, text_fmt);
+    if (f) {
+        f->str = val;
+    }
+}
+
+void
+output_value(const char *key, const char *text_fmt, double val)
+{
+    struct field *f = new_field(FIELD_VALUE, key, text_fmt);
+    if (f) {
+        f->val = val;
+    }
+}
+
+void
+output_flag(const char *key, int val)
+{
+    struct field *f = new_field(FIELD_FLAG, key, "");
+    if (f) {
+        f->val = val;
+    }
+}
+
+/* isfinite() is not reliable under -ffast-math */
+static int
+is_finite(double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return ((bits >> 52) & 0x7ff) != 0x7ff;
+}
+
+static void
+print_csv_str(const char *s)
+{
+    if (strpbrk(s, ",\"\n") == NULL) {
+        fputs(s, stdout);
+        return;
+    }
+
+    putchar('"');
+    for (; *s; s++) {
+        if (*s == '"') {
+            putchar('"');
+        }
+        putchar(*s);
+    }
+    putchar('"');
+}
+
+static void
+print_json_str(const char *s)
+{
+    putchar('"');
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            putchar('\\');
+            putchar(c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static void
+append_context(void)
+{
+    for (int i=0; i<num_context && num_field < MAX_FIELD; i++) {
+        row[num_field++] = context[i];
+    }
+}
+
+static void
+row_end_text(void)
+{
+    int num_value = 0;
+
+    for (int i=0; i<num_field; i++) {
+        struct field *f = &row[i];
+        if (f->text_fmt == NULL) {
+            continue;
+        }
+
+        switch (f->type) {
+        case FIELD_LABEL:
+            printf(f->text_fmt, f->str);
+            printf(" : ");
+            break;
+
+        case FIELD_VALUE:
+            if (num_value) {
+                printf(", ");
+            }
+            printf(f->text_fmt, f->val);
+            num_value++;
+            break;
+
+        case FIELD_FLAG:
+            if (f->val) {
+                printf(" [%s]", f->key);
+            }
+            break;
+        }
+    }
+
+    printf("\n");
+}
+
+static void
+row_end_csv(void)
+{
+    int header_changed = (num_header_key != num_field);
+
+    for (int i=0; i<num_field && !header_changed; i++) {
+        header_changed = strcmp(header_keys[i], row[i].key) != 0;
+    }
+
+    if (header_changed) {
+        for (int i=0; i<num_field; i++) {
+            header_keys[i] = row[i].key;
+            printf("%s%s", i?",":"", row[i].key);
+        }
+        printf("\n");
+        num_header_key = num_field;
+    }
+
+    for (int i=0; i<num_field; i++) {
+        struct field *f = &row[i];
+        if (i) {
+            putchar(',');
+        }
+
+        if (f->type == FIELD_LABEL) {
+            print_csv_str(f->str);
+        } else if (is_finite(f->val)) {
+            printf("%.10g", f->val);
+        }
+    }
+
+    printf("\n");
+}
+
+static void
+row_end_json(void)
+{
+    putchar('{');
+
+    for (int i=0; i<num_field; i++) {
+        struct field *f = &row[i];
+        if (i) {
+            putchar(',');
+        }
+
+        print_json_str(f->key);
+        putchar(':');
+
+        switch (f->type) {
+        case FIELD_LABEL:
+            print_json_str(f->str);
+            break;
+        case FIELD_VALUE:
+            if (is_finite(f->val)) {
+                printf("%.10g", f->val);
+            } else {
+                printf("null");
+            }
+            break;
+        case FIELD_FLAG:
+            printf("%s", f->val ? "true" : "false");
+            break;
+        }
+    }
+
+    printf("}\n");
+}
+
+void
+output_row_end(void)
+{
+    append_context();
+
+    switch (format) {
+    case OUTPUT_TEXT:
+        row_end_text();
+        break;
+    case OUTPUT_CSV:
+        row_end_csv();
+        break;
+    case OUTPUT_JSON:
+        row_end_json();
+        break;
+    }
+
+    fflush(stdout);
+}
+
+void
+output_comment(const char *fmt, ...)
+{
+    if (format != OUTPUT_TEXT) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    vprintf(fmt, ap);
+    va_end(ap);
+    printf("\n");
+}
@@ -0,0 +1,35 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+enum output_format {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+/* return negative if name is unknown */
+int output_set_format(const char *name);
+enum output_format output_get_format(void);
+
+/* one result row.
+ *
+ * text : labels are joined by " : ", values by ", ", flags are appended as " [key]".
+ *        fields whose text_fmt is NULL are not shown.
+ * csv  : header line is emitted again whenever the set of keys changes.
+ * json : one object per line.
+ */
+void output_row_begin(void);
+void output_label(const char *key, const char *text_fmt, const char *val);
+void output_value(const char *key, const char *text_fmt, double val);
+void output_flag(const char *key, int val);
+void output_row_end(void);
+
+/* value added to every following row, not shown in text (e.g. cpu number).
+ * set again with same key to update.
+ */
+void output_set_context(const char *key, double val);
+
+/* text only (e.g. section header) */
+void output_comment(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
@@ -0,0 +1,224 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <linux/perf_event.h>
+#include "perf_counter.h"
+
+const char *perf_counter_name_table[PC_NUM_EVENT] = {
+    "cycles",
+    "instructions",
+    "branch-misses",
+    "l1d-misses",
+    "stalled-frontend",
+    "stalled-backend",
+};
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} event_config_table[PC_NUM_EVENT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, (PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_FRONTEND},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+};
+
+static int
+perf_event_open(struct perf_event_attr *hw_event, pid_t pid,
+                int cpu, int group_fd, unsigned long flags )
+{
+    int ret;
+
+    ret = syscall( __NR_perf_event_open, hw_event, pid, cpu,
+                   group_fd, flags );
+    return ret;
+}
+
+static int leader_fd = -1;
+static int num_opened;
+static int event_fd[PC_NUM_EVENT];
+
+/* position in group read buffer, -1 if not opened */
+static int event_index[PC_NUM_EVENT];
+
+static int
+open_event(enum perf_counter_event ev, int group_fd)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+
+    attr.type = event_config_table[ev].type;
+    attr.size = sizeof(attr);
+    attr.config = event_config_table[ev].config;
+    attr.read_format = (PERF_FORMAT_GROUP |
+                        PERF_FORMAT_TOTAL_TIME_ENABLED |
+                        PERF_FORMAT_TOTAL_TIME_RUNNING);
+
+    return perf_event_open(&attr, 0, -1, group_fd, 0);
+}
+
+static int
+lookup_event(const char *name, size_t len)
+{
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        if (strlen(perf_counter_name_table[i]) == len &&
+            strncmp(perf_counter_name_table[i], name, len) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void
+perf_counter_open(const char *list)
+{
+    int requested[PC_NUM_EVENT] = {0};
+
+    if (list == NULL) {
+        list = PERF_COUNTER_DEFAULT_EVENTS;
+    }
+
+    const char *p = list;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        if (len) {
+            int ev = lookup_event(p, len);
+            if (ev < 0) {
+                fprintf(stderr, "unknown perf event '%.*s'. available events :", (int)len, p);
+                for (int i=0; i<PC_NUM_EVENT; i++) {
+                    fprintf(stderr, " %s", perf_counter_name_table[i]);
+                }
+                fprintf(stderr, "\n");
+                exit(1);
+            }
+            requested[ev] = 1;
+        }
+
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        event_index[i] = -1;
+    }
+
+    /* cycles is required to compute CPI */
+    leader_fd = open_event(PC_CYCLES, -1);
+    if (leader_fd == -1) {
+        perror("perf_event_open");
+        exit(1);
+    }
+
+    event_index[PC_CYCLES] = 0;
+    event_fd[0] = leader_fd;
+    num_opened = 1;
+
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        if (i == PC_CYCLES || !requested[i]) {
+            continue;
+        }
+
+        int fd = open_event((enum perf_counter_event)i, leader_fd);
+        if (fd == -1) {
+            fprintf(stderr, "perf event '%s' is not available (%s), ignored\n",
+                    perf_counter_name_table[i], strerror(errno));
+            continue;
+        }
+
+        event_index[i] = num_opened;
+        event_fd[num_opened] = fd;
+        num_opened++;
+    }
+}
+
+void
+perf_counter_close(void)
+{
+    /* close members before leader */
+    for (int i=num_opened-1; i>=0; i--) {
+        close(event_fd[i]);
+    }
+
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        event_index[i] = -1;
+    }
+
+    leader_fd = -1;
+    num_opened = 0;
+}
+
+int
+perf_counter_enabled(enum perf_counter_event ev)
+{
+    return event_index[ev] != -1;
+}
+
+void
+perf_counter_read(struct perf_counter_values *ret)
+{
+    /* nr, time_enabled, time_running, values[nr] */
+    uint64_t buf[3 + PC_NUM_EVENT];
+    ssize_t size = sizeof(uint64_t) * (3 + num_opened);
+
+    ssize_t rsz = read(leader_fd, buf, size);
+    if (rsz != size) {
+        perror("read perf");
+        exit(1);
+    }
+
+    if (buf[1] != 0 && buf[2] == 0) {
+        /* group is scheduled all or nothing */
+        fprintf(stderr, "perf counter group could not be scheduled. "
+                "too many events for this cpu, reduce the event list\n");
+        exit(1);
+    }
+
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        if (event_index[i] == -1) {
+            ret->v[i] = 0;
+        } else {
+            ret->v[i] = buf[3 + event_index[i]];
+        }
+    }
+
+    ret->time_enabled = buf[1];
+    ret->time_running = buf[2];
+    ret->scaled = 0;
+}
+
+void
+perf_counter_sub(struct perf_counter_values *ret,
+                 const struct perf_counter_values *e,
+                 const struct perf_counter_values *b)
+{
+    uint64_t enabled = e->time_enabled - b->time_enabled;
+    uint64_t running = e->time_running - b->time_running;
+
+    for (int i=0; i<PC_NUM_EVENT; i++) {
+        ret->v[i] = e->v[i] - b->v[i];
+    }
+
+    ret->time_enabled = enabled;
+    ret->time_running = running;
+    ret->scaled = (running < enabled);
+
+    /* other events (nmi watchdog ..) took counters for part of interval */
+    if (ret->scaled && running != 0) {
+        double scale = (double)enabled / (double)running;
+        for (int i=0; i<PC_NUM_EVENT; i++) {
+            ret->v[i] = (uint64_t)(ret->v[i] * scale + 0.5);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <stdint.h>
+
+/* events collected together in one perf_event group.
+ * cycles is always opened, it is the group leader.
+ */
+enum perf_counter_event {
+    PC_CYCLES,
+    PC_INSTRUCTIONS,
+    PC_BRANCH_MISSES,
+    PC_L1D_MISSES,
+    PC_STALLED_FRONTEND,
+    PC_STALLED_BACKEND,
+
+    PC_NUM_EVENT
+};
+
+struct perf_counter_values {
+    uint64_t v[PC_NUM_EVENT];
+    uint64_t time_enabled;      /* ns, group was enabled / on pmu */
+    uint64_t time_running;
+    int scaled;                 /* perf_counter_sub : group was multiplexed, v is estimate */
+};
+
+extern const char *perf_counter_name_table[PC_NUM_EVENT];
+
+#define PERF_COUNTER_DEFAULT_EVENTS \
+    "cycles,instructions,branch-misses,l1d-misses,stalled-frontend,stalled-backend"
+
+/* list : comma separated event names (NULL : PERF_COUNTER_DEFAULT_EVENTS)
+ * events which are not supported by this cpu are dropped with warning.
+ */
+void perf_counter_open(const char *list);
+int perf_counter_enabled(enum perf_counter_event ev);
+
+/* hardware events are bound to the PMU of the cpu which opened them.
+ * close and open again after moving to another core type.
+ */
+void perf_counter_close(void);
+
+/* read all events by one read() */
+void perf_counter_read(struct perf_counter_values *ret);
+
+/* ret = e - b. if group was not on pmu for whole interval (multiplexed),
+ * counts are scaled by time enabled / time running and ret->scaled is set.
+ */
+void perf_counter_sub(struct perf_counter_values *ret,
+                      const struct perf_counter_values *e,
+                      const struct perf_counter_values *b);
+
+#endif
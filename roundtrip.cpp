@@ -0,0 +1,1435 @@
+#include "ag/ag_gen.h"
+#include "ag/agt32_gen.h"
+#include "ag/ag_dis.h"
+#include "ag/ag_a32enc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* encoder round trip : encode with ag_emit_* (random and exhaustive
+ * operands), decode with ag_dis_decode and compare with the operands.
+ * code is not executed, runs on any host.
+ *
+ * expected mnemonics of core instructions are written here, not taken
+ * from ag tables. NEON rows come from ag_a32.def, the decoder has its own
+ * idea of which bits are which mnemonic, a wrong field in a row shows up
+ * as a name mismatch. C++ encoders (ag_a32enc.h) must give the same word
+ * as C emitters.
+ *
+ *   ./roundtrip [seed]
+ */
+
+#define NUM_RANDOM 2000
+
+static struct ag_Emitter a32, t32;
+static int num_check, num_fail;
+
+static uint32_t rand_state = 1;
+
+static uint32_t
+rnd(void)
+{
+    /* xorshift32, same sequence on every libc */
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+/* 0..n-1 */
+static int
+rnd_n(int n)
+{
+    return rnd() % n;
+}
+
+static void
+expect_init(struct ag_dis_insn *x, enum ag_dis_form form, const char *name, int cc)
+{
+    memset(x, 0, sizeof(*x));
+    x->form = form;
+    x->name = name;
+    x->dt = "";
+    x->cc = cc;
+    x->rd = x->rn = x->rm = x->rs = -1;
+    x->vd = x->vn = x->vm = -1;
+}
+
+static void
+fail(const char *what, uint32_t inst, const char *msg)
+{
+    char text[128];
+    ag_disasm_a32(text, sizeof(text), inst, 0);
+    printf("FAIL %s : %08x (%s) : %s\n", what, inst, text, msg);
+    num_fail++;
+}
+
+#define CHECK_FIELD(f)                                                  \
+    if (got.f != x->f) {                                                \
+        snprintf(msg, sizeof(msg), #f " is %d, expected %d", (int)got.f, (int)x->f); \
+        fail(what, inst, msg);                                          \
+        return;                                                         \
+    }
+
+static void
+check(const char *what, uint32_t inst, const struct ag_dis_insn *x)
+{
+    struct ag_dis_insn got;
+    char msg[128];
+
+    num_check++;
+
+    if (ag_dis_decode(inst, &got) < 0) {
+        fail(what, inst, "not decoded");
+        return;
+    }
+
+    if (strcmp(got.name, x->name) != 0 || strcmp(got.dt, x->dt) != 0) {
+        snprintf(msg, sizeof(msg), "expected %s%s%s", x->name, x->dt[0] ? "." : "", x->dt);
+        fail(what, inst, msg);
+        return;
+    }
+
+    CHECK_FIELD(form);
+    CHECK_FIELD(cc);
+    CHECK_FIELD(s);
+    CHECK_FIELD(rd);
+    CHECK_FIELD(rn);
+    CHECK_FIELD(rm);
+    CHECK_FIELD(rs);
+    CHECK_FIELD(shift);
+    CHECK_FIELD(imm);
+    CHECK_FIELD(incr);
+    CHECK_FIELD(add);
+    CHECK_FIELD(p);
+    CHECK_FIELD(u);
+    CHECK_FIELD(w);
+    CHECK_FIELD(reg_bits);
+    CHECK_FIELD(q);
+    CHECK_FIELD(size);
+    CHECK_FIELD(vd);
+    CHECK_FIELD(vn);
+    CHECK_FIELD(vm);
+    CHECK_FIELD(nreg);
+    CHECK_FIELD(align);
+    CHECK_FIELD(to_core);
+}
+
+/* reserved encoding must not decode */
+static void
+check_reserved(const char *what, uint32_t inst)
+{
+    struct ag_dis_insn got;
+
+    num_check++;
+    if (ag_dis_decode(inst, &got) >= 0) {
+        fail(what, inst, "reserved encoding decoded");
+    }
+}
+
+/* only instruction emitted since reset */
+static uint32_t
+a32_word(void)
+{
+    if (a32.cur != 1) {
+        fprintf(stderr, "%d words emitted\n", a32.cur);
+        abort();
+    }
+    return a32.code_buffer[0];
+}
+
+/* C++ encoder gives same word as C emitter */
+static void
+check_enc(const char *what, uint32_t emitted, uint32_t enc)
+{
+    num_check++;
+    if (emitted != enc) {
+        char msg[64];
+        snprintf(msg, sizeof(msg), "C++ encoder gives %08x", enc);
+        fail(what, emitted, msg);
+    }
+}
+
+/* T32 NEON instruction, back to A32 encoding (inverse of ag_emit_simd) */
+static uint32_t
+t32_simd_word(void)
+{
+    const uint16_t *hw = (const uint16_t*)t32.code_buffer;
+    uint32_t val;
+
+    if (t32.cur != 2) {
+        fprintf(stderr, "%d halfwords emitted\n", t32.cur);
+        abort();
+    }
+
+    val = ((uint32_t)hw[0] << 16) | hw[1];
+
+    if ((val >> 24) == 0xef || (val >> 24) == 0xff) {
+        val = 0xf2000000 | (((val >> 28) & 1) << 24) | (val & 0x00ffffff);
+    } else if ((val >> 24) == 0xf9) {
+        val = 0xf4000000 | (val & 0x00ffffff);
+    }
+
+    return val;
+}
+
+static int
+rnd_shift_imm(void)
+{
+    return AG_SHIFT_AMOUNT(rnd_n(32), rnd_n(4));
+}
+
+static int
+rnd_shift(void)
+{
+    if (rnd_n(2)) {
+        return AG_SHIFT_REG(rnd_n(16), rnd_n(4));
+    }
+    return rnd_shift_imm();
+}
+
+#define DP_TEST 1
+#define DP_MOVE 2
+
+typedef void (*dp_reg_fn)(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int rm, int shift);
+typedef int (*dp_imm_fn)(struct ag_Emitter *e, enum ag_cond cc, int s, int rd, int rn, int imm);
+
+static const struct {
+    const char *name;
+    dp_reg_fn reg;
+    dp_imm_fn imm;
+    int kind;                   /* DP_TEST : always S, rd = 0. DP_MOVE : rn = 0 */
+} dp_table[] = {
+    {"and", ag_emit_and_reg, ag_emit_and_imm, 0},
+    {"eor", ag_emit_eor_reg, ag_emit_eor_imm, 0},
+    {"sub", ag_emit_sub_reg, ag_emit_sub_imm, 0},
+    {"rsb", ag_emit_rsb_reg, ag_emit_rsb_imm, 0},
+    {"add", ag_emit_add_reg, ag_emit_add_imm, 0},
+    {"adc", ag_emit_adc_reg, ag_emit_adc_imm, 0},
+    {"sbc", ag_emit_sbc_reg, ag_emit_sbc_imm, 0},
+    {"rsc", ag_emit_rsc_reg, ag_emit_rsc_imm, 0},
+    {"tst", ag_emit_tst_reg, ag_emit_tst_imm, DP_TEST},
+    {"teq", ag_emit_teq_reg, ag_emit_teq_imm, DP_TEST},
+    {"orr", ag_emit_orr_reg, ag_emit_orr_imm, 0},
+    {"mov", ag_emit_mov_reg, ag_emit_mov_imm, DP_MOVE},
+    {"bic", ag_emit_bic_reg, ag_emit_bic_imm, 0},
+    {"mvn", ag_emit_mvn_reg, ag_emit_mvn_imm, DP_MOVE},
+};
+
+static uint32_t
+ror32(uint32_t v, int n)
+{
+    n &= 31;
+    return (v >> n) | (v << ((32 - n) & 31));
+}
+
+static void
+test_data_process(void)
+{
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(dp_table)/sizeof(dp_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int cc = rnd_n(15), s = rnd_n(2), rd = rnd_n(16), rn = rnd_n(16), rm = rnd_n(16);
+            int shift = rnd_shift();
+            int kind = dp_table[i].kind;
+
+            expect_init(&x, AG_DIS_DATA_PROCESS, dp_table[i].name, cc);
+            x.s = (kind == DP_TEST) ? 1 : s;
+            x.rd = (kind == DP_TEST) ? 0 : rd;
+            x.rn = (kind == DP_MOVE) ? 0 : rn;
+            x.rm = rm;
+            x.shift = shift;
+
+            ag_emitter_reset(&a32);
+            dp_table[i].reg(&a32, (enum ag_cond)cc, s, rd, rn, rm, shift);
+            check(dp_table[i].name, a32_word(), &x);
+
+            /* any encodable immediate */
+            uint32_t imm = ror32(rnd_n(256), rnd_n(16)*2);
+
+            x.rm = -1;
+            x.shift = 0;
+            x.imm = imm;
+
+            ag_emitter_reset(&a32);
+            if (dp_table[i].imm(&a32, (enum ag_cond)cc, s, rd, rn, imm) < 0) {
+                fail(dp_table[i].name, imm, "immediate rejected");
+                continue;
+            }
+            check(dp_table[i].name, a32_word(), &x);
+        }
+    }
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        int cc = rnd_n(15), rn = rnd_n(16), rm = rnd_n(16);
+        int shift = rnd_shift();
+
+        expect_init(&x, AG_DIS_DATA_PROCESS, "cmp", cc);
+        x.s = 1;
+        x.rd = 0;
+        x.rn = rn;
+        x.rm = rm;
+        x.shift = shift;
+
+        ag_emitter_reset(&a32);
+        ag_emit_cmp_reg(&a32, (enum ag_cond)cc, rm, rn, shift);
+        check("cmp", a32_word(), &x);
+
+        x.name = "cmn";
+        ag_emitter_reset(&a32);
+        ag_emit_cmn_reg(&a32, (enum ag_cond)cc, rm, rn, shift);
+        check("cmn", a32_word(), &x);
+
+        uint32_t imm = ror32(rnd_n(256), rnd_n(16)*2);
+
+        x.rm = -1;
+        x.shift = 0;
+        x.imm = imm;
+
+        x.name = "cmp";
+        ag_emitter_reset(&a32);
+        ag_emit_cmp_imm(&a32, (enum ag_cond)cc, rn, imm);
+        check("cmp", a32_word(), &x);
+
+        x.name = "cmn";
+        ag_emitter_reset(&a32);
+        ag_emit_cmn_imm(&a32, (enum ag_cond)cc, rn, imm);
+        check("cmn", a32_word(), &x);
+    }
+}
+
+/* every imm8 ror 2n is encoded, values that are not are rejected */
+static void
+test_modified_imm(void)
+{
+    struct ag_dis_insn x;
+
+    for (int rot=0; rot<16; rot++) {
+        for (int imm8=0; imm8<256; imm8++) {
+            uint32_t v = ror32(imm8, rot*2);
+
+            expect_init(&x, AG_DIS_DATA_PROCESS, "mov", AG_COND_AL);
+            x.rd = 1;
+            x.rn = 0;
+            x.imm = v;
+
+            ag_emitter_reset(&a32);
+            if (ag_emit_mov_imm(&a32, AG_COND_AL, 0, 1, 0, v) < 0) {
+                fail("modified imm", v, "immediate rejected");
+                continue;
+            }
+            check("modified imm", a32_word(), &x);
+        }
+    }
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        uint32_t v = rnd() >> rnd_n(32);
+        int encodable = 0;
+
+        for (int rot=0; rot<16; rot++) {
+            if ((ror32(v, 32 - rot*2) & 0xffffff00) == 0) {
+                encodable = 1;
+            }
+        }
+
+        num_check++;
+        if ((ag_encode_modified_imm(v) >= 0) != encodable) {
+            fail("modified imm", v, encodable ? "encodable value rejected" : "value accepted");
+        }
+    }
+}
+
+static void
+test_mul(void)
+{
+    struct ag_dis_insn x;
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        int cc = rnd_n(15), s = rnd_n(2);
+        int rd = rnd_n(16), rm = rnd_n(16), rs = rnd_n(16), rn = rnd_n(16);
+
+        expect_init(&x, AG_DIS_MUL, "mul", cc);
+        x.s = s;
+        x.rd = rd;
+        x.rm = rm;
+        x.rs = rs;
+
+        ag_emitter_reset(&a32);
+        ag_emit_mul(&a32, (enum ag_cond)cc, s, rd, rm, rs);
+        check("mul", a32_word(), &x);
+
+        x.name = "mla";
+        x.rn = rn;
+
+        ag_emitter_reset(&a32);
+        ag_emit_mla(&a32, (enum ag_cond)cc, s, rd, rm, rs, rn);
+        check("mla", a32_word(), &x);
+    }
+}
+
+typedef void (*ldst_reg_fn)(struct ag_Emitter *e, enum ag_cond cc, int rt, int rn, int rm, int shift, int add, int incr);
+typedef void (*ldst_imm_fn)(struct ag_Emitter *e, enum ag_cond cc, int rt, int rn, int imm, int incr);
+
+static const struct {
+    const char *name;
+    ldst_reg_fn reg;
+    ldst_imm_fn imm;
+} ldst_table[] = {
+    {"ldr", ag_emit_ldr_reg, ag_emit_ldr_imm},
+    {"ldrb", ag_emit_ldrb_reg, ag_emit_ldrb_imm},
+    {"str", ag_emit_str_reg, ag_emit_str_imm},
+    {"strb", ag_emit_strb_reg, ag_emit_strb_imm},
+};
+
+static void
+test_ldst(void)
+{
+    static const int incr_table[3] = {AG_OFFSET_ADDR, AG_PRE_INCR, AG_POST_INCR};
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(ldst_table)/sizeof(ldst_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int cc = rnd_n(15), rt = rnd_n(16), rn = rnd_n(16), rm = rnd_n(16);
+            int shift = rnd_shift_imm(), add = rnd_n(2), incr = incr_table[rnd_n(3)];
+            int imm = rnd_n(8191) - 4095;
+
+            expect_init(&x, AG_DIS_LDST, ldst_table[i].name, cc);
+            x.rd = rt;
+            x.rn = rn;
+            x.rm = rm;
+            x.shift = shift;
+            x.add = add;
+            x.incr = incr;
+
+            ag_emitter_reset(&a32);
+            ldst_table[i].reg(&a32, (enum ag_cond)cc, rt, rn, rm, shift, add, incr);
+            check(ldst_table[i].name, a32_word(), &x);
+
+            x.rm = -1;
+            x.shift = 0;
+            x.add = 0;
+            x.imm = imm;
+
+            ag_emitter_reset(&a32);
+            ldst_table[i].imm(&a32, (enum ag_cond)cc, rt, rn, imm, incr);
+            check(ldst_table[i].name, a32_word(), &x);
+        }
+    }
+}
+
+static void
+test_ldstm(void)
+{
+    struct ag_dis_insn x;
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        int cc = rnd_n(15), p = rnd_n(2), u = rnd_n(2), s = rnd_n(2), w = rnd_n(2);
+        int rn = rnd_n(16), reg_bits = 1 + rnd_n(0xffff);
+
+        expect_init(&x, AG_DIS_LDSTM, "ldm", cc);
+        x.p = p;
+        x.u = u;
+        x.s = s;
+        x.w = w;
+        x.rn = rn;
+        x.reg_bits = reg_bits;
+
+        ag_emitter_reset(&a32);
+        ag_emit_ldm(&a32, (enum ag_cond)cc, p, u, s, w, rn, reg_bits);
+        check("ldm", a32_word(), &x);
+
+        x.name = "stm";
+        ag_emitter_reset(&a32);
+        ag_emit_stm(&a32, (enum ag_cond)cc, p, u, s, w, rn, reg_bits);
+        check("stm", a32_word(), &x);
+
+        /* push : stmdb sp!, pop : ldmia sp! */
+        x.p = 1;
+        x.u = 0;
+        x.s = 0;
+        x.w = 1;
+        x.rn = AG_SP;
+        ag_emitter_reset(&a32);
+        ag_emit_push(&a32, (enum ag_cond)cc, reg_bits);
+        check("push", a32_word(), &x);
+
+        x.name = "ldm";
+        x.p = 0;
+        x.u = 1;
+        ag_emitter_reset(&a32);
+        ag_emit_pop(&a32, (enum ag_cond)cc, reg_bits);
+        check("pop", a32_word(), &x);
+    }
+}
+
+static void
+test_misc(void)
+{
+    struct ag_dis_insn x;
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        int cc = rnd_n(15), rd = rnd_n(16), rm = rnd_n(16), rn = rnd_n(16);
+        int imm16 = rnd_n(0x10000);
+
+        expect_init(&x, AG_DIS_LDSTEX, "ldrex", cc);
+        x.rd = rd;
+        x.rn = rn;
+        ag_emitter_reset(&a32);
+        ag_emit_ldrex(&a32, (enum ag_cond)cc, rd, rn);
+        check("ldrex", a32_word(), &x);
+
+        x.name = "strex";
+        x.rm = rm;
+        ag_emitter_reset(&a32);
+        ag_emit_strex(&a32, (enum ag_cond)cc, rd, rm, rn);
+        check("strex", a32_word(), &x);
+
+        expect_init(&x, AG_DIS_MOVW, "movw", cc);
+        x.rd = rd;
+        x.imm = imm16;
+        ag_emitter_reset(&a32);
+        ag_emit_movw(&a32, (enum ag_cond)cc, rd, imm16);
+        check("movw", a32_word(), &x);
+
+        x.name = "movt";
+        ag_emitter_reset(&a32);
+        ag_emit_movt(&a32, (enum ag_cond)cc, rd, imm16);
+        check("movt", a32_word(), &x);
+
+        expect_init(&x, AG_DIS_BX, "bx", cc);
+        x.rm = rm;
+        ag_emitter_reset(&a32);
+        ag_emit_bx(&a32, (enum ag_cond)cc, rm);
+        check("bx", a32_word(), &x);
+    }
+}
+
+static const char *const cond_suffix[15] = {
+    "eq", "ne", "cs", "cc", "mi", "pl", "vs", "vc",
+    "hi", "ls", "ge", "lt", "gt", "le", "",
+};
+
+/* b/bl over k instructions, forward and backward. offsets are fixed by ag_alloc_code */
+static void
+test_branch(void)
+{
+    static const int dist_table[] = {0, 1, 2, 100, 4095, 100000};
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(dist_table)/sizeof(dist_table[0]); i++) {
+        int k = dist_table[i];
+        int cc = rnd_n(15), l = rnd_n(2);
+        void *code;
+        size_t size;
+
+        ag_emitter_reset(&a32);
+        ag_label_id_t fwd = ag_alloc_label(&a32, NULL);
+        ag_label_id_t back = ag_emit_new_label(&a32, NULL);
+
+        ag_emit_branch(&a32, (enum ag_cond)cc, l, fwd);
+        for (int j=0; j<k; j++) {
+            ag_emit_mov_reg(&a32, AG_COND_AL, 0, 0, 0, 0, 0);
+        }
+        ag_emit_label(&a32, fwd);
+        ag_emit_branch(&a32, (enum ag_cond)cc, l, back);
+
+        ag_alloc_code(&code, &size, &a32);
+        const uint32_t *w = (const uint32_t*)code;
+
+        /* word 0 -> k+1, k+1 -> 0 */
+        expect_init(&x, AG_DIS_BRANCH, l ? "bl" : "b", cc);
+        x.imm = k + 1 - 2;
+        check("b forward", w[0], &x);
+
+        x.imm = -(k + 1) - 2;
+        check("b backward", w[k+1], &x);
+
+        /* formatted target */
+        char text[64], expect[64];
+        ag_disasm_a32(text, sizeof(text), w[0], (uintptr_t)&w[0]);
+        snprintf(expect, sizeof(expect), "%s%s 0x%lx", l ? "bl" : "b", cond_suffix[cc],
+                 (unsigned long)(uintptr_t)&w[k+1]);
+        num_check++;
+        if (strcmp(text, expect) != 0) {
+            fail("b target", w[0], expect);
+        }
+    }
+}
+
+/* long bl out of branch range is "add lr, pc, #0; ldr pc, =target".
+ * pool flushes while the long bls are emitted, some of them land on
+ * the bl. lr must point after the ldr, pool is never between the two.
+ */
+static void
+test_long_bl(void)
+{
+    const uint32_t add_lr = 0xe28fe000;
+    int num_pair = 0;
+    void *code;
+    size_t size;
+
+    ag_emitter_reset(&a32);
+    ag_label_id_t back = ag_emit_new_label(&a32, NULL);
+
+    /* out of bl range (+-32MiB) */
+    for (int j=0; j<(1<<23); j++) {
+        ag_emit_mov_reg(&a32, AG_COND_AL, 0, 0, 0, 0, 0);
+    }
+
+    /* single words between bls, flush point falls on both words of pair */
+    for (int j=0; j<4000; j++) {
+        ag_emit_bl(&a32, AG_COND_AL, back);
+        if (j % 3 == 0) {
+            ag_emit_mov_reg(&a32, AG_COND_AL, 0, 0, 0, 0, 0);
+        }
+    }
+
+    ag_alloc_code(&code, &size, &a32);
+    const uint32_t *w = (const uint32_t*)code;
+    size_t n = size / 4;
+
+    for (size_t i=(1<<23); i+1<n; i++) {
+        if (w[i] != add_lr) {
+            continue;
+        }
+
+        struct ag_dis_insn got;
+        num_pair++;
+        num_check++;
+        if (ag_dis_decode(w[i+1], &got) < 0 || strcmp(got.name, "ldr") != 0 ||
+            got.rd != AG_PC || got.rn != AG_PC)
+        {
+            fail("long bl", w[i+1], "add lr, pc, #0 not followed by ldr pc, [pc, ...]");
+        }
+    }
+
+    num_check++;
+    if (num_pair != 4000) {
+        fprintf(stderr, "%d long bl found\n", num_pair);
+        fail("long bl", 0, "wrong number of long bl");
+    }
+}
+
+/* vr3 entry flags */
+#define VR3_NO_Q 1              /* pairwise : q = 1 is reserved */
+#define VR3_RESERVED 4
+
+typedef void (*vr3_fn)(struct ag_Emitter *e, int q, int vd, int vn, int vm);
+typedef uint32_t (*vr3_enc)(int q, int vd, int vn, int vm);
+
+/* reserved encodings have no C++ encoder */
+#define VR3_ENC_0(name, dt) ag_enc_##name##_##dt::enc
+#define VR3_ENC_1(name, dt) NULL
+
+/* form of 3DIFF regs column */
+#define VR3_FORM_L AG_DIS_VR3_LONG
+#define VR3_FORM_W AG_DIS_VR3_WIDE
+#define VR3_FORM_N AG_DIS_VR3_NARROW
+
+#define VR3_3SAME_ENTRY(dt, size, rsv, name, U, A, B, C, regs, isa)     \
+    {ag_emit_##name##_##dt, VR3_ENC_##rsv(name, dt), #name, #dt, size,  \
+     (rsv ? VR3_RESERVED : 0) | (AG_NEON_Q_OK_##regs ? 0 : VR3_NO_Q),   \
+     AG_DIS_VR3, 0, 0, 0},
+#define VR3_3DIFF_ENTRY(dt, size, rsv, name, U, A, regs, isa)           \
+    {ag_emit_##name##_##dt, VR3_ENC_##rsv(name, dt), #name, #dt, size,  \
+     (rsv ? VR3_RESERVED : 0) | VR3_NO_Q, VR3_FORM_##regs,              \
+     AG_NEON_QD_##regs, AG_NEON_QN_##regs, AG_NEON_QM_##regs},
+
+static const struct {
+    vr3_fn fn;
+    vr3_enc enc;
+    const char *name;
+    const char *dt;
+    int size;
+    int flags;
+    enum ag_dis_form form;
+    int qd, qn, qm;             /* 3DIFF : operand is q register */
+} vr3_table[] = {
+#define AG_NEON_3SAME(name, dt, ...) AG_NEON_DT_##dt(VR3_3SAME_ENTRY, name, __VA_ARGS__)
+#define AG_NEON_3DIFF(name, dt, ...) AG_NEON_DT_##dt(VR3_3DIFF_ENTRY, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+};
+
+/* random d register number, even if q */
+static int
+rnd_dreg(int q)
+{
+    return rnd_n(32) & ~q;
+}
+
+static void
+test_vr3(void)
+{
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(vr3_table)/sizeof(vr3_table[0]); i++) {
+        int flags = vr3_table[i].flags;
+
+        if (flags & VR3_RESERVED) {
+            ag_emitter_reset(&a32);
+            vr3_table[i].fn(&a32, 0, 0, 1, 2);
+            check_reserved(vr3_table[i].name, a32_word());
+            continue;
+        }
+
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int q = (flags & VR3_NO_Q) ? 0 : rnd_n(2);
+            int nreg = q ? 16 : 32;
+            int vd = rnd_n(nreg), vn = rnd_n(nreg), vm = rnd_n(nreg);
+
+            vd &= ~vr3_table[i].qd;
+            vn &= ~vr3_table[i].qn;
+            vm &= ~vr3_table[i].qm;
+
+            expect_init(&x, vr3_table[i].form, vr3_table[i].name, 15);
+            x.dt = vr3_table[i].dt;
+            x.size = vr3_table[i].size;
+            x.q = q;
+            x.vd = q ? vd*2 : vd;
+            x.vn = q ? vn*2 : vn;
+            x.vm = q ? vm*2 : vm;
+
+            ag_emitter_reset(&a32);
+            vr3_table[i].fn(&a32, q, vd, vn, vm);
+            check(vr3_table[i].name, a32_word(), &x);
+            check_enc(vr3_table[i].name, a32_word(), vr3_table[i].enc(q, vd, vn, vm));
+
+            ag_emitter_reset(&t32);
+            vr3_table[i].fn(&t32, q, vd, vn, vm);
+            check(vr3_table[i].name, t32_simd_word(), &x);
+        }
+    }
+}
+
+typedef void (*vdup_fn)(struct ag_Emitter *e, enum ag_cond cc, int q, int vd, int rt);
+typedef uint32_t (*vdup_enc)(enum ag_cond cc, int q, int vd, int rt);
+
+static void
+test_vdup_vcvt(void)
+{
+    static const struct {
+        vdup_fn fn;
+        vdup_enc enc;
+        const char *dt;
+        int size;
+    } vdup_table[] = {
+        {ag_emit_vdup8, ag_enc_vdup8::enc, "8", 0},
+        {ag_emit_vdup16, ag_enc_vdup16::enc, "16", 1},
+        {ag_emit_vdup32, ag_enc_vdup32::enc, "32", 2},
+    };
+    struct ag_dis_insn x;
+
+    for (int i=0; i<3; i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int cc = rnd_n(15), q = rnd_n(2), rt = rnd_n(15);
+            int vd = rnd_n(32) & ~q;
+
+            expect_init(&x, AG_DIS_VDUP, "vdup", cc);
+            x.dt = vdup_table[i].dt;
+            x.size = vdup_table[i].size;
+            x.q = q;
+            x.vd = vd;
+            x.rd = rt;
+
+            ag_emitter_reset(&a32);
+            vdup_table[i].fn(&a32, (enum ag_cond)cc, q, vd, rt);
+            check("vdup", a32_word(), &x);
+            check_enc("vdup", a32_word(), vdup_table[i].enc((enum ag_cond)cc, q, vd, rt));
+
+            /* no condition in T32 */
+            x.cc = AG_COND_AL;
+            ag_emitter_reset(&t32);
+            vdup_table[i].fn(&t32, AG_COND_AL, q, vd, rt);
+            check("vdup", t32_simd_word(), &x);
+        }
+    }
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        int q = rnd_n(2);
+        int vd = rnd_n(32) & ~q, vm = rnd_n(32) & ~q;
+
+        expect_init(&x, AG_DIS_VCVT, "vcvt", 15);
+        x.dt = "f32.s32";
+        x.size = 2;
+        x.q = q;
+        x.vd = vd;
+        x.vm = vm;
+
+        ag_emitter_reset(&a32);
+        ag_emit_vcvt_f32_s32(&a32, q, vd, vm);
+        check("vcvt", a32_word(), &x);
+        check_enc("vcvt", a32_word(), ag_enc_vcvt_f32_s32::enc(q, vd, vm));
+
+        ag_emitter_reset(&t32);
+        ag_emit_vcvt_f32_s32(&t32, q, vd, vm);
+        check("vcvt", t32_simd_word(), &x);
+
+        x.dt = "s32.f32";
+        ag_emitter_reset(&a32);
+        ag_emit_vcvt_s32_f32(&a32, q, vd, vm);
+        check("vcvt", a32_word(), &x);
+        check_enc("vcvt", a32_word(), ag_enc_vcvt_s32_f32::enc(q, vd, vm));
+
+        ag_emitter_reset(&t32);
+        ag_emit_vcvt_s32_f32(&t32, q, vd, vm);
+        check("vcvt", t32_simd_word(), &x);
+    }
+}
+
+/* rm of vld/vst : [rn], [rn]!, [rn], rm */
+static int
+rnd_vldst_rm(void)
+{
+    switch (rnd_n(3)) {
+    case 0:
+        return AG_VLDST_NO_WRITEBACK;
+    case 1:
+        return AG_VLDST_POST_INCR;
+    default:
+        return rnd_n(13);
+    }
+}
+
+typedef void (*vldst_fn)(struct ag_Emitter *e, int vd, int rn, int rm, int align);
+typedef int (*vldst_multi_fn)(struct ag_Emitter *e, int vd, int nreg, int rn, int rm, int align);
+typedef uint32_t (*vldst_enc)(int vd, int rn, int rm, int align);
+typedef uint32_t (*vldst_multi_enc)(int vd, int nreg, int rn, int rm, int align);
+
+static void
+test_vldst(void)
+{
+#define VLDST_LANE_ENTRY(type, size, name, nelem, L, isa)              \
+    {ag_emit_##name##nelem##_##type, ag_enc_##name##nelem##_##type::enc, \
+     #name #nelem, #type, nelem, size},
+
+    static const struct {
+        vldst_fn fn;
+        vldst_enc enc;
+        const char *name;
+        const char *dt;
+        int nelem;
+        int size;
+    } lane_table[] = {
+#define AG_NEON_LDST_LANE(...) AG_NEON_LANE_SIZES(VLDST_LANE_ENTRY, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+
+#define VLDST_MULTI_ENTRY(type, size, name, L, isa)                     \
+    {ag_emit_##name##_multi_##type, ag_enc_##name##_multi_##type::enc, #name, #type, size},
+
+    static const struct {
+        vldst_multi_fn fn;
+        vldst_multi_enc enc;
+        const char *name;
+        const char *dt;
+        int size;
+    } multi_table[] = {
+#define AG_NEON_LDST_MULTI(...) AG_NEON_MULTI_SIZES(VLDST_MULTI_ENTRY, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(lane_table)/sizeof(lane_table[0]); i++) {
+        int size = lane_table[i].size;
+
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int vd = rnd_n(33 - lane_table[i].nelem);
+            int rn = rnd_n(15), rm = rnd_vldst_rm();
+            /* lane index, no alignment, registers one apart */
+            int index_align = rnd_n(8 >> size) << (size + 1);
+
+            expect_init(&x, AG_DIS_VLDST_LANE, lane_table[i].name, 15);
+            x.dt = lane_table[i].dt;
+            x.size = size;
+            x.vd = vd;
+            x.rn = rn;
+            x.rm = rm;
+            x.nreg = lane_table[i].nelem;
+            x.align = index_align;
+
+            ag_emitter_reset(&a32);
+            lane_table[i].fn(&a32, vd, rn, rm, index_align);
+            check(lane_table[i].name, a32_word(), &x);
+            check_enc(lane_table[i].name, a32_word(), lane_table[i].enc(vd, rn, rm, index_align));
+
+            ag_emitter_reset(&t32);
+            lane_table[i].fn(&t32, vd, rn, rm, index_align);
+            check(lane_table[i].name, t32_simd_word(), &x);
+        }
+    }
+
+    for (size_t i=0; i<sizeof(multi_table)/sizeof(multi_table[0]); i++) {
+        /* valid align field by number of registers */
+        static const int max_align[5] = {0, 1, 2, 1, 3};
+
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int nreg = 1 + rnd_n(4);
+            int vd = rnd_n(33 - nreg);
+            int rn = rnd_n(15), rm = rnd_vldst_rm();
+            int align = rnd_n(max_align[nreg] + 1);
+
+            expect_init(&x, AG_DIS_VLDST_MULTI, multi_table[i].name, 15);
+            x.dt = multi_table[i].dt;
+            x.size = multi_table[i].size;
+            x.vd = vd;
+            x.rn = rn;
+            x.rm = rm;
+            x.nreg = nreg;
+            x.align = align;
+
+            ag_emitter_reset(&a32);
+            if (multi_table[i].fn(&a32, vd, nreg, rn, rm, align) < 0) {
+                fail(multi_table[i].name, 0, "rejected");
+                continue;
+            }
+            check(multi_table[i].name, a32_word(), &x);
+            check_enc(multi_table[i].name, a32_word(), multi_table[i].enc(vd, nreg, rn, rm, align));
+
+            ag_emitter_reset(&t32);
+            multi_table[i].fn(&t32, vd, nreg, rn, rm, align);
+            check(multi_table[i].name, t32_simd_word(), &x);
+        }
+
+        /* register list out of range */
+        ag_emitter_reset(&a32);
+        num_check += 2;
+        if (multi_table[i].fn(&a32, 0, 5, 0, AG_VLDST_NO_WRITEBACK, 0) >= 0 ||
+            multi_table[i].fn(&a32, 30, 3, 0, AG_VLDST_NO_WRITEBACK, 0) >= 0)
+        {
+            fail(multi_table[i].name, 0, "register list out of range accepted");
+        }
+    }
+}
+
+typedef void (*vshift_fn)(struct ag_Emitter *e, int q, int vd, int vm, int n);
+typedef uint32_t (*vshift_enc)(int q, int vd, int vm, int n);
+typedef void (*v2misc_fn)(struct ag_Emitter *e, int q, int vd, int vm);
+typedef uint32_t (*v2misc_enc)(int q, int vd, int vm);
+
+/* form of shift, 2 registers misc regs column */
+#define VSHIFT_FORM_DQ AG_DIS_VSHIFT
+#define VSHIFT_FORM_L AG_DIS_VSHIFT_LONG
+#define VSHIFT_FORM_N AG_DIS_VSHIFT_NARROW
+#define V2MISC_FORM_DQ AG_DIS_V2MISC
+#define V2MISC_FORM_Q AG_DIS_V2MISC
+#define V2MISC_FORM_N AG_DIS_V2MISC_NARROW
+
+/* q argument allowed by regs column */
+static int
+rnd_q(int d_ok, int q_ok)
+{
+    if (d_ok && q_ok) {
+        return rnd_n(2);
+    }
+    return q_ok;
+}
+
+static void
+test_vshift(void)
+{
+#define VSHIFT_ENTRY(dt, size, rsv, name, U, A, right, regs, isa)       \
+    {ag_emit_##name##_##dt, ag_enc_##name##_##dt::enc, #name, #dt, size, right, \
+     VSHIFT_FORM_##regs, AG_NEON_D_OK_##regs, AG_NEON_Q_OK_##regs,      \
+     AG_NEON_QD_##regs, AG_NEON_QM_##regs},
+
+    static const struct {
+        vshift_fn fn;
+        vshift_enc enc;
+        const char *name;
+        const char *dt;
+        int size;
+        int right;
+        enum ag_dis_form form;
+        int d_ok, q_ok, qd, qm;
+    } vshift_table[] = {
+#define AG_NEON_SHIFT(name, dt, ...) AG_NEON_DT_##dt(VSHIFT_ENTRY, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(vshift_table)/sizeof(vshift_table[0]); i++) {
+        int esize = 8 << vshift_table[i].size;
+
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int q = rnd_q(vshift_table[i].d_ok, vshift_table[i].q_ok);
+            int vd = rnd_dreg(q | vshift_table[i].qd), vm = rnd_dreg(q | vshift_table[i].qm);
+            int amount = vshift_table[i].right ? 1 + rnd_n(esize) : rnd_n(esize);
+            const char *name = vshift_table[i].name;
+
+            /* vshll #0 */
+            if (vshift_table[i].form == AG_DIS_VSHIFT_LONG && amount == 0) {
+                name = "vmovl";
+            }
+
+            expect_init(&x, vshift_table[i].form, name, 15);
+            x.dt = vshift_table[i].dt;
+            x.size = vshift_table[i].size;
+            x.q = q;
+            x.vd = vd;
+            x.vm = vm;
+            x.imm = amount;
+
+            ag_emitter_reset(&a32);
+            vshift_table[i].fn(&a32, q, vd, vm, amount);
+            check(name, a32_word(), &x);
+            check_enc(name, a32_word(), vshift_table[i].enc(q, vd, vm, amount));
+
+            ag_emitter_reset(&t32);
+            vshift_table[i].fn(&t32, q, vd, vm, amount);
+            check(name, t32_simd_word(), &x);
+        }
+    }
+}
+
+static void
+test_v2misc_vtbl(void)
+{
+#define V2MISC_ENTRY(dt, size, rsv, name, A, B, regs, isa)              \
+    {ag_emit_##name##_##dt, ag_enc_##name##_##dt::enc, #name, #dt, size, \
+     V2MISC_FORM_##regs, AG_NEON_D_OK_##regs, AG_NEON_Q_OK_##regs,      \
+     AG_NEON_QD_##regs, AG_NEON_QM_##regs},
+
+    static const struct {
+        v2misc_fn fn;
+        v2misc_enc enc;
+        const char *name;
+        const char *dt;
+        int size;
+        enum ag_dis_form form;
+        int d_ok, q_ok, qd, qm;
+    } v2misc_table[] = {
+#define AG_NEON_2MISC(name, dt, ...) AG_NEON_DT_##dt(V2MISC_ENTRY, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(v2misc_table)/sizeof(v2misc_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int q = rnd_q(v2misc_table[i].d_ok, v2misc_table[i].q_ok);
+            int vd = rnd_dreg(q | v2misc_table[i].qd), vm = rnd_dreg(q | v2misc_table[i].qm);
+
+            expect_init(&x, v2misc_table[i].form, v2misc_table[i].name, 15);
+            x.dt = v2misc_table[i].dt;
+            x.size = v2misc_table[i].size;
+            x.q = q;
+            x.vd = vd;
+            x.vm = vm;
+
+            ag_emitter_reset(&a32);
+            v2misc_table[i].fn(&a32, q, vd, vm);
+            check(v2misc_table[i].name, a32_word(), &x);
+            check_enc(v2misc_table[i].name, a32_word(), v2misc_table[i].enc(q, vd, vm));
+
+            ag_emitter_reset(&t32);
+            v2misc_table[i].fn(&t32, q, vd, vm);
+            check(v2misc_table[i].name, t32_simd_word(), &x);
+        }
+    }
+
+    static const struct {
+        int (*fn)(struct ag_Emitter *e, int vd, int vn, int nreg, int vm);
+        uint32_t (*enc)(int vd, int vn, int nreg, int vm);
+        const char *name;
+    } vtbl_table[] = {
+#define AG_NEON_VTBL(name, op, isa) {ag_emit_##name##_8, ag_enc_##name##_8::enc, #name},
+#include "ag/ag_a32.def"
+    };
+
+    for (size_t i=0; i<sizeof(vtbl_table)/sizeof(vtbl_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int nreg = 1 + rnd_n(4);
+            int vd = rnd_n(32), vn = rnd_n(33 - nreg), vm = rnd_n(32);
+
+            expect_init(&x, AG_DIS_VTBL, vtbl_table[i].name, 15);
+            x.dt = "8";
+            x.vd = vd;
+            x.vn = vn;
+            x.vm = vm;
+            x.nreg = nreg;
+
+            ag_emitter_reset(&a32);
+            if (vtbl_table[i].fn(&a32, vd, vn, nreg, vm) < 0) {
+                fail(vtbl_table[i].name, 0, "rejected");
+                continue;
+            }
+            check(vtbl_table[i].name, a32_word(), &x);
+            check_enc(vtbl_table[i].name, a32_word(), vtbl_table[i].enc(vd, vn, nreg, vm));
+
+            ag_emitter_reset(&t32);
+            vtbl_table[i].fn(&t32, vd, vn, nreg, vm);
+            check(vtbl_table[i].name, t32_simd_word(), &x);
+        }
+
+        /* table out of range */
+        ag_emitter_reset(&a32);
+        num_check += 2;
+        if (vtbl_table[i].fn(&a32, 0, 0, 5, 0) >= 0 ||
+            vtbl_table[i].fn(&a32, 0, 30, 3, 0) >= 0)
+        {
+            fail(vtbl_table[i].name, 0, "register list out of range accepted");
+        }
+    }
+}
+
+typedef void (*vfp3_fn)(struct ag_Emitter *e, enum ag_cond cc, int vd, int vn, int vm);
+typedef uint32_t (*vfp3_enc)(enum ag_cond cc, int vd, int vn, int vm);
+typedef void (*vfp2_fn)(struct ag_Emitter *e, enum ag_cond cc, int vd, int vm);
+typedef uint32_t (*vfp2_enc)(enum ag_cond cc, int vd, int vm);
+
+static void
+test_vfp(void)
+{
+#define VFP3_ENTRY(dt, sz, rsv, name, A, op, isa)                       \
+    {ag_emit_vfp_##name##_##dt, ag_enc_vfp_##name##_##dt::enc, "v" #name, #dt, sz},
+#define VFP2_ENTRY(dt, sz, rsv, name, A, B, isa)                        \
+    {ag_emit_vfp_##name##_##dt, ag_enc_vfp_##name##_##dt::enc, "v" #name, #dt, sz},
+
+    static const struct {
+        vfp3_fn fn;
+        vfp3_enc enc;
+        const char *name;
+        const char *dt;
+        int sz;
+    } vfp3_table[] = {
+#define AG_VFP_3(name, ...) AG_VFP_DT(VFP3_ENTRY, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+
+    static const struct {
+        vfp2_fn fn;
+        vfp2_enc enc;
+        const char *name;
+        const char *dt;
+        int sz;
+    } vfp2_table[] = {
+#define AG_VFP_2(name, ...) AG_VFP_DT(VFP2_ENTRY, name, __VA_ARGS__)
+#include "ag/ag_a32.def"
+    };
+    struct ag_dis_insn x;
+
+    for (size_t i=0; i<sizeof(vfp3_table)/sizeof(vfp3_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int cc = rnd_n(15), vd = rnd_n(32), vn = rnd_n(32), vm = rnd_n(32);
+
+            expect_init(&x, AG_DIS_VFP3, vfp3_table[i].name, cc);
+            x.dt = vfp3_table[i].dt;
+            x.size = vfp3_table[i].sz;
+            x.vd = vd;
+            x.vn = vn;
+            x.vm = vm;
+
+            ag_emitter_reset(&a32);
+            vfp3_table[i].fn(&a32, (enum ag_cond)cc, vd, vn, vm);
+            check(vfp3_table[i].name, a32_word(), &x);
+            check_enc(vfp3_table[i].name, a32_word(),
+                      vfp3_table[i].enc((enum ag_cond)cc, vd, vn, vm));
+
+            x.cc = AG_COND_AL;
+            ag_emitter_reset(&t32);
+            vfp3_table[i].fn(&t32, AG_COND_AL, vd, vn, vm);
+            check(vfp3_table[i].name, t32_simd_word(), &x);
+        }
+    }
+
+    for (size_t i=0; i<sizeof(vfp2_table)/sizeof(vfp2_table[0]); i++) {
+        for (int n=0; n<NUM_RANDOM; n++) {
+            int cc = rnd_n(15), vd = rnd_n(32), vm = rnd_n(32);
+
+            expect_init(&x, AG_DIS_VFP2, vfp2_table[i].name, cc);
+            x.dt = vfp2_table[i].dt;
+            x.size = vfp2_table[i].sz;
+            x.vd = vd;
+            x.vm = vm;
+
+            ag_emitter_reset(&a32);
+            vfp2_table[i].fn(&a32, (enum ag_cond)cc, vd, vm);
+            check(vfp2_table[i].name, a32_word(), &x);
+            check_enc(vfp2_table[i].name, a32_word(),
+                      vfp2_table[i].enc((enum ag_cond)cc, vd, vm));
+
+            x.cc = AG_COND_AL;
+            ag_emitter_reset(&t32);
+            vfp2_table[i].fn(&t32, AG_COND_AL, vd, vm);
+            check(vfp2_table[i].name, t32_simd_word(), &x);
+        }
+    }
+}
+
+/* vmov between core and SIMD registers, A32 with cc and T32 */
+static void
+test_vmov_core(void)
+{
+    struct ag_Emitter *es[2] = {&a32, &t32};
+    struct ag_dis_insn x;
+
+    for (int n=0; n<NUM_RANDOM; n++) {
+        for (int i=0; i<2; i++) {
+            struct ag_Emitter *e = es[i];
+            int cc = (e == &a32) ? rnd_n(15) : AG_COND_AL;
+            int rt = rnd_n(15), rt2 = (rt + 1 + rnd_n(14)) % 15;
+            int vm = rnd_n(32), sn = rnd_n(32), lane = rnd_n(2);
+            uint32_t (*word)(void) = (e == &a32) ? a32_word : t32_simd_word;
+
+            expect_init(&x, AG_DIS_VMOV_RR, "vmov", cc);
+            x.rd = rt;
+            x.rn = rt2;
+            x.vm = vm;
+            ag_emitter_reset(e);
+            ag_emit_vmov_d_rr(e, (enum ag_cond)cc, vm, rt, rt2);
+            check("vmov d, r, r", word(), &x);
+
+            x.to_core = 1;
+            ag_emitter_reset(e);
+            ag_emit_vmov_rr_d(e, (enum ag_cond)cc, rt, rt2, vm);
+            check("vmov r, r, d", word(), &x);
+
+            expect_init(&x, AG_DIS_VMOV_S, "vmov", cc);
+            x.rd = rt;
+            x.vn = sn;
+            ag_emitter_reset(e);
+            ag_emit_vmov_s_r(e, (enum ag_cond)cc, sn, rt);
+            check("vmov s, r", word(), &x);
+
+            x.to_core = 1;
+            ag_emitter_reset(e);
+            ag_emit_vmov_r_s(e, (enum ag_cond)cc, rt, sn);
+            check("vmov r, s", word(), &x);
+
+            expect_init(&x, AG_DIS_VMOV_SCALAR, "vmov", cc);
+            x.dt = "32";
+            x.rd = rt;
+            x.vn = vm;
+            x.imm = lane;
+            ag_emitter_reset(e);
+            ag_emit_vmov_32_d_r(e, (enum ag_cond)cc, vm, lane, rt);
+            check("vmov.32 d[x], r", word(), &x);
+
+            x.to_core = 1;
+            ag_emitter_reset(e);
+            ag_emit_vmov_32_r_d(e, (enum ag_cond)cc, rt, vm, lane);
+            check("vmov.32 r, d[x]", word(), &x);
+        }
+    }
+}
+
+/* vpush / vpop (not decoded by ag_dis), known words. T32 is same word */
+static void
+test_vpush_vpop(void)
+{
+    static const struct {
+        int pop;
+        int vd, n;
+        uint32_t word;          /* A32, cc = AL */
+    } table[] = {
+        {0, 8, 8, 0xed2d8b10},  /* vpush {d8-d15} */
+        {1, 8, 8, 0xecbd8b10},  /* vpop {d8-d15} */
+        {0, 16, 16, 0xed6d0b20}, /* vpush {d16-d31} */
+        {1, 31, 1, 0xecfdfb02}, /* vpop {d31} */
+    };
+
+    for (size_t i=0; i<sizeof(table)/sizeof(table[0]); i++) {
+        void (*fn)(struct ag_Emitter *, enum ag_cond, int, int) =
+            table[i].pop ? ag_emit_vpop : ag_emit_vpush;
+        const char *what = table[i].pop ? "vpop" : "vpush";
+
+        uint32_t got[2];
+        char msg[64];
+
+        ag_emitter_reset(&a32);
+        fn(&a32, AG_COND_AL, table[i].vd, table[i].n);
+        got[0] = a32_word();
+
+        ag_emitter_reset(&t32);
+        fn(&t32, AG_COND_AL, table[i].vd, table[i].n);
+        got[1] = t32_simd_word();
+
+        snprintf(msg, sizeof(msg), "expected %08x", table[i].word);
+        for (int j=0; j<2; j++) {
+            num_check++;
+            if (got[j] != table[i].word) {
+                fail(what, got[j], msg);
+            }
+        }
+    }
+}
+
+/* C++ encoders are constant expressions, words from llvm-mc */
+static_assert(ag_enc_vadd_i32::enc(1, 0, 1, 2) == 0xf2220844, "vadd.i32 q0, q1, q2");
+static_assert(ag_enc_vmla_f32::enc(0, 31, 1, 2) == 0xf241fd12, "vmla.f32 d31, d1, d2");
+static_assert(ag_enc_vsub_f32::enc(1, 1, 2, 3) == 0xf2242d46, "vsub.f32 q1, q2, q3");
+static_assert(ag_enc_vmls_i16::enc(0, 0, 1, 2) == 0xf3110902, "vmls.i16 d0, d1, d2");
+static_assert(ag_enc_vmull_s32::enc(0, 0, 1, 2) == 0xf2a10c02, "vmull.s32 q0, d1, d2");
+static_assert(ag_enc_vld1_multi_32::enc(0, 4, 0, AG_VLDST_POST_INCR, 0) == 0xf420028d,
+              "vld1.32 {d0-d3}, [r0]!");
+static_assert(ag_enc_vfma_f32::enc(1, 0, 1, 2) == 0xf2020c54, "vfma.f32 q0, q1, q2");
+static_assert(ag_enc_vqadd_u64::enc(1, 0, 1, 2) == 0xf3320054, "vqadd.u64 q0, q1, q2");
+static_assert(ag_enc_vshl_u64::enc(1, 0, 2, 1) == 0xf3340442, "vshl.u64 q0, q1, q2");
+static_assert(ag_enc_vaddw_u16::enc(0, 0, 2, 2) == 0xf3920102, "vaddw.u16 q0, q1, d2");
+static_assert(ag_enc_vaddhn_i16::enc(0, 0, 2, 4) == 0xf2820404, "vaddhn.i16 d0, q1, q2");
+static_assert(ag_enc_vqdmull_s16::enc(0, 0, 1, 2) == 0xf2910d02, "vqdmull.s16 q0, d1, d2");
+static_assert(ag_enc_vshr_u64::enc(1, 0, 2, 64) == 0xf38000d2, "vshr.u64 q0, q1, #64");
+static_assert(ag_enc_vshrn_i64::enc(0, 0, 2, 1) == 0xf2bf0812, "vshrn.i64 d0, q1, #1");
+static_assert(ag_enc_vshll_u32::enc(0, 0, 1, 0) == 0xf3a00a11, "vmovl.u32 q0, d1");
+static_assert(ag_enc_vzip_32::enc(1, 0, 2) == 0xf3ba01c2, "vzip.32 q0, q1");
+static_assert(ag_enc_vqmovn_u64::enc(0, 0, 2) == 0xf3ba02c2, "vqmovn.u64 d0, q1");
+static_assert(ag_enc_vrsqrte_f32::enc(0, 0, 1) == 0xf3bb0581, "vrsqrte.f32 d0, d1");
+static_assert(ag_enc_vtbx_8::enc(0, 1, 4, 5) == 0xf3b10b45, "vtbx.8 d0, {d1, d2, d3, d4}, d5");
+static_assert(ag_enc_vfp_add_f32::enc(AG_COND_AL, 1, 2, 3) == 0xee710a21, "vadd.f32 s1, s2, s3");
+static_assert(ag_enc_vfp_add_f64::enc(AG_COND_AL, 17, 2, 3) == 0xee721b03, "vadd.f64 d17, d2, d3");
+static_assert(ag_enc_vfp_fms_f64::enc(AG_COND_AL, 0, 1, 2) == 0xeea10b42, "vfms.f64 d0, d1, d2");
+static_assert(ag_enc_vfp_sqrt_f32::enc(AG_COND_AL, 0, 1) == 0xeeb10ae0, "vsqrt.f32 s0, s1");
+
+/* AG_EMIT_CONST emits same word as C emitter, on both ISA */
+static void
+test_emit_const(void)
+{
+    struct ag_Emitter *es[2] = {&a32, &t32};
+
+    for (int i=0; i<2; i++) {
+        struct ag_Emitter *e = es[i];
+        uint32_t word;
+
+        ag_emitter_reset(e);
+        ag_emit_vmla_f32(e, 1, 15, 1, 2);
+        ag_emit_vld1_multi_32(e, 0, 4, 0, AG_VLDST_POST_INCR, 0);
+        ag_emit_vdup32(e, AG_COND_AL, 1, 30, 14);
+
+        AG_EMIT_CONST(e, ag_enc_vmla_f32::enc(1, 15, 1, 2));
+        AG_EMIT_CONST(e, ag_enc_vld1_multi_32::enc(0, 4, 0, AG_VLDST_POST_INCR, 0));
+        AG_EMIT_CONST(e, ag_enc_vdup32::enc(AG_COND_AL, 1, 30, 14));
+
+        for (int w=0; w<3; w++) {
+            /* T32 : 2 halfwords per instruction */
+            word = e->code_buffer[w];
+            check_enc("AG_EMIT_CONST", word, e->code_buffer[w+3]);
+        }
+    }
+}
+
+/* text of a few encodings, same as llvm-mc except aliases (push, lsl ..) */
+static void
+test_format(void)
+{
+    static const struct {
+        uint32_t inst;
+        const char *text;
+    } format_table[] = {
+        {0xc0910112, "addsgt r0, r1, r2, lsl r1"},
+        {0xe0210002, "eor r0, r1, r2"},
+        {0xe1a00241, "mov r0, r1, asr #4"},
+        {0xe1a00061, "mov r0, r1, rrx"},
+        {0xe3540064, "cmp r4, #100"},
+        {0xe3e044ff, "mvn r4, #0xff000000"},
+        {0xe0200291, "mla r0, r1, r2, r0"},
+        {0xe4932080, "ldr r2, [r3], #128"},
+        {0xe5123004, "ldr r3, [r2, #-4]"},
+        {0xe7b31103, "ldr r1, [r3, r3, lsl #2]!"},
+        {0xe7031143, "str r1, [r3, -r3, asr #2]"},
+        {0xe92d0ff0, "stmdb sp!, {r4, r5, r6, r7, r8, r9, r10, r11}"},
+        {0xe8bd0ff0, "ldm sp!, {r4, r5, r6, r7, r8, r9, r10, r11}"},
+        {0xe1910f9f, "ldrex r0, [r1]"},
+        {0xe1820f91, "strex r0, r1, [r2]"},
+        {0xe30f4fff, "movw r4, #65535"},
+        {0xe12fff1e, "bx lr"},
+        {0xf2220844, "vadd.i32 q0, q1, q2"},
+        {0xf3010d12, "vmul.f32 d0, d1, d2"},
+        {0xf3a10c02, "vmull.u32 q0, d1, d2"},
+        {0xee800b10, "vdup.32 d0, r0"},
+        {0xeea00b10, "vdup.32 q0, r0"},
+        {0xf3bb0640, "vcvt.f32.s32 q0, q0"},
+        {0xf420028d, "vld1.32 {d0-d3}, [r0]!"},
+        {0xf4a4190f, "vld2.32 {d1[0], d2[0]}, [r4]"},
+        {0xf484138f, "vst4.8 {d1[4], d2[4], d3[4], d4[4]}, [r4]"},
+        {0xe4b32080, "ldrt r2, [r3], #128"},
+        {0xe1000000, NULL},     /* tst without S */
+        {0xe1a10002, NULL},     /* mov with rn */
+        {0xf3200844, "vsub.i32 q0, q0, q2"},
+        {0xf3100950, NULL},     /* vmul.p16 */
+        {0xf2220401, "vshl.s32 d0, d1, d2"},
+        {0xf2820404, "vaddhn.i16 d0, q1, q2"},
+        {0xf3920102, "vaddw.u16 q0, q1, d2"},
+        {0xf2880812, "vshrn.i16 d0, q1, #8"},
+        {0xf2890a11, "vshll.s8 q0, d1, #1"},
+        {0xf3a00a11, "vmovl.u32 q0, d1"},
+        {0xf2a00011, "vshr.s32 d0, d1, #32"},
+        {0xf3b60142, "vuzp.16 q0, q1"},
+        {0xf3ba0180, NULL},     /* vzip.32 d0, d0 */
+        {0xf3b60282, "vqmovn.s32 d0, q1"},
+        {0xf3bb0542, "vrecpe.f32 q0, q1"},
+        {0xf3b10903, "vtbl.8 d0, {d1, d2}, d3"},
+        {0xce300a81, "vaddgt.f32 s0, s1, s2"},
+        {0xee810b02, "vdiv.f64 d0, d1, d2"},
+        {0xeeb00ae0, "vabs.f32 s0, s1"},
+        {0xec421b10, "vmov d0, r1, r2"},
+        {0xec521b31, "vmov r1, r2, d17"},
+        {0xee203b10, "vmov.32 d0[1], r3"},
+        {0xee113b90, "vmov.32 r3, d17[0]"},
+        {0xee002a90, "vmov s1, r2"},
+        {0xee1f2a90, "vmov r2, s31"},
+    };
+    char text[128];
+
+    for (size_t i=0; i<sizeof(format_table)/sizeof(format_table[0]); i++) {
+        struct ag_dis_insn d;
+        uint32_t inst = format_table[i].inst;
+
+        if (format_table[i].text == NULL) {
+            check_reserved("format", inst);
+            continue;
+        }
+
+        num_check++;
+        if (ag_dis_decode(inst, &d) < 0) {
+            fail("format", inst, "not decoded");
+            continue;
+        }
+        ag_dis_format(text, sizeof(text), &d, 0);
+        if (strcmp(text, format_table[i].text) != 0) {
+            fail("format", inst, format_table[i].text);
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc > 1) {
+        rand_state = strtoul(argv[1], NULL, 0);
+        if (rand_state == 0) {
+            rand_state = 1;
+        }
+    }
+
+    printf("seed %u\n", rand_state);
+
+    ag_emitter_init(&a32);
+    agt32_emitter_init(&t32);
+
+    test_data_process();
+    test_modified_imm();
+    test_mul();
+    test_ldst();
+    test_ldstm();
+    test_misc();
+    test_branch();
+    test_long_bl();
+    test_vr3();
+    test_vdup_vcvt();
+    test_vldst();
+    test_vshift();
+    test_v2misc_vtbl();
+    test_vfp();
+    test_vmov_core();
+    test_vpush_vpop();
+    test_emit_const();
+    test_format();
+
+    ag_emitter_fini(&t32);
+    ag_emitter_fini(&a32);
+
+    printf("%d checks, %d failed\n", num_check, num_fail);
+
+    return num_fail ? 1 : 0;
+}
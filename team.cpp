@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "team.h"
+#include "cpu.h"
+#include "npr/exec-mem.h"
+
+struct member {
+    struct team *t;
+    pthread_t th;
+    int idx;
+    int cpu;
+    int pin_failed;
+};
+
+struct team {
+    int num_thread;
+    struct member *members;
+
+    void (*init)(int idx, void *arg);
+    void *arg;
+
+    /* start : main releases members to run funcs once
+     * done  : all members finished
+     */
+    pthread_barrier_t start, done;
+    const measure_func_t *funcs;  /* NULL : exit */
+};
+
+static void *
+member_main(void *p)
+{
+    struct member *m = (struct member*)p;
+    struct team *t = m->t;
+
+    if (cpu_pin(m->cpu) < 0) {
+        m->pin_failed = 1;
+    }
+
+    if (t->init) {
+        t->init(m->idx, t->arg);
+    }
+
+    pthread_barrier_wait(&t->done);
+
+    while (1) {
+        pthread_barrier_wait(&t->start);
+        if (t->funcs == NULL) {
+            break;
+        }
+        /* code may be published by main thread after this thread started */
+        npr_exec_mem_acquire();
+        t->funcs[m->idx]();
+        pthread_barrier_wait(&t->done);
+    }
+
+    return NULL;
+}
+
+struct team *
+team_create(const int *cpus, int num_thread,
+            void (*init)(int idx, void *arg), void *arg)
+{
+    struct team *t = (struct team*)malloc(sizeof(struct team));
+
+    t->num_thread = num_thread;
+    t->members = (struct member*)calloc(num_thread, sizeof(struct member));
+    t->init = init;
+    t->arg = arg;
+    t->funcs = NULL;
+
+    pthread_barrier_init(&t->start, NULL, num_thread + 1);
+    pthread_barrier_init(&t->done, NULL, num_thread + 1);
+
+    for (int i=0; i<num_thread; i++) {
+        struct member *m = &t->members[i];
+
+        m->t = t;
+        m->idx = i;
+        m->cpu = cpus[i];
+
+        if (pthread_create(&m->th, NULL, member_main, m) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    /* wait init */
+    pthread_barrier_wait(&t->done);
+
+    for (int i=0; i<num_thread; i++) {
+        if (t->members[i].pin_failed) {
+            fprintf(stderr, "cannot pin thread to cpu %d\n", t->members[i].cpu);
+        }
+    }
+
+    return t;
+}
+
+double
+team_run(struct team *t, const measure_func_t *funcs)
+{
+    t->funcs = funcs;
+
+    pthread_barrier_wait(&t->start);
+    double tb = measure_now_ns();
+    pthread_barrier_wait(&t->done);
+    double te = measure_now_ns();
+
+    return te - tb;
+}
+
+void
+team_destroy(struct team *t)
+{
+    t->funcs = NULL;
+    pthread_barrier_wait(&t->start);
+
+    for (int i=0; i<t->num_thread; i++) {
+        pthread_join(t->members[i].th, NULL);
+    }
+
+    pthread_barrier_destroy(&t->start);
+    pthread_barrier_destroy(&t->done);
+
+    free(t->members);
+    free(t);
+}
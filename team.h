@@ -0,0 +1,23 @@
+#ifndef TEAM_H
+#define TEAM_H
+
+#include <stddef.h>
+#include "measure.h"
+
+/* threads pinned to distinct cpus, each runs generated code on request.
+ * used by multi-threaded suites (membw, c2c).
+ */
+struct team;
+
+/* init(idx, arg) is called on each thread after pinning (e.g. first touch) */
+struct team *team_create(const int *cpus, int num_thread,
+                         void (*init)(int idx, void *arg), void *arg);
+
+/* run funcs[i] on thread i once, all threads start together.
+ * return ns from start to the last thread finished.
+ */
+double team_run(struct team *t, const measure_func_t *funcs);
+
+void team_destroy(struct team *t);
+
+#endif